@@ -3,6 +3,10 @@
 // Copyright (c) 2004 Mesa Dynamics, LLC.  All rights reserved.
 
 #include "CMacPDFParser.h"
+#include "CPDFCMap.h"
+#include "CPDFFontCache.h"
+#include "CMappedFile.h"
+#include "COutputSink.h"
 
 #if defined(__PowerPlant__)
 // these are used in PP-based Mesa Dynamics projects
@@ -27,28 +31,22 @@
 
 #include "UPDFMaps.h"
 
+#include <limits.h>
+
 #if defined(__PowerPlant__)
 #include <LEditText.h>
-#include <LFastArrayIterator.h>
 #include <LProgressBar.h>
 #include <LStaticText.h>
 #endif
 
-#if defined(__PowerPlant__)
-LArray* CMacPDFParser::sObjects = NULL;
-#else
-std::vector<CGPDFObjectRef> CMacPDFParser::sObjects;
-#endif
-
-long gProgress = -1;
-long gMaxProgress = 0;
-char progressStatus[256];
+const long		kPageTreeDepth		= 64;
+const long		kFormFontDepth		= 4; // forms in forms searched for a page's font
 
 CMacPDFParser::CMacPDFParser() :
 		mPDF(NULL),
 		mPage(NULL),
+		mInput(NULL),
 		mEncodeForWord(false),
-		mShowBreaks(false),
 		mPromptForPassword(true),
 		mWindow(NULL),
 		mDeletePDF(false),
@@ -164,7 +162,7 @@ CMacPDFParser::ConvertToFile(
 	}
 #endif		
 
-	gProgress = -1;
+	ReportProgress(-1, 0);
 				
 #ifdef DEBUG
 	UInt32 modifiers = ::GetCurrentKeyModifiers();
@@ -202,6 +200,12 @@ CMacPDFParser::ConvertToFile(
 			typeString = "Property List";
 			break;
 			
+		case kWriteRawText:
+			GetOutputFile(inFile, &outFile, StringLiteral_(".raw.txt"));
+			SetEncodingOut(kTextEncodingMacRoman);
+			typeString = "raw text";
+			break;
+			
 		case kWriteHTML:
 			GetOutputFile(inFile, &outFile, StringLiteral_(".html"));
 			SetEncodingOut(kCFStringEncodingWindowsLatin1);
@@ -236,6 +240,10 @@ CMacPDFParser::ConvertToFile(
 			ownerType = 'pled';
 			break;
 			
+		case kWriteRawText:
+			SetEncodingOut(kTextEncodingMacRoman);
+			break;
+			
 		case kWriteHTML:
 			SetEncodingOut(kCFStringEncodingWindowsLatin1);
 			ownerType = 'sfri';
@@ -279,9 +287,9 @@ CMacPDFParser::ConvertToFile(
             OSErr err = ::FSCreateFileUnicode(outFile, outFilename->length, outFilename->unicode, kFSCatInfoNone, NULL, &newOutFile, NULL);
             
 #if defined(Obsolete10p4)
-			OSErr err = ::FSpCreate(&outFile, ownerType,  (inType >= kWriteRTF ? 'RTF ' : 'TEXT'), smSystemScript);
+			OSErr err = ::FSpCreate(&outFile, ownerType,  (IsRTFType(inType) ? 'RTF ' : 'TEXT'), smSystemScript);
 			
-			//output->CreateNewDataFile(ownerType, (inType >= kWriteRTF ? 'RTF ' : 'TEXT'));
+			//output->CreateNewDataFile(ownerType, (IsRTFType(inType) ? 'RTF ' : 'TEXT'));
 			
 			if(outOverrideFile == false) { // 1.3
 				if(err == wrPermErr || err == kWriteProtectedErr || err == afpAccessDenied) {			
@@ -294,7 +302,7 @@ CMacPDFParser::ConvertToFile(
 						
 						output->SetSpecifier(outFile);
 						
-						err = ::FSpCreate(&outFile, ownerType,  (inType >= kWriteRTF ? 'RTF ' : 'TEXT'), smSystemScript);
+						err = ::FSpCreate(&outFile, ownerType,  (IsRTFType(inType) ? 'RTF ' : 'TEXT'), smSystemScript);
 						
 						mDesktopConvert = true;
 					}	
@@ -350,476 +358,84 @@ CMacPDFParser::ConvertToFile(
 #endif
 			}
 			else {
-				long dataBytes = 0;
-				
-				output->OpenDataFork(fsRdWrPerm);
+				char path[PATH_MAX];
 				
-				// extract all the fonts in the catalog to build our font table
-				CGPDFDictionaryRef catalog = ::CGPDFDocumentGetCatalog(mPDF);
-				if(catalog)
-					::CGPDFDictionaryApplyFunction(catalog, CatalogToFonts, this);
-				
-				ResetObjects();
+				CFileSink sink;
+				if(::FSRefMakePath(&newOutFile, (UInt8*) path, sizeof(path)) == noErr)
+					error = sink.Open(path);
+				else
+					error = kFileWriteError;
 				
-				long fontCount = GetFontCount();
-
-				// render the document, one page at a time
-				if(inType >= kWriteRTF) {
-					char header[256] = "{\\rtf1\\mac\\ansicpg10000\n";
-					
-					if(GetPadStripping() == false)
-						strcat(header, "\\viewkind1\\viewscale100\\viewzk2\n");
+				if(error == kNoError) {
+					char* title = NULL;
 					
-					if(fontCount)
-						strcat(header, "{\\fonttbl");
-
-					long bytes = strlen(header);
-					FSWrite(output->GetDataForkRefNum(), &bytes, header);
-					
-					if(fontCount) {
-						for(long i = 0; i < fontCount; i++) {
-							PDFFontObject* f = GetFont(i);
+					if(inType == kWriteHTML) {
+						CFStringRef filename = NULL;
+						if(::LSCopyDisplayNameForRef(inFile, &filename) == noErr && filename) {
+							CFIndex titleSize = ::CFStringGetMaximumSizeForEncoding(::CFStringGetLength(filename), kCFStringEncodingUTF8) + 1;
 							
-							char fontEntry[256];
-							sprintf(fontEntry, "\\f%d\\f%s\\fcharset77 %s;", (int)i, (f->family == NULL ? "nil" : f->family), f->baseFont);
-															
-							long bytes = strlen(fontEntry);
-							FSWrite(output->GetDataForkRefNum(), &bytes, fontEntry);
-						}
-						
-						{
-							char fontEntry[256];
-							sprintf(fontEntry, "\\f%d\\fmodern\\fcharset77 Courier;}", (int)fontCount);
+							title = (char*) malloc(titleSize);
+							if(title && ::CFStringGetCString(filename, title, titleSize, kCFStringEncodingUTF8) == false) {
+								free(title);
+								title = NULL;
+							}
 							
-							long bytes = strlen(fontEntry);
-							FSWrite(output->GetDataForkRefNum(), &bytes, fontEntry);
+							::CFRelease(filename);
 						}
 					}
-				}
-				else if(inType == kWriteHTML) {
-                    CFStringRef filename;
-                    ::LSCopyDisplayNameForRef(inFile, &filename);
-
-                    CFIndex buf_len = CFStringGetMaximumSizeForEncoding ( CFStringGetLength( filename ), kCFStringEncodingUTF8 ) + 1;
-                    
-                    char* title = NULL;
-                    char buffer[buf_len];
-                    
-                    Boolean success = CFStringGetCString(filename,buffer,buf_len,kCFStringEncodingUTF8);
-                    if(success)
-                        title = &(buffer[0]);
-                    else
-                        title = (char*)"Untitled";
-
-					char header[256];
-					if(mNewlineCode == kNewlineMac)
-						sprintf(header, "<html>\r<head>\r\t<meta http-equiv=\"content-type\" content=\"text/html; charset=iso-8859-1\">\r\t<meta name=\"GENERATOR\" content=\"Trapeze\">\r\t<title>%s</title>\r</head>\r", title);
-					else if(mNewlineCode == kNewlineDOS)
-						sprintf(header, "<html>\r\n<head>\r\n\t<meta http-equiv=\"content-type\" content=\"text/html; charset=iso-8859-1\">\r\n\t<meta name=\"GENERATOR\" content=\"Trapeze\">\r\n\t<title>%s</title>\r\n</head>\r\n", title);
-					else
-						sprintf(header, "<html>\n<head>\n\t<meta http-equiv=\"content-type\" content=\"text/html; charset=iso-8859-1\">\n\t<meta name=\"GENERATOR\" content=\"Trapeze\">\n\t<title>%s</title>\n</head>\n", title);
-					
-					long bytes = strlen(header);
-					FSWrite(output->GetDataForkRefNum(), &bytes, header);
-                    
-                    if(filename)
-                        CFRelease(filename);
-				}
-				
-				size_t pages = GetPageCount();
-				size_t savePages = pages;
-				
+
 #if defined(CMACPDF_SupportGUI)
-				if(mWindow && DidAbort() == false) {
-					LStr255 statusString;
-					if(inCount) {
-						statusString = "Converting ";
-						statusString += (SInt32) pages;
-						if(pages > 1)
-							statusString += " pages to ";
-						else
-							statusString += " page to ";
-						statusString += typeString;
+					if(mWindow && DidAbort() == false) {
+						LStr255 statusString;
+						if(inCount) {
+							statusString = "Converting ";
+							statusString += (SInt32) GetPageCount();
+							if(GetPageCount() > 1)
+								statusString += " pages to ";
+							else
+								statusString += " page to ";
+							statusString += typeString;
 						
-						if(mDesktopConvert)
-							statusString += " on Desktop";
-					}
-					else {
-						statusString = "Reading PDF (";
-						statusString += (SInt32) pages;
-						if(pages > 1)
-							statusString += " pages)";
-						else
-							statusString += " page)";
-					}
+							if(mDesktopConvert)
+								statusString += " on Desktop";
+						}
+						else {
+							statusString = "Reading PDF (";
+							statusString += (SInt32) GetPageCount();
+							if(GetPageCount() > 1)
+								statusString += " pages)";
+							else
+								statusString += " page)";
+						}
 										
-					status->SetDescriptor(statusString);
+						status->SetDescriptor(statusString);
 					
-					bar->SetIndeterminateFlag(false);
-					bar->SetValue(0);
-					bar->SetMaxValue(pages);
+						bar->SetIndeterminateFlag(false);
+						bar->SetValue(0);
+						bar->SetMaxValue(GetPageCount());
 
-					mWindow->UpdatePort();
+						mWindow->UpdatePort();
 					
-					UGlobalUtilities::NoSpinDelay(40);
-				}
+						UGlobalUtilities::NoSpinDelay(40);
+					}
 #endif
 
-				gProgress = 0;
-				gMaxProgress = pages;
-				
-				for(size_t i = 1; i <= pages; i++) {
-					if(DidAbort())
-						break;
-						
-					if(IsRestricted() && i >= 3)
-						pages = i;			
+					error = ConvertDocument(&sink, title);
 					
-					RenderPage(i);
+					if(error == kNoError)
+						error = sink.Close();
 					
-#if defined(CMACPDF_SupportGUI)
-					if(bar)
-						bar->SetValue(i);
-#endif
-
-					gProgress = i;
-						
-					if(inType >= kWriteRTF) {
-						char pageStart[256];
-						sprintf(pageStart, "\\plain\\pard\\li0\\sl%d\n", (int)lroundf(12.0 * 20.0 * kRTFSpacing));
-						
-						long bytes = strlen(pageStart);
-						FSWrite(output->GetDataForkRefNum(), &bytes, pageStart);
-					}
-					else if(inType == kWriteHTML) {
-						char pageStart[256];
-						if(mNewlineCode == kNewlineMac)
-							sprintf(pageStart, "\r<a name=\"page_%d\"></a>\r", (int)i);
-						else if(mNewlineCode == kNewlineDOS)
-							sprintf(pageStart, "\r\n<a name=\"page_%d\"></a>\r\n", (int)i);
-						else
-							sprintf(pageStart, "\n<a name=\"page_%d\"></a>\n", (int)i);
-							
-						long bytes = strlen(pageStart);
-						FSWrite(output->GetDataForkRefNum(), &bytes, pageStart);
-					}
-								
-					if(inType == kWriteRTFWord) {
-						if(GetPadStripping() == false) {
-							long leftMargin = GetLeftMargin();
-							if(leftMargin) {
-								char marginEntry[256];
-								sprintf(marginEntry, "\\marglsxn%d\\margrsxn%d\n", 20 * (int)leftMargin, 0 * (int)leftMargin);
-									
-								long bytes = strlen(marginEntry);
-								FSWrite(output->GetDataForkRefNum(), &bytes, marginEntry);
-							}
-							
-							long topMargin = GetTopMargin();
-							if(topMargin) {
-								char marginEntry[256];
-								sprintf(marginEntry, "\\margtsxn%d\\margbsxn%d\n", 20 * (int)topMargin, 0 * (int)topMargin);
-									
-								long bytes = strlen(marginEntry);
-								FSWrite(output->GetDataForkRefNum(), &bytes, marginEntry);
-							}
-						}
-						else {
-							char marginEntry[256] = "\\margl0\\margr0\\margt0\\margb0\n";
-							long bytes = strlen(marginEntry);
-							FSWrite(output->GetDataForkRefNum(), &bytes, marginEntry);
-						}
-						
-						/* A4 Paper Size
-						{
-							long pageWidth = GetPageWidth();
-							long pageHeight = GetPageHeight();
-							if(pageWidth && pageHeight) {
-								char pageEntry[256];
-								sprintf(pageEntry, "\\pgwsxn%d\\pghsxn%d\n", 11899, 16838);
-									
-								long bytes = strlen(pageEntry);
-								FSWrite(output->GetDataForkRefNum(), &bytes, pageEntry);
-							}
-						}*/
-						
-						long pageWidth = GetPageWidth();
-						long pageHeight = GetPageHeight();
-						if(pageWidth && pageHeight) {
-							char pageEntry[256];
-							sprintf(pageEntry, "\\pgwsxn%d\\pghsxn%d\n", 20 * (int)pageWidth, 20 * (int)pageHeight);
-								
-							long bytes = strlen(pageEntry);
-							FSWrite(output->GetDataForkRefNum(), &bytes, pageEntry);
-						}
-					}
-					else if(inType == kWriteRTF && GetPadStripping() == false) {
-						char marginEntry[256] = "\\margl0\\margr0\\margt0\\margb0\n";
-						long bytes = strlen(marginEntry);
-						FSWrite(output->GetDataForkRefNum(), &bytes, marginEntry);
-					}
-					else if(inType == kWriteHTML) {
-						if(GetPadStripping() == false) {
-							long leftMargin = GetLeftMargin();
-							if(leftMargin) {
-								char marginEntry[256];
-								if(mNewlineCode == kNewlineMac)
-									sprintf(marginEntry, "\r<blockquote width=%d>\r", (int)leftMargin);
-								else if(mNewlineCode == kNewlineDOS)
-									sprintf(marginEntry, "\r\n<blockquote width=%d\r\n", (int)leftMargin);
-								else
-									sprintf(marginEntry, "\n<blockquote width=%d>\n", (int)leftMargin);
-									
-								long bytes = strlen(marginEntry);
-								FSWrite(output->GetDataForkRefNum(), &bytes, marginEntry);
-							}
-						}
-					}
-
-					if(inType >= kWriteRTF) {
-						char* tabs = GetTabString();
+					// nothing useful was written, so leave nothing behind
+					if(error != kNoError)
+						sink.Discard();
 						
-						if(tabs) {
-							char tabEntry[256];
-							sprintf(tabEntry, "%s\n", tabs);
-							
-							long bytes = strlen(tabEntry);
-							FSWrite(output->GetDataForkRefNum(), &bytes, tabEntry);
-							
-							free(tabs);
-						}
-					}
-					else if(i == pages && GetPadStripping() == false) {
-						// todo: should probably take newline encoding into account here
-						
-						while(mDataSize > 1 && mData[mDataSize - 1] == '\n' && mData[mDataSize - 2] == '\n')
-							mDataSize--;
-					}
-															
-					if(mData) {
-						dataBytes += mDataSize;
-						FSWrite(output->GetDataForkRefNum(), &mDataSize, mData);
-				
-						free(mData);
-						mData = NULL;
-						
-						mDataSize = 0;
-					}
-
-					if(inType == kWriteHTML) {
-						if(GetPadStripping() == false) {
-							long leftMargin = GetLeftMargin();
-							if(leftMargin) {
-								char marginEntry[256];
-								if(mNewlineCode == kNewlineMac)
-									sprintf(marginEntry, "\r</blockquote>\r");		
-								else if(mNewlineCode == kNewlineDOS)
-									sprintf(marginEntry, "\r\n</blockquote>\r\n");		
-								else
-									sprintf(marginEntry, "\n</blockquote>\n");		
-												
-								long bytes = strlen(marginEntry);
-								FSWrite(output->GetDataForkRefNum(), &bytes, marginEntry);
-							}
-						}
-					}
-
-					if(i < pages) {
-						if(inType == kWriteRTFWord && GetPadStripping() == false) {
-							char pageEnd[256] = "\\sect\n";
-							long bytes = strlen(pageEnd);
-							FSWrite(output->GetDataForkRefNum(), &bytes, pageEnd);
-						}
-						else if(inType == kWriteRTF && GetPadStripping() == false) {
-							char pageEnd[256] = "\\page\n";
-							long bytes = strlen(pageEnd);
-							FSWrite(output->GetDataForkRefNum(), &bytes, pageEnd);
-						}
-						else if(mShowBreaks) {
-							if(inType >= kWriteRTF) {
-								char pageEnd[256];
-								sprintf(pageEnd, "\\plain\\li0\\f%d ------------------------------[PAGE BREAK]------------------------------\\\n", (int)fontCount);
-								long bytes = strlen(pageEnd);
-								FSWrite(output->GetDataForkRefNum(), &bytes, pageEnd);
-							}
-							else {
-								if(mType == kWriteHTML) {
-									char tag[16];
-									if(mNewlineCode == kNewlineMac)
-										sprintf(tag, "\r<pre>\r");
-									else if(mNewlineCode == kNewlineDOS)
-										sprintf(tag, "\r\n<pre>\r\n");
-									else
-										sprintf(tag, "\n<pre>\n");
-										
-									long bytes = strlen(tag);
-									FSWrite(output->GetDataForkRefNum(), &bytes, tag);
-								}
-							
-								char pageEnd[256];
-								if(mNewlineCode == kNewlineMac)
-									sprintf(pageEnd, "------------------------------[PAGE BREAK]------------------------------\r");
-								else if(mNewlineCode == kNewlineDOS)
-									sprintf(pageEnd, "------------------------------[PAGE BREAK]------------------------------\r\n");
-								else
-									sprintf(pageEnd, "------------------------------[PAGE BREAK]------------------------------\n");
-								
-								long bytes = strlen(pageEnd);
-								FSWrite(output->GetDataForkRefNum(), &bytes, pageEnd);
-							}
-
-							if(mType == kWriteHTML) {
-								char tag[16];
-								if(mNewlineCode == kNewlineMac)
-									sprintf(tag, "</pre>\r");
-								else if(mNewlineCode == kNewlineDOS)
-									sprintf(tag, "</pre>\r\n");
-								else
-									sprintf(tag, "</pre>\n");
-										
-								long bytes = strlen(tag);
-								FSWrite(output->GetDataForkRefNum(), &bytes, tag);
-							}
-							
-						}
-					}
-					else if(IsRestricted()) {
-						if(inType >= kWriteRTF) {
-							char pageEnd[256];
-							sprintf(pageEnd, "\\plain\\li0\\f%d \\\n=====================================\\\n", (int)fontCount);
-							long bytes = strlen(pageEnd);
-							FSWrite(output->GetDataForkRefNum(), &bytes, pageEnd);
-							
-							if(savePages > 3) {
-								sprintf(pageEnd, "\\plain\\f%d  Conversion limited to three pages.\\\n", (int)fontCount);
-								bytes = strlen(pageEnd);
-								FSWrite(output->GetDataForkRefNum(), &bytes, pageEnd);
-							}
-														
-							sprintf(pageEnd, "\\plain\\f%d    Thank you for trying Trapeze!\\\n", (int)fontCount);
-							bytes = strlen(pageEnd);
-							FSWrite(output->GetDataForkRefNum(), &bytes, pageEnd);
-							
-							sprintf(pageEnd, "\\plain\\f%d =====================================\\\n", (int)fontCount);
-							bytes = strlen(pageEnd);
-							FSWrite(output->GetDataForkRefNum(), &bytes, pageEnd);
-						}
-						else {
-							if(mType == kWriteHTML) {
-								char tag[16];
-								if(mNewlineCode == kNewlineMac)
-									sprintf(tag, "\r<pre>\r");
-								else if(mNewlineCode == kNewlineDOS)
-									sprintf(tag, "\r\n<pre>\r\n");
-								else
-									sprintf(tag, "\n<pre>\n");
-										
-								long bytes = strlen(tag);
-								FSWrite(output->GetDataForkRefNum(), &bytes, tag);
-							}
-							
-							char pageEnd[256];
-							if(mNewlineCode == kNewlineMac)
-								sprintf(pageEnd, "\r=====================================\r");
-							else if(mNewlineCode == kNewlineDOS)
-								sprintf(pageEnd, "\r\n=====================================\r\n");
-							else
-								sprintf(pageEnd, "\n=====================================\n");
-							
-							long bytes = strlen(pageEnd);
-							FSWrite(output->GetDataForkRefNum(), &bytes, pageEnd);
-							
-							if(savePages > 3) {
-								if(mNewlineCode == kNewlineMac)
-									sprintf(pageEnd, " Conversion limited to three pages.\r");	
-								else if(mNewlineCode == kNewlineDOS)
-									sprintf(pageEnd, " Conversion limited to three pages.\r\n");	
-								else
-									sprintf(pageEnd, " Conversion limited to three pages.\n");	
-	
-								bytes = strlen(pageEnd);
-								FSWrite(output->GetDataForkRefNum(), &bytes, pageEnd);
-							}
-															
-							if(mNewlineCode == kNewlineMac)
-								sprintf(pageEnd, "   Thank you for trying Trapeze!\r");
-							else if(mNewlineCode == kNewlineDOS)
-								sprintf(pageEnd, "   Thank you for trying Trapeze!\r\n");
-							else
-								sprintf(pageEnd, "   Thank you for trying Trapeze!\n");
-							
-							bytes = strlen(pageEnd);
-							FSWrite(output->GetDataForkRefNum(), &bytes, pageEnd);
-							
-							if(mNewlineCode == kNewlineMac)
-								sprintf(pageEnd, "=====================================\r");
-							else if(mNewlineCode == kNewlineDOS)
-								sprintf(pageEnd, "=====================================\r\n");
-							else
-								sprintf(pageEnd, "=====================================\n");
-							
-							bytes = strlen(pageEnd);
-							FSWrite(output->GetDataForkRefNum(), &bytes, pageEnd);
-
-							if(mType == kWriteHTML) {
-								char tag[16];
-								if(mNewlineCode == kNewlineMac)
-									sprintf(tag, "</pre>\r");
-								else if(mNewlineCode == kNewlineDOS)
-									sprintf(tag, "</pre>\r\n");
-								else
-									sprintf(tag, "</pre>\n");
-
-								long bytes = strlen(tag);
-								FSWrite(output->GetDataForkRefNum(), &bytes, tag);
-							}
-						}
+					if(title)
+						free(title);
 						
 #if defined(CMACPDF_SupportGUI)
-						if(savePages > 3)
-							UGlobalUtilities::NoSpinDelay(60);
+					if(IsRestricted() && GetPageCount() > 3)
+						UGlobalUtilities::NoSpinDelay(60);
 #endif
-					}
-	
-					// done with tab table
-					FreeTabs();
-				}
-				
-				if(inType >= kWriteRTF) {
-					char footer[16] = "\n}\n";
-					long bytes = strlen(footer);
-					FSWrite(output->GetDataForkRefNum(), &bytes, footer);
-				}
-				else if(inType == kWriteHTML) {
-					char footer[16];
-					if(mNewlineCode == kNewlineMac)
-						sprintf(footer, "</html>\r");
-					else if(mNewlineCode == kNewlineDOS)
-						sprintf(footer, "</html>\r\n");
-					else
-						sprintf(footer, "</html>\n");
-
-					long bytes = strlen(footer);
-					FSWrite(output->GetDataForkRefNum(), &bytes, footer);
-				}
-				
-				// done with font table
-				FreeFonts();
-				
-				// done with xobjects
-				FreeXObjects();
-				
-				// dont with encoders
-				FreeEncoders();
-				
-				if(mAbort || dataBytes == 0) {
-					output->CloseDataFork();
-					::FSDeleteObject(outFile);
-					
-					if(mAbort)
-						error = kUserAbort;
-					else
-						error = kNoTextError;
 				}
 			}
 		}
@@ -843,8 +459,115 @@ CMacPDFParser::ConvertToFile(
 	}
 #endif
 
-	gProgress = gMaxProgress;
+	ReportProgress(GetMaxProgress(), GetMaxProgress());
+
+	return error;
+}
 
+OSErr
+CMacPDFParser::ConvertPath(
+	const char* inPath,
+	long inType,
+	COutputSink* inSink,
+	const char* inTitle)
+{
+	OSErr error = OpenInput(inPath);
+	
+	if(error == kNoError)
+		error = ConvertBuffer(mInput->GetData(), mInput->GetSize(), inType, inSink, inTitle);
+		
+	CloseInput();
+	
+	return error;
+}
+
+OSErr
+CMacPDFParser::ConvertPathToOutputs(
+	const char* inPath,
+	PDFOutput* ioOutputs,
+	long inCount,
+	const char* inTitle)
+{
+	if(ioOutputs == NULL || inCount < 1)
+		return kConvertError;
+		
+	// xml and plist are built as a tree and written through LFile
+	for(long i = 0; i < inCount; i++) {
+		if(ioOutputs[i].type == kWritePropertyList || ioOutputs[i].type == kWriteXML)
+			return kConvertError;
+	}
+	
+	mWindow = NULL;
+	
+	OSErr error = OpenInput(inPath);
+	
+	if(error == kNoError) {
+		ReportProgress(-1, 0);
+		
+		error = StartConversion(mInput->GetData(), mInput->GetSize());
+		
+		if(error == kNoError)
+			error = ConvertOutputs(ioOutputs, inCount, inTitle);
+			
+		EndConversion();
+		
+		ReportProgress(GetMaxProgress(), GetMaxProgress());
+	}
+	
+	CloseInput();
+	
+	return error;
+}
+
+OSErr
+CMacPDFParser::CountPages(
+	const char* inPath,
+	size_t& outCount)
+{
+	outCount = 0;
+	
+	OSErr error = OpenInput(inPath);
+	
+	if(error == kNoError)
+		error = StartConversion(mInput->GetData(), mInput->GetSize());
+		
+	if(error == kNoError)
+		outCount = GetPageCount();
+		
+	EndConversion();
+	
+	return error;
+}
+
+OSErr
+CMacPDFParser::ConvertBuffer(
+	const void* inData,
+	size_t inSize,
+	long inType,
+	COutputSink* inSink,
+	const char* inTitle)
+{
+	// xml and plist are built as a tree and written through LFile
+	if(inType == kWritePropertyList || inType == kWriteXML)
+		return kConvertError;
+		
+	if(inSink == NULL)
+		return kFileWriteError;
+		
+	SetOutputType(inType);
+	mWindow = NULL;
+	
+	ReportProgress(-1, 0);
+
+	OSErr error = StartConversion(inData, inSize);
+	
+	if(error == kNoError)
+		error = ConvertDocument(inSink, inTitle);
+	
+	EndConversion();
+	
+	ReportProgress(GetMaxProgress(), GetMaxProgress());
+	
 	return error;
 }
 
@@ -856,6 +579,9 @@ CMacPDFParser::BeginRender(
 	float* outWidth,
 	float* outHeight)
 {
+	// each page is walked on its own, shared resources included
+	ResetObjects();
+	
 	mPage = ::CGPDFDocumentGetPage(mPDF, inPage);	
 	if(mPage == NULL)
 		return kBadPageError;
@@ -887,8 +613,14 @@ CMacPDFParser::Render()
 {
 	if(mPage) {
 		CGPDFDictionaryRef dictionary = ::CGPDFPageGetDictionary(mPage);
-		if(dictionary)
+		if(dictionary) {
+			// resources first, so forms are known before the contents use them
+			CGPDFObjectRef resources = NULL;
+			if(::CGPDFDictionaryGetObject(dictionary, "Resources", &resources))
+				DictionaryToText("Resources", resources, this);
+				
 			::CGPDFDictionaryApplyFunction(dictionary, DictionaryToText, this);
+		}
 	}
 }
 
@@ -901,6 +633,124 @@ CMacPDFParser::EndRender()
 	}		
 }
 
+// A page's resources, which are inherited down the page tree.
+static CGPDFDictionaryRef
+PageResources(
+	CGPDFPageRef page)
+{
+	CGPDFDictionaryRef resources = NULL;
+	CGPDFDictionaryRef node = ::CGPDFPageGetDictionary(page);
+	
+	for(long depth = 0; node && depth < kPageTreeDepth; depth++) {
+		if(::CGPDFDictionaryGetDictionary(node, "Resources", &resources))
+			return resources;
+			
+		CGPDFDictionaryRef parent = NULL;
+		node = (::CGPDFDictionaryGetDictionary(node, "Parent", &parent) ? parent : NULL);
+	}
+	
+	return NULL;
+}
+
+void
+CMacPDFParser::BeginDocument()
+{
+	mResolvedFonts.clear();
+	
+	// extract all the fonts in the catalog to build our font table, unless
+	// pages are to add the ones they use; see ResolveFont()
+	if(mLazyFonts == false) {
+		std::vector<size_t> pages;
+		
+		if(GetSelectedPages(pages)) {
+			// just the resources of the pages asked for; what they share is
+			// only visited once
+			for(size_t i = 0; i < pages.size() && DidAbort() == false; i++) {
+				CGPDFPageRef page = ::CGPDFDocumentGetPage(mPDF, pages[i]);
+				CGPDFDictionaryRef resources = (page ? PageResources(page) : NULL);
+				
+				if(resources)
+					::CGPDFDictionaryApplyFunction(resources, CatalogToFonts, this);
+			}
+		}
+		else {
+			CGPDFDictionaryRef catalog = ::CGPDFDocumentGetCatalog(mPDF);
+			if(catalog)
+				::CGPDFDictionaryApplyFunction(catalog, CatalogToFonts, this);
+		}
+	}
+	
+	ResetObjects();
+}
+
+void
+CMacPDFParser::DidRenderPage(
+	size_t inPage,
+	size_t inPageCount)
+{
+#if defined(CMACPDF_SupportGUI)
+	if(mWindow) {
+		LProgressBar* bar = dynamic_cast<LProgressBar*>(mWindow->FindPaneByID(pane_Progress));
+		if(bar)
+			bar->SetValue(inPage);
+	}
+#endif
+}
+
+CPDFParser*
+CMacPDFParser::CreatePageWorker()
+{
+#if defined(CMACPDF_SupportGUI)
+	// the callbacks yield to the event loop, main thread only
+	return NULL;
+#else
+	if(mPDF == NULL)
+		return NULL;
+		
+	CMacPDFParser* worker = new CMacPDFParser;
+	
+	worker->mPDF = ::CGPDFDocumentRetain(mPDF);
+	worker->mEncodeForWord = mEncodeForWord;
+	worker->mPromptForPassword = false;
+	
+	return worker;
+#endif
+}
+
+// Finds the font in the current page's resources, or the resources of its
+// forms, and extracts it the first time any page names it.
+CPDFParser::PDFFontObject*
+CMacPDFParser::ResolveFont(
+	const char* inKey)
+{
+	if(mLazyFonts == false || mPage == NULL)
+		return GetFont(inKey);
+		
+	CGPDFDictionaryRef resources = PageResources(mPage);
+	CGPDFDictionaryRef dictionary = (resources ? FindFont(resources, inKey, kFormFontDepth) : NULL);
+	if(dictionary == NULL)
+		return GetFont(inKey);
+		
+	std::vector<ResolvedFont>::const_iterator i = mResolvedFonts.begin();
+	
+	for(i = mResolvedFonts.begin(); i != mResolvedFonts.end(); i++) {
+		if(i->dictionary == dictionary)
+			return (i->index < 0 ? NULL : GetFont(i->index));
+	}
+	
+	long count = GetFontCount();
+	
+	ExtractFont(inKey, dictionary, this);
+	
+	ResolvedFont resolved;
+	resolved.dictionary = dictionary;
+	resolved.index = (GetFontCount() > count ? count : -1);
+	
+	mResolvedFonts.push_back(resolved);
+	
+	return (resolved.index < 0 ? NULL : GetFont(resolved.index));
+}
+
 #pragma mark -
 
 #if defined(CMACPDF_SupportPS)
@@ -989,67 +839,111 @@ OSErr
 CMacPDFParser::StartConversion(
 	FSRefPtr inFile)
 {
-    LFile* input = new LFile(inFile);
-        
-    try {
-       if(input->OpenDataFork(fsRdPerm)) {
-            long header = 0;
-            long version = 0;
-            SInt32 swap;
-            
-            long bytes = sizeof(SInt32);
-            ::FSReadFork(input->GetDataForkRefNum(), fsAtMark, 0, bytes, &swap, NULL);
-            header = CFSwapInt32BigToHost(swap);
-
-            bytes = sizeof(SInt32);
-            ::FSReadFork(input->GetDataForkRefNum(), fsAtMark, 0, bytes, &swap, NULL);
-            version = CFSwapInt32BigToHost(swap);
-
-            input->CloseDataFork();
-           
-            if(header == '%!PS')
-                return kPostScriptError;
-            
-            if(header != '%PDF')
-                return kFormatError;
+	char path[PATH_MAX];
+	if(::FSRefMakePath(inFile, (UInt8*) path, sizeof(path)) != noErr)
+		return kFileReadError;
+		
+	OSErr err = OpenInput(path);
+	if(err != kNoError)
+		return err;
+		
+	err = StartConversion(mInput->GetData(), mInput->GetSize(), inFile);
+	if(err != kNoError)
+		CloseInput();
+		
+	return err;
+}
+
+OSErr
+CMacPDFParser::StartConversion(
+	const void* inData,
+	size_t inSize,
+	FSRefPtr inFile)
+{
+	if(inData == NULL || inSize < 8)
+		return kFormatError;
+		
+	const unsigned char* p = (const unsigned char*) inData;
+	
+	long header = (p[0] << 24) | (p[1] << 16) | (p[2] << 8) | p[3];
+	long version = (p[4] << 24) | (p[5] << 16) | (p[6] << 8) | p[7];
+	
+	OSErr err = CheckHeader(header, version);
+	if(err != kNoError)
+		return err;
+		
+	// the provider reads straight out of the caller's bytes, which must outlive the conversion
+	CGDataProviderRef provider = ::CGDataProviderCreateWithData(NULL, inData, inSize, NULL);
+	if(provider == NULL)
+		return kMemoryError;
+		
+	mPDF = ::CGPDFDocumentCreateWithProvider(provider);
+	
+	::CGDataProviderRelease(provider);
+	
+	return PrepareDocument(inFile);
+}
+
+OSErr
+CMacPDFParser::OpenInput(
+	const char* inPath)
+{
+	CloseInput();
+	
+	mInput = new CMappedFile;
+	if(mInput == NULL)
+		return kMemoryError;
+		
+	OSErr err = mInput->Open(inPath);
+	if(err != kNoError)
+		CloseInput();
+		
+	return err;
+}
+
+void
+CMacPDFParser::CloseInput()
+{
+	if(mInput) {
+		delete mInput;
+		mInput = NULL;
+	}
+}
+
+OSErr
+CMacPDFParser::CheckHeader(
+	long inHeader,
+	long inVersion)
+{
+	if(inHeader == '%!PS')
+		return kPostScriptError;
+	
+	if(inHeader != '%PDF')
+		return kFormatError;
 
 #if defined(__PowerPlant__)
-            if(UEnvironment::GetOSVersion() < 0x1040) {
-                if(version >= '-1.6')
-                    return kVersionError;
-            }	
-            else {
-                if(version >= '-1.7')
-                    return kVersionError;
-            }	
+	if(UEnvironment::GetOSVersion() < 0x1040) {
+		if(inVersion >= '-1.6')
+			return kVersionError;
+	}	
+	else {
+		if(inVersion >= '-1.7')
+			return kVersionError;
+	}	
 #else
-            // use Gestalt
+	// use Gestalt
 #endif
-                
-        }
-       else {
-           delete input;
-           return kFileReadError;
-       }
-    }
-  
-    catch (...) {
-        delete input;
-        return kFileReadError;
-    }
-
-	CFURLRef url = ::CFURLCreateFromFSRef(kCFAllocatorDefault, inFile);
-	if(url == NULL)
-		return kFileReadError;
-		
-	mPDF = ::CGPDFDocumentCreateWithURL(url);
-	
-	::CFRelease(url);	
 
+	return kNoError;
+}
+
+OSErr
+CMacPDFParser::PrepareDocument(
+	FSRefPtr inFile)
+{
+	// the create call already returned a reference for EndConversion to release
 	if(mPDF == NULL)
 		return kPDFOpenError;
-		
-	::CGPDFDocumentRetain(mPDF);
 			
 	bool askForPassword = false;
 	
@@ -1060,7 +954,8 @@ CMacPDFParser::StartConversion(
 	else if(::CGPDFDocumentAllowsPrinting(mPDF) == false)
 		askForPassword = true;*/
 			
-	if(askForPassword && mPromptForPassword == false) {
+	// there is nobody to ask when converting from memory
+	if(askForPassword && (mPromptForPassword == false || inFile == NULL)) {
 		::CGPDFDocumentRelease(mPDF);
 		mPDF = NULL;
 
@@ -1138,9 +1033,7 @@ CMacPDFParser::StartConversion(
 	
 	SetPageCount(pageCount);
 		
-#if defined(__PowerPlant__)
-	sObjects = new LArray;
-#endif
+	ResetObjects();
 	
 	return kNoError;
 }
@@ -1155,14 +1048,7 @@ CMacPDFParser::EndConversion()
 	
 	mDataSize = 0;
 	
-#if defined(__PowerPlant__)
-	if(sObjects) {
-		delete sObjects;
-		sObjects = NULL;
-	}
-#else
-	sObjects.clear();
-#endif	
+	ResetObjects();
 	
 	if(mPage) {					
 		::CGPDFPageRelease(mPage);
@@ -1174,6 +1060,9 @@ CMacPDFParser::EndConversion()
 		mPDF = NULL;
 	}
 
+	// only after the document is gone, it reads out of the mapping
+	CloseInput();
+
 #if defined(CMACPDF_SupportPS)
 	if(mDeletePDF)
 		::FSpDelete(&mPDFSpec);
@@ -1199,17 +1088,20 @@ CMacPDFParser::ConvertToXML(
 #if defined(CMACPDF_XMLWriteCatalog)
 	CGPDFDictionaryRef catalog = ::CGPDFDocumentGetCatalog(mPDF);
 	if(catalog) {
+		// names directly under the catalog are written as "Catalog"
+		XMLContext catalogContext = { this, NULL, NULL };
+		
 		if(inUsePropertyListFormat) {
 			CXMLTree::PushAndPop("key", "Catalog");
 			CXMLTree::Push("dict");
-			::CGPDFDictionaryApplyFunction(catalog, DictionaryToPLIST, NULL); 
+			::CGPDFDictionaryApplyFunction(catalog, DictionaryToPLIST, &catalogContext); 
 			CXMLTree::Pop();
 		}
 		else {
 			CXMLNode* catalogNode = new CXMLNode("dictionary");
 			catalogNode->SetAttribute("key", "Catalog");
 			CXMLTree::Push(catalogNode);
-			::CGPDFDictionaryApplyFunction(catalog, DictionaryToXML, NULL);
+			::CGPDFDictionaryApplyFunction(catalog, DictionaryToXML, &catalogContext);
 			CXMLTree::Pop();
 		}
 	}
@@ -1242,10 +1134,12 @@ CMacPDFParser::ConvertToXML(
 							
 			CGPDFDictionaryRef dictionary = ::CGPDFPageGetDictionary(page);
 			if(dictionary) {
+				XMLContext pageContext = { this, dictionary, NULL };
+				
 				if(inUsePropertyListFormat)
-					::CGPDFDictionaryApplyFunction(dictionary, DictionaryToPLIST, dictionary); 
+					::CGPDFDictionaryApplyFunction(dictionary, DictionaryToPLIST, &pageContext); 
 				else
-					::CGPDFDictionaryApplyFunction(dictionary, DictionaryToXML, dictionary); 
+					::CGPDFDictionaryApplyFunction(dictionary, DictionaryToXML, &pageContext); 
 			}
 			
 			CXMLTree::Pop();
@@ -1352,58 +1246,18 @@ CMacPDFParser::AddObject(
 	CGPDFObjectRef inObject,
 	ArrayIndexT& outIndex)
 {
-#if defined(__PowerPlant__)
-	{
-		LFastArrayIterator iterator(*sObjects);
-		CGPDFObjectRef ref;
-
-		while(iterator.Next(&ref)) {
-			if(ref == inObject) {
-				outIndex = iterator.GetCurrentIndex();
-				return false;
-			}	
-		}
-	}
-			
-	sObjects->AddItem(&inObject);
+	unsigned long index = 0;
+	bool added = mObjects.Add(inObject, index);
 	
-	outIndex = sObjects->GetCount();
-#else
-	std::vector<CGPDFObjectRef>::const_iterator i = sObjects.begin();
-	CGPDFObjectRef s;
+	outIndex = (ArrayIndexT) index;
 	
-	ArrayIndexT index = 1;
-	for(i = sObjects.begin(); i != sObjects.end(); i++) {
-		s = *i;			
-		
-		if(s == inObject) {
-			outIndex = index;
-			return false;
-		}
-		
-		index++;
-	}
-	
-	sObjects.push_back(inObject);
-	outIndex = (ArrayIndexT) sObjects.size();
-#endif
-
-	return true;
+	return added;
 }
 
 void
 CMacPDFParser::ResetObjects()
 {
-#if defined(__PowerPlant__)
-	if(sObjects) {
-		delete sObjects;
-		sObjects = NULL;
-	}
-
-	sObjects = new LArray;
-#else
-	sObjects.clear();
-#endif
+	mObjects.Reset();
 }
 
 #pragma mark -
@@ -1415,7 +1269,7 @@ CMacPDFParser::DictionaryToText(
 	void *info)
 {
 	CMacPDFParser* parser = (CMacPDFParser*) info;
-	if(parser && parser->DidAbort())
+	if(parser == NULL || parser->DidAbort())
 		return;
 
 #if defined(CMACPDF_SupportGUI)
@@ -1424,7 +1278,7 @@ CMacPDFParser::DictionaryToText(
 
 	ArrayIndexT a;
 	
-	if(AddObject(value, a)) {
+	if(parser->AddObject(value, a)) {
 		CGPDFObjectType ot = ::CGPDFObjectGetType(value);
 		
 		if(ot == kCGPDFObjectTypeArray) {		
@@ -1504,7 +1358,7 @@ CMacPDFParser::DictionaryToXObject(
 	void *info)
 {
 	CMacPDFParser* parser = (CMacPDFParser*) info;
-	if(parser && parser->DidAbort())
+	if(parser == NULL || parser->DidAbort())
 		return;
 
 #if defined(CMACPDF_SupportGUI)
@@ -1512,7 +1366,7 @@ CMacPDFParser::DictionaryToXObject(
 #endif
 
 	ArrayIndexT a;
-	if(AddObject(value, a)) {
+	if(parser->AddObject(value, a)) {
 		CGPDFObjectType ot = ::CGPDFObjectGetType(value);
 		
 		if(ot == kCGPDFObjectTypeStream) {
@@ -1542,7 +1396,7 @@ CMacPDFParser::CatalogToFonts(
 	void *info)
 {
 	CMacPDFParser* parser = (CMacPDFParser*) info;
-	if(parser && parser->DidAbort())
+	if(parser == NULL || parser->DidAbort())
 		return;
 		
 #if defined(CMACPDF_SupportGUI)
@@ -1551,7 +1405,7 @@ CMacPDFParser::CatalogToFonts(
 
 	ArrayIndexT a;
 	
-	if(AddObject(value, a)) {
+	if(parser->AddObject(value, a)) {
 		CGPDFObjectType ot = ::CGPDFObjectGetType(value);
 		
 		if(ot == kCGPDFObjectTypeArray) {		
@@ -1593,12 +1447,86 @@ CMacPDFParser::CatalogToFonts(
 	}
 }
 
+struct FontSearch {
+	const char* key;
+	long depth;
+	CGPDFDictionaryRef found;
+};
+
+CGPDFDictionaryRef
+CMacPDFParser::FindFont(
+	CGPDFDictionaryRef resources,
+	const char* key,
+	long depth)
+{
+	CGPDFDictionaryRef fonts = NULL;
+	CGPDFDictionaryRef font = NULL;
+	
+	if(::CGPDFDictionaryGetDictionary(resources, "Font", &fonts)) {
+		if(::CGPDFDictionaryGetDictionary(fonts, key, &font))
+			return font;
+	}
+	
+	CGPDFDictionaryRef xobjects = NULL;
+	if(depth > 0 && ::CGPDFDictionaryGetDictionary(resources, "XObject", &xobjects)) {
+		FontSearch search;
+		search.key = key;
+		search.depth = depth - 1;
+		search.found = NULL;
+		
+		::CGPDFDictionaryApplyFunction(xobjects, XObjectToFont, &search);
+		
+		return search.found;
+	}
+	
+	return NULL;
+}
+
+void
+CMacPDFParser::XObjectToFont(
+	const char *key,
+	CGPDFObjectRef value,
+	void *info)
+{
+#pragma unused (key)
+
+	FontSearch* search = (FontSearch*) info;
+	if(search->found)
+		return;
+		
+	CGPDFStreamRef stream = NULL;
+	if(::CGPDFObjectGetValue(value, kCGPDFObjectTypeStream, &stream) == false)
+		return;
+		
+	CGPDFDictionaryRef dictionary = ::CGPDFStreamGetDictionary(stream);
+	
+	const char* subtype = NULL;
+	CGPDFDictionaryRef resources = NULL;
+	
+	if(
+		dictionary &&
+		::CGPDFDictionaryGetName(dictionary, "Subtype", &subtype) && strcmp(subtype, "Form") == 0 &&
+		::CGPDFDictionaryGetDictionary(dictionary, "Resources", &resources)
+	)
+		search->found = FindFont(resources, search->key, search->depth);
+}
+
 void
 CMacPDFParser::ExtractFont(
 	const char* key,
 	CGPDFDictionaryRef dictionary,
 	CMacPDFParser* parser)
 {
+	UInt64 cacheKey = 0;
+	
+	// the same font seen in an earlier document
+	if(parser->GetFontCache()) {
+		cacheKey = HashFont(dictionary);
+		
+		if(cacheKey && parser->AddCachedFont(key, cacheKey))
+			return;
+	}
+	
 	const char* baseFont = NULL;
 	const char* encoding = NULL;
 	CGPDFDictionaryRef encodingDictionary = NULL;
@@ -1665,7 +1593,7 @@ CMacPDFParser::ExtractFont(
 				cmap = NULL;
 			}
 				
-			parser->AddFont(key, baseFont, encoding, map, umap, widths);
+			parser->AddFont(key, baseFont, encoding, map, umap, widths, 0, 0, cacheKey);
 		}	
 		else if(::CGPDFDictionaryGetStream(dictionary, "Encoding", &encodingStream)) {
 			// type 0
@@ -1677,7 +1605,7 @@ CMacPDFParser::ExtractFont(
 				cmap = NULL;
 			}
 				
-			parser->AddFont(key, baseFont, encoding, map, umap, widths);
+			parser->AddFont(key, baseFont, encoding, map, umap, widths, 0, 0, cacheKey);
 		}
 		else if(::CGPDFDictionaryGetDictionary(dictionary, "Encoding", &encodingDictionary)) {
 			// type 1, true type, type 3
@@ -1757,21 +1685,13 @@ CMacPDFParser::ExtractFont(
 								::CGPDFArrayGetName(array, i, &p);
 								
 								if(p) {
-									char c = UPDFMaps::NameToCode(converter, p);
+									char c = UPDFMaps::GlyphToCode(converter, p, &adobe);
 									if(c)
 										map[doff] = c;
 									else if(strcmp(p, "fi") == 0)
 										fi = doff;
 									else if(strcmp(p, "fl") == 0)
 										fl = doff;
-									else {
-										c = UPDFMaps::AdobeNameToCode(p);
-										
-										if(c) {
-											map[doff] = c;
-											adobe = true;
-										}
-									}
 										
 									doff++;
 								}
@@ -1804,7 +1724,7 @@ CMacPDFParser::ExtractFont(
 				cmap = NULL;
 			}
 				
-			parser->AddFont(key, baseFont, customEncoding, map, umap, widths, fi, fl);
+			parser->AddFont(key, baseFont, customEncoding, map, umap, widths, fi, fl, cacheKey);
 		}
 		else {
 			if(::CGPDFDictionaryGetStream(dictionary, "ToUnicode", &encodingStream)) {
@@ -1836,7 +1756,7 @@ CMacPDFParser::ExtractFont(
 				}
 			}*/
 			
-			parser->AddFont(key, baseFont, encoding, map, umap, widths);
+			parser->AddFont(key, baseFont, encoding, map, umap, widths, 0, 0, cacheKey);
 		}
 	}
 	
@@ -1844,221 +1764,146 @@ CMacPDFParser::ExtractFont(
 		free(cmap);
 }
 
+static void
+HashBytes(
+	UInt64& ioHash,
+	const char* inTag,
+	const void* inData,
+	size_t inSize)
+{
+	CPDFFontCache::Hash(ioHash, inTag, strlen(inTag) + 1);
+	CPDFFontCache::Hash(ioHash, &inSize, sizeof(inSize));
+	CPDFFontCache::Hash(ioHash, inData, inSize);
+}
+
+static void
+HashArray(
+	UInt64& ioHash,
+	const char* inTag,
+	CGPDFArrayRef array)
+{
+	size_t objectCount = ::CGPDFArrayGetCount(array);
+	
+	HashBytes(ioHash, inTag, &objectCount, sizeof(objectCount));
+	
+	for(size_t i = 0; i < objectCount; i++) {
+		CGPDFObjectRef object = NULL;
+		if(::CGPDFArrayGetObject(array, i, &object) == false)
+			continue;
+			
+		CGPDFObjectType ot = ::CGPDFObjectGetType(object);
+		
+		if(ot == kCGPDFObjectTypeInteger) {
+			CGPDFInteger value = 0;
+			::CGPDFObjectGetValue(object, ot, &value);
+			
+			HashBytes(ioHash, "i", &value, sizeof(value));
+		}
+		else if(ot == kCGPDFObjectTypeReal) {
+			CGPDFReal value = 0;
+			::CGPDFObjectGetValue(object, ot, &value);
+			
+			HashBytes(ioHash, "r", &value, sizeof(value));
+		}
+		else if(ot == kCGPDFObjectTypeName) {
+			const char* p = NULL;
+			::CGPDFObjectGetValue(object, ot, &p);
+			
+			if(p)
+				HashBytes(ioHash, "n", p, strlen(p));
+		}
+		else
+			HashBytes(ioHash, "?", &ot, sizeof(ot));
+	}
+}
+
+static void
+HashStream(
+	UInt64& ioHash,
+	const char* inTag,
+	CGPDFStreamRef stream)
+{
+	CGPDFDataFormat format = CGPDFDataFormatRaw;
+	CFDataRef dr = ::CGPDFStreamCopyData(stream, &format);
+	
+	if(dr) {
+		HashBytes(ioHash, inTag, ::CFDataGetBytePtr(dr), ::CFDataGetLength(dr));
+		::CFRelease(dr);
+	}
+	else
+		HashBytes(ioHash, inTag, NULL, 0);
+}
+
+// A font cache key from everything ExtractFont reads, 0 for a font it
+// would not add.
+UInt64
+CMacPDFParser::HashFont(
+	CGPDFDictionaryRef dictionary)
+{
+	const char* baseFont = NULL;
+	if(::CGPDFDictionaryGetName(dictionary, "BaseFont", &baseFont) == false)
+		return 0;
+		
+	UInt64 hash = kFontCacheSeed;
+	HashBytes(hash, "BaseFont", baseFont, strlen(baseFont));
+	
+	const char* subtype = NULL;
+	if(::CGPDFDictionaryGetName(dictionary, "Subtype", &subtype))
+		HashBytes(hash, "Subtype", subtype, strlen(subtype));
+		
+	CGPDFInteger firstChar = 0;
+	::CGPDFDictionaryGetInteger(dictionary, "FirstChar", &firstChar);
+	HashBytes(hash, "FirstChar", &firstChar, sizeof(firstChar));
+	
+	CGPDFArrayRef array = NULL;
+	if(::CGPDFDictionaryGetArray(dictionary, "Widths", &array))
+		HashArray(hash, "Widths", array);
+		
+	const char* encoding = NULL;
+	CGPDFDictionaryRef encodingDictionary = NULL;
+	CGPDFStreamRef stream = NULL;
+	
+	if(::CGPDFDictionaryGetName(dictionary, "Encoding", &encoding))
+		HashBytes(hash, "Encoding", encoding, strlen(encoding));
+	else if(::CGPDFDictionaryGetStream(dictionary, "Encoding", &stream))
+		HashStream(hash, "EncodingStream", stream);
+	else if(::CGPDFDictionaryGetDictionary(dictionary, "Encoding", &encodingDictionary)) {
+		const char* baseEncoding = NULL;
+		if(::CGPDFDictionaryGetName(encodingDictionary, "BaseEncoding", &baseEncoding))
+			HashBytes(hash, "BaseEncoding", baseEncoding, strlen(baseEncoding));
+			
+		if(::CGPDFDictionaryGetArray(encodingDictionary, "Differences", &array))
+			HashArray(hash, "Differences", array);
+	}
+	
+	CGPDFDictionaryRef fontDictionary = NULL;
+	CGPDFStringRef charset = NULL;
+	if(::CGPDFDictionaryGetDictionary(dictionary, "FontDescriptor", &fontDictionary)) {
+		if(::CGPDFDictionaryGetString(fontDictionary, "CharSet", &charset))
+			HashBytes(hash, "CharSet", ::CGPDFStringGetBytePtr(charset), ::CGPDFStringGetLength(charset));
+	}
+	
+	if(::CGPDFDictionaryGetStream(dictionary, "ToUnicode", &stream))
+		HashStream(hash, "ToUnicode", stream);
+		
+	return (hash ? hash : 1);
+}
+
 wchar_t*
 CMacPDFParser::ExtractUnicodeMap(
 	CGPDFStreamRef stream)
 {
 	wchar_t* map = NULL;
 	
-	return NULL;
-	
 	if(stream) {
 		CGPDFDataFormat format = CGPDFDataFormatRaw;
 		CFDataRef dr = ::CGPDFStreamCopyData(stream, &format);
 		if(dr) {
-			const char* dataPtr = (char*) ::CFDataGetBytePtr(dr);
-			CFIndex dataLength = ::CFDataGetLength(dr);
-				
-			for(CFIndex i = 0; i < dataLength; i++) {
-				if(i < dataLength - 12 && strncmp(&(dataPtr[i]), "beginbfrange", 12) == 0) {
-					bool inMap = true;
-				
-					while(i < dataLength && isspace(dataPtr[i]) == false)
-						i++;
-					
-					i++;
-								
-					do {
-						if(i < dataLength - 10 && strncmp(&(dataPtr[i]), "endbfrange", 10) == 0)
-							inMap = false;
-						else {
-							if(map == NULL)
-								map = (wchar_t*) calloc(256, sizeof(wchar_t));
-							
-							if(map) {
-								long start = 0;
-								long end = 0;
-								long u = 0;
-								
-								{
-									bool hex = false;
-									if(dataPtr[i] == '<') {
-										i++;
-										hex = true;
-									}
-									
-									char num[16];
-									long n = 0;
-									while(i < dataLength && isalnum(dataPtr[i]))
-										num[n++] = dataPtr[i++];
-								
-									num[n] = 0;
-									
-									if(hex)
-										i++;
-									
-									i++;
-									
-									if(n) {
-										long swap = CFSwapInt32BigToHost(strtol(num, (char**) NULL, (hex ? 16 : 10)));
-										start = swap;
-									}
-								}	
-
-								{
-									bool hex = false;
-									if(dataPtr[i] == '<') {
-										i++;
-										hex = true;
-									}
-									
-									char num[16];
-									long n = 0;
-									while(i < dataLength && isalnum(dataPtr[i]))
-										num[n++] = dataPtr[i++];
-								
-									num[n] = 0;
-									
-									if(hex)
-										i++;
-									
-									i++;
-									
-									if(n) {
-										long swap = CFSwapInt32BigToHost(strtol(num, (char**) NULL, (hex ? 16 : 10)));
-										end = swap;
-									}
-								}	
-
-								if(dataPtr[i] == '[') {
-									CFIndex k = i;
-									while(k < dataLength && dataPtr[k] != ']')
-										k++;
-										
-									if(k > i + 1 && k < dataLength) {
-										long len = (k - i) - 1;
-										long* uarray = ExtractArray((char*) &(dataPtr[i + 1]), &len);
-										if(uarray) {
-											// version 1.0 does not support arrays inside UnicodeMaps
-											free(uarray);
-										}
-										
-										i = k + 2;
-									}
-								}
-								else {
-									bool hex = false;
-									if(dataPtr[i] == '<') {
-										i++;
-										hex = true;
-									}
-									
-									char num[16];
-									long n = 0;
-									while(i < dataLength && isalnum(dataPtr[i]))
-										num[n++] = dataPtr[i++];
-								
-									num[n] = 0;
-									
-									if(hex)
-										i++;
-									
-									i++;
-									
-									if(n) {
-										long swap = CFSwapInt32BigToHost(strtol(num, (char**) NULL, (hex ? 16 : 10)));
-										u = swap;
-								
-										if(start >= 0 && start <= 255 && end >= 0 && end <= 255) {
-											for(long x = start; x <= end; x++) {
-												if(u >= 0 && u <= 255) // necessary?
-													map[x] = u;
-													
-												u++;	
-											}	
-										}
-									}
-								}
-							}
-						}
-					} while(i < dataLength && inMap);
-				}			
-				else if(i < dataLength - 11 && strncmp(&(dataPtr[i]), "beginbfchar", 11) == 0) {
-					bool inMap = true;
-				
-					while(i < dataLength && isspace(dataPtr[i]) == false)
-						i++;
-					
-					i++;
-								
-					do {
-						if(i < dataLength - 9 && strncmp(&(dataPtr[i]), "endbfchar", 9) == 0)
-							inMap = false;
-						else {
-							if(map == NULL)
-								map = (wchar_t*) calloc(256, sizeof(wchar_t));
-							
-							if(map) {
-								long start = 0;
-								long u = 0;
-								
-								{
-									bool hex = false;
-									if(dataPtr[i] == '<') {
-										i++;
-										hex = true;
-									}
-									
-									char num[16];
-									long n = 0;
-									while(i < dataLength && isalnum(dataPtr[i]))
-										num[n++] = dataPtr[i++];
-								
-									num[n] = 0;
-									
-									if(hex)
-										i++;
-									
-									i++;
-									
-									if(n) {
-										long swap = CFSwapInt32BigToHost(strtol(num, (char**) NULL, (hex ? 16 : 10)));
-										start = swap;
-									}
-								}	
-
-								{
-									bool hex = false;
-									if(dataPtr[i] == '<') {
-										i++;
-										hex = true;
-									}
-																		
-									char num[16];
-									long n = 0;
-									while(i < dataLength && isalnum(dataPtr[i]))
-										num[n++] = dataPtr[i++];
-								
-									num[n] = 0;
-									
-									if(hex)
-										i++;
-									
-									i++;
-									
-									if(n) {
-										long swap = CFSwapInt32BigToHost(strtol(num, (char**) NULL, (hex ? 16 : 10)));
-										u = swap;
-									}
-								}
-								
-								if(start >= 0 && start <= 255 && u >= 0 && u <= 255) // necessary?
-									map[start] = u;
-							}
-						}
-					} while(i < dataLength && inMap);
-				}			
-			}	
+			CPDFCMap cmap;
+			
+			// simple fonts only use the one-byte codes
+			if(cmap.Parse(::CFDataGetBytePtr(dr), ::CFDataGetLength(dr)) == kNoError)
+				map = cmap.CopyByteMap();
 				
 			::CFRelease(dr);
 		}
@@ -2080,48 +1925,12 @@ CMacPDFParser::ExtractCharMap(
 
 char*
 CMacPDFParser::ExtractCharSet(
-	CGPDFStringRef stream,
-	UPDFMaps::ConstMapParam pdfMap)
+	CGPDFStringRef stream)
 {
-	char* map = NULL;	
-	
-	long entry = 0;
-	
-	if(stream) {
-		map = (char*) malloc(256);
+	if(stream == NULL)
+		return NULL;
 		
-		if(map) {
-			for(long j = 0; j < 256; j++)
-				map[j] = j;
-
-			size_t l = ::CGPDFStringGetLength(stream);
-			unsigned char* c = (unsigned char*) ::CGPDFStringGetBytePtr(stream);
-			
-			if(c) {
-				char name[32];
-				char nindex = 0;
-				
-				for(size_t i = 0; i < l; i++) {
-					if(c[i] == '/' || i == l - 1) {
-						if(nindex) {
-							name[nindex] = 0;
-							char cm = UPDFMaps::NameToCode(pdfMap, name);
-							if(cm)
-								map[entry] = cm;
-																						
-							entry++;
-						}
-						
-						nindex = 0;
-					}
-					else
-						name[nindex++] = c[i];
-				}
-			}
-		}
-	}
-	
-	return map;
+	return CharSetToMap(::CGPDFStringGetBytePtr(stream), ::CGPDFStringGetLength(stream));
 }
 
 long*
@@ -2134,60 +1943,6 @@ CMacPDFParser::ExtractArray(
 	return NULL;
 }	
 
-char*
-CMacPDFParser::FoldMaps(
-	wchar_t* unicode,
-	char* ansi,
-	TextEncoding encoding)
-{
-	char* map = ansi;
-	
-	for(long i = 0; i < 256; i++) {
-		short u = unicode[i];
-		
-		if(u) {
-			unsigned char ustring[2];
-			memcpy(&(ustring[0]), &u, 2);
-			
-			CFStringRef sr = ::CFStringCreateWithBytes(kCFAllocatorDefault, ustring, 2, kCFStringEncodingUnicode, false);
-			if(sr) {
-				Str255 buffer;
-				if(::CFStringGetPascalString(sr, buffer, 256, encoding) && buffer[0] == 1) {
-					if(map == NULL) {
-						map = (char*) malloc(256);
-						
-						if(map) {
-							for(long j = 0; j < 256; j++)
-								map[j] = j;
-						}
-					}
-					
-					if(map) {
-						map[i] = buffer[1];
-						unicode[i] = 0;
-					}
-				}
-				
-				::CFRelease(sr);
-			}
-		}
-	}
-		
-	return map;
-}
-
-bool
-CMacPDFParser::UnicodeMapIsValid(
-	wchar_t* map)
-{
-	for(long i = 0; i < 256; i++) {
-		if(map[i])
-			return true;
-	}
-	
-	return false;
-}
-
 bool
 CMacPDFParser::CharMapIsValid(
 	char* map)
@@ -2220,6 +1975,8 @@ CMacPDFParser::IndexDictionaryToXML(
 	void *info,
 	size_t index)
 {
+	XMLContext* context = (XMLContext*) info;
+	
 	CXMLNode* keyNode = NULL;
 
 	CGPDFObjectType ot = ::CGPDFObjectGetType(value);
@@ -2309,13 +2066,13 @@ CMacPDFParser::IndexDictionaryToXML(
 			
 			if(index == -1) {
 				// parent is dictionary
-				CGPDFDictionaryRef dictionary = (CGPDFDictionaryRef) info;
+				CGPDFDictionaryRef dictionary = context->dictionary;
 				if(dictionary)
 					::CGPDFDictionaryGetName(dictionary, key, &p);
 			}
 			else {
 				// parent is array
-				CGPDFArrayRef array = (CGPDFArrayRef) info;
+				CGPDFArrayRef array = context->array;
 				if(array)
 					::CGPDFArrayGetName(array, index, &p);
 			}
@@ -2363,19 +2120,21 @@ CMacPDFParser::IndexDictionaryToXML(
 			::CGPDFObjectGetValue(value, ot, &array);
 			
 			if(array) {
+				XMLContext arrayContext = { context->parser, NULL, array };
+				
 				size_t objectCount = ::CGPDFArrayGetCount(array);
 									
 				for(size_t i = 0; i < objectCount; i++) {
 					CGPDFObjectRef object = NULL;
 					if(::CGPDFArrayGetObject(array, i, &object))
-						IndexDictionaryToXML(key, object, array, i);			
+						IndexDictionaryToXML(key, object, &arrayContext, i);			
 				}
 			}
 		}
 		else if(ot == kCGPDFObjectTypeDictionary) {
 			ArrayIndexT a;
 			
-			if(AddObject(value, a) == false)
+			if(context->parser->AddObject(value, a) == false)
 				keyNode->SetAttribute("reference", a);
 			else {
 				keyNode->SetAttribute("object", a);
@@ -2383,8 +2142,10 @@ CMacPDFParser::IndexDictionaryToXML(
 				CGPDFDictionaryRef dictionary = NULL;
 				::CGPDFObjectGetValue(value, ot, &dictionary);
 				
-				if(dictionary)
-					::CGPDFDictionaryApplyFunction(dictionary, DictionaryToXML, dictionary);
+				if(dictionary) {
+					XMLContext dictionaryContext = { context->parser, dictionary, NULL };
+					::CGPDFDictionaryApplyFunction(dictionary, DictionaryToXML, &dictionaryContext);
+				}
 			}
 		}
 		else if(ot == kCGPDFObjectTypeStream) {
@@ -2431,7 +2192,7 @@ CMacPDFParser::IndexDictionaryToPLIST(
 	void *info,
 	size_t index)
 {
-#pragma unused(info)
+	XMLContext* context = (XMLContext*) info;
 
 	CGPDFObjectType ot = ::CGPDFObjectGetType(value);
 	
@@ -2509,13 +2270,13 @@ CMacPDFParser::IndexDictionaryToPLIST(
 			
 			if(index == -1) {
 				// parent is dictionary
-				CGPDFDictionaryRef dictionary = (CGPDFDictionaryRef) info;
+				CGPDFDictionaryRef dictionary = context->dictionary;
 				if(dictionary)
 					::CGPDFDictionaryGetName(dictionary, key, &p);
 			}
 			else {
 				// parent is array
-				CGPDFArrayRef array = (CGPDFArrayRef) info;	
+				CGPDFArrayRef array = context->array;
 				if(array)
 					::CGPDFArrayGetName(array, index, &p);
 			}
@@ -2553,11 +2314,13 @@ CMacPDFParser::IndexDictionaryToPLIST(
 			if(array) {			
 				CXMLTree::Push("array");
 				
+				XMLContext arrayContext = { context->parser, NULL, array };
+				
 				size_t objectCount = ::CGPDFArrayGetCount(array);
 				for(size_t i = 0; i < objectCount; i++) {
 					CGPDFObjectRef object = NULL;
 					if(::CGPDFArrayGetObject(array, i, &object))
-						IndexDictionaryToPLIST(key, object, array, i);			
+						IndexDictionaryToPLIST(key, object, &arrayContext, i);			
 				}
 
 				CXMLTree::Pop();
@@ -2576,7 +2339,7 @@ CMacPDFParser::IndexDictionaryToPLIST(
 				
 				ArrayIndexT a;
 				
-				if(AddObject(value, a) == false) {
+				if(context->parser->AddObject(value, a) == false) {
 					char str[256];
 					sprintf(str, "%d", a);
 
@@ -2590,7 +2353,8 @@ CMacPDFParser::IndexDictionaryToPLIST(
 					CXMLTree::PushAndPop("key", "_Object");
 					CXMLTree::PushAndPop("integer", str); 
 
-					::CGPDFDictionaryApplyFunction(dictionary, DictionaryToPLIST, dictionary);
+					XMLContext dictionaryContext = { context->parser, dictionary, NULL };
+					::CGPDFDictionaryApplyFunction(dictionary, DictionaryToPLIST, &dictionaryContext);
 				}
 				
 				CXMLTree::Pop(); 
@@ -2625,11 +2389,3 @@ CMacPDFParser::IndexDictionaryToPLIST(
 }
 
 #endif // CMACPDF_SupportXML
-
-#if !defined(Obsolete10p4)
-OSErr CMacPDFParser::FSWrite(FSIORefNum refNum, long *count, const void *buffPtr)
-{
-    return ::FSWriteFork(refNum, fsAtMark, 0, *count, buffPtr, NULL);
-}
-#endif
-
@@ -7,6 +7,7 @@
 #pragma once
 
 #include "CPDFParser.h"
+#include "CPDFObjectSet.h"
 #include "UPDFMaps.h"
 
 #ifdef __GNUC__
@@ -94,6 +95,7 @@ typedef unsigned long ArrayIndexT;
 #endif
 
 class CMacPDFParser;
+class CMappedFile;
 
 class CMacPDFParser : public CPDFParser {
 public:
@@ -109,6 +111,31 @@ public:
 		FSRefPtr outOverrideFile = NULL,
         ConstHFSUniStr255Param outFilename = NULL);
 
+	// converts a PDF held in memory; inData must stay valid until this returns
+	OSErr ConvertBuffer(
+		const void* inData,
+		size_t inSize,
+		long inType,
+		COutputSink* inSink,
+		const char* inTitle = NULL);
+
+	// same, reading the PDF through a memory mapping of inPath
+	virtual OSErr ConvertPath(
+		const char* inPath,
+		long inType,
+		COutputSink* inSink,
+		const char* inTitle = NULL);
+		
+	virtual OSErr CountPages(
+		const char* inPath,
+		size_t& outCount);
+		
+	virtual OSErr ConvertPathToOutputs(
+		const char* inPath,
+		PDFOutput* ioOutputs,
+		long inCount,
+		const char* inTitle = NULL);
+
 	static bool IsAvailable();
 
 	// options
@@ -120,14 +147,6 @@ public:
 		return mEncodeForWord;
 	}
 	
-	void SetShowBreaks(bool inSet) {
-		mShowBreaks = inSet;
-	}
-	
-	bool GetShowBreaks() {
-		return mShowBreaks;
-	}
-	
 	void SetPromptForPassword(bool inSet) {
 		mPromptForPassword = inSet;
 	}
@@ -147,10 +166,38 @@ protected:
 	
 	virtual void EndRender();
 
+	virtual void BeginDocument();
+	
+	virtual void DidRenderPage(
+		size_t inPage,
+		size_t inPageCount);
+		
+	virtual CPDFParser* CreatePageWorker();
+
+	virtual PDFFontObject* ResolveFont(
+		const char* inKey);
+
 protected:
 	OSErr StartConversion(
 		FSRefPtr inFile);
 		
+	OSErr StartConversion(
+		const void* inData,
+		size_t inSize,
+		FSRefPtr inFile = NULL);
+		
+	OSErr CheckHeader(
+		long inHeader,
+		long inVersion);
+		
+	OSErr PrepareDocument(
+		FSRefPtr inFile);
+		
+	OSErr OpenInput(
+		const char* inPath);
+		
+	void CloseInput();
+		
 #if defined(CMACPDF_SupportPS)
 	OSErr StartPSConversion(
 		FSRefPtr inFile);
@@ -169,15 +216,11 @@ protected:
 		HFSUniStr255 inExtension);
 
 	// reference counting
-	static bool AddObject(
+	bool AddObject(
 		CGPDFObjectRef inRef,
 		ArrayIndexT& outIndex);
 
-	static void ResetObjects();
-
-	//static LArray* GetObjects() {
-	//	return sObjects;
-	//}
+	void ResetObjects();
 
 private:
 	// text
@@ -201,6 +244,19 @@ private:
 		CGPDFDictionaryRef dictionary,
 		CMacPDFParser* parser);
 		
+	static CGPDFDictionaryRef FindFont(
+		CGPDFDictionaryRef resources,
+		const char* key,
+		long depth);
+		
+	static void XObjectToFont(
+		const char *key,
+		CGPDFObjectRef value,
+		void *info);
+		
+	static UInt64 HashFont(
+		CGPDFDictionaryRef dictionary);
+		
 	static wchar_t* ExtractUnicodeMap(
 		CGPDFStreamRef stream);
 
@@ -208,25 +264,25 @@ private:
 		CGPDFStreamRef stream);
 
 	static char* ExtractCharSet(
-		CGPDFStringRef stream,
-		UPDFMaps::ConstMapParam pdfMap = UPDFMaps::kMacLatinMap);
+		CGPDFStringRef stream);
 
 	static long* ExtractArray(
 		char* c,
 		long* l);
 
-	static char* FoldMaps(
-		wchar_t* unicode,
-		char* ansi,
-		TextEncoding encoding = kTextEncodingMacRoman);
-
-	static bool UnicodeMapIsValid(
-		wchar_t* map);
-		
 	static bool CharMapIsValid(
 		char* map);
 
 #if defined(CMACPDF_SupportXML)		
+	// xml callbacks get one of these as info
+	struct XMLContext {
+		CMacPDFParser* parser;
+		
+		// parent of the value, for looking up names
+		CGPDFDictionaryRef dictionary;
+		CGPDFArrayRef array;
+	};
+	
 	// xml
 	static void DictionaryToXML(
 		const char *key,
@@ -257,8 +313,9 @@ protected:
 	CGPDFDocumentRef mPDF;
 	CGPDFPageRef mPage;
 	
+	CMappedFile* mInput;
+	
 	bool mEncodeForWord;
-	bool mShowBreaks;
 	bool mPromptForPassword;
 	
 	LWindow* mWindow;
@@ -268,16 +325,17 @@ protected:
 	
 	FSSpec mPDFSpec;
 	
-private:
-#if defined(__PowerPlant__)
-	static LArray* sObjects;
-#else
-	static std::vector<CGPDFObjectRef> sObjects;
-#endif	
-    
-#if !defined(Obsolete10p4)
-    OSErr FSWrite(FSIORefNum refNum, long *count, const void *buffPtr);
-#endif
+	// objects already visited, per conversion
+	CPDFObjectSet mObjects;
+	
+	// font dictionaries extracted as pages named them, and the index of
+	// each one's font, -1 for one that made none
+	struct ResolvedFont {
+		CGPDFDictionaryRef dictionary;
+		long index;
+	};
+	
+	std::vector<ResolvedFont> mResolvedFonts;
 };
 
 #endif
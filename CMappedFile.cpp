@@ -0,0 +1,98 @@
+// Trapeze
+//
+// Copyright (c) 2004 Mesa Dynamics, LLC.  All rights reserved.
+
+#include "CMappedFile.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+const size_t	kMappedHeadSize		= 4096;
+const size_t	kMappedTailSize		= 64 * 1024;
+
+CMappedFile::CMappedFile() :
+		mDescriptor(-1),
+		mData(NULL),
+		mSize(0)
+{
+}
+
+CMappedFile::~CMappedFile()
+{
+	Close();
+}
+
+OSErr
+CMappedFile::Open(
+	const char* inPath)
+{
+	Close();
+
+	mDescriptor = open(inPath, O_RDONLY);
+	if(mDescriptor < 0)
+		return CPDFParser::kFileReadError;
+
+	struct stat info;
+	if(fstat(mDescriptor, &info) != 0 || info.st_size <= 0) {
+		Close();
+		return CPDFParser::kFileReadError;
+	}
+
+	mSize = (size_t) info.st_size;
+
+	void* data = mmap(NULL, mSize, PROT_READ, MAP_PRIVATE, mDescriptor, 0);
+	if(data == MAP_FAILED) {
+		mSize = 0;
+		Close();
+		return CPDFParser::kFileReadError;
+	}
+
+	mData = (unsigned char*) data;
+
+	// objects are reached through the xref, so readahead mostly wastes memory
+	madvise(mData, mSize, MADV_RANDOM);
+
+	// the header and the trailer/xref at the end are always read first
+	WillNeed(0, kMappedHeadSize);
+
+	if(mSize > kMappedTailSize)
+		WillNeed(mSize - kMappedTailSize, kMappedTailSize);
+
+	return CPDFParser::kNoError;
+}
+
+void
+CMappedFile::Close()
+{
+	if(mData) {
+		munmap(mData, mSize);
+		mData = NULL;
+	}
+
+	mSize = 0;
+
+	if(mDescriptor >= 0) {
+		close(mDescriptor);
+		mDescriptor = -1;
+	}
+}
+
+void
+CMappedFile::WillNeed(
+	size_t inOffset,
+	size_t inLength)
+{
+	if(mData == NULL || inOffset >= mSize)
+		return;
+
+	if(inLength > mSize - inOffset)
+		inLength = mSize - inOffset;
+
+	// madvise wants a page-aligned start
+	size_t page = (size_t) getpagesize();
+	size_t start = inOffset - (inOffset % page);
+
+	madvise(mData + start, inLength + (inOffset - start), MADV_WILLNEED);
+}
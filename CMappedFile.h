@@ -0,0 +1,46 @@
+// Trapeze
+//
+// Copyright (c) 2004 Mesa Dynamics, LLC.  All rights reserved.
+
+#ifndef _H_CMappedFile
+#define _H_CMappedFile
+#pragma once
+
+#include "CPDFParser.h"
+
+#include <sys/types.h>
+
+// Read-only mapping of an input file.  Open() asks for the header (the
+// first 4K) and the trailer and xref (the last 64K) to be read ahead; the
+// rest comes in page by page as the parser touches it.
+class CMappedFile {
+public:
+	CMappedFile();
+	virtual ~CMappedFile();
+
+	OSErr Open(
+		const char* inPath);
+
+	void Close();
+
+	const unsigned char* GetData() {
+		return mData;
+	}
+
+	size_t GetSize() {
+		return mSize;
+	}
+
+	// hint that a range is about to be read (e.g. a page's content stream)
+	void WillNeed(
+		size_t inOffset,
+		size_t inLength);
+
+protected:
+	int mDescriptor;
+
+	unsigned char* mData;
+	size_t mSize;
+};
+
+#endif
@@ -0,0 +1,859 @@
+// Trapeze
+//
+// Copyright (c) 2004 Mesa Dynamics, LLC.  All rights reserved.
+
+#include "CNativePDFParser.h"
+#include "CMappedFile.h"
+#include "CPDFCMap.h"
+#include "CPDFDocument.h"
+#include "CPDFFontCache.h"
+#include "COutputSink.h"
+#include "UPDFMaps.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+const long		kFormFontDepth		= 4; // forms in forms searched for a page's font
+
+CNativePDFParser::CNativePDFParser() :
+		mDocument(NULL),
+		mPage(NULL),
+		mInput(NULL)
+{
+}
+
+CNativePDFParser::~CNativePDFParser()
+{
+	EndConversion();
+}
+
+OSErr
+CNativePDFParser::ConvertPath(
+	const char* inPath,
+	long inType,
+	COutputSink* inSink,
+	const char* inTitle)
+{
+	OSErr error = OpenInput(inPath);
+
+	if(error == kNoError)
+		error = ConvertBuffer(mInput->GetData(), mInput->GetSize(), inType, inSink, inTitle);
+
+	CloseInput();
+
+	return error;
+}
+
+OSErr
+CNativePDFParser::ConvertPathToOutputs(
+	const char* inPath,
+	PDFOutput* ioOutputs,
+	long inCount,
+	const char* inTitle)
+{
+	if(ioOutputs == NULL || inCount < 1)
+		return kConvertError;
+
+	for(long i = 0; i < inCount; i++) {
+		if(ioOutputs[i].type == kWritePropertyList || ioOutputs[i].type == kWriteXML)
+			return kConvertError;
+	}
+
+	OSErr error = OpenInput(inPath);
+
+	if(error == kNoError) {
+		ReportProgress(-1, 0);
+
+		error = StartConversion(mInput->GetData(), mInput->GetSize());
+
+		if(error == kNoError)
+			error = ConvertOutputs(ioOutputs, inCount, inTitle);
+
+		EndConversion();
+
+		ReportProgress(GetMaxProgress(), GetMaxProgress());
+	}
+
+	CloseInput();
+
+	return error;
+}
+
+OSErr
+CNativePDFParser::CountPages(
+	const char* inPath,
+	size_t& outCount)
+{
+	outCount = 0;
+
+	OSErr error = OpenInput(inPath);
+
+	if(error == kNoError)
+		error = StartConversion(mInput->GetData(), mInput->GetSize());
+
+	if(error == kNoError)
+		outCount = GetPageCount();
+
+	EndConversion();
+
+	return error;
+}
+
+OSErr
+CNativePDFParser::ConvertBuffer(
+	const void* inData,
+	size_t inSize,
+	long inType,
+	COutputSink* inSink,
+	const char* inTitle)
+{
+	// the xml and plist writers walk CoreGraphics objects
+	if(inType == kWritePropertyList || inType == kWriteXML)
+		return kConvertError;
+
+	if(inSink == NULL)
+		return kFileWriteError;
+
+	SetOutputType(inType);
+
+	ReportProgress(-1, 0);
+
+	OSErr error = StartConversion(inData, inSize);
+
+	if(error == kNoError)
+		error = ConvertDocument(inSink, inTitle);
+
+	EndConversion();
+
+	ReportProgress(GetMaxProgress(), GetMaxProgress());
+
+	return error;
+}
+
+#pragma mark -
+
+OSErr
+CNativePDFParser::BeginRender(
+	size_t inPage,
+	float* outWidth,
+	float* outHeight)
+{
+	// each page is walked on its own, shared resources included
+	mObjects.Reset();
+
+	mPage = (mDocument ? mDocument->GetPage(inPage) : NULL);
+	if(mPage == NULL)
+		return kBadPageError;
+
+	// x, y, width and height, the crop box inside the media box as
+	// CGPDFPageGetBoxRect() gives them
+	float mediaBox[4] = { 0.0, 0.0, 612.0, 792.0 };
+	GetBox("MediaBox", mediaBox);
+
+	float cropBox[4];
+	if(GetBox("CropBox", cropBox)) {
+		float left = (cropBox[0] > mediaBox[0] ? cropBox[0] : mediaBox[0]);
+		float bottom = (cropBox[1] > mediaBox[1] ? cropBox[1] : mediaBox[1]);
+		float right = (cropBox[0] + cropBox[2] < mediaBox[0] + mediaBox[2] ? cropBox[0] + cropBox[2] : mediaBox[0] + mediaBox[2]);
+		float top = (cropBox[1] + cropBox[3] < mediaBox[1] + mediaBox[3] ? cropBox[1] + cropBox[3] : mediaBox[1] + mediaBox[3]);
+
+		cropBox[0] = left;
+		cropBox[1] = bottom;
+		cropBox[2] = (right > left ? right - left : 0.0);
+		cropBox[3] = (top > bottom ? top - bottom : 0.0);
+	}
+	else
+		memcpy(cropBox, mediaBox, sizeof(cropBox));
+
+	if(cropBox[2] && cropBox[3] && cropBox[2] < mediaBox[2] && cropBox[3] < mediaBox[3]) {
+		*outWidth = cropBox[2];
+		*outHeight = cropBox[3];
+
+		mCropWidth = cropBox[0];
+		mCropHeight = cropBox[1];
+		mCrop = true;
+	}
+	else {
+		*outWidth = mediaBox[2];
+		*outHeight = mediaBox[3];
+	}
+
+	return kNoError;
+}
+
+void
+CNativePDFParser::Render()
+{
+	if(mPage == NULL)
+		return;
+
+	// forms first, so they are known before the contents use them
+	AddForms(GetResources());
+
+	CPDFObject* contents = mDocument->Get(mPage, "Contents");
+	if(contents == NULL)
+		return;
+
+	if(contents->GetType() == CPDFObject::kArray) {
+		Store();
+
+		for(size_t i = 0; i < contents->GetCount() && DidAbort() == false; i++)
+			ParseContents(mDocument->Resolve(contents->GetItem(i)));
+
+		Release();
+	}
+	else
+		ParseContents(contents);
+}
+
+void
+CNativePDFParser::EndRender()
+{
+	mPage = NULL;
+}
+
+void
+CNativePDFParser::BeginDocument()
+{
+	mResolvedFonts.clear();
+
+	// extract the fonts of every page to build our font table, unless
+	// pages are to add the ones they use; see ResolveFont()
+	if(mLazyFonts == false && mDocument) {
+		std::vector<size_t> pages;
+
+		if(GetSelectedPages(pages) == false) {
+			for(size_t i = 1; i <= GetPageCount(); i++)
+				pages.push_back(i);
+		}
+
+		// what pages share is only visited once
+		mObjects.Reset();
+
+		for(size_t i = 0; i < pages.size() && DidAbort() == false; i++) {
+			mPage = mDocument->GetPage(pages[i]);
+
+			if(mPage)
+				ResourcesToFonts(GetResources());
+		}
+
+		mPage = NULL;
+	}
+
+	mObjects.Reset();
+}
+
+CPDFParser*
+CNativePDFParser::CreatePageWorker()
+{
+	if(mDocument == NULL)
+		return NULL;
+
+	CNativePDFParser* worker = new CNativePDFParser;
+
+	// the owner keeps the input mapped until its workers are done
+	mDocument->Retain();
+	worker->mDocument = mDocument;
+
+	return worker;
+}
+
+// Finds the font in the current page's resources, or the resources of its
+// forms, and extracts it the first time any page names it.
+CPDFParser::PDFFontObject*
+CNativePDFParser::ResolveFont(
+	const char* inKey)
+{
+	if(mLazyFonts == false || mPage == NULL)
+		return GetFont(inKey);
+
+	CPDFObject* resources = GetResources();
+	CPDFObject* dictionary = (resources ? FindFont(resources, inKey, kFormFontDepth) : NULL);
+	if(dictionary == NULL)
+		return GetFont(inKey);
+
+	std::vector<ResolvedFont>::const_iterator i;
+
+	for(i = mResolvedFonts.begin(); i != mResolvedFonts.end(); i++) {
+		if(i->dictionary == dictionary)
+			return (i->index < 0 ? NULL : GetFont(i->index));
+	}
+
+	long count = GetFontCount();
+
+	ExtractFont(inKey, dictionary);
+
+	ResolvedFont resolved;
+	resolved.dictionary = dictionary;
+	resolved.index = (GetFontCount() > count ? count : -1);
+
+	mResolvedFonts.push_back(resolved);
+
+	return (resolved.index < 0 ? NULL : GetFont(resolved.index));
+}
+
+#pragma mark -
+
+OSErr
+CNativePDFParser::StartConversion(
+	const void* inData,
+	size_t inSize)
+{
+	if(inData == NULL || inSize < 8)
+		return kFormatError;
+
+	mDocument = new CPDFDocument;
+	if(mDocument == NULL)
+		return kMemoryError;
+
+	OSErr err = mDocument->Open((const unsigned char*) inData, inSize);
+	if(err != kNoError) {
+		mDocument->Release();
+		mDocument = NULL;
+
+		return err;
+	}
+
+	SetPageCount(mDocument->GetPageCount());
+
+	mObjects.Reset();
+
+	return kNoError;
+}
+
+void
+CNativePDFParser::EndConversion()
+{
+	if(mData) {
+		free(mData);
+		mData = NULL;
+	}
+
+	mDataSize = 0;
+
+	mObjects.Reset();
+	mResolvedFonts.clear();
+
+	mPage = NULL;
+
+	if(mDocument) {
+		mDocument->Release();
+		mDocument = NULL;
+	}
+
+	// only after the document is gone, it reads out of the mapping
+	CloseInput();
+}
+
+OSErr
+CNativePDFParser::OpenInput(
+	const char* inPath)
+{
+	CloseInput();
+
+	mInput = new CMappedFile;
+	if(mInput == NULL)
+		return kMemoryError;
+
+	OSErr err = mInput->Open(inPath);
+	if(err != kNoError)
+		CloseInput();
+
+	return err;
+}
+
+void
+CNativePDFParser::CloseInput()
+{
+	if(mInput) {
+		delete mInput;
+		mInput = NULL;
+	}
+}
+
+#pragma mark -
+
+void
+CNativePDFParser::ParseContents(
+	CPDFObject* inStream)
+{
+	unsigned long index;
+
+	if(inStream == NULL || inStream->GetType() != CPDFObject::kStream || mObjects.Add(inStream, index) == false)
+		return;
+
+	unsigned char* data;
+	size_t size;
+
+	if(mDocument->CopyStreamData(inStream, data, size) == kNoError) {
+		Parse(data, size);
+		free(data);
+	}
+}
+
+// The page's form XObjects, by the names its contents Do them with.  Forms
+// inside forms are not followed, as CMacPDFParser does not.
+void
+CNativePDFParser::AddForms(
+	CPDFObject* inResources)
+{
+	CPDFObject* xobjects = mDocument->GetDictionary(inResources, "XObject");
+	if(xobjects == NULL)
+		return;
+
+	for(size_t i = 0; i < xobjects->GetCount() && DidAbort() == false; i++) {
+		CPDFObject* stream = mDocument->Resolve(xobjects->GetItem(i));
+
+		unsigned long index;
+		if(stream == NULL || stream->GetType() != CPDFObject::kStream || mObjects.Add(stream, index) == false)
+			continue;
+
+		const char* subtype;
+		if(mDocument->GetName(stream, "Subtype", subtype) == false || strcmp(subtype, "Form") != 0)
+			continue;
+
+		unsigned char* data;
+		size_t size;
+
+		if(mDocument->CopyStreamData(stream, data, size) == kNoError) {
+			AddXObject(xobjects->GetKey(i), data, size);
+			free(data);
+		}
+	}
+}
+
+void
+CNativePDFParser::ResourcesToFonts(
+	CPDFObject* inResources)
+{
+	unsigned long index;
+
+	CPDFObject* fonts = mDocument->GetDictionary(inResources, "Font");
+	if(fonts == NULL || mObjects.Add(fonts, index) == false)
+		return;
+
+	for(size_t i = 0; i < fonts->GetCount() && DidAbort() == false; i++) {
+		CPDFObject* font = mDocument->Resolve(fonts->GetItem(i));
+
+		if(font && font->GetType() == CPDFObject::kDictionary && mObjects.Add(font, index))
+			ExtractFont(fonts->GetKey(i), font);
+	}
+}
+
+CPDFObject*
+CNativePDFParser::FindFont(
+	CPDFObject* inResources,
+	const char* inKey,
+	long inDepth)
+{
+	CPDFObject* font = mDocument->GetDictionary(mDocument->GetDictionary(inResources, "Font"), inKey);
+	if(font)
+		return font;
+
+	CPDFObject* xobjects = mDocument->GetDictionary(inResources, "XObject");
+	if(inDepth <= 0 || xobjects == NULL)
+		return NULL;
+
+	for(size_t i = 0; i < xobjects->GetCount(); i++) {
+		CPDFObject* stream = mDocument->Resolve(xobjects->GetItem(i));
+		if(stream == NULL || stream->GetType() != CPDFObject::kStream)
+			continue;
+
+		const char* subtype;
+		if(mDocument->GetName(stream, "Subtype", subtype) == false || strcmp(subtype, "Form") != 0)
+			continue;
+
+		CPDFObject* resources = mDocument->GetDictionary(stream, "Resources");
+		if(resources && resources != inResources) {
+			font = FindFont(resources, inKey, inDepth - 1);
+			if(font)
+				return font;
+		}
+	}
+
+	return NULL;
+}
+
+void
+CNativePDFParser::ExtractFont(
+	const char* inKey,
+	CPDFObject* inDictionary)
+{
+	UInt64 cacheKey = 0;
+
+	// the same font seen in an earlier document
+	if(GetFontCache()) {
+		cacheKey = HashFont(inDictionary);
+
+		if(cacheKey && AddCachedFont(inKey, cacheKey))
+			return;
+	}
+
+	const char* baseFont = NULL;
+	const char* encoding = NULL;
+	CPDFObject* encodingObject = mDocument->Get(inDictionary, "Encoding");
+
+	float* widths = NULL;
+	char* cmap = NULL;
+	char* map = NULL;
+	wchar_t* umap = NULL;
+
+	const unsigned char* charset;
+	size_t charsetSize;
+	if(mDocument->GetString(mDocument->GetDictionary(inDictionary, "FontDescriptor"), "CharSet", charset, charsetSize))
+		cmap = CharSetToMap(charset, charsetSize);
+
+	if(mDocument->GetName(inDictionary, "BaseFont", baseFont)) {
+		CPDFObject* widthsArray = mDocument->GetArray(inDictionary, "Widths");
+		if(widthsArray && widthsArray->GetCount()) {
+			long firstChar = 0;
+			mDocument->GetInteger(inDictionary, "FirstChar", firstChar);
+
+			widths = (float*) calloc(256, sizeof(float));
+
+			for(size_t i = 0; widths && i < widthsArray->GetCount(); i++) {
+				CPDFObject* object = mDocument->Resolve(widthsArray->GetItem(i));
+
+				float w;
+				if(object && object->GetNumber(w) && firstChar + (long) i >= 0 && firstChar + (long) i < 256)
+					widths[firstChar + i] = w;
+			}
+		}
+
+		CPDFObject* toUnicode = mDocument->GetStream(inDictionary, "ToUnicode");
+
+		if(encodingObject && encodingObject->GetName(encoding)) {
+			// type 1, true type, type 3
+
+			if(toUnicode) {
+				umap = ExtractUnicodeMap(toUnicode);
+
+				if(umap) {
+					map = FoldMaps(umap, cmap);
+					if(map == cmap)
+						cmap = NULL;
+
+					if(UnicodeMapIsValid(umap) == false) {
+						free(umap);
+						umap = NULL;
+					}
+				}
+			}
+
+			if(map == NULL && umap == NULL && cmap) {
+				map = cmap;
+				cmap = NULL;
+			}
+
+			AddFont(inKey, baseFont, encoding, map, umap, widths, 0, 0, cacheKey);
+		}
+		else if(encodingObject && encodingObject->GetType() == CPDFObject::kStream) {
+			// type 0, whose CMaps are not read yet
+
+			if(cmap) {
+				map = cmap;
+				cmap = NULL;
+			}
+
+			AddFont(inKey, baseFont, encoding, map, umap, widths, 0, 0, cacheKey);
+		}
+		else if(encodingObject && encodingObject->GetType() == CPDFObject::kDictionary) {
+			// type 1, true type, type 3
+
+			bool symbolEncoding = false;
+			bool dingbatEncoding = false;
+			bool windowsEncoding = false;
+
+			if(strstr(baseFont, "Symbol"))
+				symbolEncoding = true;
+			else if(strstr(baseFont, "Dingbat"))
+				dingbatEncoding = true;
+			else {
+				const char* baseEncoding = NULL;
+
+				if(mDocument->GetName(encodingObject, "BaseEncoding", baseEncoding)) {
+					if(strcmp(baseEncoding, "WinAnsiEncoding") == 0)
+						windowsEncoding = true;
+				}
+			}
+
+			// always encoded for Word, as CMacPDFParser forces it
+			char customEncoding[256] = "MacRomanEncoding";
+			if(symbolEncoding)
+				strcpy(customEncoding, "MacSymbolEncoding");
+			else if(dingbatEncoding)
+				strcpy(customEncoding, "MacDingbatEncoding");
+			else if(windowsEncoding)
+				strcpy(customEncoding, "WinAnsiEncoding");
+
+			unsigned char fi = 0; // ligature support
+			unsigned char fl = 0;
+
+			bool adobe = false; // adobe aNNN char code support
+
+			CPDFObject* array = mDocument->GetArray(encodingObject, "Differences");
+			if(array) { // rare for true type
+				UPDFMaps::ConstMapParam converter = UPDFMaps::kMacLatinMap;
+				if(symbolEncoding)
+					converter = UPDFMaps::kSymbolMap;
+				else if(windowsEncoding)
+					converter = UPDFMaps::kWinLatinMap;
+
+				map = (char*) malloc(256);
+				if(map) {
+					for(long i = 0; i < 256; i++)
+						map[i] = (cmap ? cmap[i] : i);
+
+					long doff = 0;
+
+					for(size_t i = 0; i < array->GetCount(); i++) {
+						CPDFObject* object = mDocument->Resolve(array->GetItem(i));
+						if(object == NULL)
+							continue;
+
+						long doffInt;
+						const char* p = NULL;
+
+						if(object->GetType() == CPDFObject::kInteger && object->GetInteger(doffInt))
+							doff = doffInt;
+						else if(object->GetName(p) && p) {
+							if(doff >= 0 && doff < 256) {
+								char c = UPDFMaps::GlyphToCode(converter, p, &adobe);
+								if(c)
+									map[doff] = c;
+								else if(strcmp(p, "fi") == 0)
+									fi = doff;
+								else if(strcmp(p, "fl") == 0)
+									fl = doff;
+							}
+
+							doff++;
+						}
+					}
+				}
+			}
+
+			if(fi || fl)
+				strcpy(customEncoding, "WinAnsiEncoding");
+			else if(adobe)
+				strcpy(customEncoding, "MacRomanEncoding");
+
+			if(toUnicode) {
+				umap = ExtractUnicodeMap(toUnicode);
+
+				if(umap) {
+					map = FoldMaps(umap, map);
+
+					if(UnicodeMapIsValid(umap) == false) {
+						free(umap);
+						umap = NULL;
+					}
+				}
+			}
+
+			if(map == NULL && umap == NULL && cmap) {
+				map = cmap;
+				cmap = NULL;
+			}
+
+			AddFont(inKey, baseFont, customEncoding, map, umap, widths, fi, fl, cacheKey);
+		}
+		else {
+			if(toUnicode) {
+				umap = ExtractUnicodeMap(toUnicode);
+
+				if(umap) {
+					map = FoldMaps(umap, cmap);
+					if(map == cmap)
+						cmap = NULL;
+
+					if(UnicodeMapIsValid(umap) == false) {
+						free(umap);
+						umap = NULL;
+					}
+				}
+			}
+
+			if(map == NULL && umap == NULL && cmap) {
+				map = cmap;
+				cmap = NULL;
+			}
+
+			AddFont(inKey, baseFont, encoding, map, umap, widths, 0, 0, cacheKey);
+		}
+	}
+
+	if(cmap)
+		free(cmap);
+}
+
+static void
+HashBytes(
+	UInt64& ioHash,
+	const char* inTag,
+	const void* inData,
+	size_t inSize)
+{
+	CPDFFontCache::Hash(ioHash, inTag, strlen(inTag) + 1);
+	CPDFFontCache::Hash(ioHash, &inSize, sizeof(inSize));
+	CPDFFontCache::Hash(ioHash, inData, inSize);
+}
+
+static void
+HashArray(
+	UInt64& ioHash,
+	const char* inTag,
+	CPDFDocument* inDocument,
+	CPDFObject* inArray)
+{
+	size_t objectCount = inArray->GetCount();
+
+	HashBytes(ioHash, inTag, &objectCount, sizeof(objectCount));
+
+	for(size_t i = 0; i < objectCount; i++) {
+		CPDFObject* object = inDocument->Resolve(inArray->GetItem(i));
+		long type = (object ? object->GetType() : CPDFObject::kNull);
+
+		long integer;
+		float real;
+		const char* p;
+
+		if(type == CPDFObject::kInteger && object->GetInteger(integer))
+			HashBytes(ioHash, "i", &integer, sizeof(integer));
+		else if(type == CPDFObject::kReal && object->GetNumber(real))
+			HashBytes(ioHash, "r", &real, sizeof(real));
+		else if(type == CPDFObject::kName && object->GetName(p))
+			HashBytes(ioHash, "n", p, strlen(p));
+		else
+			HashBytes(ioHash, "?", &type, sizeof(type));
+	}
+}
+
+static void
+HashStream(
+	UInt64& ioHash,
+	const char* inTag,
+	CPDFDocument* inDocument,
+	CPDFObject* inStream)
+{
+	unsigned char* data;
+	size_t size;
+
+	if(inDocument->CopyStreamData(inStream, data, size) == CPDFParser::kNoError) {
+		HashBytes(ioHash, inTag, data, size);
+		free(data);
+	}
+	else
+		HashBytes(ioHash, inTag, NULL, 0);
+}
+
+// A font cache key from everything ExtractFont reads, 0 for a font it
+// would not add.
+UInt64
+CNativePDFParser::HashFont(
+	CPDFObject* inDictionary)
+{
+	const char* baseFont = NULL;
+	if(mDocument->GetName(inDictionary, "BaseFont", baseFont) == false)
+		return 0;
+
+	UInt64 hash = kFontCacheSeed;
+	HashBytes(hash, "BaseFont", baseFont, strlen(baseFont));
+
+	const char* subtype = NULL;
+	if(mDocument->GetName(inDictionary, "Subtype", subtype))
+		HashBytes(hash, "Subtype", subtype, strlen(subtype));
+
+	long firstChar = 0;
+	mDocument->GetInteger(inDictionary, "FirstChar", firstChar);
+	HashBytes(hash, "FirstChar", &firstChar, sizeof(firstChar));
+
+	CPDFObject* array = mDocument->GetArray(inDictionary, "Widths");
+	if(array)
+		HashArray(hash, "Widths", mDocument, array);
+
+	const char* encoding = NULL;
+	CPDFObject* encodingObject = mDocument->Get(inDictionary, "Encoding");
+
+	if(encodingObject && encodingObject->GetName(encoding))
+		HashBytes(hash, "Encoding", encoding, strlen(encoding));
+	else if(encodingObject && encodingObject->GetType() == CPDFObject::kStream)
+		HashStream(hash, "EncodingStream", mDocument, encodingObject);
+	else if(encodingObject && encodingObject->GetType() == CPDFObject::kDictionary) {
+		const char* baseEncoding = NULL;
+		if(mDocument->GetName(encodingObject, "BaseEncoding", baseEncoding))
+			HashBytes(hash, "BaseEncoding", baseEncoding, strlen(baseEncoding));
+
+		array = mDocument->GetArray(encodingObject, "Differences");
+		if(array)
+			HashArray(hash, "Differences", mDocument, array);
+	}
+
+	const unsigned char* charset;
+	size_t charsetSize;
+	if(mDocument->GetString(mDocument->GetDictionary(inDictionary, "FontDescriptor"), "CharSet", charset, charsetSize))
+		HashBytes(hash, "CharSet", charset, charsetSize);
+
+	CPDFObject* stream = mDocument->GetStream(inDictionary, "ToUnicode");
+	if(stream)
+		HashStream(hash, "ToUnicode", mDocument, stream);
+
+	return (hash ? hash : 1);
+}
+
+wchar_t*
+CNativePDFParser::ExtractUnicodeMap(
+	CPDFObject* inStream)
+{
+	wchar_t* map = NULL;
+
+	unsigned char* data;
+	size_t size;
+
+	if(mDocument->CopyStreamData(inStream, data, size) == kNoError) {
+		CPDFCMap cmap;
+
+		// simple fonts only use the one-byte codes
+		if(cmap.Parse(data, size) == kNoError)
+			map = cmap.CopyByteMap();
+
+		free(data);
+	}
+
+	return map;
+}
+
+// A page's resources, which are inherited down the page tree.
+CPDFObject*
+CNativePDFParser::GetResources()
+{
+	CPDFObject* resources = mDocument->GetInherited(mPage, "Resources");
+
+	return (resources && resources->GetType() == CPDFObject::kDictionary ? resources : NULL);
+}
+
+bool
+CNativePDFParser::GetBox(
+	const char* inKey,
+	float* outBox)
+{
+	CPDFObject* box = mDocument->GetInherited(mPage, inKey);
+	if(box == NULL || box->GetType() != CPDFObject::kArray || box->GetCount() < 4)
+		return false;
+
+	float corners[4];
+
+	for(size_t i = 0; i < 4; i++) {
+		CPDFObject* number = mDocument->Resolve(box->GetItem(i));
+		if(number == NULL || number->GetNumber(corners[i]) == false)
+			return false;
+	}
+
+	// any two opposite corners
+	outBox[0] = (corners[0] < corners[2] ? corners[0] : corners[2]);
+	outBox[1] = (corners[1] < corners[3] ? corners[1] : corners[3]);
+	outBox[2] = (corners[0] < corners[2] ? corners[2] - corners[0] : corners[0] - corners[2]);
+	outBox[3] = (corners[1] < corners[3] ? corners[3] - corners[1] : corners[1] - corners[3]);
+
+	return true;
+}
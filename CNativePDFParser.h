@@ -0,0 +1,135 @@
+// Trapeze
+//
+// Copyright (c) 2004 Mesa Dynamics, LLC.  All rights reserved.
+
+#ifndef _H_CNativePDFParser
+#define _H_CNativePDFParser
+#pragma once
+
+#include "CPDFParser.h"
+#include "CPDFObjectSet.h"
+
+#include <vector>
+
+class CMappedFile;
+class CPDFDocument;
+class CPDFObject;
+
+// Reads the PDF itself through CPDFDocument instead of CoreGraphics, so it
+// runs where CGPDFDocument does not.  Text, RTF and HTML only, like the
+// portable entry points of CMacPDFParser; encrypted files are refused with
+// kNoPasswordError.
+class CNativePDFParser : public CPDFParser {
+public:
+	CNativePDFParser();
+	virtual ~CNativePDFParser();
+
+	// converts a PDF held in memory; inData must stay valid until this returns
+	OSErr ConvertBuffer(
+		const void* inData,
+		size_t inSize,
+		long inType,
+		COutputSink* inSink,
+		const char* inTitle = NULL);
+
+	// same, reading the PDF through a memory mapping of inPath
+	virtual OSErr ConvertPath(
+		const char* inPath,
+		long inType,
+		COutputSink* inSink,
+		const char* inTitle = NULL);
+
+	virtual OSErr CountPages(
+		const char* inPath,
+		size_t& outCount);
+
+	virtual OSErr ConvertPathToOutputs(
+		const char* inPath,
+		PDFOutput* ioOutputs,
+		long inCount,
+		const char* inTitle = NULL);
+
+protected:
+	// inherited
+	virtual OSErr BeginRender(
+		size_t inPage,
+		float* outWidth,
+		float* outHeight);
+
+	virtual void Render();
+
+	virtual void EndRender();
+
+	virtual void BeginDocument();
+
+	virtual CPDFParser* CreatePageWorker();
+
+	virtual PDFFontObject* ResolveFont(
+		const char* inKey);
+
+protected:
+	OSErr StartConversion(
+		const void* inData,
+		size_t inSize);
+
+	void EndConversion();
+
+	OSErr OpenInput(
+		const char* inPath);
+
+	void CloseInput();
+
+private:
+	// text
+	void ParseContents(
+		CPDFObject* inStream);
+
+	void AddForms(
+		CPDFObject* inResources);
+
+	// fonts
+	void ResourcesToFonts(
+		CPDFObject* inResources);
+
+	CPDFObject* FindFont(
+		CPDFObject* inResources,
+		const char* inKey,
+		long inDepth);
+
+	void ExtractFont(
+		const char* inKey,
+		CPDFObject* inDictionary);
+
+	UInt64 HashFont(
+		CPDFObject* inDictionary);
+
+	wchar_t* ExtractUnicodeMap(
+		CPDFObject* inStream);
+
+	CPDFObject* GetResources();
+
+	bool GetBox(
+		const char* inKey,
+		float* outBox);
+
+protected:
+	// document, shared with the page workers
+	CPDFDocument* mDocument;
+	CPDFObject* mPage;
+
+	CMappedFile* mInput;
+
+	// objects already visited, per page
+	CPDFObjectSet mObjects;
+
+	// font dictionaries extracted as pages named them, and the index of
+	// each one's font, -1 for one that made none
+	struct ResolvedFont {
+		CPDFObject* dictionary;
+		long index;
+	};
+
+	std::vector<ResolvedFont> mResolvedFonts;
+};
+
+#endif
@@ -0,0 +1,367 @@
+// Trapeze
+//
+// Copyright (c) 2004 Mesa Dynamics, LLC.  All rights reserved.
+
+#include "COutputSink.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+COutputSink::COutputSink() :
+		mBytesWritten(0)
+{
+}
+
+COutputSink::~COutputSink()
+{
+}
+
+OSErr
+COutputSink::Flush()
+{
+	return CPDFParser::kNoError;
+}
+
+OSErr
+COutputSink::Close()
+{
+	return Flush();
+}
+
+#pragma mark -
+
+CDescriptorSink::CDescriptorSink(
+	int inDescriptor,
+	bool inOwnsDescriptor,
+	long inBufferSize) :
+		mDescriptor(inDescriptor),
+		mOwnsDescriptor(inOwnsDescriptor),
+		mBuffer(NULL),
+		mBufferSize(inBufferSize),
+		mBufferLength(0)
+{
+	// page aligned so the kernel can copy out of it cheaply
+	void* buffer = NULL;
+	if(mBufferSize > 0 && posix_memalign(&buffer, 4096, mBufferSize) == 0)
+		mBuffer = (unsigned char*) buffer;
+	else
+		mBufferSize = 0;
+}
+
+CDescriptorSink::~CDescriptorSink()
+{
+	Close();
+
+	if(mBuffer)
+		free(mBuffer);
+}
+
+OSErr
+CDescriptorSink::Write(
+	const void* inData,
+	long inSize)
+{
+	if(mDescriptor < 0)
+		return CPDFParser::kFileWriteError;
+
+	if(inSize <= 0)
+		return CPDFParser::kNoError;
+
+	if(mBufferLength + inSize <= mBufferSize) {
+		memcpy(&(mBuffer[mBufferLength]), inData, inSize);
+		mBufferLength += inSize;
+
+		return CPDFParser::kNoError;
+	}
+
+	// pending bytes and the new block leave in the same call
+	OSErr err = WriteVector(mBuffer, mBufferLength, inData, inSize);
+	mBufferLength = 0;
+
+	return err;
+}
+
+OSErr
+CDescriptorSink::Flush()
+{
+	if(mDescriptor < 0)
+		return CPDFParser::kNoError;
+
+	OSErr err = WriteVector(mBuffer, mBufferLength, NULL, 0);
+	mBufferLength = 0;
+
+	return err;
+}
+
+OSErr
+CDescriptorSink::Close()
+{
+	OSErr err = Flush();
+
+	if(mDescriptor >= 0 && mOwnsDescriptor) {
+		if(close(mDescriptor) != 0 && err == CPDFParser::kNoError)
+			err = CPDFParser::kFileWriteError;
+	}
+
+	mDescriptor = -1;
+
+	return err;
+}
+
+OSErr
+CDescriptorSink::WriteVector(
+	const void* inFirst,
+	long inFirstSize,
+	const void* inSecond,
+	long inSecondSize)
+{
+	struct iovec vector[2];
+	int count = 0;
+
+	if(inFirstSize > 0) {
+		vector[count].iov_base = (void*) inFirst;
+		vector[count].iov_len = inFirstSize;
+		count++;
+	}
+
+	if(inSecondSize > 0) {
+		vector[count].iov_base = (void*) inSecond;
+		vector[count].iov_len = inSecondSize;
+		count++;
+	}
+
+	struct iovec* v = vector;
+
+	while(count) {
+		ssize_t written = writev(mDescriptor, v, count);
+
+		if(written < 0) {
+			if(errno == EINTR)
+				continue;
+
+			return CPDFParser::kFileWriteError;
+		}
+
+		mBytesWritten += written;
+
+		// skip whatever went out, partial writes resume mid-vector
+		while(count && (size_t) written >= v->iov_len) {
+			written -= v->iov_len;
+			v++;
+			count--;
+		}
+
+		if(count) {
+			v->iov_base = (char*) v->iov_base + written;
+			v->iov_len -= written;
+		}
+	}
+
+	return CPDFParser::kNoError;
+}
+
+#pragma mark -
+
+CFileSink::CFileSink() :
+		mPath(NULL)
+{
+}
+
+CFileSink::~CFileSink()
+{
+	Close();
+
+	if(mPath)
+		free(mPath);
+}
+
+OSErr
+CFileSink::Open(
+	const char* inPath)
+{
+	Close();
+
+	if(mPath) {
+		free(mPath);
+		mPath = NULL;
+	}
+
+	mDescriptor = open(inPath, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	if(mDescriptor < 0)
+		return CPDFParser::kFileWriteError;
+
+	mOwnsDescriptor = true;
+	mBytesWritten = 0;
+
+	mPath = strdup(inPath);
+
+	return CPDFParser::kNoError;
+}
+
+void
+CFileSink::Discard()
+{
+	mBufferLength = 0;
+
+	Close();
+
+	if(mPath) {
+		unlink(mPath);
+
+		free(mPath);
+		mPath = NULL;
+	}
+}
+
+#pragma mark -
+
+CCallbackSink::CCallbackSink(
+	SinkProc inProc,
+	void* inRefCon,
+	long inBufferSize) :
+		mProc(inProc),
+		mRefCon(inRefCon),
+		mBuffer(NULL),
+		mBufferSize(inBufferSize),
+		mBufferLength(0),
+		mClosed(false)
+{
+	if(mBufferSize > 0)
+		mBuffer = (unsigned char*) malloc(mBufferSize);
+
+	if(mBuffer == NULL)
+		mBufferSize = 0;
+}
+
+CCallbackSink::~CCallbackSink()
+{
+	Close();
+
+	if(mBuffer)
+		free(mBuffer);
+}
+
+OSErr
+CCallbackSink::Write(
+	const void* inData,
+	long inSize)
+{
+	if(mProc == NULL || mClosed)
+		return CPDFParser::kFileWriteError;
+
+	if(inSize <= 0)
+		return CPDFParser::kNoError;
+
+	mBytesWritten += inSize;
+
+	if(mBufferLength + inSize <= mBufferSize) {
+		memcpy(&(mBuffer[mBufferLength]), inData, inSize);
+		mBufferLength += inSize;
+
+		return CPDFParser::kNoError;
+	}
+
+	// too big to buffer: what is pending goes first, then the block itself
+	OSErr err = Flush();
+	if(err == CPDFParser::kNoError)
+		err = (*mProc)(inData, inSize, mRefCon);
+
+	return err;
+}
+
+OSErr
+CCallbackSink::Flush()
+{
+	if(mProc == NULL || mBufferLength == 0)
+		return CPDFParser::kNoError;
+
+	OSErr err = (*mProc)(mBuffer, mBufferLength, mRefCon);
+	mBufferLength = 0;
+
+	return err;
+}
+
+OSErr
+CCallbackSink::Close()
+{
+	if(mClosed)
+		return CPDFParser::kNoError;
+
+	OSErr err = Flush();
+
+	mClosed = true;
+
+	if(mProc) {
+		OSErr endErr = (*mProc)(NULL, 0, mRefCon);
+		if(err == CPDFParser::kNoError)
+			err = endErr;
+	}
+
+	return err;
+}
+
+#pragma mark -
+
+CMemorySink::CMemorySink(
+	long inCapacity) :
+		mData(NULL),
+		mSize(0),
+		mCapacity(0)
+{
+	if(inCapacity > 0) {
+		mData = (unsigned char*) malloc(inCapacity);
+		if(mData)
+			mCapacity = inCapacity;
+	}
+}
+
+CMemorySink::~CMemorySink()
+{
+	if(mData)
+		free(mData);
+}
+
+OSErr
+CMemorySink::Write(
+	const void* inData,
+	long inSize)
+{
+	if(inSize <= 0)
+		return CPDFParser::kNoError;
+
+	if(mSize + inSize > mCapacity) {
+		long capacity = (mCapacity ? mCapacity : 4096);
+		while(capacity < mSize + inSize)
+			capacity *= 2;
+
+		unsigned char* data = (unsigned char*) realloc(mData, capacity);
+		if(data == NULL)
+			return CPDFParser::kMemoryError;
+
+		mData = data;
+		mCapacity = capacity;
+	}
+
+	memcpy(&(mData[mSize]), inData, inSize);
+	mSize += inSize;
+
+	mBytesWritten += inSize;
+
+	return CPDFParser::kNoError;
+}
+
+unsigned char*
+CMemorySink::Detach()
+{
+	unsigned char* data = mData;
+
+	mData = NULL;
+	mSize = 0;
+	mCapacity = 0;
+
+	return data;
+}
@@ -0,0 +1,162 @@
+// Trapeze
+//
+// Copyright (c) 2004 Mesa Dynamics, LLC.  All rights reserved.
+
+#ifndef _H_COutputSink
+#define _H_COutputSink
+#pragma once
+
+#include "CPDFParser.h"
+
+#include <sys/types.h>
+
+const long		kSinkBufferSize		= 256 * 1024;
+
+// Destination for converted text.  Writes return CPDFParser error codes.
+class COutputSink {
+public:
+	COutputSink();
+	virtual ~COutputSink();
+
+	virtual OSErr Write(
+		const void* inData,
+		long inSize) = 0;
+
+	virtual OSErr Flush();
+
+	virtual OSErr Close();
+
+	unsigned long long GetBytesWritten() {
+		return mBytesWritten;
+	}
+
+protected:
+	unsigned long long mBytesWritten;
+};
+
+// Buffers small writes and hands them to a file descriptor in large
+// chunks; a write that does not fit goes out together with the pending
+// buffer in a single writev.
+class CDescriptorSink : public COutputSink {
+public:
+	CDescriptorSink(
+		int inDescriptor = -1,
+		bool inOwnsDescriptor = false,
+		long inBufferSize = kSinkBufferSize);
+
+	virtual ~CDescriptorSink();
+
+	virtual OSErr Write(
+		const void* inData,
+		long inSize);
+
+	virtual OSErr Flush();
+
+	virtual OSErr Close();
+
+	int GetDescriptor() {
+		return mDescriptor;
+	}
+
+protected:
+	OSErr WriteVector(
+		const void* inFirst,
+		long inFirstSize,
+		const void* inSecond,
+		long inSecondSize);
+
+protected:
+	int mDescriptor;
+	bool mOwnsDescriptor;
+
+	unsigned char* mBuffer;
+	long mBufferSize;
+	long mBufferLength;
+};
+
+// Creates (or truncates) a file and writes to it.
+class CFileSink : public CDescriptorSink {
+public:
+	CFileSink();
+	virtual ~CFileSink();
+
+	OSErr Open(
+		const char* inPath);
+
+	// closes and removes the file, used when a conversion produced nothing
+	void Discard();
+
+protected:
+	char* mPath;
+};
+
+// Receives a sink's bytes as they go out; returns a CPDFParser error code,
+// anything but kNoError failing the write.
+typedef OSErr (*SinkProc)(
+	const void* inData,
+	long inSize,
+	void* inRefCon);
+
+// Buffers writes and hands them to a callback whenever the buffer fills
+// or is flushed; a parser set to stream flushes after the header and
+// after each page, so every page arrives as soon as it is written.
+// Close() hands over what is left, then calls the proc once with no data
+// to mark the end of the output.
+class CCallbackSink : public COutputSink {
+public:
+	CCallbackSink(
+		SinkProc inProc,
+		void* inRefCon = NULL,
+		long inBufferSize = kSinkBufferSize);
+
+	virtual ~CCallbackSink();
+
+	virtual OSErr Write(
+		const void* inData,
+		long inSize);
+
+	virtual OSErr Flush();
+
+	virtual OSErr Close();
+
+protected:
+	SinkProc mProc;
+	void* mRefCon;
+
+	unsigned char* mBuffer;
+	long mBufferSize;
+	long mBufferLength;
+
+	bool mClosed;
+};
+
+// Collects everything in a growable block of memory.
+class CMemorySink : public COutputSink {
+public:
+	CMemorySink(
+		long inCapacity = 0);
+
+	virtual ~CMemorySink();
+
+	virtual OSErr Write(
+		const void* inData,
+		long inSize);
+
+	unsigned char* GetData() {
+		return mData;
+	}
+
+	long GetSize() {
+		return mSize;
+	}
+
+	// caller takes ownership and must free() the block
+	unsigned char* Detach();
+
+protected:
+	unsigned char* mData;
+	long mSize;
+	long mCapacity;
+};
+
+#endif
@@ -0,0 +1,737 @@
+// Trapeze
+//
+// Copyright (c) 2004 Mesa Dynamics, LLC.  All rights reserved.
+
+#include "CPDFBatch.h"
+#include "COutputSink.h"
+#include "CPDFFontCache.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+const long		kCountTask			= -1;
+
+struct CPDFBatch::Document {
+	char* input;
+	char* output;
+	char* title;
+	long type;
+
+	OSErr error;
+	bool text;
+
+	size_t pages;
+	unsigned long long inputBytes;
+
+	// ranges finish in any order and are written in order
+	long ranges;
+	long completed;
+	long written;
+
+	unsigned char** results;
+	long* resultSizes;
+	bool* resultReady;
+
+	CFileSink* sink;
+
+	pthread_mutex_t lock;
+};
+
+struct CPDFBatch::Task {
+	Document* document;
+
+	long range; // kCountTask before the document is split
+	size_t first;
+	size_t last;
+};
+
+struct CPDFBatch::Worker {
+	CPDFBatch* batch;
+	long index;
+
+	pthread_t thread;
+
+	// owner takes from the back, thieves from the front
+	std::deque<Task*> tasks;
+	pthread_mutex_t lock;
+};
+
+static char*
+CopyString(
+	const char* inString)
+{
+	return (inString ? strdup(inString) : NULL);
+}
+
+static double
+GetSeconds()
+{
+	struct timeval now;
+	gettimeofday(&now, NULL);
+
+	return (double) now.tv_sec + ((double) now.tv_usec / 1000000.0);
+}
+
+CPDFBatch::CPDFBatch(
+	PDFParserFactory inFactory,
+	void* inRefCon) :
+		mFactory(inFactory),
+		mRefCon(inRefCon),
+		mThreads(0),
+		mRangePages(kBatchRangePages),
+		mFontCache(CPDFFontCache::GetShared()),
+		mPending(0),
+		mQueued(0)
+{
+	// same as a new parser
+	mOptions.padStripping = false;
+	mOptions.rewrapping = false;
+	mOptions.relaxSpacing = false;
+	mOptions.tightSpacing = false;
+	mOptions.sorting = true;
+	mOptions.showBreaks = false;
+	mOptions.newlineCode = CPDFParser::kNewlineUNIX;
+	mOptions.renderThreads = 0;
+	mOptions.streaming = false;
+
+	memset(&(mOptions.budget), 0, sizeof(mOptions.budget));
+	mOptions.budget.degrade = CPDFParser::kDegradeRawText;
+
+	memset(&(mOptions.preview), 0, sizeof(mOptions.preview));
+
+	memset(&mStats, 0, sizeof(mStats));
+
+	pthread_mutex_init(&mIdleLock, NULL);
+	pthread_cond_init(&mIdleCondition, NULL);
+	pthread_mutex_init(&mStatsLock, NULL);
+}
+
+CPDFBatch::~CPDFBatch()
+{
+	FreeDocuments();
+
+	pthread_mutex_destroy(&mStatsLock);
+	pthread_cond_destroy(&mIdleCondition);
+	pthread_mutex_destroy(&mIdleLock);
+}
+
+OSErr
+CPDFBatch::Add(
+	const char* inInput,
+	const char* inOutput,
+	long inType,
+	const char* inTitle)
+{
+	if(inInput == NULL || inOutput == NULL)
+		return CPDFParser::kConvertError;
+
+	Document* document = (Document*) calloc(1, sizeof(Document));
+	if(document == NULL)
+		return CPDFParser::kMemoryError;
+
+	document->input = CopyString(inInput);
+	document->output = CopyString(inOutput);
+	document->title = CopyString(inTitle);
+	document->type = inType;
+	document->error = CPDFParser::kNoError;
+
+	pthread_mutex_init(&(document->lock), NULL);
+
+	mDocuments.push_back(document);
+
+	if(document->input == NULL || document->output == NULL || (inTitle && document->title == NULL)) {
+		mDocuments.pop_back();
+		FreeDocument(document);
+
+		return CPDFParser::kMemoryError;
+	}
+
+	return CPDFParser::kNoError;
+}
+
+OSErr
+CPDFBatch::GetError(
+	long inIndex)
+{
+	if(inIndex < 0 || inIndex >= (long) mDocuments.size())
+		return CPDFParser::kConvertError;
+
+	return mDocuments[inIndex]->error;
+}
+
+OSErr
+CPDFBatch::Run()
+{
+	if(mFactory == NULL)
+		return CPDFParser::kConvertError;
+
+	long threads = mThreads;
+	if(threads == 0)
+		threads = sysconf(_SC_NPROCESSORS_ONLN);
+
+	if(threads < 1)
+		threads = 1;
+
+	mCancel.Reset();
+
+	pthread_mutex_lock(&mStatsLock);
+	memset(&mStats, 0, sizeof(mStats));
+	pthread_mutex_unlock(&mStatsLock);
+
+	double start = GetSeconds();
+
+	for(long i = 0; i < threads; i++) {
+		Worker* worker = new Worker;
+
+		worker->batch = this;
+		worker->index = i;
+
+		pthread_mutex_init(&(worker->lock), NULL);
+
+		mWorkers.push_back(worker);
+	}
+
+	// deal the documents out; counting them is the first task of each
+	std::vector<Document*>::const_iterator d = mDocuments.begin();
+	long next = 0;
+
+	for(d = mDocuments.begin(); d != mDocuments.end(); d++) {
+		// whatever an earlier run left behind
+		ClearDocument(*d);
+
+		Task* task = (Task*) malloc(sizeof(Task));
+		if(task == NULL) {
+			(*d)->error = CPDFParser::kMemoryError;
+			continue;
+		}
+
+		task->document = *d;
+		task->range = kCountTask;
+		task->first = 0;
+		task->last = 0;
+
+		UPDFAtomic::Add(&mPending, 1);
+		Push(mWorkers[next], task);
+
+		next = (next + 1) % threads;
+	}
+
+	pthread_attr_t attributes;
+	pthread_attr_init(&attributes);
+	pthread_attr_setstacksize(&attributes, kRenderStackSize);
+
+	// the calling thread is worker 0
+	std::vector<Worker*> started;
+
+	for(long i = 1; i < threads; i++) {
+		Worker* worker = mWorkers[i];
+
+		if(pthread_create(&(worker->thread), &attributes, WorkerThread, worker) == 0)
+			started.push_back(worker);
+	}
+
+	pthread_attr_destroy(&attributes);
+
+	Work(mWorkers[0]);
+
+	std::vector<Worker*>::const_iterator w = started.begin();
+	for(w = started.begin(); w != started.end(); w++)
+		pthread_join((*w)->thread, NULL);
+
+	for(w = mWorkers.begin(); w != mWorkers.end(); w++) {
+		Worker* worker = *w;
+
+		pthread_mutex_destroy(&(worker->lock));
+		delete worker;
+	}
+
+	mWorkers.clear();
+
+	pthread_mutex_lock(&mStatsLock);
+
+	mStats.seconds = GetSeconds() - start;
+	if(mStats.seconds > 0.0) {
+		mStats.pagesPerSecond = (double) mStats.pages / mStats.seconds;
+		mStats.bytesPerSecond = (double) mStats.inputBytes / mStats.seconds;
+	}
+
+	pthread_mutex_unlock(&mStatsLock);
+
+	OSErr error = CPDFParser::kNoError;
+
+	if(mCancel.IsCancelled())
+		error = CPDFParser::kUserAbort;
+	else {
+		for(d = mDocuments.begin(); d != mDocuments.end(); d++) {
+			if((*d)->error != CPDFParser::kNoError) {
+				error = (*d)->error;
+				break;
+			}
+		}
+	}
+
+	return error;
+}
+
+void
+CPDFBatch::Abort()
+{
+	// every parser holds the token, conversions in progress stop mid-page
+	mCancel.Cancel();
+
+	pthread_mutex_lock(&mIdleLock);
+	pthread_cond_broadcast(&mIdleCondition);
+	pthread_mutex_unlock(&mIdleLock);
+}
+
+void
+CPDFBatch::GetStats(
+	PDFBatchStats& outStats)
+{
+	pthread_mutex_lock(&mStatsLock);
+	outStats = mStats;
+	pthread_mutex_unlock(&mStatsLock);
+}
+
+#pragma mark -
+
+void
+CPDFBatch::Push(
+	Worker* inWorker,
+	Task* inTask)
+{
+	pthread_mutex_lock(&(inWorker->lock));
+	inWorker->tasks.push_back(inTask);
+	pthread_mutex_unlock(&(inWorker->lock));
+
+	UPDFAtomic::Add(&mQueued, 1);
+
+	// counted before the broadcast, so an idle worker can't miss it
+	pthread_mutex_lock(&mIdleLock);
+	pthread_cond_broadcast(&mIdleCondition);
+	pthread_mutex_unlock(&mIdleLock);
+}
+
+CPDFBatch::Task*
+CPDFBatch::Pop(
+	Worker* inWorker)
+{
+	Task* task = NULL;
+
+	pthread_mutex_lock(&(inWorker->lock));
+
+	if(inWorker->tasks.empty() == false) {
+		task = inWorker->tasks.back();
+		inWorker->tasks.pop_back();
+	}
+
+	pthread_mutex_unlock(&(inWorker->lock));
+
+	if(task)
+		UPDFAtomic::Add(&mQueued, -1);
+
+	return task;
+}
+
+CPDFBatch::Task*
+CPDFBatch::Steal(
+	Worker* inWorker)
+{
+	long count = mWorkers.size();
+
+	for(long i = 1; i < count; i++) {
+		Worker* victim = mWorkers[(inWorker->index + i) % count];
+		Task* task = NULL;
+
+		pthread_mutex_lock(&(victim->lock));
+
+		if(victim->tasks.empty() == false) {
+			task = victim->tasks.front();
+			victim->tasks.pop_front();
+		}
+
+		pthread_mutex_unlock(&(victim->lock));
+
+		if(task) {
+			UPDFAtomic::Add(&mQueued, -1);
+			return task;
+		}
+	}
+
+	return NULL;
+}
+
+CPDFBatch::Task*
+CPDFBatch::NextTask(
+	Worker* inWorker)
+{
+	for(;;) {
+		Task* task = Pop(inWorker);
+
+		if(task == NULL)
+			task = Steal(inWorker);
+
+		if(task)
+			return task;
+
+		pthread_mutex_lock(&mIdleLock);
+
+		// everything is done, or somebody is still working and may split
+		// a document into more tasks
+		if(UPDFAtomic::Load(&mPending) == 0) {
+			pthread_mutex_unlock(&mIdleLock);
+			return NULL;
+		}
+
+		if(UPDFAtomic::Load(&mQueued) == 0)
+			pthread_cond_wait(&mIdleCondition, &mIdleLock);
+
+		pthread_mutex_unlock(&mIdleLock);
+	}
+}
+
+void
+CPDFBatch::FinishTask()
+{
+	if(UPDFAtomic::Add(&mPending, -1) == 0) {
+		pthread_mutex_lock(&mIdleLock);
+		pthread_cond_broadcast(&mIdleCondition);
+		pthread_mutex_unlock(&mIdleLock);
+	}
+}
+
+void*
+CPDFBatch::WorkerThread(
+	void* inInfo)
+{
+	Worker* worker = (Worker*) inInfo;
+	worker->batch->Work(worker);
+
+	return NULL;
+}
+
+void
+CPDFBatch::Work(
+	Worker* inWorker)
+{
+	Task* task;
+
+	while((task = NextTask(inWorker)) != NULL) {
+		if(task->range == kCountTask)
+			CountDocument(inWorker, task);
+		else
+			ConvertRange(inWorker, task);
+
+		free(task);
+
+		FinishTask();
+	}
+}
+
+#pragma mark -
+
+void
+CPDFBatch::CountDocument(
+	Worker* inWorker,
+	Task* inTask)
+{
+	Document* document = inTask->document;
+
+	if(mCancel.IsCancelled()) {
+		document->error = CPDFParser::kUserAbort;
+
+		FinishDocument(document);
+		return;
+	}
+
+	struct stat info;
+	if(stat(document->input, &info) == 0)
+		document->inputBytes = info.st_size;
+
+	CPDFParser* parser = NewParser();
+	if(parser == NULL) {
+		document->error = CPDFParser::kMemoryError;
+
+		FinishDocument(document);
+		return;
+	}
+
+	size_t pages = 0;
+	OSErr error = parser->CountPages(document->input, pages);
+
+	delete parser;
+
+	if(error == CPDFParser::kNoError && pages == 0)
+		error = CPDFParser::kNoPagesError;
+
+	long ranges = 0;
+	size_t rangePages = mRangePages;
+
+	// a preview limits the whole document, which only a single range sees
+	if(mOptions.preview.maxPages || mOptions.preview.maxChars || mOptions.preview.maxBytes)
+		rangePages = pages;
+
+	if(error == CPDFParser::kNoError) {
+		ranges = (pages + rangePages - 1) / rangePages;
+
+		document->results = (unsigned char**) calloc(ranges, sizeof(unsigned char*));
+		document->resultSizes = (long*) calloc(ranges, sizeof(long));
+		document->resultReady = (bool*) calloc(ranges, sizeof(bool));
+
+		document->sink = new CFileSink;
+
+		if(document->results == NULL || document->resultSizes == NULL || document->resultReady == NULL)
+			error = CPDFParser::kMemoryError;
+		else
+			error = document->sink->Open(document->output);
+	}
+
+	if(error != CPDFParser::kNoError) {
+		document->error = error;
+
+		FinishDocument(document);
+		return;
+	}
+
+	document->pages = pages;
+	document->ranges = ranges;
+
+	// pushed last to first, so this thread picks up the front of the
+	// document and thieves take the back
+	for(long i = ranges - 1; i >= 0; i--) {
+		Task* task = (Task*) malloc(sizeof(Task));
+
+		if(task == NULL) {
+			DeliverRange(document, i, NULL, 0, CPDFParser::kMemoryError);
+			continue;
+		}
+
+		task->document = document;
+		task->range = i;
+		task->first = (i * rangePages) + 1;
+		task->last = task->first + rangePages - 1;
+
+		if(task->last > pages)
+			task->last = pages;
+
+		UPDFAtomic::Add(&mPending, 1);
+		Push(inWorker, task);
+	}
+}
+
+void
+CPDFBatch::ConvertRange(
+	Worker* inWorker,
+	Task* inTask)
+{
+	Document* document = inTask->document;
+
+	if(mCancel.IsCancelled()) {
+		DeliverRange(document, inTask->range, NULL, 0, CPDFParser::kUserAbort);
+		return;
+	}
+
+	CPDFParser* parser = NewParser();
+	if(parser == NULL) {
+		DeliverRange(document, inTask->range, NULL, 0, CPDFParser::kMemoryError);
+		return;
+	}
+
+	// the pool already keeps every processor busy
+	parser->SetRenderThreads(0);
+	parser->SetPageRange(inTask->first, inTask->last);
+
+	CMemorySink sink;
+	OSErr error = parser->ConvertPath(document->input, document->type, &sink, document->title);
+
+	CPDFParser::PDFBudgetStats budget;
+	parser->GetBudgetStats(budget);
+
+	size_t pages = (inTask->last - inTask->first) + 1;
+	if(parser->DidStopForPreview())
+		pages = parser->GetPagesEmitted();
+
+	delete parser;
+
+	pthread_mutex_lock(&mStatsLock);
+
+	if(error == CPDFParser::kNoError || error == CPDFParser::kNoTextError)
+		mStats.pages += pages;
+
+	mStats.pagesOverBudget += budget.pages;
+
+	pthread_mutex_unlock(&mStatsLock);
+
+	long size = sink.GetSize();
+	DeliverRange(document, inTask->range, sink.Detach(), size, error);
+}
+
+void
+CPDFBatch::DeliverRange(
+	Document* inDocument,
+	long inRange,
+	void* inData,
+	long inSize,
+	OSErr inError)
+{
+	pthread_mutex_lock(&(inDocument->lock));
+
+	// a range without text is only a problem if they all are
+	if(inError == CPDFParser::kNoError)
+		inDocument->text = true;
+	else if(inError != CPDFParser::kNoTextError && inDocument->error == CPDFParser::kNoError)
+		inDocument->error = inError;
+
+	inDocument->results[inRange] = (unsigned char*) inData;
+	inDocument->resultSizes[inRange] = inSize;
+	inDocument->resultReady[inRange] = true;
+
+	// write whatever is now contiguous
+	while(inDocument->written < inDocument->ranges && inDocument->resultReady[inDocument->written]) {
+		long r = inDocument->written;
+
+		if(inDocument->results[r]) {
+			if(inDocument->error == CPDFParser::kNoError) {
+				OSErr error = inDocument->sink->Write(inDocument->results[r], inDocument->resultSizes[r]);
+				if(error != CPDFParser::kNoError)
+					inDocument->error = error;
+			}
+
+			free(inDocument->results[r]);
+			inDocument->results[r] = NULL;
+		}
+
+		inDocument->written++;
+	}
+
+	bool finished = (++(inDocument->completed) == inDocument->ranges);
+
+	pthread_mutex_unlock(&(inDocument->lock));
+
+	if(finished)
+		FinishDocument(inDocument);
+}
+
+void
+CPDFBatch::FinishDocument(
+	Document* inDocument)
+{
+	if(inDocument->error == CPDFParser::kNoError && inDocument->text == false)
+		inDocument->error = CPDFParser::kNoTextError;
+
+	unsigned long long outputBytes = 0;
+
+	if(inDocument->sink) {
+		if(inDocument->error == CPDFParser::kNoError)
+			inDocument->error = inDocument->sink->Close();
+
+		if(inDocument->error == CPDFParser::kNoError)
+			outputBytes = inDocument->sink->GetBytesWritten();
+		else
+			inDocument->sink->Discard();
+
+		delete inDocument->sink;
+		inDocument->sink = NULL;
+	}
+
+	pthread_mutex_lock(&mStatsLock);
+
+	mStats.documents++;
+
+	if(inDocument->error == CPDFParser::kNoError) {
+		mStats.inputBytes += inDocument->inputBytes;
+		mStats.outputBytes += outputBytes;
+	}
+	else
+		mStats.failures++;
+
+	pthread_mutex_unlock(&mStatsLock);
+}
+
+CPDFParser*
+CPDFBatch::NewParser()
+{
+	CPDFParser* parser = (*mFactory)(mRefCon);
+
+	if(parser) {
+		parser->SetOptions(mOptions);
+		parser->SetCancelToken(&mCancel);
+		parser->SetFontCache(mFontCache);
+	}
+
+	return parser;
+}
+
+void
+CPDFBatch::ClearDocument(
+	Document* inDocument)
+{
+	if(inDocument->results) {
+		for(long r = 0; r < inDocument->ranges; r++) {
+			if(inDocument->results[r])
+				free(inDocument->results[r]);
+		}
+
+		free(inDocument->results);
+		inDocument->results = NULL;
+	}
+
+	if(inDocument->resultSizes) {
+		free(inDocument->resultSizes);
+		inDocument->resultSizes = NULL;
+	}
+
+	if(inDocument->resultReady) {
+		free(inDocument->resultReady);
+		inDocument->resultReady = NULL;
+	}
+
+	if(inDocument->sink) {
+		delete inDocument->sink;
+		inDocument->sink = NULL;
+	}
+
+	inDocument->error = CPDFParser::kNoError;
+	inDocument->text = false;
+
+	inDocument->pages = 0;
+	inDocument->inputBytes = 0;
+
+	inDocument->ranges = 0;
+	inDocument->completed = 0;
+	inDocument->written = 0;
+}
+
+void
+CPDFBatch::FreeDocument(
+	Document* inDocument)
+{
+	ClearDocument(inDocument);
+
+	if(inDocument->input)
+		free(inDocument->input);
+
+	if(inDocument->output)
+		free(inDocument->output);
+
+	if(inDocument->title)
+		free(inDocument->title);
+
+	pthread_mutex_destroy(&(inDocument->lock));
+
+	free(inDocument);
+}
+
+void
+CPDFBatch::FreeDocuments()
+{
+	std::vector<Document*>::const_iterator i = mDocuments.begin();
+
+	for(i = mDocuments.begin(); i != mDocuments.end(); i++)
+		FreeDocument(*i);
+
+	mDocuments.clear();
+}
@@ -0,0 +1,178 @@
+// Trapeze
+//
+// Copyright (c) 2004 Mesa Dynamics, LLC.  All rights reserved.
+
+#ifndef _H_CPDFBatch
+#define _H_CPDFBatch
+#pragma once
+
+#include "CPDFParser.h"
+
+#include <pthread.h>
+
+#include <deque>
+#include <vector>
+
+const size_t	kBatchRangePages	= 64;
+
+// Converts a list of documents on a pool of threads.  Every document is
+// first counted, then cut into page ranges that are converted separately
+// and written to its output file in order, so a single 3,000 page file
+// keeps the whole pool busy instead of finishing last on one thread.
+//
+// Each thread works its own deque from the back and, when that runs dry,
+// steals from the front of the others'.
+class CPDFBatch {
+public:
+	typedef CPDFParser* (*PDFParserFactory)(
+		void* inRefCon);
+
+	struct PDFBatchStats {
+		unsigned long documents;
+		unsigned long failures;
+
+		unsigned long long pages;
+		unsigned long long pagesOverBudget;
+		unsigned long long inputBytes;
+		unsigned long long outputBytes;
+
+		double seconds;
+		double pagesPerSecond;
+		double bytesPerSecond; // pdf bytes converted
+	};
+
+public:
+	// parsers come from inFactory, one per task, and are deleted after it
+	CPDFBatch(
+		PDFParserFactory inFactory,
+		void* inRefCon = NULL);
+
+	~CPDFBatch();
+
+	// options
+	void SetOptions(const CPDFParser::PDFOptions& inOptions) {
+		mOptions = inOptions;
+	}
+
+	// 0 uses one thread per processor
+	void SetThreads(long inCount) {
+		mThreads = (inCount < 0 ? 0 : inCount);
+	}
+
+	// a preview in the options keeps each document to a single range
+	void SetRangePages(size_t inPages) {
+		mRangePages = (inPages < 1 ? 1 : inPages);
+	}
+
+	// the shared cache unless set; NULL extracts every font afresh
+	void SetFontCache(CPDFFontCache* inCache) {
+		mFontCache = inCache;
+	}
+
+	// documents
+	OSErr Add(
+		const char* inInput,
+		const char* inOutput,
+		long inType,
+		const char* inTitle = NULL);
+
+	long GetCount() {
+		return mDocuments.size();
+	}
+
+	OSErr GetError(
+		long inIndex);
+
+	// converts everything added so far; blocks, the calling thread is one
+	// of the workers.  Returns the first document error in list order.
+	OSErr Run();
+
+	// safe to call from another thread while Run() is working
+	void Abort();
+
+	void GetStats(
+		PDFBatchStats& outStats);
+
+private:
+	struct Document;
+	struct Task;
+	struct Worker;
+
+	// scheduling
+	void Push(
+		Worker* inWorker,
+		Task* inTask);
+
+	Task* Pop(
+		Worker* inWorker);
+
+	Task* Steal(
+		Worker* inWorker);
+
+	Task* NextTask(
+		Worker* inWorker);
+
+	void FinishTask();
+
+	static void* WorkerThread(
+		void* inInfo);
+
+	void Work(
+		Worker* inWorker);
+
+	// converting
+	void CountDocument(
+		Worker* inWorker,
+		Task* inTask);
+
+	void ConvertRange(
+		Worker* inWorker,
+		Task* inTask);
+
+	void DeliverRange(
+		Document* inDocument,
+		long inRange,
+		void* inData,
+		long inSize,
+		OSErr inError);
+
+	void FinishDocument(
+		Document* inDocument);
+
+	CPDFParser* NewParser();
+
+	void ClearDocument(
+		Document* inDocument);
+
+	void FreeDocument(
+		Document* inDocument);
+
+	void FreeDocuments();
+
+private:
+	PDFParserFactory mFactory;
+	void* mRefCon;
+
+	CPDFParser::PDFOptions mOptions;
+	long mThreads;
+	size_t mRangePages;
+	CPDFFontCache* mFontCache;
+
+	std::vector<Document*> mDocuments;
+	std::vector<Worker*> mWorkers;
+
+	// tasks not finished yet, and tasks sitting in a deque
+	volatile long mPending;
+	volatile long mQueued;
+
+	CPDFCancelToken mCancel;
+
+	pthread_mutex_t mIdleLock;
+	pthread_cond_t mIdleCondition;
+
+	// stats
+	pthread_mutex_t mStatsLock;
+	PDFBatchStats mStats;
+};
+
+#endif
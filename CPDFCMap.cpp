@@ -0,0 +1,682 @@
+// Trapeze
+//
+// Copyright (c) 2004 Mesa Dynamics, LLC.  All rights reserved.
+
+#include "CPDFCMap.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+
+enum {
+	kTokenKeyword = 0,
+	kTokenHex,
+	kTokenArrayStart,
+	kTokenArrayEnd,
+	kTokenOther
+};
+
+enum {
+	kModeNone = 0,
+	kModeSpace,
+	kModeChar,
+	kModeRange
+};
+
+struct CPDFCMap::Token {
+	long type;
+
+	// keywords point into the stream, hex strings are decoded
+	const unsigned char* text;
+	long size;
+	unsigned char bytes[kCMapMaxChars * 4];
+};
+
+static inline bool
+IsWhite(
+	unsigned char c)
+{
+	return (c == ' ' || c == '\n' || c == '\r' || c == '\t' || c == '\f' || c == 0);
+}
+
+static inline bool
+IsDelimiter(
+	unsigned char c)
+{
+	switch(c) {
+		case '(': case ')': case '<': case '>': case '[': case ']':
+		case '{': case '}': case '/': case '%':
+			return true;
+	}
+
+	return IsWhite(c);
+}
+
+static inline long
+HexValue(
+	unsigned char c)
+{
+	if(c >= '0' && c <= '9')
+		return c - '0';
+
+	if(c >= 'a' && c <= 'f')
+		return c - 'a' + 10;
+
+	if(c >= 'A' && c <= 'F')
+		return c - 'A' + 10;
+
+	return -1;
+}
+
+static inline bool
+IsKeyword(
+	const unsigned char* inText,
+	long inSize,
+	const char* inKeyword)
+{
+	return ((long) strlen(inKeyword) == inSize && memcmp(inText, inKeyword, inSize) == 0);
+}
+
+// a source code from a hex string; false if it is not one to four bytes
+static inline bool
+CodeValue(
+	const unsigned char* inBytes,
+	long inSize,
+	UInt32& outCode)
+{
+	if(inSize < 1 || inSize > kCMapMaxCodeBytes)
+		return false;
+
+	outCode = 0;
+	for(long i = 0; i < inSize; i++)
+		outCode = (outCode << 8) | inBytes[i];
+
+	return true;
+}
+
+CPDFCMap::CPDFCMap()
+{
+}
+
+CPDFCMap::~CPDFCMap()
+{
+}
+
+void
+CPDFCMap::Clear()
+{
+	mSpaces.clear();
+	mRanges.clear();
+	mChars.clear();
+}
+
+#pragma mark -
+
+OSErr
+CPDFCMap::Parse(
+	const unsigned char* inData,
+	long inSize)
+{
+	Clear();
+
+	if(inData == NULL || inSize <= 0)
+		return CPDFParser::kFormatError;
+
+	const unsigned char* next = inData;
+	const unsigned char* end = inData + inSize;
+
+	long mode = kModeNone;
+
+	// operands waiting for the rest of their entry
+	Token operands[2];
+	long count = 0;
+
+	// bfrange array destinations
+	bool inArray = false;
+	bool arrayDone = false;
+	UInt32 arrayCode = 0;
+	UInt32 arrayHigh = 0;
+
+	Token token;
+	while(NextToken(next, end, token)) {
+		if(token.type == kTokenKeyword) {
+			if(IsKeyword(token.text, token.size, "begincodespacerange"))
+				mode = kModeSpace;
+			else if(IsKeyword(token.text, token.size, "beginbfchar"))
+				mode = kModeChar;
+			else if(IsKeyword(token.text, token.size, "beginbfrange"))
+				mode = kModeRange;
+			else if(token.size > 3 && memcmp(token.text, "end", 3) == 0)
+				mode = kModeNone;
+
+			// a count or an operator between sections
+			count = 0;
+			inArray = false;
+			continue;
+		}
+
+		if(mode == kModeNone)
+			continue;
+
+		if(inArray) {
+			if(token.type == kTokenHex && arrayDone == false) {
+				UInt32 chars[kCMapMaxChars];
+				long n = DecodeUTF16(token.bytes, token.size, chars, kCMapMaxChars);
+
+				if(n)
+					AddChars(arrayCode, arrayCode, operands[0].size, chars, n);
+
+				if(arrayCode == arrayHigh)
+					arrayDone = true;
+				else
+					arrayCode++;
+			}
+			else if(token.type == kTokenArrayEnd) {
+				inArray = false;
+				count = 0;
+			}
+
+			continue;
+		}
+
+		if(token.type == kTokenArrayStart && mode == kModeRange && count == 2) {
+			if(CodeValue(operands[0].bytes, operands[0].size, arrayCode) &&
+				CodeValue(operands[1].bytes, operands[1].size, arrayHigh) && arrayCode <= arrayHigh) {
+				inArray = true;
+				arrayDone = false;
+			}
+			else
+				count = 0;
+
+			continue;
+		}
+
+		if(token.type != kTokenHex) {
+			// a name or number where a hex string belongs; drop the entry
+			count = 0;
+			continue;
+		}
+
+		switch(mode) {
+			case kModeSpace:
+				if(count == 1) {
+					AddSpace(operands[0], token);
+					count = 0;
+				}
+				else
+					operands[count++] = token;
+				break;
+
+			case kModeChar:
+				if(count == 1) {
+					AddRange(operands[0], operands[0], token.bytes, token.size);
+					count = 0;
+				}
+				else
+					operands[count++] = token;
+				break;
+
+			case kModeRange:
+				if(count == 2) {
+					AddRange(operands[0], operands[1], token.bytes, token.size);
+					count = 0;
+				}
+				else
+					operands[count++] = token;
+				break;
+		}
+	}
+
+	Finish();
+
+	return (mRanges.empty() ? CPDFParser::kFormatError : CPDFParser::kNoError);
+}
+
+bool
+CPDFCMap::NextToken(
+	const unsigned char*& ioNext,
+	const unsigned char* inEnd,
+	Token& outToken)
+{
+	const unsigned char* p = ioNext;
+
+	for(;;) {
+		while(p < inEnd && IsWhite(*p))
+			p++;
+
+		if(p < inEnd && *p == '%') {
+			while(p < inEnd && *p != '\n' && *p != '\r')
+				p++;
+		}
+		else
+			break;
+	}
+
+	if(p >= inEnd) {
+		ioNext = p;
+		return false;
+	}
+
+	outToken.text = p;
+	outToken.size = 0;
+	outToken.type = kTokenOther;
+
+	switch(*p) {
+		case '<':
+			if(p + 1 < inEnd && p[1] == '<') {
+				p += 2;
+				break;
+			}
+
+			{
+				long digits = 0;
+				long value = 0;
+
+				outToken.type = kTokenHex;
+
+				for(p++; p < inEnd && *p != '>'; p++) {
+					long h = HexValue(*p);
+					if(h < 0)
+						continue;
+
+					value = (value << 4) | h;
+
+					if(++digits == 2) {
+						if(outToken.size < (long) sizeof(outToken.bytes))
+							outToken.bytes[outToken.size++] = (unsigned char) value;
+
+						digits = 0;
+						value = 0;
+					}
+				}
+
+				// a final odd digit is followed by a zero
+				if(digits && outToken.size < (long) sizeof(outToken.bytes))
+					outToken.bytes[outToken.size++] = (unsigned char) (value << 4);
+
+				if(p < inEnd)
+					p++;
+			}
+			break;
+
+		case '>':
+			p += (p + 1 < inEnd && p[1] == '>' ? 2 : 1);
+			break;
+
+		case '[':
+			outToken.type = kTokenArrayStart;
+			p++;
+			break;
+
+		case ']':
+			outToken.type = kTokenArrayEnd;
+			p++;
+			break;
+
+		case '(':
+			{
+				long depth = 0;
+
+				for(; p < inEnd; p++) {
+					if(*p == '\\')
+						p++;
+					else if(*p == '(')
+						depth++;
+					else if(*p == ')' && --depth == 0) {
+						p++;
+						break;
+					}
+				}
+
+				if(p > inEnd)
+					p = inEnd;
+			}
+			break;
+
+		case '/':
+			for(p++; p < inEnd && IsDelimiter(*p) == false; p++) ;
+			break;
+
+		case ')': case '{': case '}':
+			p++;
+			break;
+
+		default:
+			outToken.type = kTokenKeyword;
+
+			for(; p < inEnd && IsDelimiter(*p) == false; p++) ;
+
+			outToken.size = p - outToken.text;
+			break;
+	}
+
+	ioNext = p;
+
+	return true;
+}
+
+long
+CPDFCMap::DecodeUTF16(
+	const unsigned char* inData,
+	long inSize,
+	UInt32* outChars,
+	long inMaxChars)
+{
+	long count = 0;
+
+	for(long i = 0; i + 1 < inSize && count < inMaxChars; i += 2) {
+		UInt32 u = (inData[i] << 8) | inData[i + 1];
+
+		if(u >= 0xD800 && u <= 0xDBFF) {
+			if(i + 3 < inSize) {
+				UInt32 low = (inData[i + 2] << 8) | inData[i + 3];
+
+				if(low >= 0xDC00 && low <= 0xDFFF) {
+					outChars[count++] = 0x10000 + ((u - 0xD800) << 10) + (low - 0xDC00);
+					i += 2;
+				}
+			}
+		}
+		else if(u < 0xDC00 || u > 0xDFFF)
+			outChars[count++] = u;
+	}
+
+	return count;
+}
+
+#pragma mark -
+
+void
+CPDFCMap::AddSpace(
+	const Token& inLow,
+	const Token& inHigh)
+{
+	Space space;
+
+	if(inLow.size != inHigh.size ||
+		CodeValue(inLow.bytes, inLow.size, space.low) == false ||
+		CodeValue(inHigh.bytes, inHigh.size, space.high) == false)
+		return;
+
+	space.bytes = inLow.size;
+	mSpaces.push_back(space);
+}
+
+void
+CPDFCMap::AddRange(
+	const Token& inLow,
+	const Token& inHigh,
+	const unsigned char* inDest,
+	long inDestSize)
+{
+	UInt32 low;
+	UInt32 high;
+
+	if(CodeValue(inLow.bytes, inLow.size, low) == false ||
+		CodeValue(inHigh.bytes, inHigh.size, high) == false || high < low)
+		return;
+
+	UInt32 chars[kCMapMaxChars];
+	long count = DecodeUTF16(inDest, inDestSize, chars, kCMapMaxChars);
+
+	if(count)
+		AddChars(low, high, inLow.size, chars, count);
+}
+
+void
+CPDFCMap::AddChars(
+	UInt32 inLow,
+	UInt32 inHigh,
+	long inBytes,
+	const UInt32* inChars,
+	long inCount)
+{
+	Range range;
+
+	range.low = inLow;
+	range.high = inHigh;
+	range.base = inLow;
+	range.length = inCount;
+	range.bytes = inBytes;
+	range.order = mRanges.size();
+
+	if(inCount == 1)
+		range.value = inChars[0];
+	else {
+		range.value = mChars.size();
+		mChars.insert(mChars.end(), inChars, inChars + inCount);
+	}
+
+	mRanges.push_back(range);
+}
+
+bool
+CPDFCMap::RangeLess(
+	const Range& inA,
+	const Range& inB)
+{
+	if(inA.bytes != inB.bytes)
+		return (inA.bytes < inB.bytes);
+
+	if(inA.low != inB.low)
+		return (inA.low < inB.low);
+
+	return (inA.order < inB.order);
+}
+
+// Sorts the ranges, settles overlaps in favor of the later definition and
+// folds neighbors that continue each other.
+void
+CPDFCMap::Finish()
+{
+	std::sort(mRanges.begin(), mRanges.end(), RangeLess);
+
+	bool overlap = false;
+	for(size_t i = 1; i < mRanges.size() && overlap == false; i++) {
+		if(mRanges[i].bytes == mRanges[i - 1].bytes && mRanges[i].low <= mRanges[i - 1].high)
+			overlap = true;
+	}
+
+	if(overlap) {
+		// rare; paint the ranges over each other in the order they came
+		std::vector<Range> byOrder(mRanges);
+		for(size_t i = 0; i < mRanges.size(); i++)
+			byOrder[mRanges[i].order] = mRanges[i];
+
+		std::vector<Range> painted;
+		for(size_t i = 0; i < byOrder.size(); i++) {
+			const Range& top = byOrder[i];
+			std::vector<Range> kept;
+
+			for(size_t j = 0; j < painted.size(); j++) {
+				const Range& under = painted[j];
+
+				if(under.bytes != top.bytes || under.high < top.low || under.low > top.high) {
+					kept.push_back(under);
+					continue;
+				}
+
+				if(under.low < top.low) {
+					Range head = under;
+					head.high = top.low - 1;
+					kept.push_back(head);
+				}
+
+				if(under.high > top.high) {
+					Range tail = under;
+					tail.low = top.high + 1;
+					kept.push_back(tail);
+				}
+			}
+
+			kept.push_back(top);
+			painted.swap(kept);
+		}
+
+		mRanges.swap(painted);
+		std::sort(mRanges.begin(), mRanges.end(), RangeLess);
+	}
+
+	// fold runs of codes mapped to consecutive characters
+	size_t n = 0;
+	for(size_t i = 0; i < mRanges.size(); i++) {
+		if(n) {
+			Range& last = mRanges[n - 1];
+			const Range& range = mRanges[i];
+
+			if(last.length == 1 && range.length == 1 && last.bytes == range.bytes &&
+				last.high + 1 == range.low &&
+				last.value + (range.low - last.base) == range.value + (range.low - range.base)) {
+				last.high = range.high;
+				continue;
+			}
+		}
+
+		mRanges[n++] = mRanges[i];
+	}
+
+	mRanges.resize(n);
+
+	// the ranges hold on to their size for good
+	std::vector<Range>(mRanges).swap(mRanges);
+	std::vector<UInt32>(mChars).swap(mChars);
+}
+
+#pragma mark -
+
+const CPDFCMap::Range*
+CPDFCMap::Find(
+	UInt32 inCode,
+	long inBytes)
+{
+	// the last range starting at or before the code
+	size_t low = 0;
+	size_t high = mRanges.size();
+
+	while(low < high) {
+		size_t mid = (low + high) / 2;
+		const Range& range = mRanges[mid];
+
+		if(range.bytes < inBytes || (range.bytes == inBytes && range.low <= inCode))
+			low = mid + 1;
+		else
+			high = mid;
+	}
+
+	if(low == 0)
+		return NULL;
+
+	const Range* range = &(mRanges[low - 1]);
+
+	if(range->bytes != inBytes || range->high < inCode)
+		return NULL;
+
+	return range;
+}
+
+long
+CPDFCMap::NextCode(
+	const unsigned char* inText,
+	long inSize,
+	UInt32& outCode)
+{
+	if(inSize <= 0)
+		return 0;
+
+	long shortest = 0;
+
+	// a code belongs to a range when each of its bytes is within the
+	// range's bytes at that position
+	for(long bytes = 1; bytes <= kCMapMaxCodeBytes && bytes <= inSize; bytes++) {
+		for(size_t i = 0; i < mSpaces.size(); i++) {
+			const Space& space = mSpaces[i];
+			if(space.bytes != bytes)
+				continue;
+
+			if(shortest == 0 || bytes < shortest)
+				shortest = bytes;
+
+			bool match = true;
+			for(long b = 0; b < bytes && match; b++) {
+				long shift = (bytes - 1 - b) * 8;
+				unsigned char lo = (unsigned char) (space.low >> shift);
+				unsigned char hi = (unsigned char) (space.high >> shift);
+
+				match = (inText[b] >= lo && inText[b] <= hi);
+			}
+
+			if(match) {
+				CodeValue(inText, bytes, outCode);
+				return bytes;
+			}
+		}
+	}
+
+	// outside every range; skip as many bytes as the shortest codes take
+	if(shortest == 0 || shortest > inSize)
+		shortest = 1;
+
+	CodeValue(inText, shortest, outCode);
+
+	return shortest;
+}
+
+long
+CPDFCMap::Lookup(
+	UInt32 inCode,
+	long inBytes,
+	UInt32* outChars,
+	long inMaxChars)
+{
+	const Range* range = Find(inCode, inBytes);
+	if(range == NULL || inMaxChars < 1)
+		return 0;
+
+	UInt32 offset = inCode - range->base;
+
+	if(range->length == 1) {
+		outChars[0] = range->value + offset;
+		return 1;
+	}
+
+	// for a range, codes past the first bump the last character
+	long count = range->length;
+	if(count > inMaxChars)
+		count = inMaxChars;
+
+	memcpy(outChars, &(mChars[range->value]), count * sizeof(UInt32));
+
+	if(count == range->length)
+		outChars[count - 1] += offset;
+
+	return count;
+}
+
+wchar_t*
+CPDFCMap::CopyByteMap()
+{
+	wchar_t* map = NULL;
+
+	// one-byte codes come first; wider ones only fill what is left
+	for(size_t i = 0; i < mRanges.size(); i++) {
+		const Range& range = mRanges[i];
+		if(range.length != 1 || range.low > 0xFF)
+			continue;
+
+		if(map == NULL) {
+			map = (wchar_t*) calloc(256, sizeof(wchar_t));
+			if(map == NULL)
+				return NULL;
+		}
+
+		UInt32 high = (range.high > 0xFF ? 0xFF : range.high);
+
+		for(UInt32 c = range.low; c <= high; c++) {
+			if(map[c] == 0)
+				map[c] = (wchar_t) (range.value + (c - range.base));
+		}
+	}
+
+	return map;
+}
@@ -0,0 +1,122 @@
+// Trapeze
+//
+// Copyright (c) 2004 Mesa Dynamics, LLC.  All rights reserved.
+
+#ifndef _H_CPDFCMap
+#define _H_CPDFCMap
+#pragma once
+
+#include "CPDFParser.h"
+
+#include <vector>
+
+const long	kCMapMaxCodeBytes	= 4;
+const long	kCMapMaxChars		= 32; // code points one code can map to
+
+// A ToUnicode CMap: character codes of one to four bytes, as the
+// codespace ranges define them, mapped to Unicode.  The stream is read in
+// one pass; bfchar and bfrange entries, array destinations included, are
+// kept as a sorted list of ranges, with runs of codes that map to
+// consecutive characters folded into one range.
+class CPDFCMap {
+public:
+	CPDFCMap();
+	~CPDFCMap();
+
+	// kFormatError if the stream maps nothing
+	OSErr Parse(
+		const unsigned char* inData,
+		long inSize);
+
+	void Clear();
+
+	bool IsEmpty() {
+		return mRanges.empty();
+	}
+
+	long GetRangeCount() {
+		return mRanges.size();
+	}
+
+	// the length of the code at the start of inText; with no codespace
+	// ranges codes are one byte
+	long NextCode(
+		const unsigned char* inText,
+		long inSize,
+		UInt32& outCode);
+
+	// the characters for a code, UTF-16 surrogates joined; 0 if unmapped
+	long Lookup(
+		UInt32 inCode,
+		long inBytes,
+		UInt32* outChars,
+		long inMaxChars = kCMapMaxChars);
+
+	// the single-character mappings of codes 0-255, for simple fonts; a
+	// calloc'd table or NULL if there are none
+	wchar_t* CopyByteMap();
+
+protected:
+	struct Space {
+		UInt32 low;
+		UInt32 high;
+		long bytes;
+	};
+
+	struct Range {
+		UInt32 low;
+		UInt32 high;
+		UInt32 base; // the code that maps to value as is
+		UInt32 value; // a character, or the offset of a string in mChars
+		unsigned short length; // characters per code
+		unsigned char bytes;
+		unsigned long order; // later definitions win
+	};
+
+	struct Token;
+
+	static bool NextToken(
+		const unsigned char*& ioNext,
+		const unsigned char* inEnd,
+		Token& outToken);
+
+	static long DecodeUTF16(
+		const unsigned char* inData,
+		long inSize,
+		UInt32* outChars,
+		long inMaxChars);
+
+	void AddSpace(
+		const Token& inLow,
+		const Token& inHigh);
+
+	void AddRange(
+		const Token& inLow,
+		const Token& inHigh,
+		const unsigned char* inDest,
+		long inDestSize);
+
+	void AddChars(
+		UInt32 inLow,
+		UInt32 inHigh,
+		long inBytes,
+		const UInt32* inChars,
+		long inCount);
+
+	void Finish();
+
+	const Range* Find(
+		UInt32 inCode,
+		long inBytes);
+
+	static bool RangeLess(
+		const Range& inA,
+		const Range& inB);
+
+protected:
+	std::vector<Space> mSpaces;
+	std::vector<Range> mRanges;
+	std::vector<UInt32> mChars;
+};
+
+#endif
@@ -0,0 +1,1433 @@
+// Trapeze
+//
+// Copyright (c) 2004 Mesa Dynamics, LLC.  All rights reserved.
+
+#include "CPDFDocument.h"
+#include "CPDFFilter.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+const long		kMaxObjectNumber	= 8388607;	// PDF 1.7 appendix C
+const size_t	kStartXRefWindow	= 2048;		// searched for startxref from the end
+const size_t	kEndStreamWindow	= 64;		// after a stream's /Length
+
+static bool
+IsSpace(
+	unsigned char c)
+{
+	return (c == 0 || c == 9 || c == 10 || c == 12 || c == 13 || c == 32);
+}
+
+static long
+HexValue(
+	unsigned char c)
+{
+	if(c >= '0' && c <= '9')
+		return c - '0';
+
+	if(c >= 'a' && c <= 'f')
+		return c - 'a' + 10;
+
+	if(c >= 'A' && c <= 'F')
+		return c - 'A' + 10;
+
+	return -1;
+}
+
+static const unsigned char*
+FindBytes(
+	const unsigned char* inData,
+	size_t inSize,
+	const char* inBytes)
+{
+	size_t length = strlen(inBytes);
+
+	if(length == 0 || inSize < length)
+		return NULL;
+
+	const unsigned char* last = inData + inSize - length;
+	for(const unsigned char* c = inData; c <= last; c++) {
+		c = (const unsigned char*) memchr(c, inBytes[0], last - c + 1);
+		if(c == NULL)
+			break;
+
+		if(memcmp(c, inBytes, length) == 0)
+			return c;
+	}
+
+	return NULL;
+}
+
+#pragma mark -
+
+CPDFObject::CPDFObject(
+	long inType) :
+		mType(inType),
+		mBoolean(false),
+		mInteger(0),
+		mReal(0.0),
+		mString(NULL),
+		mLength(0),
+		mStreamOffset(0)
+{
+}
+
+CPDFObject::~CPDFObject()
+{
+	for(size_t i = 0; i < mItems.size(); i++)
+		delete mItems[i];
+
+	for(size_t i = 0; i < mKeys.size(); i++)
+		free(mKeys[i]);
+
+	if(mString)
+		free(mString);
+}
+
+bool
+CPDFObject::GetBoolean(
+	bool& outValue)
+{
+	if(mType != kBoolean)
+		return false;
+
+	outValue = mBoolean;
+
+	return true;
+}
+
+bool
+CPDFObject::GetInteger(
+	long& outValue)
+{
+	if(mType == kInteger)
+		outValue = mInteger;
+	else if(mType == kReal)
+		outValue = (long) mReal;
+	else
+		return false;
+
+	return true;
+}
+
+bool
+CPDFObject::GetNumber(
+	float& outValue)
+{
+	if(mType == kInteger)
+		outValue = (float) mInteger;
+	else if(mType == kReal)
+		outValue = mReal;
+	else
+		return false;
+
+	return true;
+}
+
+bool
+CPDFObject::GetName(
+	const char*& outName)
+{
+	if(mType != kName)
+		return false;
+
+	outName = mString;
+
+	return true;
+}
+
+bool
+CPDFObject::GetString(
+	const unsigned char*& outData,
+	size_t& outSize)
+{
+	if(mType != kString)
+		return false;
+
+	outData = (const unsigned char*) mString;
+	outSize = mLength;
+
+	return true;
+}
+
+CPDFObject*
+CPDFObject::Find(
+	const char* inKey)
+{
+	if(mType != kDictionary && mType != kStream)
+		return NULL;
+
+	// the last of a repeated key wins, as it does for most readers
+	for(size_t i = mKeys.size(); i > 0; i--) {
+		if(strcmp(mKeys[i - 1], inKey) == 0)
+			return mItems[i - 1];
+	}
+
+	return NULL;
+}
+
+#pragma mark -
+
+CPDFDocument::CPDFDocument() :
+	mRefs(1),
+	mData(NULL),
+	mSize(0),
+	mTrailer(NULL),
+	mPageCount(0)
+{
+	pthread_mutexattr_t attributes;
+
+	// loading an object can load the objects its /Length or object stream needs
+	pthread_mutexattr_init(&attributes);
+	pthread_mutexattr_settype(&attributes, PTHREAD_MUTEX_RECURSIVE);
+	pthread_mutex_init(&mLock, &attributes);
+	pthread_mutexattr_destroy(&attributes);
+}
+
+CPDFDocument::~CPDFDocument()
+{
+	for(size_t i = 0; i < mObjects.size(); i++)
+		delete mObjects[i];
+
+	for(size_t i = 0; i < mTrailers.size(); i++)
+		delete mTrailers[i];
+
+	pthread_mutex_destroy(&mLock);
+}
+
+void
+CPDFDocument::Retain()
+{
+	UPDFAtomic::Add(&mRefs, 1);
+}
+
+void
+CPDFDocument::Release()
+{
+	if(UPDFAtomic::Add(&mRefs, -1) == 0)
+		delete this;
+}
+
+OSErr
+CPDFDocument::Open(
+	const unsigned char* inData,
+	size_t inSize)
+{
+	mData = inData;
+	mSize = inSize;
+
+	if(mData == NULL || FindBytes(mData, (mSize < 1024 ? mSize : 1024), "%PDF-") == NULL)
+		return CPDFParser::kFormatError;
+
+	// startxref, near the end; a damaged or missing one means rebuilding
+	size_t window = (mSize < kStartXRefWindow ? mSize : kStartXRefWindow);
+	const unsigned char* startxref = NULL;
+	const unsigned char* c = mData + mSize - window;
+
+	while((c = FindBytes(c, mData + mSize - c, "startxref")) != NULL) {
+		startxref = c;
+		c++;
+	}
+
+	OSErr err = CPDFParser::kFormatError;
+	if(startxref) {
+		Lexer lexer = { mData, (size_t) (startxref - mData) + 9, mSize };
+		long offset;
+
+		if(ReadInteger(lexer, offset) && offset > 0 && (size_t) offset < mSize)
+			err = ReadXRef(offset);
+	}
+
+	if(err == CPDFParser::kNoError && GetDictionary(GetCatalog(), "Pages") == NULL)
+		err = CPDFParser::kFormatError;
+
+	if(err != CPDFParser::kNoError) {
+		RebuildXRef();
+
+		if(GetDictionary(GetCatalog(), "Pages") == NULL)
+			return CPDFParser::kPDFOpenError;
+	}
+
+	// the standard security handler needs RC4 and AES, which this reader
+	// leaves to the platform backend
+	if(mTrailer->Find("Encrypt"))
+		return CPDFParser::kNoPasswordError;
+
+	// the pages are found once, here, before any page worker shares the
+	// document; the root's /Count is believed only as far as the tree
+	// bears it out, so a hostile one cannot make a reader loop over pages
+	// that are not there
+	pthread_mutex_lock(&mLock);
+
+	CPDFObjectSet visited;
+	CollectPages(GetDictionary(GetCatalog(), "Pages"), 0, visited);
+	mPageCount = mPages.size();
+
+	pthread_mutex_unlock(&mLock);
+
+	long count = 0;
+	if(GetInteger(GetDictionary(GetCatalog(), "Pages"), "Count", count) && count > 0 && (size_t) count < mPageCount)
+		mPageCount = count;
+
+	if(mPageCount == 0)
+		return CPDFParser::kNoPagesError;
+
+	return CPDFParser::kNoError;
+}
+
+CPDFObject*
+CPDFDocument::GetPage(
+	size_t inPage)
+{
+	if(inPage < 1 || inPage > mPageCount)
+		return NULL;
+
+	// unchanged since Open(), so any thread may read it
+	return mPages[inPage - 1];
+}
+
+CPDFObject*
+CPDFDocument::GetCatalog()
+{
+	return GetDictionary(mTrailer, "Root");
+}
+
+CPDFObject*
+CPDFDocument::Resolve(
+	CPDFObject* inObject)
+{
+	if(inObject == NULL || inObject->mType != CPDFObject::kReference)
+		return inObject;
+
+	pthread_mutex_lock(&mLock);
+
+	CPDFObject* object = Load(inObject->mInteger);
+
+	pthread_mutex_unlock(&mLock);
+
+	// an object that is only a reference is not allowed, and not followed
+	if(object && (object->mType == CPDFObject::kReference || object->mType == CPDFObject::kNull))
+		return NULL;
+
+	return object;
+}
+
+CPDFObject*
+CPDFDocument::Get(
+	CPDFObject* inDictionary,
+	const char* inKey)
+{
+	if(inDictionary == NULL)
+		return NULL;
+
+	CPDFObject* object = Resolve(inDictionary->Find(inKey));
+	if(object && object->mType == CPDFObject::kNull)
+		return NULL;
+
+	return object;
+}
+
+CPDFObject*
+CPDFDocument::GetDictionary(
+	CPDFObject* inDictionary,
+	const char* inKey)
+{
+	CPDFObject* object = Get(inDictionary, inKey);
+
+	return (object && object->mType == CPDFObject::kDictionary ? object : NULL);
+}
+
+CPDFObject*
+CPDFDocument::GetArray(
+	CPDFObject* inDictionary,
+	const char* inKey)
+{
+	CPDFObject* object = Get(inDictionary, inKey);
+
+	return (object && object->mType == CPDFObject::kArray ? object : NULL);
+}
+
+CPDFObject*
+CPDFDocument::GetStream(
+	CPDFObject* inDictionary,
+	const char* inKey)
+{
+	CPDFObject* object = Get(inDictionary, inKey);
+
+	return (object && object->mType == CPDFObject::kStream ? object : NULL);
+}
+
+bool
+CPDFDocument::GetName(
+	CPDFObject* inDictionary,
+	const char* inKey,
+	const char*& outName)
+{
+	CPDFObject* object = Get(inDictionary, inKey);
+
+	return (object && object->GetName(outName));
+}
+
+bool
+CPDFDocument::GetInteger(
+	CPDFObject* inDictionary,
+	const char* inKey,
+	long& outValue)
+{
+	CPDFObject* object = Get(inDictionary, inKey);
+
+	return (object && object->GetInteger(outValue));
+}
+
+bool
+CPDFDocument::GetNumber(
+	CPDFObject* inDictionary,
+	const char* inKey,
+	float& outValue)
+{
+	CPDFObject* object = Get(inDictionary, inKey);
+
+	return (object && object->GetNumber(outValue));
+}
+
+bool
+CPDFDocument::GetString(
+	CPDFObject* inDictionary,
+	const char* inKey,
+	const unsigned char*& outData,
+	size_t& outSize)
+{
+	CPDFObject* object = Get(inDictionary, inKey);
+
+	return (object && object->GetString(outData, outSize));
+}
+
+CPDFObject*
+CPDFDocument::GetInherited(
+	CPDFObject* inPage,
+	const char* inKey)
+{
+	CPDFObject* node = inPage;
+
+	for(long depth = 0; node && depth < kMaxPageDepth; depth++) {
+		CPDFObject* object = Get(node, inKey);
+		if(object)
+			return object;
+
+		node = GetDictionary(node, "Parent");
+	}
+
+	return NULL;
+}
+
+OSErr
+CPDFDocument::CopyStreamData(
+	CPDFObject* inStream,
+	unsigned char*& outData,
+	size_t& outSize)
+{
+	outData = NULL;
+	outSize = 0;
+
+	if(inStream == NULL || inStream->mType != CPDFObject::kStream)
+		return CPDFParser::kFormatError;
+
+	size_t length = GetStreamLength(inStream);
+
+	unsigned char* data = (unsigned char*) malloc(length ? length : 1);
+	if(data == NULL)
+		return CPDFParser::kMemoryError;
+
+	memcpy(data, mData + inStream->mStreamOffset, length);
+
+	// one filter or an array of them, each with its own parameters
+	CPDFObject* filter = Get(inStream, "Filter");
+	CPDFObject* parms = Get(inStream, "DecodeParms");
+
+	size_t count = 0;
+	if(filter && filter->mType == CPDFObject::kName)
+		count = 1;
+	else if(filter && filter->mType == CPDFObject::kArray)
+		count = filter->GetCount();
+
+	for(size_t i = 0; i < count; i++) {
+		CPDFObject* name = (filter->mType == CPDFObject::kName ? filter : Resolve(filter->GetItem(i)));
+		CPDFObject* parm = parms;
+
+		if(parms && parms->mType == CPDFObject::kArray)
+			parm = Resolve(parms->GetItem(i));
+
+		const char* filterName;
+		if(name == NULL || name->GetName(filterName) == false)
+			continue;
+
+		PDFFilterParms filterParms;
+		CPDFFilter::DefaultParms(filterParms);
+
+		if(parm && parm->mType == CPDFObject::kDictionary) {
+			GetInteger(parm, "Predictor", filterParms.predictor);
+			GetInteger(parm, "Colors", filterParms.colors);
+			GetInteger(parm, "BitsPerComponent", filterParms.bitsPerComponent);
+			GetInteger(parm, "Columns", filterParms.columns);
+			GetInteger(parm, "EarlyChange", filterParms.earlyChange);
+		}
+
+		unsigned char* decoded;
+		size_t decodedSize;
+
+		OSErr err = CPDFFilter::Decode(filterName, filterParms, data, length, decoded, decodedSize);
+		free(data);
+
+		if(err != CPDFParser::kNoError)
+			return err;
+
+		data = decoded;
+		length = decodedSize;
+	}
+
+	// Parse() may look a byte past the end of what it is given
+	unsigned char* padded = (unsigned char*) realloc(data, length + 1);
+	if(padded == NULL) {
+		free(data);
+		return CPDFParser::kMemoryError;
+	}
+
+	padded[length] = 0;
+
+	outData = padded;
+	outSize = length;
+
+	return CPDFParser::kNoError;
+}
+
+#pragma mark -
+
+OSErr
+CPDFDocument::ReadXRef(
+	size_t inOffset)
+{
+	std::vector<size_t> pending;
+	std::vector<size_t> visited;
+
+	pending.push_back(inOffset);
+
+	while(pending.empty() == false && (long) visited.size() < kMaxXRefSections) {
+		size_t offset = pending.back();
+		pending.pop_back();
+
+		// a /Prev that loops back
+		bool seen = false;
+		for(size_t i = 0; i < visited.size() && seen == false; i++)
+			seen = (visited[i] == offset);
+
+		if(seen || offset >= mSize)
+			continue;
+
+		visited.push_back(offset);
+
+		Lexer lexer = { mData, offset, mSize };
+		CPDFObject* trailer = NULL;
+
+		if(ReadKeyword(lexer, "xref")) {
+			if(ReadXRefTable(lexer, trailer) == false) {
+				delete trailer;
+				return CPDFParser::kFormatError;
+			}
+		}
+		else {
+			trailer = ParseIndirect(offset, -1);
+
+			const char* type;
+			if(trailer == NULL || trailer->mType != CPDFObject::kStream ||
+				(trailer->Find("Type") && trailer->Find("Type")->GetName(type) && strcmp(type, "XRef")) ||
+				ReadXRefStream(trailer) == false) {
+				delete trailer;
+				return CPDFParser::kFormatError;
+			}
+		}
+
+		mTrailers.push_back(trailer);
+		if(mTrailer == NULL)
+			mTrailer = trailer;
+
+		// older sections fill in only what the newer ones left out, and a
+		// hybrid file's stream comes before the table's /Prev
+		long next;
+		CPDFObject* prev = trailer->Find("Prev");
+		if(prev && prev->GetInteger(next) && next > 0)
+			pending.push_back(next);
+
+		CPDFObject* stream = trailer->Find("XRefStm");
+		if(stream && stream->GetInteger(next) && next > 0)
+			pending.push_back(next);
+	}
+
+	if(mTrailer == NULL)
+		return CPDFParser::kFormatError;
+
+	// entries the newest trailer leaves out come from the older ones
+	for(size_t i = 1; i < mTrailers.size(); i++) {
+		static const char* kInherited[] = { "Root", "Encrypt", "Info" };
+
+		for(size_t k = 0; k < sizeof(kInherited) / sizeof(kInherited[0]); k++) {
+			CPDFObject* value = mTrailers[i]->Find(kInherited[k]);
+
+			if(value && value->mType == CPDFObject::kReference && mTrailer->Find(kInherited[k]) == NULL) {
+				CPDFObject* copy = new CPDFObject(CPDFObject::kReference);
+				copy->mInteger = value->mInteger;
+
+				mTrailer->mKeys.push_back(strdup(kInherited[k]));
+				mTrailer->mItems.push_back(copy);
+			}
+		}
+	}
+
+	mObjects.resize(mXRef.size(), NULL);
+	mLoading.resize(mXRef.size(), 0);
+
+	return CPDFParser::kNoError;
+}
+
+bool
+CPDFDocument::ReadXRefTable(
+	Lexer& ioLexer,
+	CPDFObject*& outTrailer)
+{
+	outTrailer = NULL;
+
+	for(;;) {
+		if(ReadKeyword(ioLexer, "trailer")) {
+			outTrailer = ParseObject(ioLexer, 0);
+
+			return (outTrailer && outTrailer->mType == CPDFObject::kDictionary);
+		}
+
+		long start, count;
+		if(ReadInteger(ioLexer, start) == false || ReadInteger(ioLexer, count) == false)
+			return false;
+
+		// each entry takes twenty bytes, so a count past that is damage
+		if(start < 0 || count < 0 || (size_t) count > (ioLexer.end - ioLexer.position) / 18 + 1)
+			return false;
+
+		for(long i = 0; i < count; i++) {
+			long offset, generation;
+			if(ReadInteger(ioLexer, offset) == false || ReadInteger(ioLexer, generation) == false)
+				return false;
+
+			SkipSpace(ioLexer);
+			if(ioLexer.position >= ioLexer.end)
+				return false;
+
+			unsigned char kind = ioLexer.data[ioLexer.position++];
+			if(kind == 'n' && offset > 0)
+				SetEntry(start + i, 1, offset, generation);
+			else if(kind != 'n' && kind != 'f')
+				return false;
+		}
+	}
+}
+
+bool
+CPDFDocument::ReadXRefStream(
+	CPDFObject* inStream)
+{
+	CPDFObject* widths = inStream->Find("W");
+	if(widths == NULL || widths->mType != CPDFObject::kArray || widths->GetCount() < 3)
+		return false;
+
+	long w[3];
+	for(long i = 0; i < 3; i++) {
+		if(widths->GetItem(i)->GetInteger(w[i]) == false || w[i] < 0 || w[i] > 8)
+			return false;
+	}
+
+	long size = 0;
+	CPDFObject* sizeObject = inStream->Find("Size");
+	if(sizeObject == NULL || sizeObject->GetInteger(size) == false)
+		return false;
+
+	unsigned char* data;
+	size_t dataSize;
+	if(CopyStreamData(inStream, data, dataSize) != CPDFParser::kNoError)
+		return false;
+
+	// subsections as first and count pairs, the whole table by default
+	std::vector<long> index;
+	CPDFObject* indexObject = inStream->Find("Index");
+	if(indexObject && indexObject->mType == CPDFObject::kArray) {
+		for(size_t i = 0; i + 1 < indexObject->GetCount(); i += 2) {
+			long first, count;
+			if(indexObject->GetItem(i)->GetInteger(first) && indexObject->GetItem(i + 1)->GetInteger(count)) {
+				index.push_back(first);
+				index.push_back(count);
+			}
+		}
+	}
+	else {
+		index.push_back(0);
+		index.push_back(size);
+	}
+
+	size_t entrySize = w[0] + w[1] + w[2];
+	const unsigned char* entry = data;
+	const unsigned char* end = data + dataSize;
+
+	for(size_t s = 0; s < index.size() && entrySize; s += 2) {
+		for(long i = 0; i < index[s + 1] && entry + entrySize <= end; i++) {
+			size_t fields[3];
+
+			for(long f = 0; f < 3; f++) {
+				fields[f] = 0;
+				for(long b = 0; b < w[f]; b++)
+					fields[f] = (fields[f] << 8) | *entry++;
+			}
+
+			// a missing type field means every entry is in the file
+			char type = (w[0] ? (char) fields[0] : 1);
+
+			if(type == 1 && fields[1] > 0)
+				SetEntry(index[s] + i, 1, fields[1], (long) fields[2]);
+			else if(type == 2)
+				SetEntry(index[s] + i, 2, fields[1], (long) fields[2]);
+		}
+	}
+
+	free(data);
+
+	return true;
+}
+
+void
+CPDFDocument::RebuildXRef()
+{
+	for(size_t i = 0; i < mObjects.size(); i++)
+		delete mObjects[i];
+
+	for(size_t i = 0; i < mTrailers.size(); i++)
+		delete mTrailers[i];
+
+	mXRef.clear();
+	mObjects.clear();
+	mLoading.clear();
+	mTrailers.clear();
+	mTrailer = NULL;
+
+	// every "n g obj" that starts a line, the last in the file winning as
+	// an incremental update's would; and the last trailer with a /Root
+	for(size_t i = 0; i < mSize; i++) {
+		if(i > 0 && IsSpace(mData[i - 1]) == false && IsDelimiter(mData[i - 1]) == false)
+			continue;
+
+		unsigned char c = mData[i];
+
+		if(c >= '0' && c <= '9') {
+			Lexer lexer = { mData, i, mSize };
+			long number, generation;
+
+			if(ReadInteger(lexer, number) && ReadInteger(lexer, generation) && ReadKeyword(lexer, "obj") &&
+				number > 0 && number <= kMaxObjectNumber) {
+				if((size_t) number >= mXRef.size()) {
+					XRefEntry none = { 0, 0, 0 };
+					mXRef.resize(number + 1, none);
+				}
+
+				mXRef[number].type = 1;
+				mXRef[number].offset = i;
+				mXRef[number].index = generation;
+
+				i = lexer.position - 1;
+			}
+		}
+		else if(c == 't' && i + 7 <= mSize && memcmp(mData + i, "trailer", 7) == 0) {
+			Lexer lexer = { mData, i + 7, mSize };
+			CPDFObject* trailer = ParseObject(lexer, 0);
+
+			if(trailer && trailer->mType == CPDFObject::kDictionary && trailer->Find("Root")) {
+				mTrailers.push_back(trailer);
+				mTrailer = trailer;
+			}
+			else
+				delete trailer;
+		}
+	}
+
+	mObjects.resize(mXRef.size(), NULL);
+	mLoading.resize(mXRef.size(), 0);
+
+	// Objects in object streams are only listed in the streams, and a file
+	// with only xref streams has its /Root in one of them or not at all.
+	long catalog = 0;
+	size_t count = mXRef.size();
+
+	for(size_t n = 1; n < count; n++) {
+		if(mXRef[n].type != 1)
+			continue;
+
+		CPDFObject* object = ParseIndirect(mXRef[n].offset, n);
+		if(object == NULL)
+			continue;
+
+		const char* type = NULL;
+		if(object->Find("Type"))
+			object->Find("Type")->GetName(type);
+
+		if(type && strcmp(type, "ObjStm") == 0 && object->mType == CPDFObject::kStream) {
+			unsigned char* data;
+			size_t dataSize;
+
+			long pairs = 0;
+			if(object->Find("N"))
+				object->Find("N")->GetInteger(pairs);
+
+			if(CopyStreamData(object, data, dataSize) == CPDFParser::kNoError) {
+				Lexer lexer = { data, 0, dataSize };
+
+				for(long i = 0; i < pairs; i++) {
+					long number, offset;
+					if(ReadInteger(lexer, number) == false || ReadInteger(lexer, offset) == false)
+						break;
+
+					if(number > 0 && number <= kMaxObjectNumber && ((size_t) number >= mXRef.size() || mXRef[number].type == 0))
+						SetEntry(number, 2, n, i);
+				}
+
+				free(data);
+			}
+		}
+		else if(type && strcmp(type, "XRef") == 0 && object->Find("Root") && mTrailer == NULL) {
+			mTrailers.push_back(object);
+			mTrailer = object;
+			object = NULL;
+		}
+		else if(type && strcmp(type, "Catalog") == 0)
+			catalog = n;
+
+		delete object;
+	}
+
+	if(mTrailer == NULL && catalog) {
+		mTrailer = new CPDFObject(CPDFObject::kDictionary);
+
+		CPDFObject* root = new CPDFObject(CPDFObject::kReference);
+		root->mInteger = catalog;
+
+		mTrailer->mKeys.push_back(strdup("Root"));
+		mTrailer->mItems.push_back(root);
+		mTrailers.push_back(mTrailer);
+	}
+
+	mObjects.resize(mXRef.size(), NULL);
+	mLoading.resize(mXRef.size(), 0);
+}
+
+void
+CPDFDocument::SetEntry(
+	long inNumber,
+	char inType,
+	size_t inOffset,
+	long inIndex)
+{
+	if(inNumber <= 0 || inNumber > kMaxObjectNumber)
+		return;
+
+	if((size_t) inNumber >= mXRef.size()) {
+		XRefEntry none = { 0, 0, 0 };
+		mXRef.resize(inNumber + 1, none);
+	}
+
+	// sections are read newest first
+	if(mXRef[inNumber].type == 0) {
+		mXRef[inNumber].type = inType;
+		mXRef[inNumber].offset = inOffset;
+		mXRef[inNumber].index = inIndex;
+	}
+}
+
+void
+CPDFDocument::CollectPages(
+	CPDFObject* inNode,
+	long inDepth,
+	CPDFObjectSet& ioVisited)
+{
+	unsigned long index;
+
+	if(inNode == NULL || inDepth >= kMaxPageDepth || ioVisited.Add(inNode, index) == false)
+		return;
+
+	CPDFObject* kids = GetArray(inNode, "Kids");
+	if(kids == NULL) {
+		mPages.push_back(inNode);
+		return;
+	}
+
+	for(size_t i = 0; i < kids->GetCount(); i++) {
+		CPDFObject* kid = Resolve(kids->GetItem(i));
+
+		if(kid && kid->mType == CPDFObject::kDictionary)
+			CollectPages(kid, inDepth + 1, ioVisited);
+	}
+}
+
+#pragma mark -
+
+CPDFObject*
+CPDFDocument::Load(
+	long inNumber)
+{
+	if(inNumber <= 0 || (size_t) inNumber >= mObjects.size())
+		return NULL;
+
+	if(mObjects[inNumber] || mLoading[inNumber])
+		return mObjects[inNumber];
+
+	mLoading[inNumber] = 1;
+
+	if(mXRef[inNumber].type == 1)
+		mObjects[inNumber] = ParseIndirect(mXRef[inNumber].offset, inNumber);
+	else if(mXRef[inNumber].type == 2)
+		LoadObjectStream((long) mXRef[inNumber].offset);
+
+	mLoading[inNumber] = 0;
+
+	return mObjects[inNumber];
+}
+
+CPDFObject*
+CPDFDocument::ParseIndirect(
+	size_t inOffset,
+	long inNumber)
+{
+	if(inOffset >= mSize)
+		return NULL;
+
+	Lexer lexer = { mData, inOffset, mSize };
+	long number, generation;
+
+	if(ReadInteger(lexer, number) == false || ReadInteger(lexer, generation) == false || ReadKeyword(lexer, "obj") == false)
+		return NULL;
+
+	if(inNumber >= 0 && number != inNumber)
+		return NULL;
+
+	CPDFObject* object = ParseObject(lexer, 0);
+
+	if(object && object->mType == CPDFObject::kDictionary) {
+		Lexer stream = lexer;
+
+		if(ReadKeyword(stream, "stream")) {
+			// the data starts after the end of line, CRLF or LF
+			if(stream.position < mSize && mData[stream.position] == '\r')
+				stream.position++;
+			if(stream.position < mSize && mData[stream.position] == '\n')
+				stream.position++;
+
+			object->mType = CPDFObject::kStream;
+			object->mStreamOffset = stream.position;
+		}
+	}
+
+	return object;
+}
+
+void
+CPDFDocument::LoadObjectStream(
+	long inNumber)
+{
+	CPDFObject* stream = Load(inNumber);
+	if(stream == NULL || stream->mType != CPDFObject::kStream)
+		return;
+
+	long pairs = 0, first = 0;
+	if(GetInteger(stream, "N", pairs) == false || GetInteger(stream, "First", first) == false || pairs <= 0 || first < 0)
+		return;
+
+	unsigned char* data;
+	size_t dataSize;
+	if(CopyStreamData(stream, data, dataSize) != CPDFParser::kNoError)
+		return;
+
+	// every object the xref still places in this stream, at once, since
+	// decoding the stream is most of the cost
+	Lexer pairLexer = { data, 0, dataSize };
+
+	for(long i = 0; i < pairs; i++) {
+		long number, offset;
+		if(ReadInteger(pairLexer, number) == false || ReadInteger(pairLexer, offset) == false)
+			break;
+
+		if(number <= 0 || (size_t) number >= mObjects.size() || mObjects[number] ||
+			mXRef[number].type != 2 || mXRef[number].offset != (size_t) inNumber)
+			continue;
+
+		if(offset < 0 || (size_t) (first + offset) >= dataSize)
+			continue;
+
+		Lexer lexer = { data, (size_t) (first + offset), dataSize };
+		mObjects[number] = ParseObject(lexer, 0);
+	}
+
+	free(data);
+}
+
+size_t
+CPDFDocument::GetStreamLength(
+	CPDFObject* inStream)
+{
+	size_t offset = inStream->mStreamOffset;
+	if(offset >= mSize)
+		return 0;
+
+	size_t available = mSize - offset;
+
+	// trust /Length only if endstream follows it
+	long length;
+	if(GetInteger(inStream, "Length", length) && length >= 0 && (size_t) length <= available) {
+		size_t window = available - length;
+		if(window > kEndStreamWindow)
+			window = kEndStreamWindow;
+
+		if(FindBytes(mData + offset + length, window, "endstream"))
+			return length;
+	}
+
+	const unsigned char* end = FindBytes(mData + offset, available, "endstream");
+	if(end == NULL)
+		return available;
+
+	length = end - (mData + offset);
+
+	// the end of line before endstream is not data
+	if(length > 0 && mData[offset + length - 1] == '\n')
+		length--;
+	if(length > 0 && mData[offset + length - 1] == '\r')
+		length--;
+
+	return length;
+}
+
+#pragma mark -
+
+void
+CPDFDocument::SkipSpace(
+	Lexer& ioLexer)
+{
+	while(ioLexer.position < ioLexer.end) {
+		unsigned char c = ioLexer.data[ioLexer.position];
+
+		if(c == '%') {
+			while(ioLexer.position < ioLexer.end && ioLexer.data[ioLexer.position] != '\r' && ioLexer.data[ioLexer.position] != '\n')
+				ioLexer.position++;
+		}
+		else if(IsSpace(c))
+			ioLexer.position++;
+		else
+			break;
+	}
+}
+
+bool
+CPDFDocument::ReadInteger(
+	Lexer& ioLexer,
+	long& outValue)
+{
+	SkipSpace(ioLexer);
+
+	size_t position = ioLexer.position;
+	bool negative = false;
+
+	if(position < ioLexer.end && (ioLexer.data[position] == '-' || ioLexer.data[position] == '+'))
+		negative = (ioLexer.data[position++] == '-');
+
+	size_t digits = position;
+	long value = 0;
+
+	while(position < ioLexer.end && ioLexer.data[position] >= '0' && ioLexer.data[position] <= '9') {
+		if(value < 100000000000L / 10)
+			value = value * 10 + (ioLexer.data[position] - '0');
+		position++;
+	}
+
+	if(position == digits)
+		return false;
+
+	if(position < ioLexer.end && IsSpace(ioLexer.data[position]) == false && IsDelimiter(ioLexer.data[position]) == false)
+		return false;
+
+	ioLexer.position = position;
+	outValue = (negative ? -value : value);
+
+	return true;
+}
+
+bool
+CPDFDocument::ReadKeyword(
+	Lexer& ioLexer,
+	const char* inKeyword)
+{
+	SkipSpace(ioLexer);
+
+	size_t length = strlen(inKeyword);
+	size_t position = ioLexer.position;
+
+	if(position + length > ioLexer.end || memcmp(ioLexer.data + position, inKeyword, length) != 0)
+		return false;
+
+	position += length;
+	if(position < ioLexer.end && IsSpace(ioLexer.data[position]) == false && IsDelimiter(ioLexer.data[position]) == false)
+		return false;
+
+	ioLexer.position = position;
+
+	return true;
+}
+
+CPDFObject*
+CPDFDocument::ParseObject(
+	Lexer& ioLexer,
+	long inDepth)
+{
+	if(inDepth >= kMaxObjectDepth)
+		return NULL;
+
+	SkipSpace(ioLexer);
+	if(ioLexer.position >= ioLexer.end)
+		return NULL;
+
+	const unsigned char* data = ioLexer.data;
+	unsigned char c = data[ioLexer.position];
+
+	if(c == '/') {
+		CPDFObject* object = new CPDFObject(CPDFObject::kName);
+		object->mString = ParseName(ioLexer);
+		object->mLength = strlen(object->mString);
+
+		return object;
+	}
+
+	if(c == '(')
+		return ParseString(ioLexer);
+
+	if(c == '<' && ioLexer.position + 1 < ioLexer.end && data[ioLexer.position + 1] == '<') {
+		CPDFObject* object = new CPDFObject(CPDFObject::kDictionary);
+		ioLexer.position += 2;
+
+		for(;;) {
+			SkipSpace(ioLexer);
+			if(ioLexer.position >= ioLexer.end)
+				break;
+
+			if(data[ioLexer.position] == '>') {
+				ioLexer.position += 2;
+				break;
+			}
+
+			// a key that is not a name ends the dictionary where it is
+			if(data[ioLexer.position] != '/')
+				break;
+
+			char* key = ParseName(ioLexer);
+			CPDFObject* value = ParseObject(ioLexer, inDepth + 1);
+
+			if(value == NULL) {
+				free(key);
+				break;
+			}
+
+			object->mKeys.push_back(key);
+			object->mItems.push_back(value);
+		}
+
+		if(ioLexer.position > ioLexer.end)
+			ioLexer.position = ioLexer.end;
+
+		return object;
+	}
+
+	if(c == '<')
+		return ParseHexString(ioLexer);
+
+	if(c == '[') {
+		CPDFObject* object = new CPDFObject(CPDFObject::kArray);
+		ioLexer.position++;
+
+		for(;;) {
+			SkipSpace(ioLexer);
+			if(ioLexer.position >= ioLexer.end)
+				break;
+
+			if(data[ioLexer.position] == ']') {
+				ioLexer.position++;
+				break;
+			}
+
+			CPDFObject* item = ParseObject(ioLexer, inDepth + 1);
+			if(item == NULL)
+				break;
+
+			object->mItems.push_back(item);
+		}
+
+		return object;
+	}
+
+	if((c >= '0' && c <= '9') || c == '-' || c == '+' || c == '.') {
+		CPDFObject* object = ParseNumber(ioLexer);
+
+		// "n g R" is a reference
+		if(object && object->mType == CPDFObject::kInteger && object->mInteger >= 0) {
+			Lexer lexer = ioLexer;
+			long generation;
+
+			if(ReadInteger(lexer, generation) && generation >= 0 && ReadKeyword(lexer, "R")) {
+				object->mType = CPDFObject::kReference;
+				ioLexer = lexer;
+			}
+		}
+
+		return object;
+	}
+
+	if(ReadKeyword(ioLexer, "true")) {
+		CPDFObject* object = new CPDFObject(CPDFObject::kBoolean);
+		object->mBoolean = true;
+
+		return object;
+	}
+
+	if(ReadKeyword(ioLexer, "false"))
+		return new CPDFObject(CPDFObject::kBoolean);
+
+	if(ReadKeyword(ioLexer, "null"))
+		return new CPDFObject(CPDFObject::kNull);
+
+	return NULL;
+}
+
+CPDFObject*
+CPDFDocument::ParseNumber(
+	Lexer& ioLexer)
+{
+	const unsigned char* data = ioLexer.data;
+	size_t position = ioLexer.position;
+
+	bool negative = false;
+	while(position < ioLexer.end && (data[position] == '-' || data[position] == '+')) {
+		if(data[position] == '-')
+			negative = !negative;
+		position++;
+	}
+
+	double value = 0.0;
+	double scale = 0.0;
+	bool real = false;
+
+	while(position < ioLexer.end) {
+		unsigned char c = data[position];
+
+		if(c >= '0' && c <= '9') {
+			if(real) {
+				value += (c - '0') * scale;
+				scale /= 10.0;
+			}
+			else
+				value = value * 10.0 + (c - '0');
+		}
+		else if(c == '.' && real == false) {
+			real = true;
+			scale = 0.1;
+		}
+		else
+			break;
+
+		position++;
+	}
+
+	if(position == ioLexer.position)
+		return NULL;
+
+	// stray characters run on like "1.2.3" or "4-" are skipped with the number
+	while(position < ioLexer.end && IsSpace(data[position]) == false && IsDelimiter(data[position]) == false)
+		position++;
+
+	ioLexer.position = position;
+
+	if(negative)
+		value = -value;
+
+	CPDFObject* object;
+	if(real || value > 2147483647.0 || value < -2147483648.0) {
+		object = new CPDFObject(CPDFObject::kReal);
+		object->mReal = (float) value;
+	}
+	else {
+		object = new CPDFObject(CPDFObject::kInteger);
+		object->mInteger = (long) value;
+	}
+
+	return object;
+}
+
+char*
+CPDFDocument::ParseName(
+	Lexer& ioLexer)
+{
+	const unsigned char* data = ioLexer.data;
+	size_t start = ++ioLexer.position;
+
+	while(ioLexer.position < ioLexer.end && IsSpace(data[ioLexer.position]) == false && IsDelimiter(data[ioLexer.position]) == false)
+		ioLexer.position++;
+
+	char* name = (char*) malloc(ioLexer.position - start + 1);
+	char* n = name;
+
+	for(size_t i = start; i < ioLexer.position; i++) {
+		// #xx is the byte xx
+		if(data[i] == '#' && i + 2 < ioLexer.position && HexValue(data[i + 1]) >= 0 && HexValue(data[i + 2]) >= 0) {
+			*n++ = (char) (HexValue(data[i + 1]) * 16 + HexValue(data[i + 2]));
+			i += 2;
+		}
+		else
+			*n++ = data[i];
+	}
+
+	*n = 0;
+
+	return name;
+}
+
+CPDFObject*
+CPDFDocument::ParseString(
+	Lexer& ioLexer)
+{
+	const unsigned char* data = ioLexer.data;
+	size_t position = ++ioLexer.position;
+
+	// no longer than the bytes it is written in
+	size_t limit = position;
+	long nesting = 1;
+
+	while(limit < ioLexer.end && nesting) {
+		if(data[limit] == '\\')
+			limit++;
+		else if(data[limit] == '(')
+			nesting++;
+		else if(data[limit] == ')')
+			nesting--;
+		limit++;
+	}
+
+	if(limit > ioLexer.end)
+		limit = ioLexer.end;
+
+	CPDFObject* object = new CPDFObject(CPDFObject::kString);
+	object->mString = (char*) malloc(limit - position + 1);
+
+	unsigned char* s = (unsigned char*) object->mString;
+	nesting = 1;
+
+	while(position < limit) {
+		unsigned char c = data[position++];
+
+		if(c == '(')
+			nesting++;
+		else if(c == ')' && --nesting == 0)
+			break;
+		else if(c == '\r') {
+			// any end of line in a string is a line feed
+			if(position < limit && data[position] == '\n')
+				position++;
+			c = '\n';
+		}
+		else if(c == '\\' && position < limit) {
+			c = data[position++];
+
+			switch(c) {
+				case 'n':	c = '\n';	break;
+				case 'r':	c = '\r';	break;
+				case 't':	c = '\t';	break;
+				case 'b':	c = '\b';	break;
+				case 'f':	c = '\f';	break;
+
+				case '\r':
+					if(position < limit && data[position] == '\n')
+						position++;
+					continue;
+
+				case '\n':
+					continue;
+
+				default:
+					if(c >= '0' && c <= '7') {
+						long value = c - '0';
+
+						for(long digit = 1; digit < 3 && position < limit && data[position] >= '0' && data[position] <= '7'; digit++)
+							value = value * 8 + (data[position++] - '0');
+
+						c = (unsigned char) value;
+					}
+					break;
+			}
+		}
+
+		*s++ = c;
+	}
+
+	object->mLength = s - (unsigned char*) object->mString;
+	*s = 0;
+
+	ioLexer.position = position;
+
+	return object;
+}
+
+CPDFObject*
+CPDFDocument::ParseHexString(
+	Lexer& ioLexer)
+{
+	const unsigned char* data = ioLexer.data;
+	size_t position = ++ioLexer.position;
+
+	size_t limit = position;
+	while(limit < ioLexer.end && data[limit] != '>')
+		limit++;
+
+	CPDFObject* object = new CPDFObject(CPDFObject::kString);
+	object->mString = (char*) malloc((limit - position) / 2 + 2);
+
+	unsigned char* s = (unsigned char*) object->mString;
+	long high = -1;
+
+	for(; position < limit; position++) {
+		long value = HexValue(data[position]);
+		if(value < 0)
+			continue;
+
+		if(high < 0)
+			high = value;
+		else {
+			*s++ = (unsigned char) (high * 16 + value);
+			high = -1;
+		}
+	}
+
+	// an odd last digit is followed by 0
+	if(high >= 0)
+		*s++ = (unsigned char) (high * 16);
+
+	object->mLength = s - (unsigned char*) object->mString;
+	*s = 0;
+
+	ioLexer.position = (limit < ioLexer.end ? limit + 1 : limit);
+
+	return object;
+}
+
+bool
+CPDFDocument::IsDelimiter(
+	unsigned char c)
+{
+	return (c == '(' || c == ')' || c == '<' || c == '>' || c == '[' || c == ']' ||
+		c == '{' || c == '}' || c == '/' || c == '%');
+}
@@ -0,0 +1,298 @@
+// Trapeze
+//
+// Copyright (c) 2004 Mesa Dynamics, LLC.  All rights reserved.
+
+#ifndef _H_CPDFDocument
+#define _H_CPDFDocument
+#pragma once
+
+#include "CPDFParser.h"
+#include "CPDFObjectSet.h"
+
+#include <pthread.h>
+
+#include <vector>
+
+const long		kMaxObjectDepth		= 64;	// arrays and dictionaries inside each other
+const long		kMaxXRefSections	= 256;	// followed through /Prev and /XRefStm
+const long		kMaxPageDepth		= 64;
+
+class CPDFDocument;
+
+// One object parsed out of a PDF file.  Arrays and dictionaries own what
+// they hold; a reference is just the number of the object it names until
+// the document resolves it.  A stream is its dictionary and the offset of
+// its data in the file.  Nothing changes once the document has parsed it,
+// so any thread may read it.
+class CPDFObject {
+public:
+	enum {
+		kNull = 0,
+		kBoolean,
+		kInteger,
+		kReal,
+		kName,
+		kString,
+		kArray,
+		kDictionary,
+		kStream,
+		kReference
+	};
+
+public:
+	CPDFObject(
+		long inType);
+
+	~CPDFObject();
+
+	long GetType() {
+		return mType;
+	}
+
+	bool GetBoolean(
+		bool& outValue);
+
+	bool GetInteger(
+		long& outValue);
+
+	// an integer or a real
+	bool GetNumber(
+		float& outValue);
+
+	bool GetName(
+		const char*& outName);
+
+	bool GetString(
+		const unsigned char*& outData,
+		size_t& outSize);
+
+	// array items, or the entries of a dictionary or stream dictionary
+	size_t GetCount() {
+		return mItems.size();
+	}
+
+	CPDFObject* GetItem(
+		size_t inIndex) {
+		return (inIndex < mItems.size() ? mItems[inIndex] : NULL);
+	}
+
+	const char* GetKey(
+		size_t inIndex) {
+		return (inIndex < mKeys.size() ? mKeys[inIndex] : NULL);
+	}
+
+	// a dictionary's value as written, references unresolved
+	CPDFObject* Find(
+		const char* inKey);
+
+private:
+	friend class CPDFDocument;
+
+	long mType;
+
+	bool mBoolean;
+	long mInteger;			// or the object number of a reference
+	float mReal;
+
+	char* mString;			// strings and names, NUL terminated
+	size_t mLength;
+
+	std::vector<CPDFObject*> mItems;
+	std::vector<char*> mKeys;	// dictionaries, one per item
+
+	size_t mStreamOffset;	// the data after "stream"
+};
+
+// A PDF file read in place, out of memory the caller keeps, typically a
+// CMappedFile.  Opening reads the cross-reference sections, table or
+// stream, newest first, and walks the page tree; other objects are parsed
+// the first time they are asked for, those in object streams a whole
+// stream at a time, and cached until the document goes.  Page workers
+// share a document through Retain().
+class CPDFDocument {
+public:
+	CPDFDocument();
+
+	void Retain();
+
+	void Release();
+
+	// inData must stay valid while the document is in use
+	OSErr Open(
+		const unsigned char* inData,
+		size_t inSize);
+
+	size_t GetPageCount() {
+		return mPageCount;
+	}
+
+	// the 1-based page's dictionary, or NULL
+	CPDFObject* GetPage(
+		size_t inPage);
+
+	CPDFObject* GetCatalog();
+
+	// the object a reference names, NULL for one that is not in the file;
+	// any other object as it is
+	CPDFObject* Resolve(
+		CPDFObject* inObject);
+
+	// a dictionary's (or stream's) values, resolved and checked for type
+	CPDFObject* Get(
+		CPDFObject* inDictionary,
+		const char* inKey);
+
+	CPDFObject* GetDictionary(
+		CPDFObject* inDictionary,
+		const char* inKey);
+
+	CPDFObject* GetArray(
+		CPDFObject* inDictionary,
+		const char* inKey);
+
+	CPDFObject* GetStream(
+		CPDFObject* inDictionary,
+		const char* inKey);
+
+	bool GetName(
+		CPDFObject* inDictionary,
+		const char* inKey,
+		const char*& outName);
+
+	bool GetInteger(
+		CPDFObject* inDictionary,
+		const char* inKey,
+		long& outValue);
+
+	bool GetNumber(
+		CPDFObject* inDictionary,
+		const char* inKey,
+		float& outValue);
+
+	bool GetString(
+		CPDFObject* inDictionary,
+		const char* inKey,
+		const unsigned char*& outData,
+		size_t& outSize);
+
+	// a page attribute, looked up the page tree if the page does not have it
+	CPDFObject* GetInherited(
+		CPDFObject* inPage,
+		const char* inKey);
+
+	// The stream's data through its filters, malloc'd for the caller and
+	// followed by a NUL that outSize leaves out; kFormatError for a filter
+	// text extraction has no use for.
+	OSErr CopyStreamData(
+		CPDFObject* inStream,
+		unsigned char*& outData,
+		size_t& outSize);
+
+private:
+	~CPDFDocument();
+
+	struct XRefEntry {
+		char type;		// 0 free or unknown, 1 in the file, 2 in an object stream
+		size_t offset;	// of the object, or the number of its object stream
+		long index;		// generation, or index in the object stream
+	};
+
+	struct Lexer {
+		const unsigned char* data;
+		size_t position;
+		size_t end;
+	};
+
+	// opening
+	OSErr ReadXRef(
+		size_t inOffset);
+
+	bool ReadXRefTable(
+		Lexer& ioLexer,
+		CPDFObject*& outTrailer);
+
+	bool ReadXRefStream(
+		CPDFObject* inStream);
+
+	void RebuildXRef();
+
+	void SetEntry(
+		long inNumber,
+		char inType,
+		size_t inOffset,
+		long inIndex);
+
+	void CollectPages(
+		CPDFObject* inNode,
+		long inDepth,
+		CPDFObjectSet& ioVisited);
+
+	// objects
+	CPDFObject* Load(
+		long inNumber);
+
+	CPDFObject* ParseIndirect(
+		size_t inOffset,
+		long inNumber);
+
+	void LoadObjectStream(
+		long inNumber);
+
+	size_t GetStreamLength(
+		CPDFObject* inStream);
+
+	// parsing
+	static void SkipSpace(
+		Lexer& ioLexer);
+
+	static bool ReadInteger(
+		Lexer& ioLexer,
+		long& outValue);
+
+	static bool ReadKeyword(
+		Lexer& ioLexer,
+		const char* inKeyword);
+
+	static CPDFObject* ParseObject(
+		Lexer& ioLexer,
+		long inDepth);
+
+	static CPDFObject* ParseNumber(
+		Lexer& ioLexer);
+
+	static char* ParseName(
+		Lexer& ioLexer);
+
+	static CPDFObject* ParseString(
+		Lexer& ioLexer);
+
+	static CPDFObject* ParseHexString(
+		Lexer& ioLexer);
+
+	static bool IsDelimiter(
+		unsigned char c);
+
+private:
+	volatile long mRefs;
+
+	// objects load on whichever thread asks first
+	pthread_mutex_t mLock;
+
+	const unsigned char* mData;
+	size_t mSize;
+
+	std::vector<XRefEntry> mXRef;
+	std::vector<CPDFObject*> mObjects;
+	std::vector<char> mLoading;
+
+	// the newest trailer, which the others only fill in
+	CPDFObject* mTrailer;
+	std::vector<CPDFObject*> mTrailers;
+
+	size_t mPageCount;
+
+	// every page in order, found when the document opens
+	std::vector<CPDFObject*> mPages;
+};
+
+#endif
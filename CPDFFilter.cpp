@@ -0,0 +1,533 @@
+// Trapeze
+//
+// Copyright (c) 2004 Mesa Dynamics, LLC.  All rights reserved.
+
+#include "CPDFFilter.h"
+
+#include <ctype.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <zlib.h>
+
+const size_t	kFilterChunk		= 64 * 1024;
+const size_t	kMaxFilterOutput	= 64 * 1024 * 1024;
+const long		kLZWTableSize		= 4096;
+
+// Output that grows as a filter writes it, up to kMaxFilterOutput, where a
+// filter stops as it does at damage; a few compressed bytes can claim
+// gigabytes, and no page's text needs anything like that.
+struct CPDFFilter::Buffer {
+	unsigned char* data;
+	size_t size;
+	size_t capacity;
+	bool full;
+
+	bool Reserve(
+		size_t inMore) {
+		if(size + inMore <= capacity)
+			return true;
+
+		if(size + inMore > kMaxFilterOutput) {
+			full = true;
+			return false;
+		}
+
+		size_t capacity = (this->capacity ? this->capacity : kFilterChunk);
+		while(capacity < size + inMore)
+			capacity *= 2;
+
+		if(capacity > kMaxFilterOutput)
+			capacity = kMaxFilterOutput;
+
+		unsigned char* grown = (unsigned char*) realloc(data, capacity);
+		if(grown == NULL)
+			return false;
+
+		data = grown;
+		this->capacity = capacity;
+
+		return true;
+	}
+
+	bool Append(
+		const unsigned char* inData,
+		size_t inSize) {
+		if(Reserve(inSize) == false)
+			return false;
+
+		memcpy(&(data[size]), inData, inSize);
+		size += inSize;
+
+		return true;
+	}
+};
+
+void
+CPDFFilter::DefaultParms(
+	PDFFilterParms& outParms)
+{
+	outParms.predictor = 1;
+	outParms.colors = 1;
+	outParms.bitsPerComponent = 8;
+	outParms.columns = 1;
+	outParms.earlyChange = 1;
+}
+
+OSErr
+CPDFFilter::Decode(
+	const char* inFilter,
+	const PDFFilterParms& inParms,
+	const unsigned char* inData,
+	size_t inSize,
+	unsigned char*& outData,
+	size_t& outSize)
+{
+	Buffer buffer;
+	buffer.data = NULL;
+	buffer.size = 0;
+	buffer.capacity = 0;
+	buffer.full = false;
+
+	OSErr error = CPDFParser::kNoError;
+	bool predicts = false;
+
+	if(strcmp(inFilter, "FlateDecode") == 0 || strcmp(inFilter, "Fl") == 0) {
+		error = Inflate(inData, inSize, buffer);
+		predicts = true;
+	}
+	else if(strcmp(inFilter, "LZWDecode") == 0 || strcmp(inFilter, "LZW") == 0) {
+		error = DecodeLZW(inData, inSize, inParms.earlyChange, buffer);
+		predicts = true;
+	}
+	else if(strcmp(inFilter, "ASCIIHexDecode") == 0 || strcmp(inFilter, "AHx") == 0)
+		error = DecodeASCIIHex(inData, inSize, buffer);
+	else if(strcmp(inFilter, "ASCII85Decode") == 0 || strcmp(inFilter, "A85") == 0)
+		error = DecodeASCII85(inData, inSize, buffer);
+	else
+		error = CPDFParser::kFormatError;
+
+	// what fit is kept, like what decoded before damage
+	if(error == CPDFParser::kMemoryError && buffer.full)
+		error = CPDFParser::kNoError;
+
+	if(error == CPDFParser::kNoError && predicts && inParms.predictor >= 2)
+		error = Predict(inParms, buffer);
+
+	if(error != CPDFParser::kNoError) {
+		if(buffer.data)
+			free(buffer.data);
+
+		outData = NULL;
+		outSize = 0;
+
+		return error;
+	}
+
+	// an empty stream still gets a block, so callers can tell it from a failure
+	if(buffer.data == NULL && buffer.Reserve(1) == false)
+		return CPDFParser::kMemoryError;
+
+	outData = buffer.data;
+	outSize = buffer.size;
+
+	return CPDFParser::kNoError;
+}
+
+#pragma mark -
+
+OSErr
+CPDFFilter::Inflate(
+	const unsigned char* inData,
+	size_t inSize,
+	Buffer& ioBuffer)
+{
+	// some writers leave off the zlib header, so a stream that fails
+	// straight away is tried again as raw deflate
+	for(long attempt = 0; attempt < 2; attempt++) {
+		z_stream z;
+		memset(&z, 0, sizeof(z));
+
+		if((attempt == 0 ? inflateInit(&z) : inflateInit2(&z, -MAX_WBITS)) != Z_OK)
+			return CPDFParser::kMemoryError;
+
+		z.next_in = (Bytef*) inData;
+		z.avail_in = (uInt) inSize;
+
+		int status = Z_OK;
+
+		while(status == Z_OK) {
+			if(ioBuffer.Reserve(kFilterChunk) == false) {
+				inflateEnd(&z);
+				return CPDFParser::kMemoryError;
+			}
+
+			z.next_out = &(ioBuffer.data[ioBuffer.size]);
+			z.avail_out = (uInt) (ioBuffer.capacity - ioBuffer.size);
+
+			uInt before = z.avail_out;
+
+			status = inflate(&z, Z_NO_FLUSH);
+
+			ioBuffer.size += before - z.avail_out;
+
+			// truncated input, nothing more will come out
+			if(status == Z_BUF_ERROR || (status == Z_OK && z.avail_in == 0 && z.avail_out != 0))
+				break;
+		}
+
+		inflateEnd(&z);
+
+		if(ioBuffer.size || status == Z_STREAM_END)
+			break;
+	}
+
+	return CPDFParser::kNoError;
+}
+
+OSErr
+CPDFFilter::DecodeLZW(
+	const unsigned char* inData,
+	size_t inSize,
+	long inEarlyChange,
+	Buffer& ioBuffer)
+{
+	short* prefix = (short*) malloc(kLZWTableSize * sizeof(short));
+	unsigned char* suffix = (unsigned char*) malloc(kLZWTableSize);
+	unsigned char* first = (unsigned char*) malloc(kLZWTableSize);
+	unsigned short* length = (unsigned short*) malloc(kLZWTableSize * sizeof(unsigned short));
+	unsigned char* string = (unsigned char*) malloc(kLZWTableSize);
+
+	OSErr error = CPDFParser::kNoError;
+
+	if(prefix == NULL || suffix == NULL || first == NULL || length == NULL || string == NULL)
+		error = CPDFParser::kMemoryError;
+
+	if(error == CPDFParser::kNoError) {
+		for(long i = 0; i < 256; i++) {
+			prefix[i] = -1;
+			suffix[i] = i;
+			first[i] = i;
+			length[i] = 1;
+		}
+
+		unsigned long bits = 0;
+		long bitCount = 0;
+		long codeSize = 9;
+		long nextCode = 258;
+		long previous = -1;
+
+		size_t i = 0;
+
+		for(;;) {
+			while(bitCount < codeSize && i < inSize) {
+				bits = (bits << 8) | inData[i++];
+				bitCount += 8;
+			}
+
+			if(bitCount < codeSize)
+				break;
+
+			long code = (bits >> (bitCount - codeSize)) & ((1 << codeSize) - 1);
+			bitCount -= codeSize;
+
+			if(code == 256) {
+				codeSize = 9;
+				nextCode = 258;
+				previous = -1;
+
+				continue;
+			}
+
+			if(code == 257)
+				break;
+
+			if(previous < 0) {
+				if(code > 255)
+					break;
+
+				unsigned char c = code;
+				if(ioBuffer.Append(&c, 1) == false) {
+					error = CPDFParser::kMemoryError;
+					break;
+				}
+
+				previous = code;
+				continue;
+			}
+
+			long entry = code;
+			long size = 0;
+
+			if(code < nextCode)
+				size = length[code];
+			else if(code == nextCode && nextCode < kLZWTableSize) {
+				// the code being defined: the previous string and its own first byte
+				entry = previous;
+				size = length[previous] + 1;
+				string[size - 1] = first[previous];
+			}
+			else
+				break;
+
+			// spelled backwards from the last byte
+			long end = (code < nextCode ? size : size - 1);
+			for(long k = end - 1; k >= 0 && entry >= 0; k--) {
+				string[k] = suffix[entry];
+				entry = prefix[entry];
+			}
+
+			if(ioBuffer.Append(string, size) == false) {
+				error = CPDFParser::kMemoryError;
+				break;
+			}
+
+			if(nextCode < kLZWTableSize) {
+				prefix[nextCode] = previous;
+				suffix[nextCode] = string[0];
+				first[nextCode] = first[previous];
+				length[nextCode] = length[previous] + 1;
+
+				nextCode++;
+			}
+
+			if(nextCode + inEarlyChange >= (1 << codeSize) && codeSize < 12)
+				codeSize++;
+
+			previous = code;
+		}
+	}
+
+	if(prefix)
+		free(prefix);
+
+	if(suffix)
+		free(suffix);
+
+	if(first)
+		free(first);
+
+	if(length)
+		free(length);
+
+	if(string)
+		free(string);
+
+	return error;
+}
+
+OSErr
+CPDFFilter::DecodeASCIIHex(
+	const unsigned char* inData,
+	size_t inSize,
+	Buffer& ioBuffer)
+{
+	if(ioBuffer.Reserve(inSize / 2 + 1) == false)
+		return CPDFParser::kMemoryError;
+
+	long high = -1;
+
+	for(size_t i = 0; i < inSize && inData[i] != '>'; i++) {
+		long c = inData[i];
+		long nibble;
+
+		if(c >= '0' && c <= '9')
+			nibble = c - '0';
+		else if(c >= 'a' && c <= 'f')
+			nibble = c - 'a' + 10;
+		else if(c >= 'A' && c <= 'F')
+			nibble = c - 'A' + 10;
+		else
+			continue;
+
+		if(high < 0)
+			high = nibble;
+		else {
+			ioBuffer.data[ioBuffer.size++] = (high << 4) | nibble;
+			high = -1;
+		}
+	}
+
+	// an odd digit out is followed by a 0
+	if(high >= 0)
+		ioBuffer.data[ioBuffer.size++] = high << 4;
+
+	return CPDFParser::kNoError;
+}
+
+OSErr
+CPDFFilter::DecodeASCII85(
+	const unsigned char* inData,
+	size_t inSize,
+	Buffer& ioBuffer)
+{
+	if(ioBuffer.Reserve((inSize / 5 + 1) * 4) == false)
+		return CPDFParser::kMemoryError;
+
+	unsigned long long tuple = 0;
+	long count = 0;
+
+	for(size_t i = 0; i < inSize; i++) {
+		long c = inData[i];
+
+		if(isspace(c))
+			continue;
+
+		if(c == '~')
+			break;
+
+		if(c == 'z' && count == 0) {
+			if(ioBuffer.Reserve(4) == false)
+				return CPDFParser::kMemoryError;
+
+			memset(&(ioBuffer.data[ioBuffer.size]), 0, 4);
+			ioBuffer.size += 4;
+
+			continue;
+		}
+
+		if(c < '!' || c > 'u')
+			break;
+
+		tuple = tuple * 85 + (c - '!');
+
+		if(++count == 5) {
+			if(ioBuffer.Reserve(4) == false)
+				return CPDFParser::kMemoryError;
+
+			for(long k = 3; k >= 0; k--)
+				ioBuffer.data[ioBuffer.size++] = (tuple >> (k * 8)) & 0xFF;
+
+			tuple = 0;
+			count = 0;
+		}
+	}
+
+	// a short last group is padded out with the highest digit
+	if(count > 1) {
+		for(long k = count; k < 5; k++)
+			tuple = tuple * 85 + 84;
+
+		if(ioBuffer.Reserve(4) == false)
+			return CPDFParser::kMemoryError;
+
+		for(long k = 3; k >= 5 - count; k--)
+			ioBuffer.data[ioBuffer.size++] = (tuple >> (k * 8)) & 0xFF;
+	}
+
+	return CPDFParser::kNoError;
+}
+
+// Undoes a TIFF (2) or PNG (10 and up) predictor, row by row.
+OSErr
+CPDFFilter::Predict(
+	const PDFFilterParms& inParms,
+	Buffer& ioBuffer)
+{
+	long bitsPerPixel = inParms.colors * inParms.bitsPerComponent;
+	long bytesPerPixel = (bitsPerPixel + 7) / 8;
+	size_t rowLength = (inParms.columns * bitsPerPixel + 7) / 8;
+
+	if(bitsPerPixel <= 0 || rowLength == 0)
+		return CPDFParser::kFormatError;
+
+	if(inParms.predictor == 2) {
+		// only whole bytes per component are differenced here
+		if(inParms.bitsPerComponent != 8)
+			return CPDFParser::kNoError;
+
+		for(size_t row = 0; row < ioBuffer.size; row += rowLength) {
+			unsigned char* p = &(ioBuffer.data[row]);
+			size_t n = (ioBuffer.size - row < rowLength ? ioBuffer.size - row : rowLength);
+
+			for(size_t i = bytesPerPixel; i < n; i++)
+				p[i] += p[i - bytesPerPixel];
+		}
+
+		return CPDFParser::kNoError;
+	}
+
+	if(inParms.predictor < 10)
+		return CPDFParser::kNoError;
+
+	// each row leads with its own PNG filter type
+	size_t capacity = ioBuffer.size + rowLength;
+
+	unsigned char* out = (unsigned char*) malloc(capacity);
+	unsigned char* prior = (unsigned char*) calloc(rowLength, 1);
+
+	if(out == NULL || prior == NULL) {
+		if(out)
+			free(out);
+
+		if(prior)
+			free(prior);
+
+		return CPDFParser::kMemoryError;
+	}
+
+	size_t outSize = 0;
+
+	for(size_t row = 0; row < ioBuffer.size; row += rowLength + 1) {
+		long type = ioBuffer.data[row];
+		const unsigned char* in = &(ioBuffer.data[row + 1]);
+
+		size_t n = ioBuffer.size - row - 1;
+		if(n > rowLength)
+			n = rowLength;
+
+		unsigned char* p = &(out[outSize]);
+
+		for(size_t i = 0; i < n; i++) {
+			long left = (i >= (size_t) bytesPerPixel ? p[i - bytesPerPixel] : 0);
+			long up = prior[i];
+			long upLeft = (i >= (size_t) bytesPerPixel ? prior[i - bytesPerPixel] : 0);
+
+			switch(type) {
+				case 1:
+					p[i] = in[i] + left;
+					break;
+
+				case 2:
+					p[i] = in[i] + up;
+					break;
+
+				case 3:
+					p[i] = in[i] + ((left + up) >> 1);
+					break;
+
+				case 4: {
+					long estimate = left + up - upLeft;
+					long pa = labs(estimate - left);
+					long pb = labs(estimate - up);
+					long pc = labs(estimate - upLeft);
+
+					if(pa <= pb && pa <= pc)
+						p[i] = in[i] + left;
+					else if(pb <= pc)
+						p[i] = in[i] + up;
+					else
+						p[i] = in[i] + upLeft;
+
+					break;
+				}
+
+				default:
+					p[i] = in[i];
+					break;
+			}
+		}
+
+		memcpy(prior, p, n);
+		outSize += n;
+	}
+
+	free(prior);
+	free(ioBuffer.data);
+
+	ioBuffer.data = out;
+	ioBuffer.size = outSize;
+	ioBuffer.capacity = capacity;
+
+	return CPDFParser::kNoError;
+}
@@ -0,0 +1,70 @@
+// Trapeze
+//
+// Copyright (c) 2004 Mesa Dynamics, LLC.  All rights reserved.
+
+#ifndef _H_CPDFFilter
+#define _H_CPDFFilter
+#pragma once
+
+#include "CPDFParser.h"
+
+#include <stddef.h>
+
+// a filter's DecodeParms, with the defaults of PDF 1.7 section 7.4
+struct PDFFilterParms {
+	long predictor;
+	long colors;
+	long bitsPerComponent;
+	long columns;
+	long earlyChange;	// LZW only
+};
+
+// The stream filters text extraction needs: FlateDecode, LZWDecode,
+// ASCIIHexDecode and ASCII85Decode, with the TIFF and PNG predictors.
+// Image filters (DCT, JBIG2, CCITT, JPX) are not decoded.
+class CPDFFilter {
+public:
+	static void DefaultParms(
+		PDFFilterParms& outParms);
+
+	// Decodes inData through the filter named inFilter, full or abbreviated.
+	// outData is malloc'd for the caller.  A damaged stream gives back what
+	// decoded before the damage; kFormatError for a filter not supported.
+	static OSErr Decode(
+		const char* inFilter,
+		const PDFFilterParms& inParms,
+		const unsigned char* inData,
+		size_t inSize,
+		unsigned char*& outData,
+		size_t& outSize);
+
+private:
+	struct Buffer;
+
+	static OSErr Inflate(
+		const unsigned char* inData,
+		size_t inSize,
+		Buffer& ioBuffer);
+
+	static OSErr DecodeLZW(
+		const unsigned char* inData,
+		size_t inSize,
+		long inEarlyChange,
+		Buffer& ioBuffer);
+
+	static OSErr DecodeASCIIHex(
+		const unsigned char* inData,
+		size_t inSize,
+		Buffer& ioBuffer);
+
+	static OSErr DecodeASCII85(
+		const unsigned char* inData,
+		size_t inSize,
+		Buffer& ioBuffer);
+
+	static OSErr Predict(
+		const PDFFilterParms& inParms,
+		Buffer& ioBuffer);
+};
+
+#endif
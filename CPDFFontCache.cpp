@@ -0,0 +1,304 @@
+// Trapeze
+//
+// Copyright (c) 2004 Mesa Dynamics, LLC.  All rights reserved.
+
+#include "CPDFFontCache.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+struct CPDFFontCache::Entry : public CPDFFontCache::Font {
+	UInt64 key;
+	long refs;
+
+	Entry* newer;
+	Entry* older;
+};
+
+static pthread_once_t sSharedOnce = PTHREAD_ONCE_INIT;
+static CPDFFontCache* sShared = NULL;
+
+static void
+MakeShared()
+{
+	sShared = new CPDFFontCache;
+}
+
+CPDFFontCache::CPDFFontCache(
+	size_t inCapacity) :
+		mNewest(NULL),
+		mOldest(NULL),
+		mCapacity(inCapacity),
+		mLookups(0),
+		mHits(0),
+		mEvictions(0)
+{
+	pthread_mutex_init(&mLock, NULL);
+}
+
+CPDFFontCache::~CPDFFontCache()
+{
+	std::map<UInt64, Entry*>::iterator i;
+
+	for(i = mEntries.begin(); i != mEntries.end(); i++)
+		FreeEntry(i->second);
+
+	mEntries.clear();
+
+	pthread_mutex_destroy(&mLock);
+}
+
+CPDFFontCache*
+CPDFFontCache::GetShared()
+{
+	pthread_once(&sSharedOnce, MakeShared);
+
+	return sShared;
+}
+
+void
+CPDFFontCache::Hash(
+	UInt64& ioHash,
+	const void* inData,
+	size_t inSize)
+{
+	const unsigned char* data = (const unsigned char*) inData;
+
+	for(size_t i = 0; i < inSize; i++)
+		ioHash = (ioHash ^ data[i]) * 1099511628211ULL;
+}
+
+void
+CPDFFontCache::SetCapacity(
+	size_t inEntries)
+{
+	pthread_mutex_lock(&mLock);
+
+	mCapacity = inEntries;
+	Evict(mCapacity);
+
+	pthread_mutex_unlock(&mLock);
+}
+
+#pragma mark -
+
+const CPDFFontCache::Font*
+CPDFFontCache::Acquire(
+	UInt64 inKey)
+{
+	Entry* entry = NULL;
+
+	pthread_mutex_lock(&mLock);
+
+	mLookups++;
+
+	std::map<UInt64, Entry*>::iterator i = mEntries.find(inKey);
+	if(i != mEntries.end()) {
+		entry = i->second;
+		entry->refs++;
+
+		Touch(entry);
+		mHits++;
+	}
+
+	pthread_mutex_unlock(&mLock);
+
+	return entry;
+}
+
+const CPDFFontCache::Font*
+CPDFFontCache::Insert(
+	UInt64 inKey,
+	const char* inBaseFont,
+	const char* inEncoding,
+	char* inMap,
+	wchar_t* inUMap,
+	float* inWidths,
+	unsigned char inFI,
+	unsigned char inFL)
+{
+	Entry* entry = (Entry*) calloc(1, sizeof(Entry));
+	if(entry == NULL)
+		return NULL;
+
+	entry->baseFont = strdup(inBaseFont);
+	entry->encoding = (inEncoding ? strdup(inEncoding) : NULL);
+
+	if(entry->baseFont == NULL || (inEncoding && entry->encoding == NULL)) {
+		FreeEntry(entry);
+		return NULL;
+	}
+
+	entry->map = inMap;
+	entry->umap = inUMap;
+	entry->widths = inWidths;
+	entry->fi = inFI;
+	entry->fl = inFL;
+
+	entry->key = inKey;
+	entry->refs = 1;
+
+	pthread_mutex_lock(&mLock);
+
+	std::map<UInt64, Entry*>::iterator i = mEntries.find(inKey);
+	if(i != mEntries.end()) {
+		// lost a race to another parser with the same font
+		Entry* existing = i->second;
+		existing->refs++;
+
+		Touch(existing);
+
+		pthread_mutex_unlock(&mLock);
+
+		FreeEntry(entry);
+
+		return existing;
+	}
+
+	mEntries[inKey] = entry;
+	Touch(entry);
+
+	Evict(mCapacity);
+
+	pthread_mutex_unlock(&mLock);
+
+	return entry;
+}
+
+void
+CPDFFontCache::Release(
+	UInt64 inKey)
+{
+	pthread_mutex_lock(&mLock);
+
+	std::map<UInt64, Entry*>::iterator i = mEntries.find(inKey);
+	if(i != mEntries.end() && i->second->refs > 0) {
+		i->second->refs--;
+
+		if(mEntries.size() > mCapacity)
+			Evict(mCapacity);
+	}
+
+	pthread_mutex_unlock(&mLock);
+}
+
+void
+CPDFFontCache::Flush()
+{
+	pthread_mutex_lock(&mLock);
+
+	Evict(0);
+
+	pthread_mutex_unlock(&mLock);
+}
+
+void
+CPDFFontCache::GetStats(
+	FontCacheStats& outStats)
+{
+	pthread_mutex_lock(&mLock);
+
+	outStats.lookups = mLookups;
+	outStats.hits = mHits;
+	outStats.evictions = mEvictions;
+
+	outStats.entries = mEntries.size();
+	outStats.referenced = 0;
+
+	for(Entry* entry = mNewest; entry; entry = entry->older) {
+		if(entry->refs)
+			outStats.referenced++;
+	}
+
+	pthread_mutex_unlock(&mLock);
+
+	outStats.hitRate = (outStats.lookups ? (double) outStats.hits / outStats.lookups : 0.0);
+}
+
+#pragma mark -
+
+// Moves an entry to the front of the use list, adding it if it is new;
+// the lock is held.
+void
+CPDFFontCache::Touch(
+	Entry* inEntry)
+{
+	if(inEntry == mNewest)
+		return;
+
+	Unlink(inEntry);
+
+	inEntry->older = mNewest;
+	inEntry->newer = NULL;
+
+	if(mNewest)
+		mNewest->newer = inEntry;
+
+	mNewest = inEntry;
+
+	if(mOldest == NULL)
+		mOldest = inEntry;
+}
+
+void
+CPDFFontCache::Unlink(
+	Entry* inEntry)
+{
+	if(inEntry->newer)
+		inEntry->newer->older = inEntry->older;
+	else if(mNewest == inEntry)
+		mNewest = inEntry->older;
+
+	if(inEntry->older)
+		inEntry->older->newer = inEntry->newer;
+	else if(mOldest == inEntry)
+		mOldest = inEntry->newer;
+
+	inEntry->newer = NULL;
+	inEntry->older = NULL;
+}
+
+// Frees the least recently used entries nobody holds until no more than
+// inEntries are left, or only held ones; the lock is held.
+void
+CPDFFontCache::Evict(
+	size_t inEntries)
+{
+	Entry* entry = mOldest;
+
+	while(entry && mEntries.size() > inEntries) {
+		Entry* newer = entry->newer;
+
+		if(entry->refs == 0) {
+			Unlink(entry);
+			mEntries.erase(entry->key);
+
+			FreeEntry(entry);
+			mEvictions++;
+		}
+
+		entry = newer;
+	}
+}
+
+void
+CPDFFontCache::FreeEntry(
+	Entry* inEntry)
+{
+	if(inEntry->baseFont)
+		free(inEntry->baseFont);
+
+	if(inEntry->encoding)
+		free(inEntry->encoding);
+
+	if(inEntry->map)
+		free(inEntry->map);
+
+	if(inEntry->umap)
+		free(inEntry->umap);
+
+	if(inEntry->widths)
+		free(inEntry->widths);
+
+	free(inEntry);
+}
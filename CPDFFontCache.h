@@ -0,0 +1,125 @@
+// Trapeze
+//
+// Copyright (c) 2004 Mesa Dynamics, LLC.  All rights reserved.
+
+#ifndef _H_CPDFFontCache
+#define _H_CPDFFontCache
+#pragma once
+
+#include "CPDFParser.h"
+
+#include <pthread.h>
+
+#include <map>
+
+const size_t	kFontCacheEntries	= 2048;
+const UInt64	kFontCacheSeed		= 14695981039346656037ULL;
+
+// Fonts extracted from documents, shared between parsers and threads.
+// An entry is keyed by a hash of the font dictionary's contents, so the
+// same embedded font in another document made by the same program comes
+// back without rebuilding its widths and maps.  Entries never change once
+// added; a parser holds a reference to each one it uses, and unreferenced
+// entries are evicted oldest use first past the capacity.
+class CPDFFontCache {
+public:
+	struct Font {
+		char* baseFont; // as the document has it
+		char* encoding;
+
+		char* map;
+		wchar_t* umap;
+		float* widths;
+
+		unsigned char fi;
+		unsigned char fl;
+	};
+
+	struct FontCacheStats {
+		unsigned long long lookups;
+		unsigned long long hits;
+		unsigned long long evictions;
+
+		unsigned long entries;
+		unsigned long referenced;
+
+		double hitRate;
+	};
+
+public:
+	CPDFFontCache(
+		size_t inCapacity = kFontCacheEntries);
+
+	~CPDFFontCache();
+
+	// the one every parser may use
+	static CPDFFontCache* GetShared();
+
+	// FNV-1a, 64 bits; start from kFontCacheSeed
+	static void Hash(
+		UInt64& ioHash,
+		const void* inData,
+		size_t inSize);
+
+	void SetCapacity(
+		size_t inEntries);
+
+	// a font with a reference for the caller, or NULL
+	const Font* Acquire(
+		UInt64 inKey);
+
+	// Adds a font and takes its tables, returning it with a reference for
+	// the caller.  If another thread added the key first its entry comes
+	// back and the tables are freed.  NULL if out of memory, in which case
+	// the tables are still the caller's.
+	const Font* Insert(
+		UInt64 inKey,
+		const char* inBaseFont,
+		const char* inEncoding,
+		char* inMap,
+		wchar_t* inUMap,
+		float* inWidths,
+		unsigned char inFI,
+		unsigned char inFL);
+
+	void Release(
+		UInt64 inKey);
+
+	// drops every entry no parser holds
+	void Flush();
+
+	void GetStats(
+		FontCacheStats& outStats);
+
+private:
+	struct Entry;
+
+	void Touch(
+		Entry* inEntry);
+
+	void Unlink(
+		Entry* inEntry);
+
+	void Evict(
+		size_t inEntries);
+
+	static void FreeEntry(
+		Entry* inEntry);
+
+private:
+	pthread_mutex_t mLock;
+
+	std::map<UInt64, Entry*> mEntries;
+
+	// most recently used first
+	Entry* mNewest;
+	Entry* mOldest;
+
+	size_t mCapacity;
+
+	unsigned long long mLookups;
+	unsigned long long mHits;
+	unsigned long long mEvictions;
+};
+
+#endif
@@ -0,0 +1,142 @@
+// Trapeze
+//
+// Copyright (c) 2004 Mesa Dynamics, LLC.  All rights reserved.
+
+#include "CPDFObjectSet.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+CPDFObjectSet::CPDFObjectSet(
+	unsigned long inCapacity) :
+		mSlots(NULL),
+		mCapacity(16),
+		mCount(0),
+		mGeneration(1)
+{
+	while(mCapacity < inCapacity)
+		mCapacity <<= 1;
+
+	mSlots = (Slot*) calloc(mCapacity, sizeof(Slot));
+	if(mSlots == NULL)
+		mCapacity = 0;
+}
+
+CPDFObjectSet::~CPDFObjectSet()
+{
+	if(mSlots)
+		free(mSlots);
+}
+
+bool
+CPDFObjectSet::Add(
+	const void* inObject,
+	unsigned long& outIndex)
+{
+	// keep the table at most half full so probe runs stay short
+	if((mCount + 1) * 2 > mCapacity)
+		Grow();
+
+	Slot* slot = Find(inObject);
+	if(slot == NULL) {
+		// out of memory; report it as new so the caller still visits it
+		outIndex = ++mCount;
+		return true;
+	}
+
+	if(slot->generation == mGeneration) {
+		outIndex = slot->index;
+		return false;
+	}
+
+	slot->object = inObject;
+	slot->index = ++mCount;
+	slot->generation = mGeneration;
+
+	outIndex = slot->index;
+
+	return true;
+}
+
+bool
+CPDFObjectSet::Contains(
+	const void* inObject)
+{
+	Slot* slot = Find(inObject);
+
+	return (slot && slot->generation == mGeneration);
+}
+
+void
+CPDFObjectSet::Reset()
+{
+	mCount = 0;
+
+	if(++mGeneration == 0) {
+		// wrapped around, old stamps could look current again
+		if(mSlots)
+			memset(mSlots, 0, mCapacity * sizeof(Slot));
+
+		mGeneration = 1;
+	}
+}
+
+CPDFObjectSet::Slot*
+CPDFObjectSet::Find(
+	const void* inObject)
+{
+	if(mSlots == NULL)
+		return NULL;
+
+	unsigned long mask = mCapacity - 1;
+	unsigned long i = Hash(inObject) & mask;
+
+	// stops at the object or at the first slot not used in this generation
+	while(mSlots[i].generation == mGeneration && mSlots[i].object != inObject)
+		i = (i + 1) & mask;
+
+	return &(mSlots[i]);
+}
+
+void
+CPDFObjectSet::Grow()
+{
+	unsigned long capacity = (mCapacity ? mCapacity << 1 : 16);
+
+	Slot* slots = (Slot*) calloc(capacity, sizeof(Slot));
+	if(slots == NULL)
+		return;
+
+	Slot* oldSlots = mSlots;
+	unsigned long oldCapacity = mCapacity;
+
+	mSlots = slots;
+	mCapacity = capacity;
+
+	unsigned long mask = mCapacity - 1;
+
+	for(unsigned long j = 0; j < oldCapacity; j++) {
+		if(oldSlots[j].generation != mGeneration)
+			continue;
+
+		unsigned long i = Hash(oldSlots[j].object) & mask;
+		while(mSlots[i].generation == mGeneration)
+			i = (i + 1) & mask;
+
+		mSlots[i] = oldSlots[j];
+	}
+
+	if(oldSlots)
+		free(oldSlots);
+}
+
+unsigned long
+CPDFObjectSet::Hash(
+	const void* inObject)
+{
+	// pointers are aligned, so mix the high bits down (Fibonacci hashing)
+	unsigned long long h = (unsigned long long) (size_t) inObject;
+	h *= 0x9E3779B97F4A7C15ULL;
+
+	return (unsigned long) (h >> 32) ^ (unsigned long) h;
+}
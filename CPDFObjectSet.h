@@ -0,0 +1,58 @@
+// Trapeze
+//
+// Copyright (c) 2004 Mesa Dynamics, LLC.  All rights reserved.
+
+#ifndef _H_CPDFObjectSet
+#define _H_CPDFObjectSet
+#pragma once
+
+#include <stddef.h>
+
+// Visited set keyed by object identity.  Open addressing with linear
+// probing; each slot carries the generation it was written in, so Reset()
+// just starts a new generation instead of clearing the table.
+class CPDFObjectSet {
+public:
+	CPDFObjectSet(
+		unsigned long inCapacity = 1024);
+
+	~CPDFObjectSet();
+
+	// true if inObject was not in the set yet; outIndex is its 1-based
+	// insertion order either way
+	bool Add(
+		const void* inObject,
+		unsigned long& outIndex);
+
+	bool Contains(
+		const void* inObject);
+
+	void Reset();
+
+	unsigned long GetCount() {
+		return mCount;
+	}
+
+private:
+	struct Slot {
+		const void* object;
+		unsigned long index;
+		unsigned long generation;
+	};
+
+	Slot* Find(
+		const void* inObject);
+
+	void Grow();
+
+	static unsigned long Hash(
+		const void* inObject);
+
+private:
+	Slot* mSlots;
+	unsigned long mCapacity; // power of two
+	unsigned long mCount;
+	unsigned long mGeneration;
+};
+
+#endif
@@ -0,0 +1,860 @@
+// Trapeze
+//
+// Copyright (c) 2004 Mesa Dynamics, LLC.  All rights reserved.
+
+#include "CPDFPageCache.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+const char		kCacheMagic[4]		= { 'T', 'r', 'P', 'C' };
+const UInt32	kCacheByteOrder		= 0x01020304;
+const long		kCacheTableSize		= 256;
+
+enum {
+	kCacheMap = 0x01,
+	kCacheUMap = 0x02,
+	kCacheWidths = 0x04
+};
+
+// The file is a header, the pages, the font table and then the page table,
+// which holds an offset and a size for every page.  The header is written
+// last, so a file cut short never opens.
+struct CPDFPageCache::CacheHeader {
+	char magic[4];
+	UInt32 version;
+	UInt32 byteOrder;
+	UInt32 wideSize;
+	UInt8 digest[kDocumentDigestSize];
+	UInt64 documentSize;
+	UInt64 pageTable;
+	UInt64 fontTable;
+	UInt32 pageCount;
+	UInt32 fontCount;
+};
+
+// followed by the key and name, each with its terminator, padded to four
+// bytes, then whichever tables the font has
+struct CPDFPageCache::CacheFont {
+	UInt32 size;
+	UInt32 encoding;
+	UInt32 keySize;
+	UInt32 nameSize;
+	UInt8 fi;
+	UInt8 fl;
+	UInt8 mapInPlace;
+	UInt8 tables;
+};
+
+// a page record is a CachePage, then its runs
+struct CachePage {
+	SInt32 error;
+	UInt32 runCount;
+	float width;
+	float height;
+	float cropWidth;
+	float cropHeight;
+	UInt8 crop;
+	UInt8 rawPage;
+	UInt8 reserved[2];
+};
+
+// followed by the text, padded to four bytes
+struct CacheRun {
+	float x;
+	float y;
+	float f;
+	float fs;
+	float l;
+	float tc;
+	float tw;
+	SInt32 font;
+	UInt32 size;
+};
+
+static inline long
+PadToWord(
+	long inSize)
+{
+	return (inSize + 3) & ~3L;
+}
+
+CPDFPageCache::CPDFPageCache() :
+		mWriting(false),
+		mOffset(0),
+		mDocumentSize(0),
+		mPageCount(0),
+		mPageTable(NULL)
+{
+	memset(mDigest, 0, sizeof(mDigest));
+}
+
+CPDFPageCache::~CPDFPageCache()
+{
+	Discard();
+	Close();
+}
+
+#pragma mark -
+
+const UInt32	kSHA256Rounds[64] = {
+	0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+	0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+	0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+	0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+	0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+	0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+	0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+	0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+};
+
+static inline UInt32
+RotateRight(
+	UInt32 inValue,
+	long inBits)
+{
+	return (inValue >> inBits) | (inValue << (32 - inBits));
+}
+
+// one 64-byte block into the running state
+static void
+SHA256Block(
+	UInt32* ioState,
+	const unsigned char* inBlock)
+{
+	UInt32 w[64];
+
+	for(long i = 0; i < 16; i++)
+		w[i] = ((UInt32) inBlock[i * 4] << 24) | ((UInt32) inBlock[i * 4 + 1] << 16) | ((UInt32) inBlock[i * 4 + 2] << 8) | inBlock[i * 4 + 3];
+
+	for(long i = 16; i < 64; i++) {
+		UInt32 s0 = RotateRight(w[i - 15], 7) ^ RotateRight(w[i - 15], 18) ^ (w[i - 15] >> 3);
+		UInt32 s1 = RotateRight(w[i - 2], 17) ^ RotateRight(w[i - 2], 19) ^ (w[i - 2] >> 10);
+
+		w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+	}
+
+	UInt32 a = ioState[0];
+	UInt32 b = ioState[1];
+	UInt32 c = ioState[2];
+	UInt32 d = ioState[3];
+	UInt32 e = ioState[4];
+	UInt32 f = ioState[5];
+	UInt32 g = ioState[6];
+	UInt32 h = ioState[7];
+
+	for(long i = 0; i < 64; i++) {
+		UInt32 t1 = h + (RotateRight(e, 6) ^ RotateRight(e, 11) ^ RotateRight(e, 25)) + ((e & f) ^ (~e & g)) + kSHA256Rounds[i] + w[i];
+		UInt32 t2 = (RotateRight(a, 2) ^ RotateRight(a, 13) ^ RotateRight(a, 22)) + ((a & b) ^ (a & c) ^ (b & c));
+
+		h = g;
+		g = f;
+		f = e;
+		e = d + t1;
+		d = c;
+		c = b;
+		b = a;
+		a = t1 + t2;
+	}
+
+	ioState[0] += a;
+	ioState[1] += b;
+	ioState[2] += c;
+	ioState[3] += d;
+	ioState[4] += e;
+	ioState[5] += f;
+	ioState[6] += g;
+	ioState[7] += h;
+}
+
+// SHA-256 of the whole file; a cache is only reused for the same bytes,
+// not for a file that merely hashes or measures the same
+OSErr
+CPDFPageCache::HashDocument(
+	const char* inPath,
+	UInt8* outDigest,
+	UInt64& outSize)
+{
+	CMappedFile file;
+
+	OSErr err = file.Open(inPath);
+	if(err != CPDFParser::kNoError)
+		return err;
+
+	const unsigned char* data = file.GetData();
+	size_t size = file.GetSize();
+
+	file.WillNeed(0, size);
+
+	UInt32 state[8] = {
+		0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19
+	};
+
+	size_t i = 0;
+
+	for(; i + 64 <= size; i += 64)
+		SHA256Block(state, &(data[i]));
+
+	// the tail, a 1 bit, zeros and the length in bits fill one block or two
+	unsigned char tail[128];
+	size_t tailSize = (size - i < 56 ? 64 : 128);
+
+	memset(tail, 0, sizeof(tail));
+	if(size > i)
+		memcpy(tail, &(data[i]), size - i);
+	tail[size - i] = 0x80;
+
+	UInt64 bits = (UInt64) size * 8;
+	for(long j = 0; j < 8; j++)
+		tail[tailSize - 1 - j] = (unsigned char) (bits >> (j * 8));
+
+	for(size_t j = 0; j < tailSize; j += 64)
+		SHA256Block(state, &(tail[j]));
+
+	for(long j = 0; j < 8; j++) {
+		outDigest[j * 4] = (UInt8) (state[j] >> 24);
+		outDigest[j * 4 + 1] = (UInt8) (state[j] >> 16);
+		outDigest[j * 4 + 2] = (UInt8) (state[j] >> 8);
+		outDigest[j * 4 + 3] = (UInt8) state[j];
+	}
+
+	outSize = size;
+
+	return CPDFParser::kNoError;
+}
+
+#pragma mark -
+
+OSErr
+CPDFPageCache::Create(
+	const char* inCachePath,
+	const char* inDocumentPath)
+{
+	Discard();
+	Close();
+
+	OSErr err = HashDocument(inDocumentPath, mDigest, mDocumentSize);
+	if(err != CPDFParser::kNoError)
+		return err;
+
+	err = mSink.Open(inCachePath);
+	if(err != CPDFParser::kNoError)
+		return err;
+
+	mWriting = true;
+	mOffset = 0;
+
+	mPageOffsets.clear();
+	mPageSizes.clear();
+
+	// a blank header until Finish()
+	CacheHeader header;
+	memset(&header, 0, sizeof(header));
+
+	err = WriteBlock(&header, sizeof(header));
+	if(err != CPDFParser::kNoError)
+		Discard();
+
+	return err;
+}
+
+unsigned char*
+CPDFPageCache::PackPage(
+	const PageInfo& inInfo,
+	const std::vector<CPDFParser::PDFRun*>& inRuns,
+	long& outSize)
+{
+	std::vector<CPDFParser::PDFRun*>::const_iterator i;
+	CPDFParser::PDFRun* run;
+
+	long size = sizeof(CachePage);
+
+	for(i = inRuns.begin(); i != inRuns.end(); i++) {
+		run = *i;
+
+		size += sizeof(CacheRun) + PadToWord(run->size);
+	}
+
+	unsigned char* data = (unsigned char*) calloc(1, size);
+	if(data == NULL) {
+		outSize = 0;
+		return NULL;
+	}
+
+	CachePage* page = (CachePage*) data;
+
+	page->error = inInfo.error;
+	page->runCount = inRuns.size();
+	page->width = inInfo.width;
+	page->height = inInfo.height;
+	page->cropWidth = inInfo.cropWidth;
+	page->cropHeight = inInfo.cropHeight;
+	page->crop = inInfo.crop;
+	page->rawPage = inInfo.rawPage;
+
+	long offset = sizeof(CachePage);
+
+	for(i = inRuns.begin(); i != inRuns.end(); i++) {
+		run = *i;
+
+		CacheRun* record = (CacheRun*) &(data[offset]);
+
+		record->x = run->x;
+		record->y = run->y;
+		record->f = run->f;
+		record->fs = run->fs;
+		record->l = run->l;
+		record->tc = run->tc;
+		record->tw = run->tw;
+		record->font = run->font;
+		record->size = run->size;
+
+		offset += sizeof(CacheRun);
+
+		memcpy(&(data[offset]), run->text, run->size);
+		offset += PadToWord(run->size);
+	}
+
+	outSize = size;
+
+	return data;
+}
+
+OSErr
+CPDFPageCache::WritePage(
+	size_t inPage,
+	const unsigned char* inData,
+	long inSize)
+{
+	if(mWriting == false)
+		return CPDFParser::kFileWriteError;
+
+	if(inData == NULL || inPage < 1) {
+		Discard();
+		return CPDFParser::kMemoryError;
+	}
+
+	if(mPageOffsets.size() < inPage) {
+		mPageOffsets.resize(inPage, 0);
+		mPageSizes.resize(inPage, 0);
+	}
+
+	mPageOffsets[inPage - 1] = mOffset;
+	mPageSizes[inPage - 1] = inSize;
+
+	OSErr err = WriteBlock(inData, inSize);
+	if(err != CPDFParser::kNoError)
+		Discard();
+
+	return err;
+}
+
+OSErr
+CPDFPageCache::Finish(
+	size_t inPageCount,
+	const std::vector<CPDFParser::PDFFontObject*>& inFonts)
+{
+	if(mWriting == false)
+		return CPDFParser::kFileWriteError;
+
+	// every page has to be there
+	bool complete = (inPageCount > 0 && mPageOffsets.size() == inPageCount);
+
+	for(size_t i = 0; complete && i < inPageCount; i++) {
+		if(mPageOffsets[i] == 0)
+			complete = false;
+	}
+
+	if(complete == false) {
+		Discard();
+		return CPDFParser::kConvertError;
+	}
+
+	OSErr err = CPDFParser::kNoError;
+
+	UInt64 fontTable = mOffset;
+
+	std::vector<CPDFParser::PDFFontObject*>::const_iterator i;
+	CPDFParser::PDFFontObject* f;
+
+	for(i = inFonts.begin(); i != inFonts.end() && err == CPDFParser::kNoError; i++) {
+		f = *i;
+
+		CacheFont font;
+		memset(&font, 0, sizeof(font));
+
+		font.encoding = (f->encoder ? f->encoder->encoding : CPDFParser::kEncodeMacRoman);
+		font.keySize = strlen(f->key) + 1;
+		font.nameSize = strlen(f->name) + 1;
+		font.fi = f->fi;
+		font.fl = f->fl;
+		font.mapInPlace = f->mapInPlace;
+
+		long strings = font.keySize + font.nameSize;
+
+		font.size = sizeof(CacheFont) + PadToWord(strings);
+
+		if(f->map) {
+			font.tables |= kCacheMap;
+			font.size += kCacheTableSize;
+		}
+
+		if(f->umap) {
+			font.tables |= kCacheUMap;
+			font.size += kCacheTableSize * sizeof(wchar_t);
+		}
+
+		if(f->widths) {
+			font.tables |= kCacheWidths;
+			font.size += kCacheTableSize * sizeof(float);
+		}
+
+		static const char zeros[4] = { 0, 0, 0, 0 };
+
+		err = WriteBlock(&font, sizeof(font));
+
+		if(err == CPDFParser::kNoError)
+			err = WriteBlock(f->key, font.keySize);
+
+		if(err == CPDFParser::kNoError)
+			err = WriteBlock(f->name, font.nameSize);
+
+		if(err == CPDFParser::kNoError)
+			err = WriteBlock(zeros, PadToWord(strings) - strings);
+
+		if(err == CPDFParser::kNoError && f->map)
+			err = WriteBlock(f->map, kCacheTableSize);
+
+		if(err == CPDFParser::kNoError && f->umap)
+			err = WriteBlock(f->umap, kCacheTableSize * sizeof(wchar_t));
+
+		if(err == CPDFParser::kNoError && f->widths)
+			err = WriteBlock(f->widths, kCacheTableSize * sizeof(float));
+	}
+
+	if(err == CPDFParser::kNoError)
+		err = Align();
+
+	UInt64 pageTable = mOffset;
+
+	for(size_t j = 0; j < inPageCount && err == CPDFParser::kNoError; j++) {
+		UInt64 entry[2] = { mPageOffsets[j], mPageSizes[j] };
+
+		err = WriteBlock(entry, sizeof(entry));
+	}
+
+	if(err == CPDFParser::kNoError)
+		err = mSink.Flush();
+
+	if(err == CPDFParser::kNoError) {
+		CacheHeader header;
+		memset(&header, 0, sizeof(header));
+
+		memcpy(header.magic, kCacheMagic, sizeof(header.magic));
+		header.version = kPageCacheVersion;
+		header.byteOrder = kCacheByteOrder;
+		header.wideSize = sizeof(wchar_t);
+		memcpy(header.digest, mDigest, sizeof(header.digest));
+		header.documentSize = mDocumentSize;
+		header.pageTable = pageTable;
+		header.fontTable = fontTable;
+		header.pageCount = inPageCount;
+		header.fontCount = inFonts.size();
+
+		if(pwrite(mSink.GetDescriptor(), &header, sizeof(header), 0) != sizeof(header))
+			err = CPDFParser::kFileWriteError;
+	}
+
+	if(err == CPDFParser::kNoError)
+		err = mSink.Close();
+
+	if(err != CPDFParser::kNoError) {
+		Discard();
+		return err;
+	}
+
+	mWriting = false;
+
+	mPageOffsets.clear();
+	mPageSizes.clear();
+
+	return CPDFParser::kNoError;
+}
+
+void
+CPDFPageCache::Discard()
+{
+	if(mWriting) {
+		mSink.Discard();
+		mWriting = false;
+	}
+
+	mPageOffsets.clear();
+	mPageSizes.clear();
+}
+
+OSErr
+CPDFPageCache::WriteBlock(
+	const void* inData,
+	long inSize)
+{
+	OSErr err = mSink.Write(inData, inSize);
+
+	if(err == CPDFParser::kNoError)
+		mOffset += inSize;
+
+	return err;
+}
+
+// the page table is read as 64 bit words
+OSErr
+CPDFPageCache::Align()
+{
+	static const char zeros[8] = { 0, 0, 0, 0, 0, 0, 0, 0 };
+
+	long pad = (8 - (long) (mOffset % 8)) % 8;
+
+	return WriteBlock(zeros, pad);
+}
+
+#pragma mark -
+
+OSErr
+CPDFPageCache::Open(
+	const char* inCachePath,
+	const char* inDocumentPath)
+{
+	Discard();
+	Close();
+
+	UInt8 digest[kDocumentDigestSize];
+	UInt64 documentSize;
+
+	OSErr err = HashDocument(inDocumentPath, digest, documentSize);
+	if(err != CPDFParser::kNoError)
+		return err;
+
+	err = mFile.Open(inCachePath);
+	if(err != CPDFParser::kNoError)
+		return err;
+
+	const unsigned char* data = mFile.GetData();
+	UInt64 size = mFile.GetSize();
+
+	const CacheHeader* header = (const CacheHeader*) data;
+
+	if(size < sizeof(CacheHeader) || memcmp(header->magic, kCacheMagic, sizeof(header->magic)) != 0)
+		err = CPDFParser::kFormatError;
+	else if(
+		header->version != kPageCacheVersion ||
+		header->byteOrder != kCacheByteOrder ||
+		header->wideSize != sizeof(wchar_t)
+	)
+		err = CPDFParser::kVersionError;
+	else if(memcmp(header->digest, digest, sizeof(digest)) != 0 || header->documentSize != documentSize)
+		err = CPDFParser::kFormatError;
+	else if(
+		header->pageCount == 0 ||
+		header->pageTable % 8 ||
+		header->pageTable > size ||
+		(size - header->pageTable) / (2 * sizeof(UInt64)) < header->pageCount
+	)
+		err = CPDFParser::kFormatError;
+
+	if(err != CPDFParser::kNoError) {
+		Close();
+		return err;
+	}
+
+	// check everything up front, reading pages then needs no bounds checks
+	// beyond the runs themselves
+	const UInt64* pageTable = (const UInt64*) &(data[header->pageTable]);
+
+	for(UInt32 i = 0; i < header->pageCount && err == CPDFParser::kNoError; i++) {
+		UInt64 offset = pageTable[i * 2];
+		UInt64 pageSize = pageTable[i * 2 + 1];
+
+		if(offset % 4 || offset > size || pageSize < sizeof(CachePage) || pageSize > size - offset)
+			err = CPDFParser::kFormatError;
+	}
+
+	UInt64 offset = header->fontTable;
+
+	for(UInt32 i = 0; i < header->fontCount && err == CPDFParser::kNoError; i++) {
+		if(offset % 4 || offset > size || size - offset < sizeof(CacheFont)) {
+			err = CPDFParser::kFormatError;
+			break;
+		}
+
+		const CacheFont* font = (const CacheFont*) &(data[offset]);
+
+		UInt64 tables = 0;
+
+		if(font->tables & kCacheMap)
+			tables += kCacheTableSize;
+
+		if(font->tables & kCacheUMap)
+			tables += kCacheTableSize * sizeof(wchar_t);
+
+		if(font->tables & kCacheWidths)
+			tables += kCacheTableSize * sizeof(float);
+
+		UInt64 strings = (UInt64) font->keySize + font->nameSize;
+		const char* key = (const char*) (font + 1);
+
+		if(
+			font->keySize == 0 ||
+			font->nameSize == 0 ||
+			font->size != sizeof(CacheFont) + PadToWord(strings) + tables ||
+			font->size > size - offset ||
+			key[font->keySize - 1] != 0 ||
+			key[strings - 1] != 0
+		)
+			err = CPDFParser::kFormatError;
+		else {
+			mFonts.push_back(font);
+			offset += font->size;
+		}
+	}
+
+	if(err != CPDFParser::kNoError) {
+		Close();
+		return err;
+	}
+
+	mPageCount = header->pageCount;
+	mPageTable = pageTable;
+
+	return CPDFParser::kNoError;
+}
+
+void
+CPDFPageCache::Close()
+{
+	mFile.Close();
+
+	mPageCount = 0;
+	mPageTable = NULL;
+
+	mFonts.clear();
+}
+
+bool
+CPDFPageCache::GetFont(
+	long inIndex,
+	CPDFParser::PDFFontObject& outFont,
+	TextEncoding& outEncoding)
+{
+	if(inIndex < 0 || inIndex >= (long) mFonts.size())
+		return false;
+
+	const CacheFont* font = mFonts[inIndex];
+	const unsigned char* p = (const unsigned char*) (font + 1);
+
+	memset(&outFont, 0, sizeof(outFont));
+
+	outFont.index = inIndex;
+	outFont.key = (char*) p;
+	outFont.name = (char*) &(p[font->keySize]);
+	outFont.baseFont = outFont.name;
+
+	p += PadToWord(font->keySize + font->nameSize);
+
+	if(font->tables & kCacheMap) {
+		outFont.map = (char*) p;
+		p += kCacheTableSize;
+	}
+
+	if(font->tables & kCacheUMap) {
+		outFont.umap = (wchar_t*) p;
+		p += kCacheTableSize * sizeof(wchar_t);
+	}
+
+	if(font->tables & kCacheWidths)
+		outFont.widths = (float*) p;
+
+	outFont.fi = font->fi;
+	outFont.fl = font->fl;
+	outFont.mapInPlace = font->mapInPlace;
+	outFont.borrowed = true;
+
+	outEncoding = font->encoding;
+
+	return true;
+}
+
+OSErr
+CPDFPageCache::GetPage(
+	size_t inPage,
+	PageInfo& outInfo,
+	RunCursor& outCursor)
+{
+	if(inPage < 1 || inPage > mPageCount)
+		return CPDFParser::kBadPageError;
+
+	const unsigned char* data = mFile.GetData();
+
+	UInt64 offset = mPageTable[(inPage - 1) * 2];
+	UInt64 size = mPageTable[(inPage - 1) * 2 + 1];
+
+	const CachePage* page = (const CachePage*) &(data[offset]);
+
+	outInfo.error = page->error;
+	outInfo.width = page->width;
+	outInfo.height = page->height;
+	outInfo.crop = page->crop;
+	outInfo.cropWidth = page->cropWidth;
+	outInfo.cropHeight = page->cropHeight;
+	outInfo.rawPage = page->rawPage;
+
+	outCursor.next = (const unsigned char*) (page + 1);
+	outCursor.end = &(data[offset + size]);
+	outCursor.remaining = page->runCount;
+
+	return CPDFParser::kNoError;
+}
+
+bool
+CPDFPageCache::NextRun(
+	RunCursor& ioCursor,
+	CPDFParser::PDFRun& outRun)
+{
+	if(ioCursor.remaining <= 0 || ioCursor.end - ioCursor.next < (long) sizeof(CacheRun))
+		return false;
+
+	const CacheRun* run = (const CacheRun*) ioCursor.next;
+	const unsigned char* text = (const unsigned char*) (run + 1);
+
+	if(PadToWord(run->size) > ioCursor.end - text)
+		return false;
+
+	outRun.text = (unsigned char*) text;
+	outRun.size = run->size;
+
+	outRun.x = run->x;
+	outRun.y = run->y;
+	outRun.f = run->f;
+	outRun.fs = run->fs;
+	outRun.l = run->l;
+	outRun.tc = run->tc;
+	outRun.tw = run->tw;
+
+	outRun.font = run->font;
+
+	ioCursor.next = text + PadToWord(run->size);
+	ioCursor.remaining--;
+
+	return true;
+}
+
+#pragma mark -
+
+CCachedPDFParser::CCachedPDFParser(
+	CPDFPageCache* inCache) :
+		mCache(inCache),
+		mCachedRawPage(false)
+{
+	memset(&mCursor, 0, sizeof(mCursor));
+}
+
+CCachedPDFParser::~CCachedPDFParser()
+{
+}
+
+OSErr
+CCachedPDFParser::Convert(
+	long inType,
+	COutputSink* inSink,
+	const char* inTitle)
+{
+	// xml and plist are built from the document itself
+	if(inType == kWritePropertyList || inType == kWriteXML)
+		return kConvertError;
+
+	if(inSink == NULL)
+		return kFileWriteError;
+
+	if(mCache == NULL || mCache->GetPageCount() == 0)
+		return kConvertError;
+
+	SetOutputType(inType);
+	SetPageCount(mCache->GetPageCount());
+
+	ReportProgress(-1, 0);
+
+	OSErr error = ConvertDocument(inSink, inTitle);
+
+	ReportProgress(GetMaxProgress(), GetMaxProgress());
+
+	return error;
+}
+
+OSErr
+CCachedPDFParser::BeginRender(
+	size_t inPage,
+	float* outWidth,
+	float* outHeight)
+{
+	CPDFPageCache::PageInfo info;
+
+	OSErr error = mCache->GetPage(inPage, info, mCursor);
+
+	if(error == kNoError)
+		error = info.error;
+
+	if(error != kNoError)
+		return error;
+
+	*outWidth = info.width;
+	*outHeight = info.height;
+
+	mCrop = info.crop;
+	mCropWidth = info.cropWidth;
+	mCropHeight = info.cropHeight;
+
+	mCachedRawPage = info.rawPage;
+
+	return kNoError;
+}
+
+void
+CCachedPDFParser::Render()
+{
+	SetRawPage(mCachedRawPage);
+
+	PDFRun run;
+
+	while(CPDFPageCache::NextRun(mCursor, run)) {
+		if(DidAbort())
+			break;
+
+		ShowRun(&run);
+	}
+}
+
+void
+CCachedPDFParser::EndRender()
+{
+	memset(&mCursor, 0, sizeof(mCursor));
+}
+
+void
+CCachedPDFParser::BeginDocument()
+{
+	long count = mCache->GetFontCount();
+
+	for(long i = 0; i < count; i++) {
+		PDFFontObject font;
+		TextEncoding encoding;
+
+		if(mCache->GetFont(i, font, encoding))
+			CopyFont(&font, encoding);
+	}
+}
+
+CPDFParser*
+CCachedPDFParser::CreatePageWorker()
+{
+	return new CCachedPDFParser(mCache);
+}
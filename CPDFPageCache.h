@@ -0,0 +1,173 @@
+// Trapeze
+//
+// Copyright (c) 2004 Mesa Dynamics, LLC.  All rights reserved.
+
+#ifndef _H_CPDFPageCache
+#define _H_CPDFPageCache
+#pragma once
+
+#include "CPDFParser.h"
+#include "CMappedFile.h"
+#include "COutputSink.h"
+
+#include <vector>
+
+const UInt32	kPageCacheVersion	= 2;
+const long		kDocumentDigestSize	= 32;
+
+// Parsed pages kept on disk: every page's runs and the font table, keyed
+// by a SHA-256 of the PDF's bytes.  Converting the same document again, with
+// other options or to another type, lays the pages out from the cache
+// instead of parsing them; see CCachedPDFParser.  The file is read in place
+// through a mapping and is only good on the kind of machine that wrote it.
+class CPDFPageCache {
+public:
+	struct PageInfo {
+		OSErr error;
+		float width;
+		float height;
+		bool crop;
+		float cropWidth;
+		float cropHeight;
+		bool rawPage;
+	};
+
+	// a page's runs, read in order with NextRun()
+	struct RunCursor {
+		const unsigned char* next;
+		const unsigned char* end;
+		long remaining;
+	};
+
+public:
+	CPDFPageCache();
+	~CPDFPageCache();
+
+	static OSErr HashDocument(
+		const char* inPath,
+		UInt8* outDigest,
+		UInt64& outSize);
+
+	// writing; a parser given the cache with SetPageCache() adds the pages
+	// and finishes it, or discards it if the conversion stopped short
+	OSErr Create(
+		const char* inCachePath,
+		const char* inDocumentPath);
+
+	bool IsWriting() {
+		return mWriting;
+	}
+
+	// a page's record, malloc'd; NULL if out of memory
+	static unsigned char* PackPage(
+		const PageInfo& inInfo,
+		const std::vector<CPDFParser::PDFRun*>& inRuns,
+		long& outSize);
+
+	OSErr WritePage(
+		size_t inPage,
+		const unsigned char* inData,
+		long inSize);
+
+	OSErr Finish(
+		size_t inPageCount,
+		const std::vector<CPDFParser::PDFFontObject*>& inFonts);
+
+	void Discard();
+
+	// reading; kFormatError for a cache of another document or a damaged
+	// one, kVersionError for one written by another version
+	OSErr Open(
+		const char* inCachePath,
+		const char* inDocumentPath);
+
+	void Close();
+
+	size_t GetPageCount() {
+		return mPageCount;
+	}
+
+	long GetFontCount() {
+		return mFonts.size();
+	}
+
+	// the font's strings and tables point into the cache
+	bool GetFont(
+		long inIndex,
+		CPDFParser::PDFFontObject& outFont,
+		TextEncoding& outEncoding);
+
+	OSErr GetPage(
+		size_t inPage,
+		PageInfo& outInfo,
+		RunCursor& outCursor);
+
+	// the run's text points into the cache
+	static bool NextRun(
+		RunCursor& ioCursor,
+		CPDFParser::PDFRun& outRun);
+
+protected:
+	struct CacheHeader;
+	struct CacheFont;
+
+	OSErr WriteBlock(
+		const void* inData,
+		long inSize);
+
+	OSErr Align();
+
+protected:
+	// writing
+	bool mWriting;
+	CFileSink mSink;
+	UInt64 mOffset;
+	UInt8 mDigest[kDocumentDigestSize];
+	UInt64 mDocumentSize;
+	std::vector<UInt64> mPageOffsets;
+	std::vector<UInt64> mPageSizes;
+
+	// reading
+	CMappedFile mFile;
+	size_t mPageCount;
+	const UInt64* mPageTable;
+	std::vector<const CacheFont*> mFonts;
+};
+
+// Converts from a page cache rather than a PDF.  Pages are laid out from
+// the cached runs with the type and options set now; the cache must stay
+// open until the conversion returns.
+class CCachedPDFParser : public CPDFParser {
+public:
+	CCachedPDFParser(
+		CPDFPageCache* inCache);
+
+	virtual ~CCachedPDFParser();
+
+	OSErr Convert(
+		long inType,
+		COutputSink* inSink,
+		const char* inTitle = NULL);
+
+protected:
+	// inherited
+	virtual OSErr BeginRender(
+		size_t inPage,
+		float* outWidth,
+		float* outHeight);
+
+	virtual void Render();
+
+	virtual void EndRender();
+
+	virtual void BeginDocument();
+
+	virtual CPDFParser* CreatePageWorker();
+
+protected:
+	CPDFPageCache* mCache;
+	CPDFPageCache::RunCursor mCursor;
+	bool mCachedRawPage;
+};
+
+#endif
@@ -3,19 +3,97 @@
 // Copyright (c) 2004 Mesa Dynamics, LLC.  All rights reserved.
 
 #include "CPDFParser.h"
+#include "COutputSink.h"
+#include "CPDFFontCache.h"
+#include "CPDFPageCache.h"
+#include "CPageQueue.h"
+#include "UPDFFormat.h"
+#include "UPDFMaps.h"
+#include "UPDFUnicode.h"
 
 #include <ctype.h>
+#include <pthread.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/time.h>
 
 #include <algorithm>
 
 //#define SHOWCOORDS
 
+// the page budget that ran out first
+enum {
+	kWithinBudget = 0,
+	kOverOperations,
+	kOverTextObjects,
+	kOverPageBytes,
+	kOverTime
+};
+
+// stands in for a page dropped by kDegradeSkipPage
+static const char kBudgetMarker[] = "[page skipped, over budget]";
+
+// Shared by the writer and the page workers, everything in it is guarded
+// by lock.
+struct CPDFParser::PDFRenderState {
+	struct Slot {
+		PDFPageOutput page;
+		
+		// grid this page leaves behind for the next one
+		long col;
+		long line;
+		
+		bool grid;
+		bool done;
+	};
+	
+	struct Worker {
+		PDFRenderState* state;
+		CPDFParser* parser;
+		pthread_t thread;
+	};
+
+	pthread_mutex_t lock;
+	pthread_cond_t changed;
+	
+	size_t first;		// page of slots[1]
+	size_t pages;
+	size_t next;		// last slot handed to a worker
+	size_t written;		// last slot emitted
+	size_t window;		// how far workers may run ahead of the writer
+	bool stop;
+	
+	// one per page, slots[0] holds the grid the range starts with
+	Slot* slots;
+	
+	std::vector<Worker*> workers;
+};
+
+// One worker rendering every page in turn, feeding the writer through a
+// page queue.
+struct CPDFParser::PDFPipeline {
+	CPageQueue queue;
+	
+	CPDFParser* parser;
+	pthread_t thread;
+	
+	size_t first;
+	size_t last;
+	volatile long stop;
+};
+
 CPDFParser::CPDFParser() :
-		mAbort(false),
+		mAbort(0),
 		mRestrict(false),
+		mCancel(NULL),
+		mOwner(NULL),
+		mProgress(-1),
+		mMaxProgress(0),
+		mPhase(kPhaseIdle),
+		mBytesParsed(0),
+		mProgressProc(NULL),
+		mProgressRefCon(NULL),
 		mCol(0),
 		mLine(0),
 		mPadCols(true),
@@ -25,14 +103,24 @@ CPDFParser::CPDFParser() :
 		mRelaxSpacing(false),
 		mTightSpacing(false),
 		mSort(true),
+		mShowBreaks(false),
 		mNewlineCode(kNewlineUNIX),
+		mRenderThreads(0),
+		mStreaming(false),
+		mFirstPage(0),
+		mLastPage(0),
+		mBytesEmitted(0),
+		mPagesEmitted(0),
+		mPreviewDone(false),
 		mFontChanges(true),
 		mSizeChanges(true),
 		mStyleChanges(true),
 		mSuperSubChanges(true),
-		mTabTable(NULL),
 		mData(NULL),
 		mDataSize(0),
+		mFontCache(NULL),
+		mLazyFonts(false),
+		mJoinedFonts(0),
 		mPageWidth(0),
 		mPageHeight(0),
 		mPageLength(0),
@@ -43,13 +131,33 @@ CPDFParser::CPDFParser() :
 		mTopMargin(0),
 		mLeftMargin(0),
 		mParseIntoStore(false),
-		mParseBytes(0)
+		mRecordRuns(false),
+		mDeferLayout(false),
+		mPageCache(NULL),
+		mPageModel(NULL),
+		mPageModelSize(0),
+		mParseBytes(0),
+		mOverBudget(0),
+		mOperations(0),
+		mPageStart(0.0),
+		mRawPage(false),
+		mRawX(0.0),
+		mRawY(0.0),
+		mRawRuns(0),
+		mRawCapacity(0)
 {
+	memset(&mBudget, 0, sizeof(mBudget));
+	mBudget.degrade = kDegradeRawText;
+	
+	memset(&mBudgetStats, 0, sizeof(mBudgetStats));
+	
+	memset(&mPreview, 0, sizeof(mPreview));
 }
 
 CPDFParser::~CPDFParser()
 {
 	FreeTabs();
+	FreeRuns();
 
 	FreeFonts();
 	FreeXObjects();
@@ -59,70 +167,1705 @@ CPDFParser::~CPDFParser()
 		free(mData);
 		mData = NULL;
 	}
+	
+	if(mPageModel) {
+		free(mPageModel);
+		mPageModel = NULL;
+	}
 }
 
 #pragma mark -
 
+#define emit_(x, n)		(mBytesEmitted += (n), error = (error == kNoError ? inSink->Write(x, n) : error))
+
 OSErr
-CPDFParser::RenderPage(
-	size_t inPage)
+CPDFParser::ConvertDocument(
+	COutputSink* inSink,
+	const char* inTitle)
 {
-	float width = 0.0;
-	float height = 0.0;
+	if(inSink == NULL)
+		return kFileWriteError;
+		
+	OSErr error = kNoError;
+	long dataBytes = 0;
 	
-	mCrop = false;
-	mCropWidth = 0.0;
-	mCropHeight = 0.0;
+	UPDFAtomic::Store(&mBytesParsed, 0);
+	SetPhase(kPhaseOpening);
 	
-	OSErr error = BeginRender(inPage, &width, &height);
+	memset(&mBudgetStats, 0, sizeof(mBudgetStats));
 	
-	if(error != kNoError)
-		return error;
-
-	if(width < 72.0)
-		width = 72.0;
+	mBytesEmitted = 0;
+	mPagesEmitted = 0;
+	mPreviewDone = false;
+	
+	mRecordRuns = (mPageCache && mPageCache->IsWriting());
+	
+	// rtf lists every font in its header and recorded runs index the
+	// table; anything else can take fonts as pages use them
+	mLazyFonts = (IsRTFType(mType) == false && mRecordRuns == false);
+	
+	// extract the fonts in the document to build our font table
+	BeginDocument();
+	
+	std::vector<PDFPageSpan> spans;
+	bool header;
+	bool trailer;
+	size_t savePages;
+	
+	if(GetPageSpans(spans, header, trailer, savePages) == false)
+		error = kBadPageError;
 		
-	if(height < 72.0)
-		height = 72.0;
+	if(error == kNoError && header)
+		error = EmitHeader(inSink, inTitle);
 		
-	mPageWidth = lroundf(width);
-	mPageHeight = lroundf(height);
+	// the header goes out before the first page is parsed
+	if(error == kNoError && mStreaming)
+		error = inSink->Flush();
 	
-	mPageLength = 0;
-	mPageWeight = 0;
-	mPageWidths = 0;
-	mPageSpacing = 0;
+	ReportProgress(0, savePages);
+	
+	// render the document, one page at a time
+	for(size_t s = 0; s < spans.size(); s++) {
+		if(error != kNoError || DidAbort() || mPreviewDone)
+			break;
+			
+		error = ConvertPages(inSink, spans[s].first, spans[s].last, spans[s].pages, savePages, dataBytes);
+	}
+	
+	if(error == kNoError && trailer)
+		error = EmitTrailer(inSink);
+	
+	if(error == kNoError)
+		error = inSink->Flush();
+		
+	FinishPageCache(error == kNoError && mPreviewDone == false && IsWholeDocument(spans, header, trailer));
+	
+	// done with font table
+	FreeFonts();
+	
+	// done with xobjects
+	FreeXObjects();
+	
+	// done with encoders
+	FreeEncoders();
+	
+	if(error == kNoError) {
+		if(DidAbort())
+			error = kUserAbort;
+		else if(dataBytes == 0)
+			error = kNoTextError;
+	}
+	
+	SetPhase(kPhaseDone);
+	
+	return error;
+}
 
-	// set only at beginning of page (removed from InitMetrics())
-	mF = 1.0;
-	mFS = 1.0;
+// Parses each page once and lays it out once per output.  The parse is kept
+// as runs of text with the state they were shown in; every output has a
+// parser of its own that replays them with its own type, font names and
+// encoders, just as if it had parsed the page itself.
+OSErr
+CPDFParser::ConvertOutputs(
+	PDFOutput* ioOutputs,
+	long inCount,
+	const char* inTitle)
+{
+	if(ioOutputs == NULL || inCount < 1)
+		return kConvertError;
+		
+	std::vector<CPDFParser*> emitters;
+	std::vector<long> dataBytes(inCount, 0);
+	
+	OSErr error = kNoError;
+	long i;
+	
+	// the parse runs as plain text; the caller's type comes back after
+	long saveType = mType;
+	
+	for(i = 0; i < inCount; i++) {
+		ioOutputs[i].error = (ioOutputs[i].sink ? kNoError : kFileWriteError);
+		
+		CPDFParser* emitter = CreatePageWorker();
+		if(emitter == NULL) {
+			error = kConvertError;
+			break;
+		}
+		
+		emitters.push_back(emitter);
+	}
+	
+	if(error == kNoError) {
+		UPDFAtomic::Store(&mBytesParsed, 0);
+		SetPhase(kPhaseOpening);
+		
+		memset(&mBudgetStats, 0, sizeof(mBudgetStats));
+		
+		mPagesEmitted = 0;
+		mPreviewDone = false;
+		
+		// parsed as plain text, which leaves the runs unescaped and the
+		// font names whole; the outputs escape and trim their own
+		mType = kWritePlainText;
+		mRecordRuns = true;
+		mDeferLayout = true;
+		mLazyFonts = false;
+		
+		BeginDocument();
+		
+		std::vector<PDFPageSpan> spans;
+		bool header;
+		bool trailer;
+		size_t savePages;
+		
+		bool span = GetPageSpans(spans, header, trailer, savePages);
+		
+		for(i = 0; i < inCount; i++) {
+			PDFOutput& output = ioOutputs[i];
+			
+			emitters[i]->JoinOutput(this, output.type);
+			
+			if(span == false)
+				output.error = kBadPageError;
+			else if(output.error == kNoError && header)
+				output.error = emitters[i]->EmitHeader(output.sink, inTitle);
+				
+			if(output.error == kNoError && mStreaming)
+				output.error = output.sink->Flush();
+		}
+		
+		ReportProgress(0, savePages);
+		
+		// outputs that have written the last page of their preview
+		std::vector<bool> ended(inCount, false);
+		
+		// set once no output is left taking pages, whether each ended its
+		// preview or failed
+		bool stopped = true;
+		
+		for(i = 0; i < inCount; i++) {
+			if(ioOutputs[i].error == kNoError)
+				stopped = false;
+		}
+		
+		for(size_t s = 0; s < spans.size() && DidAbort() == false && stopped == false; s++) {
+			size_t pages = spans[s].pages;
+			
+			for(size_t page = spans[s].first; page <= spans[s].last; page++) {
+				if(DidAbort())
+					break;
+					
+				float width = 0.0;
+				float height = 0.0;
+				
+				OSErr pageError = ParsePage(page, width, height);
+				
+				if(DidAbort()) {
+					FreeRuns();
+					break;
+				}
+				
+				if(mPageCache && mPageCache->IsWriting()) {
+					PackPage(pageError, width, height);
+					
+					mPageCache->WritePage(page, mPageModel, mPageModelSize);
+				}
+				
+				// each output keeps to its own preview; parsing stops when
+				// none is left taking pages
+				bool more = false;
+				
+				for(i = 0; i < inCount; i++) {
+					PDFOutput& output = ioOutputs[i];
+					
+					if(output.error != kNoError || ended[i])
+						continue;
+						
+					PDFPageOutput pageOutput;
+					
+					emitters[i]->ReplayPage(this, pageError, width, height);
+					emitters[i]->TakePageOutput(pageOutput);
+					
+					SetPhase(kPhaseWriting);
+					
+					ended[i] = EndsPreview(mPagesEmitted, dataBytes[i], emitters[i]->mBytesEmitted, pageOutput.dataSize);
+					
+					output.error = emitters[i]->EmitPage(output.sink, pageOutput, page, (ended[i] ? page : pages), savePages, dataBytes[i]);
+					
+					if(output.error == kNoError && mStreaming)
+						output.error = output.sink->Flush();
+						
+					if(output.error == kNoError && ended[i] == false)
+						more = true;
+				}
+				
+				mPagesEmitted++;
+				
+				FreeRuns();
+				
+				ReportProgress(page, savePages);
+				
+				DidRenderPage(page, pages);
+				
+				if(more == false) {
+					mPreviewDone = (std::find(ended.begin(), ended.end(), true) != ended.end());
+					stopped = true;
+					break;
+				}
+			}
+		}
+		
+		for(i = 0; i < inCount; i++) {
+			PDFOutput& output = ioOutputs[i];
+			
+			if(output.error == kNoError && trailer)
+				output.error = emitters[i]->EmitTrailer(output.sink);
+				
+			if(output.error == kNoError)
+				output.error = output.sink->Flush();
+				
+			if(output.error == kNoError) {
+				if(DidAbort())
+					output.error = kUserAbort;
+				else if(dataBytes[i] == 0)
+					output.error = kNoTextError;
+			}
+			
+			if(error == kNoError)
+				error = output.error;
+		}
+		
+		FinishPageCache(span && stopped == false && IsWholeDocument(spans, header, trailer));
+		
+		// done with font table
+		FreeFonts();
+		
+		// done with xobjects
+		FreeXObjects();
+		
+		// done with encoders
+		FreeEncoders();
+		
+		SetPhase(kPhaseDone);
+	}
+	
+	mType = saveType;
+	
+	for(i = 0; i < (long) emitters.size(); i++)
+		delete emitters[i];
+	
+	return error;
+}
 
-	mFont = NULL;
-	mAllWhitespace = false;
+// The runs of pages to convert, with whether the header and trailer go
+// with them; false when none of the pages asked for are in the document.
+bool
+CPDFParser::GetPageSpans(
+	std::vector<PDFPageSpan>& outSpans,
+	bool& outHeader,
+	bool& outTrailer,
+	size_t& outSavePages)
+{
+	size_t pages = GetPageCount();
+	outSavePages = pages;
+	
+	if(IsRestricted() && pages > 3)
+		pages = 3;
+		
+	outSpans.clear();
+	
+	PDFPageSpan span;
+	
+	if(mPageRanges.empty()) {
+		// a range is a slice of the whole document, framed just as it would
+		// be there: the header comes with the first page, the trailer with the last
+		span.first = 1;
+		span.last = pages;
+		span.pages = pages;
+		
+		if(mFirstPage) {
+			span.first = mFirstPage;
+			
+			if(mLastPage && mLastPage < span.last)
+				span.last = mLastPage;
+				
+			if(span.first > span.last)
+				return false;
+		}
+		
+		outHeader = (span.first == 1);
+		outTrailer = (span.last == pages);
+		
+		outSpans.push_back(span);
+		
+		return true;
+	}
+	
+	// a list is a document of its own, with a break after every page but
+	// its last; ranges past the end are dropped, ones running over it cut
+	std::vector<PDFPageRange>::const_iterator i = mPageRanges.begin();
+	
+	for(i = mPageRanges.begin(); i != mPageRanges.end(); i++) {
+		span.first = (i->first ? i->first : 1);
+		span.last = (i->last && i->last < pages ? i->last : pages);
+		span.pages = span.last + 1;
+		
+		if(span.first <= span.last)
+			outSpans.push_back(span);
+	}
+	
+	if(outSpans.empty())
+		return false;
+		
+	outSpans.back().pages = outSpans.back().last;
+	
+	outHeader = true;
+	outTrailer = true;
+	
+	return true;
+}
 
-	mQDepth = 0;
+bool
+CPDFParser::IsWholeDocument(
+	const std::vector<PDFPageSpan>& inSpans,
+	bool inHeader,
+	bool inTrailer)
+{
+	return (
+		inHeader && inTrailer &&
+		inSpans.size() == 1 &&
+		inSpans[0].first == 1 && inSpans[0].last == GetPageCount()
+	);
+}
 
-	for(long i = 0; i < kMaxQDepth; i++) {
-		mSaveScale[i] = 1.0;
-		mSaveDeltaX[i] = 0.0;
-		mSaveDeltaY[i] = 0.0;
+bool
+CPDFParser::GetSelectedPages(
+	std::vector<size_t>& outPages)
+{
+	outPages.clear();
+	
+	if(mPageRanges.empty())
+		return false;
+		
+	std::vector<PDFPageSpan> spans;
+	bool header;
+	bool trailer;
+	size_t savePages;
+	
+	if(GetPageSpans(spans, header, trailer, savePages)) {
+		for(size_t s = 0; s < spans.size(); s++) {
+			for(size_t page = spans[s].first; page <= spans[s].last; page++)
+				outPages.push_back(page);
+		}
 	}
+	
+	return true;
+}
+
+OSErr
+CPDFParser::EmitHeader(
+	COutputSink* inSink,
+	const char* inTitle)
+{
+	OSErr error = kNoError;
+	
+	long fontCount = GetFontCount();
+	
+	unsigned char entry[512];
+	long bytes;
+	
+	if(IsRTFType(mType)) {
+		bytes = UPDFFormat::AppendString(entry, "{\\rtf1\\mac\\ansicpg10000\n");
+	
+		if(GetPadStripping() == false)
+			bytes += UPDFFormat::AppendString(&(entry[bytes]), "\\viewkind1\\viewscale100\\viewzk2\n");
+	
+		if(fontCount)
+			bytes += UPDFFormat::AppendString(&(entry[bytes]), "{\\fonttbl");
+	
+		emit_(entry, bytes);
+	
+		if(fontCount) {
+			for(long i = 0; i < fontCount; i++) {
+				PDFFontObject* f = GetFont(i);
+				const char* family = (f->family == NULL ? "nil" : f->family);
+			
+				emit_(f->tag, f->tagSize);
+				emit_("\\f", 2);
+				emit_(family, strlen(family));
+				emit_("\\fcharset77 ", 12);
+				emit_(f->baseFont, f->faceSize);
+				emit_(";", 1);
+			}
 		
-	mScale = 1.0;
-	mDeltaX = 0.0;
-	mDeltaY = 0.0;
+			bytes = UPDFFormat::AppendLiteral(entry, "\\f", 2);
+			bytes += UPDFFormat::AppendDecimal(&(entry[bytes]), fontCount);
+			bytes += UPDFFormat::AppendString(&(entry[bytes]), "\\fmodern\\fcharset77 Courier;}");
+			emit_(entry, bytes);
+		}
+		
+		if(inTitle) {
+			emit_("\n{\\info{\\title ", 15);
+		
+			if(error == kNoError)
+				error = EmitTitle(inSink, inTitle);
+		
+			emit_("}}", 2);
+		}
+	}
+	else if(mType == kWriteHTML) {
+		const char* title = (inTitle ? inTitle : "Untitled");
 	
-	InitChunker();
-	InitMetrics();
+		const UPDFFormat::Fragment& head = UPDFFormat::GetFragment(mNewlineCode, UPDFFormat::kFragmentHTMLHead);
+		emit_(head.text, head.size);
+	
+		if(error == kNoError)
+			error = EmitTitle(inSink, title);
+	
+		const UPDFFormat::Fragment& titleEnd = UPDFFormat::GetFragment(mNewlineCode, UPDFFormat::kFragmentHTMLTitleEnd);
+		emit_(titleEnd.text, titleEnd.size);
+	}
+	
+	return error;
+}
+
+// the title comes from a file name, already in the output's encoding, and
+// may hold anything the markup would take for its own
+OSErr
+CPDFParser::EmitTitle(
+	COutputSink* inSink,
+	const char* inTitle)
+{
+	OSErr error = kNoError;
+	
+	unsigned char entry[256];
+	long bytes = 0;
+	
+	for(const char* c = inTitle; *c && error == kNoError; c++) {
+		if(IsRTFType(mType)) {
+			if(*c == '\\' || *c == '{' || *c == '}')
+				entry[bytes++] = '\\';
+				
+			entry[bytes++] = *c;
+		}
+		else if(*c == '&')
+			bytes += UPDFFormat::AppendLiteral(&(entry[bytes]), "&amp;", 5);
+		else if(*c == '<')
+			bytes += UPDFFormat::AppendLiteral(&(entry[bytes]), "&lt;", 4);
+		else if(*c == '>')
+			bytes += UPDFFormat::AppendLiteral(&(entry[bytes]), "&gt;", 4);
+		else
+			entry[bytes++] = *c;
 		
-	// subclasses should make calls to Parse() here
-	Render();
+		// room for the longest entity
+		if(bytes > (long) sizeof(entry) - 8) {
+			emit_(entry, bytes);
+			bytes = 0;
+		}
+	}
 	
-	// only necessary if the PDF is malformed or a memory error resulted in an
-	// unprocessed chunk of text
-	CloseChunker();
+	if(bytes)
+		emit_(entry, bytes);
+	
+	return error;
+}
+
+OSErr
+CPDFParser::EmitTrailer(
+	COutputSink* inSink)
+{
+	OSErr error = kNoError;
+	
+	if(IsRTFType(mType))
+		emit_("\n}\n", 3);
+	else if(mType == kWriteHTML) {
+		const UPDFFormat::Fragment& footer = UPDFFormat::GetFragment(mNewlineCode, UPDFFormat::kFragmentHTMLEnd);
+		emit_(footer.text, footer.size);
+	}
+	
+	return error;
+}
+
+OSErr
+CPDFParser::ConvertPages(
+	COutputSink* inSink,
+	size_t inFirst,
+	size_t inLast,
+	size_t inPages,
+	size_t inSavePages,
+	long& ioDataBytes)
+{
+	OSErr error = kNoError;
+	
+	// both NULL when the pages are rendered here, in sequence
+	PDFRenderState* state = StartWorkers(inFirst, inLast);
+	PDFPipeline* pipeline = (state ? NULL : StartPipeline(inFirst, inLast));
+	
+	for(size_t i = inFirst; i <= inLast; i++) {
+		if(DidAbort() || error != kNoError)
+			break;
+			
+		PDFPageOutput page;
+		
+		if(state) {
+			PDFRenderState::Slot& slot = state->slots[i - inFirst + 1];
+			
+			pthread_mutex_lock(&(state->lock));
+			
+			while(slot.done == false)
+				pthread_cond_wait(&(state->changed), &(state->lock));
+				
+			pthread_mutex_unlock(&(state->lock));
+			
+			page = slot.page;
+			memset(&(slot.page), 0, sizeof(PDFPageOutput));
+			
+			// leave the grid where rendering in sequence would have
+			mCol = slot.col;
+			mLine = slot.line;
+		}
+		else if(pipeline) {
+			long spins = 0;
+			bool closed = false;
+			bool got;
+			
+			while((got = pipeline->queue.Pop(page)) == false) {
+				// a closed queue may still have taken a last page
+				if(closed)
+					break;
+					
+				closed = pipeline->queue.IsClosed();
+				
+				if(closed == false)
+					CPageQueue::Wait(spins);
+			}
+			
+			// the renderer stopped early, on an abort
+			if(got == false)
+				break;
+		}
+		else {
+			RenderPage(i);
+			TakePageOutput(page);
+		}
+		
+		// a page cut short by a cancel is not written
+		if(DidAbort()) {
+			if(page.data)
+				free(page.data);
+				
+			if(page.tabs)
+				free(page.tabs);
+				
+			if(page.model)
+				free(page.model);
+				
+			break;
+		}
+		
+		ReportProgress(i, inSavePages);
 		
-	// setup environment	
+		DidRenderPage(i, inPages);
+		
+		SetPhase(kPhaseWriting);
+		
+		// a preview's last page is written as the document's last
+		bool last = EndsPreview(mPagesEmitted, ioDataBytes, mBytesEmitted, page.dataSize);
+		
+		error = EmitPage(inSink, page, i, (last ? i : inPages), inSavePages, ioDataBytes);
+		mPagesEmitted++;
+		
+		if(error == kNoError && mStreaming)
+			error = inSink->Flush();
+		
+		// pages reach the cache in order, whichever thread parsed them
+		if(page.model) {
+			if(error == kNoError && mPageCache && mPageCache->IsWriting())
+				mPageCache->WritePage(i, page.model, page.modelSize);
+				
+			free(page.model);
+		}
+		
+		if(state) {
+			pthread_mutex_lock(&(state->lock));
+			
+			state->written = i - inFirst + 1;
+			
+			pthread_cond_broadcast(&(state->changed));
+			pthread_mutex_unlock(&(state->lock));
+		}
+		
+		// the pages still rendering are dropped with the workers
+		if(last) {
+			mPreviewDone = true;
+			break;
+		}
+	}
+	
+	if(state)
+		StopWorkers(state);
+		
+	if(pipeline)
+		StopPipeline(pipeline);
+	
+	return error;
+}
+
+// Whether the page about to be written, inPageBytes of text, is the last
+// one the preview takes, given what has been written so far.
+bool
+CPDFParser::EndsPreview(
+	long inPages,
+	long inDataBytes,
+	long inBytes,
+	long inPageBytes)
+{
+	if(mPreview.maxPages && inPages + 1 >= mPreview.maxPages)
+		return true;
+		
+	if(mPreview.maxChars && inDataBytes + inPageBytes >= mPreview.maxChars)
+		return true;
+		
+	if(mPreview.maxBytes && inBytes + inPageBytes >= mPreview.maxBytes)
+		return true;
+		
+	return false;
+}
+
+OSErr
+CPDFParser::EmitPage(
+	COutputSink* inSink,
+	PDFPageOutput& inPage,
+	size_t inPageIndex,
+	size_t inPages,
+	size_t inSavePages,
+	long& ioDataBytes)
+{
+	OSErr error = kNoError;
+	long fontCount = GetFontCount();
+	
+	unsigned char entry[512];
+	long bytes;
+	
+	if(IsRTFType(mType)) {
+		bytes = UPDFFormat::AppendLiteral(entry, "\\plain\\pard\\li0\\sl", 18);
+		bytes += UPDFFormat::AppendDecimal(&(entry[bytes]), lroundf(12.0 * 20.0 * kRTFSpacing));
+		entry[bytes++] = '\n';
+		
+		emit_(entry, bytes);
+	}
+	else if(mType == kWriteHTML) {
+		bytes = UPDFFormat::AppendFragment(entry, mNewlineCode, UPDFFormat::kFragmentAnchorStart);
+		bytes += UPDFFormat::AppendDecimal(&(entry[bytes]), inPageIndex);
+		bytes += UPDFFormat::AppendFragment(&(entry[bytes]), mNewlineCode, UPDFFormat::kFragmentAnchorEnd);
+			
+		emit_(entry, bytes);
+	}
+				
+	if(mType == kWriteRTFWord) {
+		if(GetPadStripping() == false) {
+			long leftMargin = inPage.leftMargin;
+			if(leftMargin) {
+				bytes = UPDFFormat::AppendLiteral(entry, "\\marglsxn", 9);
+				bytes += UPDFFormat::AppendDecimal(&(entry[bytes]), 20 * leftMargin);
+				bytes += UPDFFormat::AppendLiteral(&(entry[bytes]), "\\margrsxn0\n", 11);
+					
+				emit_(entry, bytes);
+			}
+			
+			long topMargin = inPage.topMargin;
+			if(topMargin) {
+				bytes = UPDFFormat::AppendLiteral(entry, "\\margtsxn", 9);
+				bytes += UPDFFormat::AppendDecimal(&(entry[bytes]), 20 * topMargin);
+				bytes += UPDFFormat::AppendLiteral(&(entry[bytes]), "\\margbsxn0\n", 11);
+					
+				emit_(entry, bytes);
+			}
+		}
+		else
+			emit_("\\margl0\\margr0\\margt0\\margb0\n", 29);
+		
+		// A4 Paper Size: \pgwsxn11899\pghsxn16838
+		
+		long pageWidth = inPage.pageWidth;
+		long pageHeight = inPage.pageHeight;
+		if(pageWidth && pageHeight) {
+			bytes = UPDFFormat::AppendLiteral(entry, "\\pgwsxn", 7);
+			bytes += UPDFFormat::AppendDecimal(&(entry[bytes]), 20 * pageWidth);
+			bytes += UPDFFormat::AppendLiteral(&(entry[bytes]), "\\pghsxn", 7);
+			bytes += UPDFFormat::AppendDecimal(&(entry[bytes]), 20 * pageHeight);
+			entry[bytes++] = '\n';
+				
+			emit_(entry, bytes);
+		}
+	}
+	else if(mType == kWriteRTF && GetPadStripping() == false)
+		emit_("\\margl0\\margr0\\margt0\\margb0\n", 29);
+	else if(mType == kWriteHTML) {
+		if(GetPadStripping() == false) {
+			long leftMargin = inPage.leftMargin;
+			if(leftMargin) {
+				bytes = UPDFFormat::AppendFragment(entry, mNewlineCode, UPDFFormat::kFragmentBlockquoteStart);
+				bytes += UPDFFormat::AppendDecimal(&(entry[bytes]), leftMargin);
+				bytes += UPDFFormat::AppendFragment(&(entry[bytes]), mNewlineCode, UPDFFormat::kFragmentBlockquoteEnd);
+					
+				emit_(entry, bytes);
+			}
+		}
+	}
+
+	if(IsRTFType(mType)) {
+		char* tabs = inPage.tabs;
+		
+		if(tabs) {
+			bytes = strlen(tabs);
+			tabs[bytes++] = '\n';
+			
+			emit_(tabs, bytes);
+		}
+	}
+	else if(inPageIndex == inPages && GetPadStripping() == false) {
+		// todo: should probably take newline encoding into account here
+		
+		while(inPage.dataSize > 1 && inPage.data[inPage.dataSize - 1] == '\n' && inPage.data[inPage.dataSize - 2] == '\n')
+			inPage.dataSize--;
+	}
+											
+	if(inPage.data) {
+		ioDataBytes += inPage.dataSize;
+		emit_(inPage.data, inPage.dataSize);
+
+		free(inPage.data);
+		inPage.data = NULL;
+		
+		inPage.dataSize = 0;
+	}
+
+	if(mType == kWriteHTML) {
+		if(GetPadStripping() == false) {
+			long leftMargin = inPage.leftMargin;
+			if(leftMargin) {
+				const UPDFFormat::Fragment& close = UPDFFormat::GetFragment(mNewlineCode, UPDFFormat::kFragmentBlockquoteClose);
+				emit_(close.text, close.size);
+			}
+		}
+	}
+
+	if(inPageIndex < inPages) {
+		if(mType == kWriteRTFWord && GetPadStripping() == false)
+			emit_("\\sect\n", 6);
+		else if(mType == kWriteRTF && GetPadStripping() == false)
+			emit_("\\page\n", 6);
+		else if(mShowBreaks) {
+			if(IsRTFType(mType)) {
+				bytes = UPDFFormat::AppendLiteral(entry, "\\plain\\li0\\f", 12);
+				bytes += UPDFFormat::AppendDecimal(&(entry[bytes]), fontCount);
+				bytes += UPDFFormat::AppendString(&(entry[bytes]), " ------------------------------[PAGE BREAK]------------------------------\\\n");
+			}
+			else {
+				bytes = 0;
+				
+				if(mType == kWriteHTML)
+					bytes += UPDFFormat::AppendFragment(&(entry[bytes]), mNewlineCode, UPDFFormat::kFragmentPreStart);
+				
+				bytes += UPDFFormat::AppendFragment(&(entry[bytes]), mNewlineCode, UPDFFormat::kFragmentPageBreak);
+			}
+
+			if(mType == kWriteHTML)
+				bytes += UPDFFormat::AppendFragment(&(entry[bytes]), mNewlineCode, UPDFFormat::kFragmentPreEnd);
+			
+			emit_(entry, bytes);
+		}
+	}
+	else if(IsRestricted()) {
+		if(IsRTFType(mType)) {
+			unsigned char fontTag[32];
+			long fontTagSize = UPDFFormat::AppendLiteral(fontTag, "\\plain\\f", 8);
+			fontTagSize += UPDFFormat::AppendDecimal(&(fontTag[fontTagSize]), fontCount);
+
+			bytes = UPDFFormat::AppendLiteral(entry, "\\plain\\li0", 10);
+			bytes += UPDFFormat::AppendLiteral(&(entry[bytes]), (char*) &(fontTag[6]), fontTagSize - 6);
+			bytes += UPDFFormat::AppendString(&(entry[bytes]), " \\\n=====================================\\\n");
+			
+			if(inSavePages > 3) {
+				bytes += UPDFFormat::AppendLiteral(&(entry[bytes]), (char*) fontTag, fontTagSize);
+				bytes += UPDFFormat::AppendString(&(entry[bytes]), "  Conversion limited to three pages.\\\n");
+			}
+										
+			bytes += UPDFFormat::AppendLiteral(&(entry[bytes]), (char*) fontTag, fontTagSize);
+			bytes += UPDFFormat::AppendString(&(entry[bytes]), "    Thank you for trying Trapeze!\\\n");
+			
+			bytes += UPDFFormat::AppendLiteral(&(entry[bytes]), (char*) fontTag, fontTagSize);
+			bytes += UPDFFormat::AppendString(&(entry[bytes]), " =====================================\\\n");
+		}
+		else {
+			bytes = 0;
+			
+			if(mType == kWriteHTML)
+				bytes += UPDFFormat::AppendFragment(&(entry[bytes]), mNewlineCode, UPDFFormat::kFragmentPreStart);
+			
+			bytes += UPDFFormat::AppendFragment(&(entry[bytes]), mNewlineCode, UPDFFormat::kFragmentRuleStart);
+			
+			if(inSavePages > 3)
+				bytes += UPDFFormat::AppendFragment(&(entry[bytes]), mNewlineCode, UPDFFormat::kFragmentLimited);
+											
+			bytes += UPDFFormat::AppendFragment(&(entry[bytes]), mNewlineCode, UPDFFormat::kFragmentThanks);
+			bytes += UPDFFormat::AppendFragment(&(entry[bytes]), mNewlineCode, UPDFFormat::kFragmentRule);
+
+			if(mType == kWriteHTML)
+				bytes += UPDFFormat::AppendFragment(&(entry[bytes]), mNewlineCode, UPDFFormat::kFragmentPreEnd);
+		}
+		
+		emit_(entry, bytes);
+	}
+	
+	if(inPage.tabs) {
+		free(inPage.tabs);
+		inPage.tabs = NULL;
+	}
+	
+	return error;
+}
+
+#undef emit_
+
+void
+CPDFParser::ReportProgress(
+	long inProgress,
+	long inMaxProgress)
+{
+	UPDFAtomic::Store(&mMaxProgress, inMaxProgress);
+	UPDFAtomic::Store(&mProgress, inProgress);
+	
+	if(mProgressProc)
+		(*mProgressProc)(inProgress, inMaxProgress, mProgressRefCon);
+}
+
+// Page workers report to the parser that owns the document, so whoever
+// polls it sees the latest phase entered on any thread.
+void
+CPDFParser::SetPhase(
+	long inPhase)
+{
+	CPDFParser* target = (mOwner ? mOwner : this);
+	
+	UPDFAtomic::Store(&(target->mPhase), inPhase);
+}
+
+void
+CPDFParser::GetProgress(
+	PDFProgress& outProgress)
+{
+	outProgress.pages = UPDFAtomic::Load(&mProgress);
+	outProgress.maxPages = UPDFAtomic::Load(&mMaxProgress);
+	outProgress.bytes = UPDFAtomic::Load(&mBytesParsed);
+	outProgress.phase = UPDFAtomic::Load(&mPhase);
+}
+
+void
+CPDFParser::TakePageOutput(
+	PDFPageOutput& outPage)
+{
+	outPage.data = mData;
+	outPage.dataSize = mDataSize;
+	
+	outPage.tabs = (IsRTFType(mType) ? GetTabString() : NULL);
+	
+	outPage.topMargin = mTopMargin;
+	outPage.leftMargin = mLeftMargin;
+	outPage.pageWidth = mPageWidth;
+	outPage.pageHeight = mPageHeight;
+	
+	outPage.model = mPageModel;
+	outPage.modelSize = mPageModelSize;
+	
+	mData = NULL;
+	mDataSize = 0;
+	
+	mPageModel = NULL;
+	mPageModelSize = 0;
+	
+	// done with tab table
+	FreeTabs();
+}
+
+#pragma mark -
+
+void
+CPDFParser::SetOptions(
+	const PDFOptions& inOptions)
+{
+	SetPadStripping(inOptions.padStripping);
+	SetRewrapping(inOptions.rewrapping);
+	SetRelaxSpacing(inOptions.relaxSpacing);
+	SetTightSpacing(inOptions.tightSpacing);
+	SetSorting(inOptions.sorting);
+	SetShowBreaks(inOptions.showBreaks);
+	SetNewlineCode(inOptions.newlineCode);
+	SetRenderThreads(inOptions.renderThreads);
+	SetStreaming(inOptions.streaming);
+	SetBudget(inOptions.budget);
+	SetPreview(inOptions.preview);
+}
+
+void
+CPDFParser::GetOptions(
+	PDFOptions& outOptions)
+{
+	outOptions.padStripping = GetPadStripping();
+	outOptions.rewrapping = GetRewrapping();
+	outOptions.relaxSpacing = GetRelaxSpacing();
+	outOptions.tightSpacing = GetTightSpacing();
+	outOptions.sorting = GetSorting();
+	outOptions.showBreaks = GetShowBreaks();
+	outOptions.newlineCode = GetNewlineCode();
+	outOptions.renderThreads = GetRenderThreads();
+	outOptions.streaming = GetStreaming();
+	GetBudget(outOptions.budget);
+	GetPreview(outOptions.preview);
+}
+
+void
+CPDFParser::SetPageRanges(
+	const PDFPageRange* inRanges,
+	long inCount)
+{
+	mFirstPage = 0;
+	mLastPage = 0;
+	
+	mPageRanges.clear();
+	
+	if(inRanges) {
+		for(long i = 0; i < inCount; i++)
+			mPageRanges.push_back(inRanges[i]);
+	}
+}
+
+void
+CPDFParser::GetBudgetStats(
+	PDFBudgetStats& outStats)
+{
+	outStats.pages = UPDFAtomic::Load(&(mBudgetStats.pages));
+	outStats.operations = UPDFAtomic::Load(&(mBudgetStats.operations));
+	outStats.textObjects = UPDFAtomic::Load(&(mBudgetStats.textObjects));
+	outStats.pageBytes = UPDFAtomic::Load(&(mBudgetStats.pageBytes));
+	outStats.milliseconds = UPDFAtomic::Load(&(mBudgetStats.milliseconds));
+	outStats.skipped = UPDFAtomic::Load(&(mBudgetStats.skipped));
+}
+
+void
+CPDFParser::SetOutputType(
+	long inType)
+{
+	mType = inType;
+	
+	switch(inType) {
+		case kWriteASCII:
+			SetEncodingOut(kEncodeASCII);
+			break;
+			
+		case kWriteHTML:
+			SetEncodingOut(kEncodeWinANSI);
+			break;
+			
+		default:
+			SetEncodingOut(kEncodeMacRoman);
+			break;
+	}
+}
+
+#pragma mark -
+
+void
+CPDFParser::JoinDocument(
+	CPDFParser* inOwner)
+{
+	mOwner = inOwner;
+	
+	mType = inOwner->mType;
+	mPageCount = inOwner->mPageCount;
+	
+	mPadCols = inOwner->mPadCols;
+	mPadLines = inOwner->mPadLines;
+	mPadStrip = inOwner->mPadStrip;
+	mRewrap = inOwner->mRewrap;
+	mRelaxSpacing = inOwner->mRelaxSpacing;
+	mTightSpacing = inOwner->mTightSpacing;
+	mSort = inOwner->mSort;
+	mShowBreaks = inOwner->mShowBreaks;
+	mNewlineCode = inOwner->mNewlineCode;
+	
+	mFontChanges = inOwner->mFontChanges;
+	mSizeChanges = inOwner->mSizeChanges;
+	mStyleChanges = inOwner->mStyleChanges;
+	mSuperSubChanges = inOwner->mSuperSubChanges;
+	
+	mEncodingOut = inOwner->mEncodingOut;
+	
+	mBudget = inOwner->mBudget;
+	
+	// page workers record for the owner's cache
+	mRecordRuns = inOwner->mRecordRuns;
+	
+	// read only while pages render; the owner frees it, see StopWorkers()
+	mFontTable = inOwner->mFontTable;
+	mJoinedFonts = mFontTable.size();
+	mLazyFonts = inOwner->mLazyFonts;
+}
+
+void
+CPDFParser::LeaveDocument()
+{
+	mFontTable.erase(mFontTable.begin(), mFontTable.begin() + mJoinedFonts);
+	mJoinedFonts = 0;
+	
+	FreeFonts();
+}
+
+// An output of ConvertOutputs(), with fonts of its own named for its type.
+void
+CPDFParser::JoinOutput(
+	CPDFParser* inOwner,
+	long inType)
+{
+	JoinDocument(inOwner);
+	
+	mRecordRuns = false;
+	mFontTable.clear();
+	mJoinedFonts = 0;
+	
+	mBytesEmitted = 0;
+	
+	SetOutputType(inType);
+	CloneFonts(inOwner);
+}
+	
+// Lays out the runs the owner recorded for its last page as if they had
+// been parsed here.
+void
+CPDFParser::ReplayPage(
+	CPDFParser* inOwner,
+	OSErr inError,
+	float width,
+	float height)
+{
+	ResetPage();
+	
+	if(inError != kNoError)
+		return;
+		
+	mCrop = inOwner->mCrop;
+	mCropWidth = inOwner->mCropWidth;
+	mCropHeight = inOwner->mCropHeight;
+	
+	StartPage(width, height);
+	
+	mRawPage = inOwner->mRawPage;
+	
+	std::vector<PDFRun*>::const_iterator i = inOwner->mPageRuns.begin();
+	PDFRun* run;
+	
+	for(i = inOwner->mPageRuns.begin(); i != inOwner->mPageRuns.end(); i++) {
+		run = *i;
+		
+		if(mOverBudget || DidAbort())
+			break;
+			
+		ShowRun(run);
+	}
+	
+	CloseChunker();
+	
+	if(mOverBudget)
+		DegradePage();
+	
+	SetupGrid(width, height);
+	
+	LayoutPage(width, height);
+}
+	
+// Shows a recorded run of text as Parse() would have, escaped for this
+// parser's type.
+void
+CPDFParser::ShowRun(
+	const PDFRun* inRun)
+{
+	if(mOverBudget)
+		return;
+		
+	mX = inRun->x;
+	mY = inRun->y;
+	mF = inRun->f;
+	mFS = inRun->fs;
+	mL = inRun->l;
+	mTC = inRun->tc;
+	mTW = inRun->tw;
+	
+	mFont = (inRun->font < 0 || inRun->font >= GetFontCount() ? NULL : mFontTable[inRun->font]);
+	
+	// room for every character escaped
+	OpenChunker(inRun->size * 2);
+	if(ReserveChunk(inRun->size * 2) == false)
+		return;
+		
+	for(long j = 0; j < inRun->size; j++) {
+		if(IsRTFType(mType) && istoken_(inRun->text[j]))
+			c[cd++] = '\\';
+			
+		c[cd++] = inRun->text[j];
+	}
+	
+	ProcessChunk();
+}
+	
+// Runs are kept as the document has them, so the escapes Parse() added for
+// rtf come out again.
+void
+CPDFParser::RecordRun()
+{
+	PDFRun* run = (PDFRun*) malloc(sizeof(PDFRun));
+	if(run == NULL)
+		return;
+		
+	run->text = (unsigned char*) malloc(cd ? cd : 1);
+	if(run->text == NULL) {
+		free(run);
+		return;
+	}
+	
+	long size = 0;
+	
+	for(long i = 0; i < cd; i++) {
+		if(IsRTFType(mType) && c[i] == '\\' && i + 1 < cd && istoken_(c[i + 1]))
+			continue;
+			
+		run->text[size++] = c[i];
+	}
+		
+	run->size = size;
+	
+	run->x = mX;
+	run->y = mY;
+	run->f = mF;
+	run->fs = mFS;
+	run->l = mL;
+	run->tc = mTC;
+	run->tw = mTW;
+	
+	run->font = (mFont ? mFont->index : -1);
+	
+	mPageRuns.push_back(run);
+}
+	
+void
+CPDFParser::PackPage(
+	OSErr inError,
+	float width,
+	float height)
+{
+	CPDFPageCache::PageInfo info;
+	
+	info.error = inError;
+	info.width = width;
+	info.height = height;
+	info.crop = mCrop;
+	info.cropWidth = mCropWidth;
+	info.cropHeight = mCropHeight;
+	info.rawPage = (inError == kNoError && mRawPage);
+	
+	if(mPageModel)
+		free(mPageModel);
+		
+	mPageModel = CPDFPageCache::PackPage(info, mPageRuns, mPageModelSize);
+}
+	
+// The cache is only kept for the whole document, parsed to the end.
+void
+CPDFParser::FinishPageCache(
+	bool inComplete)
+{
+	if(mPageCache && mPageCache->IsWriting()) {
+		if(inComplete && DidAbort() == false)
+			mPageCache->Finish(GetPageCount(), mFontTable);
+		else
+			mPageCache->Discard();
+	}
+	
+	mRecordRuns = false;
+	mDeferLayout = false;
+	
+	if(mPageModel) {
+		free(mPageModel);
+		mPageModel = NULL;
+	}
+	
+	mPageModelSize = 0;
+}
+	
+void
+CPDFParser::FreeRuns()
+{
+	std::vector<PDFRun*>::const_iterator i = mPageRuns.begin();
+	PDFRun* run;
+	
+	for(i = mPageRuns.begin(); i != mPageRuns.end(); i++) {
+		run = *i;
+		
+		free(run->text);
+		free(run);
+	}
+	
+	mPageRuns.clear();
+}
+
+CPDFParser::PDFRenderState*
+CPDFParser::StartWorkers(
+	size_t inFirst,
+	size_t inLast)
+{
+	size_t inPages = inLast - inFirst + 1;
+	
+	size_t count = (size_t) mRenderThreads;
+	if(count > inPages)
+		count = inPages;
+		
+	if(count < 2)
+		return NULL;
+		
+	PDFRenderState* state = new PDFRenderState;
+	
+	state->slots = (PDFRenderState::Slot*) calloc(inPages + 1, sizeof(PDFRenderState::Slot));
+	if(state->slots == NULL) {
+		delete state;
+		return NULL;
+	}
+	
+	pthread_mutex_init(&(state->lock), NULL);
+	pthread_cond_init(&(state->changed), NULL);
+	
+	state->first = inFirst;
+	state->pages = inPages;
+	state->next = 0;
+	state->written = 0;
+	state->window = 2 * count;
+	state->stop = false;
+	
+	state->slots[0].col = mCol;
+	state->slots[0].line = mLine;
+	state->slots[0].grid = true;
+	
+	pthread_attr_t attributes;
+	pthread_attr_init(&attributes);
+	pthread_attr_setstacksize(&attributes, kRenderStackSize);
+	
+	for(size_t i = 0; i < count; i++) {
+		CPDFParser* parser = CreatePageWorker();
+		if(parser == NULL)
+			break;
+			
+		parser->JoinDocument(this);
+		
+		PDFRenderState::Worker* worker = (PDFRenderState::Worker*) malloc(sizeof(PDFRenderState::Worker));
+		if(worker) {
+			worker->state = state;
+			worker->parser = parser;
+			
+			if(pthread_create(&(worker->thread), &attributes, RenderThread, worker) == 0) {
+				state->workers.push_back(worker);
+				continue;
+			}
+			
+			free(worker);
+		}
+		
+		parser->LeaveDocument();
+		delete parser;
+		
+		break;
+	}
+	
+	pthread_attr_destroy(&attributes);
+	
+	// no workers, render in sequence
+	if(state->workers.empty()) {
+		StopWorkers(state);
+		return NULL;
+	}
+	
+	return state;
+}
+
+void
+CPDFParser::StopWorkers(
+	PDFRenderState* inState)
+{
+	pthread_mutex_lock(&(inState->lock));
+	
+	inState->stop = true;
+	
+	pthread_cond_broadcast(&(inState->changed));
+	pthread_mutex_unlock(&(inState->lock));
+	
+	std::vector<PDFRenderState::Worker*>::const_iterator i = inState->workers.begin();
+	PDFRenderState::Worker* w;
+	
+	for(i = inState->workers.begin(); i != inState->workers.end(); i++) {
+		w = *i;
+		
+		pthread_join(w->thread, NULL);
+		
+		w->parser->LeaveDocument();
+		delete w->parser;
+		
+		free(w);
+	}
+	
+	inState->workers.clear();
+	
+	// pages finished ahead of an error or abort
+	for(size_t j = 1; j <= inState->pages; j++) {
+		PDFPageOutput& page = inState->slots[j].page;
+		
+		if(page.data)
+			free(page.data);
+			
+		if(page.tabs)
+			free(page.tabs);
+			
+		if(page.model)
+			free(page.model);
+	}
+	
+	free(inState->slots);
+	
+	pthread_cond_destroy(&(inState->changed));
+	pthread_mutex_destroy(&(inState->lock));
+	
+	delete inState;
+}
+
+void*
+CPDFParser::RenderThread(
+	void* inInfo)
+{
+	PDFRenderState::Worker* worker = (PDFRenderState::Worker*) inInfo;
+	PDFRenderState* state = worker->state;
+	CPDFParser* parser = worker->parser;
+	
+	pthread_mutex_lock(&(state->lock));
+	
+	for(;;) {
+		// stay within reach of the writer so finished pages don't pile up
+		while(state->stop == false && state->next < state->pages && state->next >= state->written + state->window)
+			pthread_cond_wait(&(state->changed), &(state->lock));
+			
+		if(state->stop || state->next >= state->pages)
+			break;
+			
+		size_t page = ++(state->next);
+		PDFRenderState::Slot& slot = state->slots[page];
+		
+		pthread_mutex_unlock(&(state->lock));
+		
+		float width = 0.0;
+		float height = 0.0;
+		
+		OSErr error = parser->ParsePage(state->first - 1 + page, width, height);
+		
+		if(parser->mRecordRuns) {
+			parser->PackPage(error, width, height);
+			parser->FreeRuns();
+		}
+		
+		// weighted text sizes its own grid, otherwise the page before decides
+		bool ownGrid = (error == kNoError && parser->mPageLength && parser->mPageWeight);
+		
+		pthread_mutex_lock(&(state->lock));
+		
+		if(ownGrid == false) {
+			PDFRenderState::Slot& previous = state->slots[page - 1];
+			
+			while(previous.grid == false)
+				pthread_cond_wait(&(state->changed), &(state->lock));
+				
+			parser->mCol = previous.col;
+			parser->mLine = previous.line;
+		}
+		
+		if(error == kNoError)
+			parser->SetupGrid(width, height);
+			
+		slot.col = parser->mCol;
+		slot.line = parser->mLine;
+		slot.grid = true;
+		
+		pthread_cond_broadcast(&(state->changed));
+		pthread_mutex_unlock(&(state->lock));
+		
+		if(error == kNoError)
+			parser->LayoutPage(width, height);
+			
+		parser->TakePageOutput(slot.page);
+		
+		pthread_mutex_lock(&(state->lock));
+		
+		slot.done = true;
+		
+		pthread_cond_broadcast(&(state->changed));
+	}
+	
+	pthread_mutex_unlock(&(state->lock));
+	
+	return NULL;
+}
+
+CPDFParser::PDFPipeline*
+CPDFParser::StartPipeline(
+	size_t inFirst,
+	size_t inLast)
+{
+	if(mRenderThreads != 1 || inLast <= inFirst)
+		return NULL;
+		
+	CPDFParser* parser = CreatePageWorker();
+	if(parser == NULL)
+		return NULL;
+		
+	parser->JoinDocument(this);
+	
+	// the worker carries the grid from page to page, starting from ours
+	parser->mCol = mCol;
+	parser->mLine = mLine;
+	
+	PDFPipeline* pipeline = new PDFPipeline;
+	
+	pipeline->parser = parser;
+	pipeline->first = inFirst;
+	pipeline->last = inLast;
+	pipeline->stop = 0;
+	
+	if(pipeline->queue.IsValid()) {
+		pthread_attr_t attributes;
+		pthread_attr_init(&attributes);
+		pthread_attr_setstacksize(&attributes, kRenderStackSize);
+		
+		int result = pthread_create(&(pipeline->thread), &attributes, PipelineThread, pipeline);
+		
+		pthread_attr_destroy(&attributes);
+		
+		if(result == 0)
+			return pipeline;
+	}
+	
+	parser->LeaveDocument();
+	delete parser;
+	
+	delete pipeline;
+	
+	return NULL;
+}
+
+void
+CPDFParser::StopPipeline(
+	PDFPipeline* inPipeline)
+{
+	UPDFAtomic::Store(&(inPipeline->stop), 1);
+	
+	pthread_join(inPipeline->thread, NULL);
+	
+	CPDFParser* parser = inPipeline->parser;
+	
+	mCol = parser->mCol;
+	mLine = parser->mLine;
+	
+	parser->LeaveDocument();
+	delete parser;
+	
+	// pages still queued are freed with the queue
+	delete inPipeline;
+}
+
+void*
+CPDFParser::PipelineThread(
+	void* inInfo)
+{
+	PDFPipeline* pipeline = (PDFPipeline*) inInfo;
+	CPDFParser* parser = pipeline->parser;
+	
+	for(size_t i = pipeline->first; i <= pipeline->last; i++) {
+		if(parser->DidAbort() || UPDFAtomic::Load(&(pipeline->stop)))
+			break;
+			
+		PDFPageOutput page;
+		
+		parser->RenderPage(i);
+		parser->TakePageOutput(page);
+		
+		long spins = 0;
+		
+		while(pipeline->queue.Push(page) == false) {
+			if(UPDFAtomic::Load(&(pipeline->stop))) {
+				if(page.data)
+					free(page.data);
+					
+				if(page.tabs)
+					free(page.tabs);
+					
+				if(page.model)
+					free(page.model);
+					
+				goto out;
+			}
+			
+			CPageQueue::Wait(spins);
+		}
+	}
+	
+out:
+	pipeline->queue.Close();
+	
+	return NULL;
+}
+
+#pragma mark -
+
+OSErr
+CPDFParser::RenderPage(
+	size_t inPage)
+{
+	float width = 0.0;
+	float height = 0.0;
+	
+	OSErr error = ParsePage(inPage, width, height);
+	
+	if(mRecordRuns) {
+		PackPage(error, width, height);
+		FreeRuns();
+	}
+	
+	if(error == kNoError) {
+		SetupGrid(width, height);
+		
+		error = LayoutPage(width, height);
+	}
+	
+	return error;
+}
+
+OSErr
+CPDFParser::ParsePage(
+	size_t inPage,
+	float& outWidth,
+	float& outHeight)
+{
+	float width = 0.0;
+	float height = 0.0;
+	
+	SetPhase(kPhaseParsing);
+	
+	// nothing carries over from the previous page
+	FreeXObjects();
+	
+	ResetPage();
+	
+	OSErr error = BeginRender(inPage, &width, &height);
+	
+	if(error != kNoError)
+		return error;
+
+	StartPage(width, height);
+		
+	// subclasses should make calls to Parse() here
+	Render();
+	
+	// only necessary if the PDF is malformed or a memory error resulted in an
+	// unprocessed chunk of text
+	CloseChunker();
+	
+	if(mOverBudget)
+		DegradePage();
+	
+	EndRender();
+	
+	outWidth = width;
+	outHeight = height;
+	
+	return kNoError;
+}
+
+void
+CPDFParser::ResetPage()
+{
+	mTopMargin = 0;
+	mLeftMargin = 0;
+	
+	mPageWidth = 0;
+	mPageHeight = 0;
+	
+	mCrop = false;
+	mCropWidth = 0.0;
+	mCropHeight = 0.0;
+}
+
+// Page state for the text about to be shown, once BeginRender() has
+// measured the page.
+void
+CPDFParser::StartPage(
+	float& ioWidth,
+	float& ioHeight)
+{
+	if(ioWidth < 72.0)
+		ioWidth = 72.0;
+		
+	if(ioHeight < 72.0)
+		ioHeight = 72.0;
+		
+	mPageWidth = lroundf(ioWidth);
+	mPageHeight = lroundf(ioHeight);
+	
+	mPageLength = 0;
+	mPageWeight = 0;
+	mPageWidths = 0;
+	mPageSpacing = 0;
+	
+	mRawX = 0.0;
+	mRawY = 0.0;
+	mRawRuns = 0;
+	mRawCapacity = 0;
+
+	// set only at beginning of page (removed from InitMetrics())
+	mF = 1.0;
+	mFS = 1.0;
+
+	mFont = NULL;
+	mAllWhitespace = false;
+
+	mQDepth = 0;
+
+	for(long i = 0; i < kMaxQDepth; i++) {
+		mSaveScale[i] = 1.0;
+		mSaveDeltaX[i] = 0.0;
+		mSaveDeltaY[i] = 0.0;
+	}
+		
+	mScale = 1.0;
+	mDeltaX = 0.0;
+	mDeltaY = 0.0;
+	
+	InitChunker();
+	InitMetrics();
+	
+	StartBudget();
+}
+
+// Sizes the text grid from the page's font weights.  A page without any
+// keeps the grid of the page before it, which is all that ties one page's
+// layout to another.
+void
+CPDFParser::SetupGrid(
+	float width,
+	float height)
+{
 	if(mCol == 0)
 		mCol = lroundf(width / kCellWidth);
 		
@@ -147,35 +1890,68 @@ CPDFParser::RenderPage(
 			mCol = lroundf((2.0 * width) / (float) averageWeight);
 			mLine = lroundf(height / (float) averageWeight);
 		}
-			
-		// initialize rendering parameters
-		xmax = 0.0;
-		ymax = 0.0;
 		
 		if(mCol < 12)
 			mCol = 12;
 			
 		if(mLine < 6)
 			mLine = 6;
-			
+	}
+}
+
+OSErr
+CPDFParser::LayoutPage(
+	float width,
+	float height)
+{
+	OSErr error = kNoError;
+	
+	SetPhase(kPhaseLayout);
+	
+	// written as it was parsed, there is nothing to lay out
+	if(mType == kWriteRawText)
+		return FinishRawText();
+	
+	if(mPageLength) {
+		// initialize rendering parameters
+		xmax = 0.0;
+		ymax = 0.0;
+		
 		// normalize page space
 		Normalize(width,  height);
 
 		xs = (mCol == 0 ? 1.0 : ((float) mCol / (float) width));
 		ys = (mLine == 0 ? 1.0 : ((float) mLine / (float) height));
 		
+		// each pass is linear in the page (the sort nearly so), checking
+		// between them keeps a cancel from waiting on the whole layout
+		if(DidAbort()) {
+			error = kUserAbort;
+			goto out;
+		}
+		
 		// sort text objects by location on page
-		if(mSort)
+		if(mSort && mRawPage == false)
 			std::stable_sort(mPageObjects.begin(), mPageObjects.end(), CTextSorter());
 		
+		if(DidAbort()) {
+			error = kUserAbort;
+			goto out;
+		}
+		
 		// fit objects into text space
 		Fit();
 		
 		// find line breaks
 		CalcLines();
 
+		if(DidAbort()) {
+			error = kUserAbort;
+			goto out;
+		}
+		
 		// insert tags if necessary
-		if(mType >= kWriteRTF)
+		if(IsRTFType(mType))
 			ObjectsToRTF();
 		else if(mType == kWriteHTML)
 			ObjectsToHTML();
@@ -183,9 +1959,14 @@ CPDFParser::RenderPage(
 		// adjust for all additional whitespace
 		mPageLength += CalcWhitespace();
 		
-		if(mType >= kWriteRTF)
+		if(IsRTFType(mType))
 			CalcExtraTabs();
 		
+		if(DidAbort()) {
+			error = kUserAbort;
+			goto out;
+		}
+		
 		// allocate buffers
 		if(mPageLength == 0)
 			goto out;
@@ -264,7 +2045,7 @@ CPDFParser::RenderPage(
 							}
 						}
 						else if(t->col && t->ws == false) {
-							if(mType >= kWriteRTF) {
+							if(IsRTFType(mType)) {
 								if(mPadStrip == false && GetTabIndex(t->col) != -1 && t->x > currentX) {
 									long tabs = GetTabsToCol(lroundf(currentX * xs), t->col);
 									
@@ -329,10 +2110,8 @@ CPDFParser::RenderPage(
 						currentY = t->y;
 						currentF = t->f;
 
-						if(t->pre) {
-							memcpy(&(mData[mDataSize]), t->pre, t->preSize);
-							mDataSize += t->preSize;
-						}
+						if(t->preSize)
+							mDataSize += ExpandTags(t, false, &(mData[mDataSize]));
 						
 						//if(spaceCount) {
 						//	memcpy(&(mData[mDataSize]), spaceBuffer, spaceCount);
@@ -346,20 +2125,12 @@ CPDFParser::RenderPage(
 						
 						currentCol += t->width;
 						
-						if(t->post) {
-							memcpy(&(mData[mDataSize]), t->post, t->postSize);
-							mDataSize += t->postSize;
-						}																	
+						if(t->postSize)
+							mDataSize += ExpandTags(t, true, &(mData[mDataSize]));
 					}
 					
 					free(t->text);
 				}
-									
-				if(t->pre)
-					free(t->pre);
-					
-				if(t->post)
-					free(t->post);				
 
 				free(t);
 			}
@@ -376,7 +2147,7 @@ CPDFParser::RenderPage(
 	}
 
 out:
-	if(error == kMemoryError) {
+	if(error != kNoError) {
 		std::vector<PDFTextObject*>::const_iterator i = mPageObjects.begin();
 		PDFTextObject* t;
 
@@ -386,19 +2157,19 @@ out:
 			if(t->text)
 				free(t->text);
 				
-			if(t->pre)
-				free(t->pre);
-				
-			if(t->post)
-				free(t->post);				
-				
 			free(t);
 		}
 	}
 	
 	mPageObjects.clear();
 	
-	EndRender();
+	if(mData && DidAbort()) {
+		free(mData);
+		mData = NULL;
+		mDataSize = 0;
+		
+		error = kUserAbort;
+	}
 		
 	if(mData) {
 		if(mPadStrip)
@@ -409,7 +2180,7 @@ out:
 		if(mRewrap)
 			Rewrap();
 			
-		if(mType >= kWriteRTF)
+		if(IsRTFType(mType))
 			PageToRTF();
 		else if(mType == kWriteHTML)
 			PageToHTML();
@@ -485,88 +2256,60 @@ CPDFParser::ObjectsToRTF()
 			}
 			
 			if(changeFont || changeSize || changeSuper || changeSub) {
-				char* pre = (char*) malloc(64);
-				pre[0] = 0;
-
-				char* post = NULL;
-				if((changeSuper || changeSub) && pre) {
-					post = (char*) malloc(64);
-					post[0] = 0;
-				}
+				unsigned short pre = 0;
+				unsigned short post = 0;
 				
-				if(pre) {
-					char buf[64];
-					
-					if(mStyleChanges) {
-						if(changeBold == false && boldStyle) {
-							strcat(pre, "\\b0");
-							boldStyle = false;
-						}
-					
-						if(changeItalic == false && italicStyle) {
-							strcat(pre, "\\i0");
-							italicStyle = false;
-						}
+				if(mStyleChanges) {
+					if(changeBold == false && boldStyle) {
+						pre |= kTagBoldOff;
+						boldStyle = false;
 					}
-										
-					if(mFontChanges && changeFont) {
-						sprintf(buf, "\\f%d", (int)t->font->index);
-						strcat(pre, buf);
-					}
-						
-					if(mSizeChanges && changeSize) {
-						sprintf(buf, "\\fs%d\\sl%d", (int)fontSize, (int)lineSpacing);
-						strcat(pre, buf);
+				
+					if(changeItalic == false && italicStyle) {
+						pre |= kTagItalicOff;
+						italicStyle = false;
 					}
+				}
+									
+				if(mFontChanges && changeFont)
+					pre |= kTagFont;
 					
-					if(mStyleChanges) {
-						if(changeBold && boldStyle == false) {
-							strcat(pre, "\\b");
-							boldStyle = true;
-						}
-					
-						if(changeItalic && italicStyle == false) {
-							strcat(pre, "\\i");
-							italicStyle = true;
-						}
-					}
-						
-					if(post) {
-						if(mSuperSubChanges) {
-							if(changeSuper)
-								strcat(pre, "\\super");
-							else if(changeSub)
-								strcat(pre, "\\sub");
-						}
+				if(mSizeChanges && changeSize)
+					pre |= kTagSize;
+				
+				if(mStyleChanges) {
+					if(changeBold && boldStyle == false) {
+						pre |= kTagBold;
+						boldStyle = true;
 					}
-					
-					if(pre[0]) {
-						strcat(pre, " ");
-												
-						t->pre = pre;
-						t->preSize = strlen(pre);
-						
-						mPageLength += t->preSize;
+				
+					if(changeItalic && italicStyle == false) {
+						pre |= kTagItalic;
+						italicStyle = true;
 					}
-					else
-						free(pre);
 				}
-				
-				if(post) {
-					if(mSuperSubChanges && (changeSuper || changeSub))
-						strcat(post, "\\nosupersub");
 					
-					if(post[0]) {	
-						strcat(post, " {}");
-						
-						t->post = post;
-						t->postSize = strlen(post);
-						
-						mPageLength += t->postSize;
+				if(mSuperSubChanges) {
+					if(changeSuper) {
+						pre |= kTagSuper;
+						post |= kTagSuper;
+					}
+					else if(changeSub) {
+						pre |= kTagSub;
+						post |= kTagSub;
 					}
-					else
-						free(post);
 				}
+				
+				t->tag.font = t->font;
+				t->tag.pre = pre;
+				t->tag.post = post;
+				t->tag.size = fontSize;
+				t->tag.spacing = lineSpacing;
+				
+				t->preSize = ExpandTags(t, false);
+				t->postSize = ExpandTags(t, true);
+				
+				mPageLength += t->preSize + t->postSize;
 			}
 		}
 	}
@@ -611,11 +2354,10 @@ CPDFParser::ObjectsToHTML()
 					
 					for(long j = 0; j < t->size; j++) {
 						if(t->text[j] > 127) {
-							char escaped[8];
-							sprintf(escaped, "&#%d;", t->text[j]);
-							long len = strlen(escaped);
-							for(long k = 0; k < len; k++)
-								escapedText[ei++] = escaped[k];
+							escapedText[ei++] = '&';
+							escapedText[ei++] = '#';
+							ei += UPDFFormat::AppendDecimal(&(escapedText[ei]), t->text[j]);
+							escapedText[ei++] = ';';
 						}
 						else switch(t->text[j]) {
 							case '&':
@@ -699,103 +2441,63 @@ CPDFParser::ObjectsToHTML()
 			}
 			
 			if(changeFont || changeSize || changeSuper || changeSub) {
-				char* pre = (char*) malloc(64);
-				pre[0] = 0;
-
-				char* post = NULL;
-				if((changeSuper || changeSub) && pre) {
-					post = (char*) malloc(64);
-					post[0] = 0;
-				}
+				unsigned short pre = 0;
+				unsigned short post = 0;
 				
-				if(pre) {
-					char buf[64];
-					
-					if(mStyleChanges) {
-						if(changeBold == false && boldStyle) {
-							strcat(pre, "</b>");
-							boldStyle = false;
-						}
-					
-						if(changeItalic == false && italicStyle) {
-							strcat(pre, "</i>");
-							italicStyle = false;
-						}
-					}
-										
-					/*if(mFontChanges && changeFont) {
-						sprintf(buf, "\\f%d", t->font->index);
-						strcat(pre, buf);
-					}*/
-						
-					if((mFontChanges && changeFont) || (mSizeChanges && changeSize)) {
-						if(currentFont) {				
-							if(inFont)
-								sprintf(buf, "</font><font face=\"%s\" size=%d>", currentFont->baseFont, (int)currentSize);
-							else {
-								sprintf(buf, "<font face=\"%s\" size=%d>", currentFont->baseFont, (int)currentSize);
-								inFont = true;
-							}
-						}
-						else {
-							if(inFont)
-								sprintf(buf, "</font><font size=%d>", (int)currentSize);
-							else {
-								sprintf(buf, "<font size=%d>", (int)currentSize);
-								inFont = true;
-							}
-						}
-						strcat(pre, buf);
-					}
-					
-					if(mStyleChanges) {
-						if(changeBold && boldStyle == false) {
-							strcat(pre, "<b>");
-							boldStyle = true;
-						}
-					
-						if(changeItalic && italicStyle == false) {
-							strcat(pre, "<i>");
-							italicStyle = true;
-						}
+				if(mStyleChanges) {
+					if(changeBold == false && boldStyle) {
+						pre |= kTagBoldOff;
+						boldStyle = false;
 					}
-						
-					if(post) {
-						if(mSuperSubChanges) {
-							if(changeSuper)
-								strcat(pre, "<sup>");
-							else if(changeSub)
-								strcat(pre, "<sub>");
-						}
+				
+					if(changeItalic == false && italicStyle) {
+						pre |= kTagItalicOff;
+						italicStyle = false;
 					}
+				}
+									
+				if((mFontChanges && changeFont) || (mSizeChanges && changeSize)) {
+					pre |= kTagFont;
 					
-					if(pre[0]) {
-						t->pre = pre;
-						t->preSize = strlen(pre);
-						
-						mPageLength += t->preSize;
-					}
+					if(inFont)
+						pre |= kTagFontClose;
 					else
-						free(pre);
+						inFont = true;
 				}
 				
-				if(post) {
-						if(mSuperSubChanges) {
-							if(changeSuper)
-								strcat(post, "</sup>");
-							else if(changeSub)
-								strcat(post, "</sub>");
-						}
+				if(mStyleChanges) {
+					if(changeBold && boldStyle == false) {
+						pre |= kTagBold;
+						boldStyle = true;
+					}
+				
+					if(changeItalic && italicStyle == false) {
+						pre |= kTagItalic;
+						italicStyle = true;
+					}
+				}
 					
-					if(post[0]) {	
-						t->post = post;
-						t->postSize = strlen(post);
-						
-						mPageLength += t->postSize;
+				if(mSuperSubChanges) {
+					if(changeSuper) {
+						pre |= kTagSuper;
+						post |= kTagSuper;
+					}
+					else if(changeSub) {
+						pre |= kTagSub;
+						post |= kTagSub;
 					}
-					else
-						free(post);
 				}
+				
+				t->tag.font = currentFont;
+				t->tag.pre = pre;
+				t->tag.post = post;
+				t->tag.size = currentSize;
+				t->tag.spacing = 0;
+				
+				t->preSize = ExpandTags(t, false);
+				t->postSize = ExpandTags(t, true);
+				
+				mPageLength += t->preSize + t->postSize;
 			}
 		}
 	}
@@ -805,6 +2507,105 @@ CPDFParser::ObjectsToHTML()
 	mPageItalic = italicStyle;
 }
 
+#define tag_(x)		UPDFFormat::AppendLiteral((outText ? &(outText[bytes]) : NULL), x, sizeof(x) - 1)
+#define number_(x)	UPDFFormat::AppendDecimal((outText ? &(outText[bytes]) : NULL), x)
+
+long
+CPDFParser::ExpandTags(
+	const PDFTextObject* inObject,
+	bool inPost,
+	unsigned char* outText)
+{
+	const PDFTagObject& tag = inObject->tag;
+	long bytes = 0;
+
+	if(IsRTFType(mType)) {
+		if(inPost) {
+			if(tag.post) {
+				bytes += tag_("\\nosupersub");
+				bytes += tag_(" {}");
+			}
+		}
+		else if(tag.pre) {
+			if(tag.pre & kTagBoldOff)
+				bytes += tag_("\\b0");
+				
+			if(tag.pre & kTagItalicOff)
+				bytes += tag_("\\i0");
+			
+			if(tag.pre & kTagFont)
+				bytes += UPDFFormat::AppendLiteral((outText ? &(outText[bytes]) : NULL), tag.font->tag, tag.font->tagSize);
+			
+			if(tag.pre & kTagSize) {
+				bytes += tag_("\\fs");
+				bytes += number_(tag.size);
+				bytes += tag_("\\sl");
+				bytes += number_(tag.spacing);
+			}
+			
+			if(tag.pre & kTagBold)
+				bytes += tag_("\\b");
+				
+			if(tag.pre & kTagItalic)
+				bytes += tag_("\\i");
+				
+			if(tag.pre & kTagSuper)
+				bytes += tag_("\\super");
+			else if(tag.pre & kTagSub)
+				bytes += tag_("\\sub");
+			
+			bytes += tag_(" ");
+		}
+	}
+	else if(mType == kWriteHTML) {
+		if(inPost) {
+			if(tag.post & kTagSuper)
+				bytes += tag_("</sup>");
+			else if(tag.post & kTagSub)
+				bytes += tag_("</sub>");
+		}
+		else {
+			if(tag.pre & kTagBoldOff)
+				bytes += tag_("</b>");
+				
+			if(tag.pre & kTagItalicOff)
+				bytes += tag_("</i>");
+				
+			if(tag.pre & kTagFont) {
+				if(tag.pre & kTagFontClose)
+					bytes += tag_("</font>");
+				
+				if(tag.font) {
+					bytes += tag_("<font face=\"");
+					bytes += UPDFFormat::AppendLiteral((outText ? &(outText[bytes]) : NULL), tag.font->baseFont, tag.font->faceSize);
+					bytes += tag_("\" size=");
+				}
+				else
+					bytes += tag_("<font size=");
+				
+				bytes += number_(tag.size);
+				bytes += tag_(">");
+			}
+			
+			if(tag.pre & kTagBold)
+				bytes += tag_("<b>");
+				
+			if(tag.pre & kTagItalic)
+				bytes += tag_("<i>");
+				
+			if(tag.pre & kTagSuper)
+				bytes += tag_("<sup>");
+			else if(tag.pre & kTagSub)
+				bytes += tag_("<sub>");
+		}
+	}
+		
+	return bytes;
+}
+
+#undef tag_
+#undef number_
+
 bool
 CPDFParser::Strip()
 {
@@ -923,7 +2724,7 @@ CPDFParser::Rewrap()
 				if(i < 2 || (mData[i - 1] == '\n' && mData[i - 2] == '\n')) {
 					feed = true;
 					
-					if(mType >= kWriteRTF) {
+					if(IsRTFType(mType)) {
 						if(mData[i] == '\\' && !istoken_(mData[i + 1])) {
 							if(i && mData[i - 1] == '\\')
 								;
@@ -982,7 +2783,7 @@ CPDFParser::Rewrap()
 								}
 								
 								if(foundText) {
-									if(mType >= kWriteRTF) {
+									if(IsRTFType(mType)) {
 										for(long z = k; z < j - 3; z++) {
 											if(mData[z] == '\\') {
 												if(istoken_(mData[z + 1]))
@@ -1010,7 +2811,7 @@ CPDFParser::Rewrap()
 								break;
 							else {
 								if(nl) {
-									if(mType >= kWriteRTF && mData[j] == '\\' && j && mData[j - 1] != '\\' && !istoken_(mData[j + 1])) {
+									if(IsRTFType(mType) && mData[j] == '\\' && j && mData[j - 1] != '\\' && !istoken_(mData[j + 1])) {
 										while(j < mDataSize && mData[j] != ' ')
 											j++;
 									}
@@ -1159,19 +2960,12 @@ CPDFParser::PageToRTF()
 							
 							if(margin != marginSet) {
 								if(margin > 0) {
-									char marginEntry[256];
-									sprintf(marginEntry, "\\li%d\n", (int)(20 * lroundf((float) margin / xs)));
-										
-									long bytes = strlen(marginEntry);
-									memcpy(&(buffer[bufferSize]), marginEntry, bytes);
-									bufferSize += bytes;
+									bufferSize += UPDFFormat::AppendLiteral(&(buffer[bufferSize]), "\\li", 3);
+									bufferSize += UPDFFormat::AppendDecimal(&(buffer[bufferSize]), 20 * lroundf((float) margin / xs));
+									buffer[bufferSize++] = '\n';
 								}
 								else {
-									char marginEntry[256] = "\\li0\n";
-										
-									long bytes = strlen(marginEntry);
-									memcpy(&(buffer[bufferSize]), marginEntry, bytes);
-									bufferSize += bytes;
+									bufferSize += UPDFFormat::AppendLiteral(&(buffer[bufferSize]), "\\li0\n", 5);
 									
 									margin = 0;
 								}
@@ -1535,6 +3329,7 @@ CPDFParser::Parse(
 	}
 	
 	mParseBytes += n;
+	UPDFAtomic::Add(&((mOwner ? mOwner : this)->mBytesParsed), n);
 	
 	if(init) {
 		insideString = false;
@@ -1544,7 +3339,11 @@ CPDFParser::Parse(
 		insideImage = false;
 	}
 		
-	for(long j = 0; j < n; j++) {
+	for(long j = 0; j < n && mOverBudget == 0; j++) {
+		// a single huge content stream can't hold up a cancel
+		if((j & (kCancelBytes - 1)) == 0 && j && (DidAbort() || CheckTime()))
+			break;
+			
 		if(insideText && p[j] == '(') {
 			insideString = true;
 			
@@ -1580,7 +3379,11 @@ CPDFParser::Parse(
 						if(mRelaxSpacing && spacing == 0)
 							spacing = 1;
 							
-						while(spacing) {
+						// a kern can be any size the file likes
+						if(spacing > cSize - cd)
+							spacing = cSize - cd;
+							
+						while(spacing > 0) {
 							c[cd++] = ' ';
 							spacing--;
 						}
@@ -1593,6 +3396,10 @@ CPDFParser::Parse(
 		else if(insideString) {
 			OpenChunker(n);
 			
+			// a character and its escape
+			if(ReserveChunk(2) == false)
+				continue;
+				
 			unsigned char charInStream = 0;
 			
 			if(j < (n - 1) && p[j] == '\\') {
@@ -1659,7 +3466,7 @@ CPDFParser::Parse(
 				charInStream = (mFont && mFont->mapInPlace ? mFont->map[p[j]] : p[j]);
 			
 			if(charInStream) {				
-				if(mType >= kWriteRTF) {
+				if(IsRTFType(mType)) {
 					switch(charInStream) {
 						case '\\':
 						case '{':
@@ -1710,7 +3517,7 @@ CPDFParser::Parse(
 						unsigned char charInStream = (mFont && mFont->mapInPlace ? mFont->map[charInChar] : charInChar);
 						
 						if(charInStream) {				
-							if(mType >= kWriteRTF) {
+							if(IsRTFType(mType)) {
 								switch(charInStream) {
 									case '\\':
 									case '{':
@@ -1724,7 +3531,7 @@ CPDFParser::Parse(
 					}
 					else {
 						/*//c[cd++] = MapUnicode(charInHex);
-						if(mType >= kWriteRTF) {
+						if(IsRTFType(mType)) {
 							char us[16];
 							sprintf(us, "{\\u%d?}", charInHex);
 							long ul = strlen(us);
@@ -1737,7 +3544,8 @@ CPDFParser::Parse(
 			}
 		}
 		else if(insideHex) {
-			if(isdigit(p[j]) || (p[j] >= 'A' && p[j] <= 'F'))
+			// a lone digit can come out as a character and its escape
+			if((isdigit(p[j]) || (p[j] >= 'A' && p[j] <= 'F')) && ReserveChunk(2))
 				c[cd++] = p[j];
 		}
 		else if(insideImage) {
@@ -1758,21 +3566,27 @@ CPDFParser::Parse(
 			char operand[256];
 			long oo = 0;
 			
-			while(j < n && (isdigit(p[j]) || p[j] == '-' || p[j] == '.')) {
+			while(j < n && oo < (long) sizeof(operand) - 1 && (isdigit(p[j]) || p[j] == '-' || p[j] == '.')) {
 				operand[oo++] = p[j];
 				j++;
 			}
 			
+			// operands, and whatever else ends at whitespace: operators, names
+			if(mBudget.maxOperations && (oo || (j < n && isspace(p[j]) == false && (j + 1 >= n || isspace(p[j + 1]))))) {
+				if(++mOperations > mBudget.maxOperations)
+					OverBudget(kOverOperations);
+			}
+			
 			if(oo) {
 				for(long i = kMaxOperands - 1; i > 0; i--)
 					mOperand[i] = mOperand[i - 1];
 					
 				operand[oo] = 0;
 				
-				CFSwappedFloat32 swap = CFConvertFloat32HostToSwapped(strtof(operand, (char**) NULL));
-				mOperand[0] = CFConvertFloat32SwappedToHost(swap);
+				UPDFPlatform::SwappedFloat32 swap = UPDFPlatform::FloatHostToSwapped(strtof(operand, (char**) NULL));
+				mOperand[0] = UPDFPlatform::FloatSwappedToHost(swap);
 				
-				if(p[j] == '(' && insideArray)
+				if(j < n && p[j] == '(' && insideArray)
 					mArrayJ = mOperand[0];
 					
 				j--;
@@ -1817,7 +3631,7 @@ CPDFParser::Parse(
 						k--;
 						
 					if(p[k] == '/' && ++k < j) {
-						char* objName = (char*) malloc(j - k);
+						char* objName = (char*) malloc(j - k + 1);
 						if(objName) {
 							long objLength = 0;
 							
@@ -1874,7 +3688,7 @@ CPDFParser::Parse(
 								k--;
 								
 							if(p[k] == '/' && ++k < j) {
-								char* fontName = (char*) malloc(j - k);
+								char* fontName = (char*) malloc(j - k + 1);
 								if(fontName) {
 									long fontLength = 0;
 									
@@ -1885,7 +3699,7 @@ CPDFParser::Parse(
 									
 									if(fontLength) {
 										if(mFont == NULL || strcmp(mFont->key, fontName) != 0)
-											mFont = GetFont(fontName);
+											mFont = ResolveFont(fontName);
 									}
 									
 									free(fontName);
@@ -1992,9 +3806,11 @@ CPDFParser::AddXObject(
 		if(object->key) {
 			strcpy(object->key, inKey);
 
-			object->data = (unsigned char*) malloc(inSize);
+			// NUL padded like page contents, for Parse()
+			object->data = (unsigned char*) malloc(inSize + 1);
 			if(object->data) {
 				memcpy(object->data, inData, inSize);
+				object->data[inSize] = 0;
 				
 				object->size = inSize;
 				
@@ -2047,6 +3863,77 @@ CPDFParser::FreeXObjects()
 
 void
 CPDFParser::AddFont(
+	const char* inKey,
+	const char* inBaseFont,
+	const char* inEncoding,
+	char* inMap,
+	wchar_t* inUMap,
+	float* inWidths,
+	unsigned char inFI,
+	unsigned char inFL,
+	UInt64 inCacheKey)
+{
+	if(mFontCache && inCacheKey) {
+		// the cache takes the tables; if it can't they are still ours
+		const CPDFFontCache::Font* shared = mFontCache->Insert(inCacheKey, inBaseFont, inEncoding, inMap, inUMap, inWidths, inFI, inFL);
+		
+		if(shared) {
+			PDFFontObject* font = NewFont(inKey, shared->baseFont, shared->encoding, shared->map, shared->umap, shared->widths, shared->fi, shared->fl);
+			
+			if(font) {
+				font->borrowed = true;
+				font->cache = mFontCache;
+				font->cacheKey = inCacheKey;
+			}
+			else
+				mFontCache->Release(inCacheKey);
+				
+			return;
+		}
+	}
+	
+	if(NewFont(inKey, inBaseFont, inEncoding, inMap, inUMap, inWidths, inFI, inFL) == NULL) {
+		if(inMap)
+			free(inMap);
+			
+		if(inUMap)
+			free(inUMap);
+			
+		if(inWidths)
+			free(inWidths);
+	}
+}
+
+bool
+CPDFParser::AddCachedFont(
+	const char* inKey,
+	UInt64 inCacheKey)
+{
+	if(mFontCache == NULL)
+		return false;
+		
+	const CPDFFontCache::Font* shared = mFontCache->Acquire(inCacheKey);
+	if(shared == NULL)
+		return false;
+		
+	PDFFontObject* font = NewFont(inKey, shared->baseFont, shared->encoding, shared->map, shared->umap, shared->widths, shared->fi, shared->fl);
+	
+	if(font == NULL) {
+		mFontCache->Release(inCacheKey);
+		return false;
+	}
+	
+	font->borrowed = true;
+	font->cache = mFontCache;
+	font->cacheKey = inCacheKey;
+	
+	return true;
+}
+
+// Adds a font that owns the tables given; NULL if out of memory, and the
+// tables are left to the caller.
+CPDFParser::PDFFontObject*
+CPDFParser::NewFont(
 	const char* inKey,
 	const char* inBaseFont,
 	const char* inEncoding,
@@ -2069,6 +3956,7 @@ CPDFParser::AddFont(
 			
 		font->key = (char*) malloc(strlen(inKey) + 1);
 		font->baseFont = (char*) malloc(baseFontSize + 1);
+		font->name = NULL;
 		font->family = (char*) malloc(8);
 		font->map = inMap;
 		font->umap = inUMap;
@@ -2081,7 +3969,11 @@ CPDFParser::AddFont(
 				strcpy(font->baseFont, &(inBaseFont[7]));
 			else
 				strcpy(font->baseFont, inBaseFont);
-			
+				
+			font->name = strdup(font->baseFont);
+		}
+		
+		if(font->key && font->baseFont && font->name) {
 			TextEncoding encoding = kEncodeMacRoman;
 			
 			if(inEncoding == NULL || strcmp(inEncoding, "MacRomanEncoding") == 0)
@@ -2107,155 +3999,243 @@ CPDFParser::AddFont(
 				font->mapInPlace = true;
 			else
 				font->mapInPlace = false;
+				
+			font->borrowed = false;
+			font->cache = NULL;
+			font->cacheKey = 0;
 			
-			char* synth = strchr(font->baseFont, '-');
+			NameFont(font);
 			
-			if(synth == NULL)
-				synth = strchr(font->baseFont, ',');
+			mFontTable.push_back(font);
+			return font;
+		}
+		
+		if(font->key)
+			free(font->key);
+		
+		if(font->baseFont)
+			free(font->baseFont);
 			
-			if(synth) {
-				if(strstr(font->baseFont, "-BoldItal") || strstr(font->baseFont, ",BoldItal") ) { // matches -BoldItal(ic)
-					font->bold = true;
-					font->italic = true;
-				}
-				else if(strstr(font->baseFont, "-Bold") || strstr(font->baseFont, ",Bold"))
-					font->bold = true;
-				else if(strstr(font->baseFont, "-Ital") || strstr(font->baseFont, ",Ital")) // matches -Ital(ic)
-					font->italic = true;
-					
-				if(mType == kWriteRTFWord || mType == kWriteHTML)
-					*synth = 0;
-			}
+		if(font->name)
+			free(font->name);
+						
+		if(font->family)
+			free(font->family);
+						
+		free(font);
+	}
+	
+	return NULL;
+}
+
+// Style, face name, family and tag of a font about to join the table; the
+// face name is trimmed for the types that show it.
+void
+CPDFParser::NameFont(
+	PDFFontObject* font)
+{
+	char* synth = strchr(font->baseFont, '-');
+	
+	if(synth == NULL)
+		synth = strchr(font->baseFont, ',');
+	
+	if(synth) {
+		if(strstr(font->baseFont, "-BoldItal") || strstr(font->baseFont, ",BoldItal") ) { // matches -BoldItal(ic)
+			font->bold = true;
+			font->italic = true;
+		}
+		else if(strstr(font->baseFont, "-Bold") || strstr(font->baseFont, ",Bold"))
+			font->bold = true;
+		else if(strstr(font->baseFont, "-Ital") || strstr(font->baseFont, ",Ital")) // matches -Ital(ic)
+			font->italic = true;
 			
-			if(font->bold == false &&
-				(
-					strstr(font->baseFont, "Bold") ||
-					strstr(font->baseFont, "BdMS") ||
-					strstr(font->baseFont, "BdItMS")
-				)
+		if(mType == kWriteRTFWord || mType == kWriteHTML)
+			*synth = 0;
+	}
+	
+	if(font->bold == false &&
+		(
+			strstr(font->baseFont, "Bold") ||
+			strstr(font->baseFont, "BdMS") ||
+			strstr(font->baseFont, "BdItMS")
+		)
+	)
+		font->bold = true;
+		
+	if(font->italic == false &&
+		(
+			strstr(font->baseFont, "Oblique") ||
+			strstr(font->baseFont, "Italic") ||
+			strstr(font->baseFont, "ItMS")
+		)
+	)
+		font->italic = true;
+		
+	if(mType == kWriteRTFWord || mType == kWriteHTML) {
+		long len = strlen(font->baseFont);
+		
+		if(len > 6 && strcmp(&(font->baseFont[len - 6]), "BdItMS") == 0)
+			font->baseFont[len - 6] = 0;						
+		else if
+		(
+			len > 4 &&
+			(
+				strcmp(&(font->baseFont[len - 4]), "BdMS") == 0 ||
+				strcmp(&(font->baseFont[len - 4]), "ItMS") == 0 ||
+				strcmp(&(font->baseFont[len - 4]), "PSMT") == 0
 			)
-				font->bold = true;
-				
-			if(font->italic == false &&
-				(
-					strstr(font->baseFont, "Oblique") ||
-					strstr(font->baseFont, "Italic") ||
-					strstr(font->baseFont, "ItMS")
-				)
+		)
+			font->baseFont[len - 4] = 0;
+		else if
+		(
+			len > 3 &&
+			(
+				strcmp(&(font->baseFont[len - 3]), "ITC") == 0
 			)
-				font->italic = true;
-				
-			if(mType == kWriteRTFWord || mType == kWriteHTML) {
-				long len = strlen(font->baseFont);
-				
-				if(len > 6 && strcmp(&(font->baseFont[len - 6]), "BdItMS") == 0)
-					font->baseFont[len - 6] = 0;						
-				else if
-				(
-					len > 4 &&
-					(
-						strcmp(&(font->baseFont[len - 4]), "BdMS") == 0 ||
-						strcmp(&(font->baseFont[len - 4]), "ItMS") == 0 ||
-						strcmp(&(font->baseFont[len - 4]), "PSMT") == 0
-					)
-				)
-					font->baseFont[len - 4] = 0;
-				else if
-				(
-					len > 3 &&
-					(
-						strcmp(&(font->baseFont[len - 3]), "ITC") == 0
-					)
-				)
-					font->baseFont[len - 3] = 0;
-				else if
-				(
-					len > 2 &&
-					(
-						strcmp(&(font->baseFont[len - 2]), "PS") == 0 ||
-						strcmp(&(font->baseFont[len - 2]), "MT") == 0 ||
-						strcmp(&(font->baseFont[len - 2]), "MS") == 0
-					)
-				)
-					font->baseFont[len - 2] = 0;
+		)
+			font->baseFont[len - 3] = 0;
+		else if
+		(
+			len > 2 &&
+			(
+				strcmp(&(font->baseFont[len - 2]), "PS") == 0 ||
+				strcmp(&(font->baseFont[len - 2]), "MT") == 0 ||
+				strcmp(&(font->baseFont[len - 2]), "MS") == 0
+			)
+		)
+			font->baseFont[len - 2] = 0;
 
-				// respace mixed caps
-				len = strlen(font->baseFont);
-				
-				long cc = 0;
-				for(long i = 0; i < len - 1; i++) {
-					if(islower(font->baseFont[i]) && isupper(font->baseFont[i + 1]))
-						cc++;
-				}
+		// respace mixed caps
+		len = strlen(font->baseFont);
+		
+		long cc = 0;
+		for(long i = 0; i < len - 1; i++) {
+			if(islower(font->baseFont[i]) && isupper(font->baseFont[i + 1]))
+				cc++;
+		}
+		
+		if(cc) {
+			char* mixed = (char*) malloc(len + cc + 1);
+			
+			if(mixed) {
+				long ml = 0;
 				
-				if(cc) {
-					char* mixed = (char*) malloc(len + cc + 1);
+				for(long i = 0; i < len; i++) {
+					mixed[ml++] = font->baseFont[i];
 					
-					if(mixed) {
-						long ml = 0;
-						
-						for(long i = 0; i < len; i++) {
-							mixed[ml++] = font->baseFont[i];
-							
-							if(
-								i < len - 2 &&
-								islower(font->baseFont[i]) &&
-								isupper(font->baseFont[i + 1]) &&
-								islower(font->baseFont[i + 2])
-							)
-								mixed[ml++] = ' ';
-						}
-						
-						mixed[ml] = 0;
-						
-						free(font->baseFont);
-						font->baseFont = mixed;
-					}				
+					if(
+						i < len - 2 &&
+						islower(font->baseFont[i]) &&
+						isupper(font->baseFont[i + 1]) &&
+						islower(font->baseFont[i + 2])
+					)
+						mixed[ml++] = ' ';
 				}
-			}
-						
-			if(font->family) {
-				if(strstr(font->baseFont, "Times") || strstr(font->baseFont, "Palatino"))
-					strcpy(font->family, "roman");
-				else if(strstr(font->baseFont, "Helvetica") || strstr(font->baseFont, "Geneva") || strstr(font->baseFont, "Arial"))
-					strcpy(font->family, "swiss");
-				else if(strstr(font->baseFont, "Courier") || strstr(font->baseFont, "Monaco"))
-					strcpy(font->family, "modern");
-				else if(strstr(font->baseFont, "Cursive") || strstr(font->baseFont, "Script"))
-					strcpy(font->family, "script");
-				else if(strstr(font->baseFont, "Chancery"))
-					strcpy(font->family, "decor");
-				else if(strstr(font->baseFont, "Symbol") || strstr(font->baseFont, "Dingbats"))
-					strcpy(font->family, "tech");
-				else
-					strcpy(font->family, "nil");
-			}
-			
-			font->index = mFontTable.size();
-			
-			mFontTable.push_back(font);
-			return;
+				
+				mixed[ml] = 0;
+				
+				free(font->baseFont);
+				font->baseFont = mixed;
+			}				
 		}
+	}
+				
+	if(font->family) {
+		if(strstr(font->baseFont, "Times") || strstr(font->baseFont, "Palatino"))
+			strcpy(font->family, "roman");
+		else if(strstr(font->baseFont, "Helvetica") || strstr(font->baseFont, "Geneva") || strstr(font->baseFont, "Arial"))
+			strcpy(font->family, "swiss");
+		else if(strstr(font->baseFont, "Courier") || strstr(font->baseFont, "Monaco"))
+			strcpy(font->family, "modern");
+		else if(strstr(font->baseFont, "Cursive") || strstr(font->baseFont, "Script"))
+			strcpy(font->family, "script");
+		else if(strstr(font->baseFont, "Chancery"))
+			strcpy(font->family, "decor");
+		else if(strstr(font->baseFont, "Symbol") || strstr(font->baseFont, "Dingbats"))
+			strcpy(font->family, "tech");
+		else
+			strcpy(font->family, "nil");
+	}
+	
+	font->index = mFontTable.size();
+	
+	font->tagSize = UPDFFormat::AppendLiteral((unsigned char*) font->tag, "\\f", 2);
+	font->tagSize += UPDFFormat::AppendDecimal((unsigned char*) &(font->tag[font->tagSize]), font->index);
+	font->tag[font->tagSize] = 0;
+	
+	font->faceSize = strlen(font->baseFont);
+}
+
+// Copies of the owner's fonts, named for this parser's type.  The maps
+// and widths stay with the owner, which outlives the copies.
+void
+CPDFParser::CloneFonts(
+	CPDFParser* inOwner)
+{
+	std::vector<PDFFontObject*>::const_iterator i = inOwner->mFontTable.begin();
+	PDFFontObject* f;
+	
+	for(i = inOwner->mFontTable.begin(); i != inOwner->mFontTable.end(); i++) {
+		f = *i;
+		
+		CopyFont(f, f->encoder ? f->encoder->encoding : kEncodeMacRoman);
+	}
+}
+	
+// Adds a font made from another, named from scratch; its map, umap and
+// widths are borrowed and must outlive this parser's font table.
+void
+CPDFParser::CopyFont(
+	const PDFFontObject* inFont,
+	TextEncoding inEncoding)
+{
+	PDFFontObject* font = (PDFFontObject*) malloc(sizeof(PDFFontObject));
+	if(font == NULL)
+		return;
 		
+	font->key = strdup(inFont->key);
+	font->baseFont = strdup(inFont->name);
+	font->name = strdup(inFont->name);
+	font->family = (char*) malloc(8);
+	
+	if(font->key == NULL || font->baseFont == NULL || font->name == NULL) {
 		if(font->key)
 			free(font->key);
-		
+			
 		if(font->baseFont)
 			free(font->baseFont);
-						
+			
+		if(font->name)
+			free(font->name);
+			
 		if(font->family)
 			free(font->family);
-						
-		if(font->map)
-			free(font->map);
-			
-		if(font->widths)
-			free(font->widths);
 			
 		free(font);
+		return;
 	}
+	
+	font->map = inFont->map;
+	font->umap = inFont->umap;
+	font->widths = inFont->widths;
+	font->borrowed = true;
+	font->cache = NULL;
+	font->cacheKey = 0;
+	
+	font->encoder = AddEncoder(inEncoding);
+	
+	font->bold = false;
+	font->italic = false;
+	
+	font->fi = inFont->fi;
+	font->fl = inFont->fl;
+	font->mapInPlace = inFont->mapInPlace;
+	
+	NameFont(font);
+	
+	mFontTable.push_back(font);
 }
-
+	
 CPDFParser::PDFFontObject*
 CPDFParser::GetFont(
 	const char* inKey)
@@ -2280,6 +4260,13 @@ CPDFParser::GetFont(
 	return mFontTable[inIndex];
 }
 
+CPDFParser::PDFFontObject*
+CPDFParser::ResolveFont(
+	const char* inKey)
+{
+	return GetFont(inKey);
+}
+
 void
 CPDFParser::FreeFonts()
 {
@@ -2291,18 +4278,23 @@ CPDFParser::FreeFonts()
 		
 		free(f->key);
 		free(f->baseFont);
+		free(f->name);
 		
 		if(f->family)
 			free(f->family);
 		
-		if(f->map)
-			free(f->map);
-		
-		if(f->umap)
-			free(f->umap);
-		
-		if(f->widths)
-			free(f->widths);
+		if(f->cache)
+			f->cache->Release(f->cacheKey);
+		else if(f->borrowed == false) {
+			if(f->map)
+				free(f->map);
+			
+			if(f->umap)
+				free(f->umap);
+			
+			if(f->widths)
+				free(f->widths);
+		}
 		
 		free(f);
 	}
@@ -2310,6 +4302,98 @@ CPDFParser::FreeFonts()
 	mFontTable.clear();
 }
 
+char*
+CPDFParser::FoldMaps(
+	wchar_t* unicode,
+	char* ansi,
+	TextEncoding encoding)
+{
+	char* map = ansi;
+	
+	unsigned char (*fold)(unsigned long) = UPDFUnicode::ToMacRoman;
+	if(encoding == kTextEncodingWindowsLatin1)
+		fold = UPDFUnicode::ToWinAnsi;
+	else if(encoding == kTextEncodingMacSymbol)
+		fold = UPDFUnicode::ToSymbol;
+	
+	for(long i = 0; i < 256; i++) {
+		if(unicode[i] == 0)
+			continue;
+			
+		unsigned char c = fold(unicode[i]);
+		if(c) {
+			if(map == NULL) {
+				map = (char*) malloc(256);
+				
+				if(map) {
+					for(long j = 0; j < 256; j++)
+						map[j] = j;
+				}
+			}
+			
+			if(map) {
+				map[i] = c;
+				unicode[i] = 0;
+			}
+		}
+	}
+		
+	return map;
+}
+
+bool
+CPDFParser::UnicodeMapIsValid(
+	wchar_t* map)
+{
+	for(long i = 0; i < 256; i++) {
+		if(map[i])
+			return true;
+	}
+	
+	return false;
+}
+
+char*
+CPDFParser::CharSetToMap(
+	const unsigned char* c,
+	size_t l)
+{
+	char* map = NULL;	
+	
+	long entry = 0;
+	
+	if(c) {
+		map = (char*) malloc(256);
+		
+		if(map) {
+			for(long j = 0; j < 256; j++)
+				map[j] = j;
+
+			char name[32];
+			size_t nindex = 0;
+			
+			for(size_t i = 0; i < l && entry < 256; i++) {
+				if(c[i] == '/' || i == l - 1) {
+					if(nindex) {
+						name[nindex] = 0;
+						char cm = UPDFMaps::NameToCode(UPDFMaps::kMacLatinMap, name);
+						if(cm)
+							map[entry] = cm;
+																					
+						entry++;
+					}
+					
+					nindex = 0;
+				}
+				else if(nindex < sizeof(name) - 1)
+					name[nindex++] = c[i];
+			}
+		}
+	}
+	
+	return map;
+}
+
 void
 CPDFParser::AddTab(
 	long inCol)
@@ -2326,7 +4410,6 @@ CPDFParser::GetTabString()
 	char* outTabs = NULL;
 	
 	long tabStringLength = 0;
-	char tabBuf[16];
 	
 	{
 		std::vector<long>::const_iterator i = mTabTable.begin();
@@ -2339,9 +4422,7 @@ CPDFParser::GetTabString()
 			if(mType == kWriteRTFWord)
 				tabValue -= mLeftMargin;
 				
-			sprintf(tabBuf, "\\tx%d", 20 * (int)tabValue);
-			
-			tabStringLength += strlen(tabBuf);
+			tabStringLength += 3 + UPDFFormat::AppendDecimal(NULL, 20 * tabValue);
 		}
 	}
 	
@@ -2364,11 +4445,8 @@ CPDFParser::GetTabString()
 			if(mType == kWriteRTFWord)
 				tabValue -= mLeftMargin;
 				
-			sprintf(tabBuf, "\\tx%d", 20 * (int)tabValue);
-			
-			long len = strlen(tabBuf);
-			memcpy(&(outTabs[tabStringLength]), tabBuf, len);
-			tabStringLength += len;
+			tabStringLength += UPDFFormat::AppendLiteral((unsigned char*) &(outTabs[tabStringLength]), "\\tx", 3);
+			tabStringLength += UPDFFormat::AppendDecimal((unsigned char*) &(outTabs[tabStringLength]), 20 * tabValue);
 		}
 		
 		outTabs[tabStringLength] = 0;
@@ -2435,16 +4513,12 @@ CPDFParser::AddEncoder(
 		
 		if(encoder) {
 			encoder->encoding = inEncoding;
-			encoder->tec = NULL;
+			encoder->converter = NULL;
 			
 			if(inEncoding != mEncodingOut) {
-#if defined(WIN32)
-				// todo: add .NET text encoding support
-#else
-				TECObjectRef tec;
-				if(::TECCreateConverter(&tec, inEncoding, mEncodingOut) == noErr)
-					encoder->tec = tec;
-#endif					
+				UPDFPlatform::TextConverter converter;
+				if(UPDFPlatform::CreateConverter(inEncoding, mEncodingOut, converter))
+					encoder->converter = converter;
 			}
 						
 			mEncoders.push_back(encoder);
@@ -2480,13 +4554,8 @@ CPDFParser::FreeEncoders()
 	for(i = mEncoders.begin(); i != mEncoders.end(); i++) {
 		e = *i;
 		
-		if(e->tec) {
-#if defined(WIN32)
-		// todo: add .NET text encoding support
-#else
-			::TECDisposeConverter(e->tec);
-#endif
-		}
+		if(e->converter)
+			UPDFPlatform::DisposeConverter(e->converter);
 		
 		free(e);
 	}
@@ -2730,7 +4799,7 @@ CPDFParser::CalcWhitespace()
 					
 					if(mLine && mPadLines) {
 						float fontsize = currentF;
-						if(mType < kWriteRTF || fequal_(fontsize, 0.0))
+						if(IsRTFType(mType) == false || fequal_(fontsize, 0.0))
 							fontsize = basey;
 							
 						float delta = leading * (currentY - t->y);
@@ -2780,11 +4849,11 @@ CPDFParser::CalcWhitespace()
 							long offset = w - currentCol;
 							
 							long midOffset = offset;
-							if(mType >= kWriteRTF && t->f > basef)
+							if(IsRTFType(mType) && t->f > basef)
 								midOffset = lroundf(((float) offset * basex) / t->f);
 																				
 							if(mRelaxSpacing || midOffset >= kMinMidlineSpacing) {
-								if(mType >= kWriteRTF && mPadStrip == false) {
+								if(IsRTFType(mType) && mPadStrip == false) {
 									AddTab(w);
 									currentCol = t->col;
 								}
@@ -2813,13 +4882,13 @@ CPDFParser::CalcWhitespace()
 		}
 	}
 	
-	if(mType >= kWriteRTF && mPadStrip == false)
+	if(IsRTFType(mType) && mPadStrip == false)
 		stable_sort(mTabTable.begin(), mTabTable.end(), CTabSorter()); // sort tab table
 	else {
 		mPageSpacing = 2;
 		
 		if(mLine) {
-			if(mType < kWriteRTF || fequal_(currentF, 0.0))
+			if(IsRTFType(mType) == false || fequal_(currentF, 0.0))
 				mPageSpacing = lroundf(leading * currentY * ys);
 			else
 				mPageSpacing = lroundf(leading * currentY / currentF);
@@ -2890,6 +4959,159 @@ CPDFParser::CalcExtraTabs()
 
 #pragma mark -
 
+void
+CPDFParser::StartBudget()
+{
+	mOverBudget = kWithinBudget;
+	mOperations = 0;
+	mRawPage = false;
+	
+	if(mBudget.maxMilliseconds) {
+		struct timeval now;
+		gettimeofday(&now, NULL);
+		
+		mPageStart = ((double) now.tv_sec * 1000.0) + ((double) now.tv_usec / 1000.0);
+	}
+}
+
+void
+CPDFParser::OverBudget(
+	long inLimit)
+{
+	if(mOverBudget == kWithinBudget)
+		mOverBudget = inLimit;
+}
+
+// Called as each text object is added; the clock is read every 256.
+void
+CPDFParser::CheckPageBudget()
+{
+	long objects = (mType == kWriteRawText ? mRawRuns : (long) mPageObjects.size());
+	
+	if(mBudget.maxTextObjects && objects >= mBudget.maxTextObjects)
+		OverBudget(kOverTextObjects);
+	else if(mBudget.maxPageBytes && mPageLength > mBudget.maxPageBytes)
+		OverBudget(kOverPageBytes);
+	else if((objects & 255) == 0)
+		CheckTime();
+}
+
+bool
+CPDFParser::CheckTime()
+{
+	if(mBudget.maxMilliseconds && mOverBudget == kWithinBudget) {
+		struct timeval now;
+		gettimeofday(&now, NULL);
+		
+		double elapsed = ((double) now.tv_sec * 1000.0) + ((double) now.tv_usec / 1000.0) - mPageStart;
+		
+		if(elapsed > (double) mBudget.maxMilliseconds)
+			OverBudget(kOverTime);
+	}
+	
+	return (mOverBudget != kWithinBudget);
+}
+
+// Parsing stopped when the budget ran out.  Either lay out what it got
+// without sorting, or replace the page with a marker; the event goes to
+// the owner's stats so page workers add up.
+void
+CPDFParser::DegradePage()
+{
+	CPDFParser* target = (mOwner ? mOwner : this);
+	PDFBudgetStats& stats = target->mBudgetStats;
+	
+	UPDFAtomic::Add(&(stats.pages), 1);
+	
+	switch(mOverBudget) {
+		case kOverOperations:
+			UPDFAtomic::Add(&(stats.operations), 1);
+			break;
+			
+		case kOverTextObjects:
+			UPDFAtomic::Add(&(stats.textObjects), 1);
+			break;
+			
+		case kOverPageBytes:
+			UPDFAtomic::Add(&(stats.pageBytes), 1);
+			break;
+			
+		case kOverTime:
+			UPDFAtomic::Add(&(stats.milliseconds), 1);
+			break;
+	}
+	
+	if(mBudget.degrade != kDegradeSkipPage) {
+		mRawPage = true;
+		return;
+	}
+	
+	UPDFAtomic::Add(&(stats.skipped), 1);
+	
+	FreeRuns();
+	
+	std::vector<PDFTextObject*>::const_iterator i = mPageObjects.begin();
+	PDFTextObject* t;
+
+	for(i = mPageObjects.begin(); i != mPageObjects.end(); i++) {
+		t = *i;
+
+		if(t->text)
+			free(t->text);
+			
+		free(t);
+	}
+	
+	mPageObjects.clear();
+	
+	mPageLength = 0;
+	mPageWeight = 0;
+	mPageWidths = 0;
+	
+	// raw text went straight into the page
+	if(mType == kWriteRawText) {
+		mDataSize = 0;
+		
+		mRawX = 0.0;
+		mRawY = 0.0;
+	}
+	
+	// the marker goes at the top left, in plain 12 point text; not at x 0,
+	// Normalize() takes a page with nothing right of 0 for a flipped one
+	mOverBudget = kWithinBudget;
+	
+	mFont = NULL;
+	mF = 1.0;
+	mFS = 12.0;
+	
+	mX = 1.0 + (mCrop ? mCropWidth : 0.0);
+	mY = (float) mPageHeight + (mCrop ? mCropHeight : 0.0);
+	mTrueY = mY;
+	
+	mAllWhitespace = false;
+	
+	if(mRecordRuns) {
+		InitChunker();
+		OpenChunker(sizeof(kBudgetMarker));
+		
+		if(c) {
+			memcpy(c, kBudgetMarker, sizeof(kBudgetMarker) - 1);
+			cd = sizeof(kBudgetMarker) - 1;
+			
+			RecordRun();
+		}
+		
+		CloseChunker();
+		
+		if(mDeferLayout)
+			return;
+	}
+	
+	AddTextToPage((unsigned char*) kBudgetMarker, sizeof(kBudgetMarker) - 1);
+}
+
+#pragma mark -
+
 void
 CPDFParser::InitMetrics()
 {
@@ -2921,6 +5143,7 @@ CPDFParser::InitChunker()
 {
 	c = NULL;
 	cd = 0;
+	cSize = 0;
 }
 
 void
@@ -2938,9 +5161,37 @@ CPDFParser::OpenChunker(
 		
 		c = (unsigned char *) malloc(inSize);
 		cd = 0;
+		cSize = (c ? inSize : 0);
 	}
 }
 
+// Makes room for inMore bytes after the cd already in the chunk.  A chunk
+// starts the size of the stream, which an escape for every character or a
+// wide kern can outgrow.
+bool
+CPDFParser::ReserveChunk(
+	long inMore)
+{
+	if(c == NULL)
+		return false;
+		
+	if(cd + inMore <= cSize)
+		return true;
+		
+	long size = cSize * 2;
+	if(size < cd + inMore)
+		size = cd + inMore;
+		
+	unsigned char* grown = (unsigned char*) realloc(c, size);
+	if(grown == NULL)
+		return false;
+		
+	c = grown;
+	cSize = size;
+	
+	return true;
+}
+
 void
 CPDFParser::CloseChunker()
 {
@@ -2949,12 +5200,22 @@ CPDFParser::CloseChunker()
 		c = NULL;
 
 		cd = 0;
+		cSize = 0;
 	}
 }
 
 void
 CPDFParser::ProcessChunk()
 {
+	if(mRecordRuns) {
+		RecordRun();
+		
+		if(mDeferLayout) {
+			CloseChunker();
+			return;
+		}
+	}
+	
 	mTrueY = mY;
 	
 	if(mAllWhitespace == false && cd <= kMinScriptLength && mX > mLastX + EPS && fequal_(mLastY, 0.0) == false) {
@@ -3048,6 +5309,7 @@ CPDFParser::PadChunk(
 	if(bufferSize) {					
 		free(c);
 		c = buffer;
+		cSize = cd + (cd * pad);
 		cd = bufferSize;
 	}
 	else
@@ -3061,6 +5323,9 @@ CPDFParser::AddTextToPage(
 	unsigned char* inText,
 	long inSize)
 {
+	if(mOverBudget)
+		return NULL;
+		
 	bool killBuffer = false;
 	
 	long width = 0; // actual number of characters to fit when rendering
@@ -3161,7 +5426,7 @@ CPDFParser::AddTextToPage(
 		}
 		
 		if(mFont) {
-			if(mType >= kWriteRTF && mFont->widths)
+			if((IsRTFType(mType) || mType == kWriteRawText) && mFont->widths)
 				textWidth = GetTextWidth(inText, inSize);
 				
 			unsigned char* map = Map(inText, inSize);
@@ -3187,7 +5452,7 @@ CPDFParser::AddTextToPage(
 		width = inSize;
 		
 		if(mFont) {
-			if(mType >= kWriteRTF && mFont->widths)
+			if((IsRTFType(mType) || mType == kWriteRawText) && mFont->widths)
 				textWidth = GetTextWidth(inText, inSize);
 
 			unsigned char* map = Map(inText, inSize);
@@ -3236,12 +5501,25 @@ CPDFParser::AddTextToPage(
 		}
 	}
 	
+	if(mType == kWriteRawText) {
+		float f = mF * mFS;
+		float runWidth = (mFont && mFont->widths ? f * (textWidth / 1000.0) : f * ((float) inSize * .5));
+		
+		AppendRawText(inText, inSize, pagex, pagey, runWidth);
+		
+		if(killBuffer)
+			free(inText);
+			
+		return NULL;
+	}
+	
 	PDFTextObject* t = (PDFTextObject*) malloc(sizeof(PDFTextObject));
 
 	if(t) {
-		t->pre = NULL;
+		t->tag.font = NULL;
+		t->tag.pre = 0;
+		t->tag.post = 0;
 		t->preSize = 0;
-		t->post = NULL;
 		t->postSize = 0;
 
 #ifdef SHOWCOORDS		
@@ -3261,7 +5539,7 @@ CPDFParser::AddTextToPage(
 			t->ws = mAllWhitespace;
 			
 			t->tx = t->x;
-			if(mType >= kWriteRTF) {
+			if(IsRTFType(mType)) {
 				if(mFont && mFont->widths)
 					t->tx += (t->f * (textWidth / 1000.0));
 				else
@@ -3280,6 +5558,7 @@ CPDFParser::AddTextToPage(
 			mPageWidths += t->width;
 			
 			mPageObjects.push_back(t);
+			CheckPageBudget();
 						
 			return t;
 		}
@@ -3296,7 +5575,7 @@ CPDFParser::AddTextToPage(
 			t->ws = mAllWhitespace;
 
 			t->tx = t->x;
-			if(mType >= kWriteRTF) {
+			if(IsRTFType(mType)) {
 				if(mFont && mFont->widths)
 					t->tx += (t->f * (textWidth / 1000.0));
 				else
@@ -3319,6 +5598,7 @@ CPDFParser::AddTextToPage(
 			mPageWidths += t->width;
 			
 			mPageObjects.push_back(t);
+			CheckPageBudget();
 			
 			return t;
 		}
@@ -3333,6 +5613,108 @@ CPDFParser::AddTextToPage(
 	return NULL;
 }
 
+// Writes a run straight into the page, in the order the content stream
+// shows it.  A baseline that moved by more than half the font size starts
+// a new line; a gap wider than a thin space, or a step back along the
+// same line, is one space.
+void
+CPDFParser::AppendRawText(
+	const unsigned char* inText,
+	long inSize,
+	float inX,
+	float inY,
+	float inWidth)
+{
+	if(inSize <= 0)
+		return;
+		
+	unsigned char last = (mDataSize ? mData[mDataSize - 1] : '\n');
+	
+	if(mAllWhitespace) {
+		if(last != ' ' && last != '\n')
+			AppendRaw(" ", 1);
+			
+		return;
+	}
+	
+	if(mDataSize) {
+		float size = mF * mFS;
+		
+		if(size < 1.0)
+			size = 1.0;
+		
+		if(fabsf(inY - mRawY) > size * .5) {
+			if(last == ' ')
+				mDataSize--;
+				
+			AppendRaw("\n", 1);
+		}
+		else if(last != ' ' && isspace(inText[0]) == false) {
+			if(inX > mRawX + (size * .15) || inX < mRawX - size)
+				AppendRaw(" ", 1);
+		}
+	}
+	
+	if(AppendRaw(inText, inSize)) {
+		mPageLength += inSize;
+		mRawRuns++;
+		
+		CheckPageBudget();
+	}
+	
+	mRawX = inX + inWidth;
+	mRawY = inY;
+}
+
+bool
+CPDFParser::AppendRaw(
+	const void* inData,
+	long inSize)
+{
+	if(mDataSize + inSize > mRawCapacity) {
+		long capacity = (mRawCapacity ? mRawCapacity * 2 : 32767L);
+		while(capacity < mDataSize + inSize)
+			capacity *= 2;
+			
+		unsigned char* data = (unsigned char*) realloc(mData, capacity);
+		if(data == NULL)
+			return false;
+			
+		mData = data;
+		mRawCapacity = capacity;
+	}
+	
+	memcpy(&(mData[mDataSize]), inData, inSize);
+	mDataSize += inSize;
+	
+	return true;
+}
+
+OSErr
+CPDFParser::FinishRawText()
+{
+	if(mData && DidAbort()) {
+		free(mData);
+		mData = NULL;
+		mDataSize = 0;
+		
+		return kUserAbort;
+	}
+	
+	if(mData) {
+		// pages end on a line of their own
+		if(mDataSize && mData[mDataSize - 1] == ' ')
+			mDataSize--;
+			
+		if(mDataSize && mData[mDataSize - 1] != '\n')
+			AppendRaw("\n", 1);
+			
+		FixNewlines();
+	}
+	
+	return kNoError;
+}
+
 long
 CPDFParser::MapUnicode(
 	wchar_t inCode)
@@ -3383,7 +5765,8 @@ CPDFParser::Map(
 		return inText;
 	}*/	
 		
-	unsigned char* buffer = (unsigned char*) malloc(inSize * 10);
+	// a code can take two {\uN?} groups of ten bytes
+	unsigned char* buffer = (unsigned char*) malloc(inSize * 20);
 	if(buffer == NULL)
 		return inText;
 		
@@ -3393,15 +5776,22 @@ CPDFParser::Map(
 		wchar_t u = (mFont->umap ? mFont->umap[inText[i]] : 0);
 		
 		if(u) {
-			if(mType >= kWriteRTF) {
-				char us[16];
-				sprintf(us, "{\\u%d?}", u);
+			if(IsRTFType(mType)) {
+				// characters past the BMP go out as a surrogate pair
+				wchar_t pair[2] = { u, 0 };
+				if(u > 0xFFFF) {
+					pair[0] = 0xD800 + ((u - 0x10000) >> 10);
+					pair[1] = 0xDC00 + ((u - 0x10000) & 0x3FF);
+				}
 				
-				long len = strlen(us);
-				memcpy(&(buffer[bufferSize]), us, len);
-				bufferSize += len;
+				for(long j = 0; j < 2 && pair[j]; j++) {
+					bufferSize += UPDFFormat::AppendLiteral(&(buffer[bufferSize]), "{\\u", 3);
+					bufferSize += UPDFFormat::AppendDecimal(&(buffer[bufferSize]), pair[j]);
+					buffer[bufferSize++] = '?';
+					buffer[bufferSize++] = '}';
+				}
 			}
-			else if(mType == kWritePlainText)
+			else if(mType == kWritePlainText || mType == kWriteRawText)
 				inText[i] = '\245';
 			else
 				inText[i] = '-';
@@ -3440,12 +5830,16 @@ CPDFParser::Encode(
 {
 	PDFEncoder* encoder = mFont->encoder;
 			
+	if(encoder == NULL)
+		return inText;
+		
+	// converters keep state, a page worker uses its own
+	if(mOwner)
+		encoder = AddEncoder(encoder->encoding);
+		
 	if(encoder == NULL)
 		return inText;
 								
-#if defined(WIN32)
-		// todo: add .NET text encoding support
-#else
 	if(mEncodingOut == kEncodeASCII) {
 		unsigned char bullet = (encoder->encoding == kEncodeMacSymbol ? '\267' : '\245');
 		
@@ -3455,10 +5849,7 @@ CPDFParser::Encode(
 		}
 	}
 	
-	TECObjectRef tec = encoder->tec;
-	if(tec) {
-		bool didEncode = false;
-		
+	if(encoder->converter) {
 		long bufferSize = inSize * 8;
 		if(bufferSize < 32)
 			bufferSize = 32;
@@ -3466,26 +5857,16 @@ CPDFParser::Encode(
 		unsigned char* buffer = (unsigned char*) malloc(bufferSize);
 		
 		if(buffer) {	
-			ByteCount encodedIn = 0;
-			ByteCount encodedOut = 0;
-			ByteCount flushedOut = 0;
-				
-			if(::TECConvertText(tec, inText, inSize, &encodedIn, buffer, bufferSize, &encodedOut) == noErr) {
-				if(::TECFlushText(tec, &(buffer[encodedOut]), bufferSize - encodedOut, &flushedOut) == noErr)
-					didEncode = true;
-			}
-		
-			::TECClearConverterContextInfo(tec);			
+			size_t encodedSize = 0;
 			
-			if(didEncode) {
-				inSize = encodedOut + flushedOut;
+			if(UPDFPlatform::ConvertText(encoder->converter, inText, inSize, buffer, bufferSize, encodedSize)) {
+				inSize = encodedSize;
 				return buffer;
 			}
 			
 			free(buffer);
 		}
 	}
-#endif
 
 	return inText;	
 }
@@ -6,20 +6,16 @@
 #define _H_CPDFParser
 #pragma once
 
-#if defined(WIN32)
-	// todo: add .NET text encoding support
-#else
-	#ifdef __GNUC__
-		#include <CoreServices/CoreServices.h>
-	#else
-		#include <CarbonCore/TextCommon.h>
-		#include <CarbonCore/TextEncodingConverter.h>
-	#endif
-#endif
+#include "UPDFAtomic.h"
+#include "UPDFPlatform.h"
 
 #include <math.h>
 #include <vector>
 
+class COutputSink;
+class CPDFFontCache;
+class CPDFPageCache;
+
 #define EPS				.01
 #define fequal_(x, y)	(-EPS < x - y && x - y < EPS)
 #define istoken_(c)		(c == '\\' || c == '{' || c == '}')
@@ -34,17 +30,35 @@ const long		kMaxOperands		= 6;
 
 const long		kMaxQDepth			= 8;
 
-#if defined(WIN32)
-typedef UInt32 TextEncoding;
+// same as the main thread, Parse() recurses through nested forms
+const size_t	kRenderStackSize	= 8 * 1024 * 1024;
 
-enum {
-	kTextEncodingMacRoman = 0,
-	kTextEncodingWindowsANSI,
-	kTextEncodingUS_ASCII,
-	kTextEncodingMacSymbol,
-	kTextEncodingMacDingbats,
+// content bytes parsed between checks for a cancel, well under 10 ms
+const long		kCancelBytes		= 64 * 1024;
+
+// Cancels every conversion it is given to, from any thread.  One token
+// can be shared by several parsers, a batch for instance.
+class CPDFCancelToken {
+public:
+	CPDFCancelToken() :
+			mCancelled(0) {
+	}
+	
+	void Cancel() {
+		UPDFAtomic::Store(&mCancelled, 1);
+	}
+	
+	void Reset() {
+		UPDFAtomic::Store(&mCancelled, 0);
+	}
+	
+	bool IsCancelled() {
+		return (UPDFAtomic::Load(&mCancelled) != 0);
+	}
+	
+private:
+	volatile long mCancelled;
 };
-#endif
 
 class CPDFParser {
 public:
@@ -74,8 +88,9 @@ public:
 		kWriteXML,
 		kWritePropertyList,
 		kWriteHTML,
-		kWriteRTF, // must be penultimate
-		kWriteRTFWord // must be ultimate
+		kWriteRTF,
+		kWriteRTFWord,
+		kWriteRawText = 7 // runs in reading order, no layout
 	};
 	
 	enum {
@@ -103,12 +118,9 @@ public:
 	
 	struct PDFEncoder {
 		TextEncoding encoding;
-
-#if defined(WIN32)
-		// todo: add .NET text encoding support
-#else
-		TECObjectRef tec;
-#endif
+		
+		// NULL when the text is written as it is
+		UPDFPlatform::TextConverter converter;
 	};
 	
 	struct PDFXObject {
@@ -122,6 +134,7 @@ public:
 
 		char* key;
 		char* baseFont;
+		char* name; // baseFont as the document has it, before NameFont()
 	
 		char* map;
 		wchar_t* umap;
@@ -139,7 +152,41 @@ public:
 		unsigned char fl;
 		
 		bool mapInPlace;
+		bool borrowed; // map, umap and widths belong to another parser's font
+		
+		// set when map, umap and widths belong to a font cache entry
+		CPDFFontCache* cache;
+		UInt64 cacheKey;
+		
 		//char reserved[30];
+		
+		// precomputed rtf font tag (\fN)
+		char tag[16];
+		long tagSize;
+		
+		long faceSize;
+	};
+
+	enum {
+		kTagBoldOff = 0x0001,
+		kTagItalicOff = 0x0002,
+		kTagFontClose = 0x0004,
+		kTagFont = 0x0008,
+		kTagSize = 0x0010,
+		kTagBold = 0x0020,
+		kTagItalic = 0x0040,
+		kTagSuper = 0x0080,
+		kTagSub = 0x0100
+	};
+	
+	struct PDFTagObject {
+		PDFFontObject* font;
+		
+		unsigned short pre;
+		unsigned short post;
+		
+		long size;
+		long spacing;
 	};
 
 	struct PDFTextObject {
@@ -155,10 +202,9 @@ public:
 		
 		PDFFontObject* font;
 		
-		char* pre;
+		// tag deltas, expanded by ExpandTags() when the page is written
+		PDFTagObject tag;
 		long preSize;
-		
-		char* post;
 		long postSize;	
 			
 		// post processing	
@@ -171,6 +217,123 @@ public:
 		unsigned char* data;
 		long dataSize;
 	};
+	
+	// a rendered page, ready to be framed and written
+	struct PDFPageOutput {
+		unsigned char* data;
+		long dataSize;
+		
+		char* tabs;
+		
+		long topMargin;
+		long leftMargin;
+		long pageWidth;
+		long pageHeight;
+		
+		// the page's runs packed for a page cache, or NULL
+		unsigned char* model;
+		long modelSize;
+	};
+	
+	// a chunk of text as Parse() found it, unescaped, with the state it was
+	// shown in; a page parsed once replays into as many outputs as needed
+	struct PDFRun {
+		unsigned char* text;
+		long size;
+		
+		float x;
+		float y;
+		float f;
+		float fs;
+		float l;
+		float tc;
+		float tw;
+		
+		long font; // index into the font table, -1 for none
+	};
+	
+	// one destination of ConvertPathToOutputs()
+	struct PDFOutput {
+		long type;
+		COutputSink* sink;
+		OSErr error;
+	};
+	
+	// one entry of SetPageRanges(), 1-based; a last of 0 runs to the end
+	struct PDFPageRange {
+		size_t first;
+		size_t last;
+	};
+	
+	enum {
+		kDegradeRawText = 0,	// keep what was parsed, unsorted
+		kDegradeSkipPage		// drop the page, leave a marker
+	};
+	
+	// per page limits for broken or hostile content streams, 0 is no limit
+	struct PDFBudget {
+		long maxOperations;		// content stream operators and operands
+		long maxTextObjects;
+		long maxPageBytes;		// text collected for the page
+		long maxMilliseconds;	// parsing only
+		long degrade;
+	};
+	
+	// pages that ran over, in total and by the limit hit first
+	struct PDFBudgetStats {
+		long pages;
+		long operations;
+		long textObjects;
+		long pageBytes;
+		long milliseconds;
+		long skipped;
+	};
+	
+	// Stops a conversion once any limit is reached, 0 being no limit.  The
+	// page that reaches it is the last one written, and the output is
+	// finished off as if it were the last page of the document.
+	struct PDFPreview {
+		long maxBytes;		// written to the sink, markup included
+		long maxChars;		// page text
+		long maxPages;
+	};
+	
+	// the option setters in one place, for handing a configuration around
+	struct PDFOptions {
+		bool padStripping;
+		bool rewrapping;
+		bool relaxSpacing;
+		bool tightSpacing;
+		bool sorting;
+		bool showBreaks;
+		char newlineCode;
+		long renderThreads;
+		bool streaming;
+		PDFBudget budget;
+		PDFPreview preview;
+	};
+	
+	typedef void (*PDFProgressProc)(
+		long inProgress,
+		long inMaxProgress,
+		void* inRefCon);
+	
+	enum {
+		kPhaseIdle = 0,
+		kPhaseOpening,	// document setup and the font table
+		kPhaseParsing,
+		kPhaseLayout,
+		kPhaseWriting,
+		kPhaseDone
+	};
+	
+	// a snapshot of a conversion in progress, see GetProgress()
+	struct PDFProgress {
+		long pages;		// -1 while opening
+		long maxPages;
+		long bytes;		// content stream bytes parsed
+		long phase;		// latest phase entered on any render thread
+	};
 
 public:
 	CPDFParser();
@@ -180,12 +343,26 @@ public:
 		return mType;
 	}
 
+	// preferences and -t store types by number, so a new type takes the
+	// next value and RTF is tested by name rather than as a range
+	static bool IsRTFType(long inType) {
+		return (inType == kWriteRTF || inType == kWriteRTFWord);
+	}
+
 	void Abort() {
-		mAbort = true;
+		UPDFAtomic::Store(&mAbort, 1);
 	}
 
 	bool DidAbort() {
-		return mAbort;
+		if(UPDFAtomic::Load(&mAbort) || (mCancel && mCancel->IsCancelled()))
+			return true;
+			
+		return (mOwner && mOwner->DidAbort());
+	}
+	
+	// checked between pages and every kCancelBytes while parsing one
+	void SetCancelToken(CPDFCancelToken* inToken) {
+		mCancel = inToken;
 	}
 	
 	void Restrict() {
@@ -237,6 +414,14 @@ public:
 		return mSort;
 	}
 	
+	void SetShowBreaks(bool inSet) {
+		mShowBreaks = inSet;
+	}
+	
+	bool GetShowBreaks() {
+		return mShowBreaks;
+	}
+	
 	void SetNewlineCode(char inSet) {
 		mNewlineCode = inSet;
 	}
@@ -244,6 +429,148 @@ public:
 	char GetNewlineCode() {
 		return mNewlineCode;
 	}
+	
+	// threads rendering pages while the calling thread writes them: 0, the
+	// default, does everything on the calling thread, 1 pipelines rendering
+	// with writing, more render pages side by side; both need
+	// CreatePageWorker()
+	void SetRenderThreads(long inCount) {
+		mRenderThreads = (inCount < 0 ? 0 : inCount);
+	}
+	
+	long GetRenderThreads() {
+		return mRenderThreads;
+	}
+	
+	// flushes the sink after the header and after every page, so a reader
+	// on the other end sees each page as soon as it is written; the trailer
+	// still closes the output when a conversion is cancelled part way
+	void SetStreaming(bool inSet) {
+		mStreaming = inSet;
+	}
+	
+	bool GetStreaming() {
+		return mStreaming;
+	}
+	
+	// converts pages inFirst through inLast (1-based) as a slice of the
+	// whole document, so slices written one after another make up the
+	// full conversion; 0 converts everything
+	void SetPageRange(size_t inFirst, size_t inLast = 0) {
+		mFirstPage = inFirst;
+		mLastPage = inLast;
+		
+		mPageRanges.clear();
+	}
+	
+	// Converts just the pages in the ranges, in the order given, as a
+	// document of their own with its header and trailer.  Only those pages
+	// are parsed and only the fonts they use extracted, so a few pages of a
+	// long document cost what a short one does.  NULL or a count of 0
+	// converts everything; replaces any SetPageRange().
+	void SetPageRanges(
+		const PDFPageRange* inRanges,
+		long inCount);
+		
+	long GetPageRangeCount() {
+		return (long) mPageRanges.size();
+	}
+	
+	void SetBudget(const PDFBudget& inBudget) {
+		mBudget = inBudget;
+	}
+	
+	void GetBudget(PDFBudget& outBudget) {
+		outBudget = mBudget;
+	}
+	
+	// safe to poll from another thread
+	void GetBudgetStats(
+		PDFBudgetStats& outStats);
+		
+	void SetPreview(const PDFPreview& inPreview) {
+		mPreview = inPreview;
+	}
+	
+	void GetPreview(PDFPreview& outPreview) {
+		outPreview = mPreview;
+	}
+	
+	// whether the last conversion stopped at a preview limit
+	bool DidStopForPreview() {
+		return mPreviewDone;
+	}
+	
+	// pages the last conversion wrote
+	long GetPagesEmitted() {
+		return mPagesEmitted;
+	}
+	
+	void SetOptions(
+		const PDFOptions& inOptions);
+		
+	void GetOptions(
+		PDFOptions& outOptions);
+		
+	// a cache opened with CPDFPageCache::Create() that a conversion of the
+	// whole document fills as it parses; NULL for none
+	void SetPageCache(CPDFPageCache* inCache) {
+		mPageCache = inCache;
+	}
+	
+	// fonts are looked up in and added to the cache, and shared with other
+	// parsers using it; NULL for none
+	void SetFontCache(CPDFFontCache* inCache) {
+		mFontCache = inCache;
+	}
+	
+	CPDFFontCache* GetFontCache() {
+		return mFontCache;
+	}
+		
+	// portable entry points, implemented by the platform parsers; a title
+	// is escaped for HTML and RTF but must be in the output's encoding,
+	// ISO Latin-1 for HTML and Mac Roman for RTF
+	virtual OSErr ConvertPath(
+		const char* inPath,
+		long inType,
+		COutputSink* inSink,
+		const char* inTitle = NULL) {
+		return kConvertError;
+	}
+	
+	virtual OSErr CountPages(
+		const char* inPath,
+		size_t& outCount) {
+		return kConvertError;
+	}
+	
+	// parses the document once and writes every output from it; each
+	// output gets its own error, the first of which is returned
+	virtual OSErr ConvertPathToOutputs(
+		const char* inPath,
+		PDFOutput* ioOutputs,
+		long inCount,
+		const char* inTitle = NULL) {
+		return kConvertError;
+	}
+	
+	// progress, -1 while preprocessing; safe to poll from another thread
+	void SetProgressProc(PDFProgressProc inProc, void* inRefCon = NULL) {
+		mProgressProc = inProc;
+		mProgressRefCon = inRefCon;
+	}
+	
+	long GetProgress() {
+		return UPDFAtomic::Load(&mProgress);
+	}
+	
+	long GetMaxProgress() {
+		return UPDFAtomic::Load(&mMaxProgress);
+	}
+	
+	void GetProgress(
+		PDFProgress& outProgress);
 		
 protected:
 	virtual OSErr BeginRender(
@@ -255,7 +582,43 @@ protected:
 	
 	virtual void EndRender() = 0;
 	
+	// document hooks
+	virtual void BeginDocument() {
+	}
+	
+	// the pages SetPageRanges() picked, in the order they are converted;
+	// false when the whole document or a slice of it is
+	bool GetSelectedPages(
+		std::vector<size_t>& outPages);
+	
+	virtual void DidRenderPage(
+		size_t inPage,
+		size_t inPageCount) {
+	}
+	
+	// a parser on the same document that can render pages on another
+	// thread, or NULL to render them in sequence
+	virtual CPDFParser* CreatePageWorker() {
+		return NULL;
+	}
+	
+	void JoinDocument(
+		CPDFParser* inOwner);
+	
+	// gives the owner's fonts back and frees the ones resolved here
+	void LeaveDocument();
+	
 protected:
+	// converting
+	OSErr ConvertDocument(
+		COutputSink* inSink,
+		const char* inTitle = NULL);
+		
+	OSErr ConvertOutputs(
+		PDFOutput* ioOutputs,
+		long inCount,
+		const char* inTitle = NULL);
+		
 	// rendering
 	OSErr RenderPage(
 		size_t inPage);
@@ -264,6 +627,11 @@ protected:
 
 	void ObjectsToHTML();
 
+	long ExpandTags(
+		const PDFTextObject* inObject,
+		bool inPost,
+		unsigned char* outText = NULL);
+
 	bool Strip();
 	
 	bool Clean();
@@ -276,6 +644,13 @@ protected:
 	
 	void FixNewlines();
 	
+	void ReportProgress(
+		long inProgress,
+		long inMaxProgress);
+	
+	void SetPhase(
+		long inPhase);
+	
 	void SetPageCount(size_t inCount) {
 		mPageCount = inCount;
 	}
@@ -301,6 +676,10 @@ protected:
 		mEncodingOut = inEncoding;
 	}
 	
+	// the type and the text encoding it is written in
+	void SetOutputType(
+		long inType);
+	
 	// parsing
 	unsigned char* Extract(
 		const unsigned char* p,
@@ -339,7 +718,33 @@ protected:
 		wchar_t* inUMap,
 		float* inWidths,
 		unsigned char inFI = 0,
-		unsigned char inFL = 0);
+		unsigned char inFL = 0,
+		UInt64 inCacheKey = 0);
+	
+	// adds the font cache's font for the key; false if it has none
+	bool AddCachedFont(
+		const char* inKey,
+		UInt64 inCacheKey);
+	
+	void NameFont(
+		PDFFontObject* ioFont);
+	
+	void CopyFont(
+		const PDFFontObject* inFont,
+		TextEncoding inEncoding);
+	
+	void CloneFonts(
+		CPDFParser* inOwner);
+	
+	PDFFontObject* NewFont(
+		const char* inKey,
+		const char* inBaseFont,
+		const char* inEncoding,
+		char* inMap,
+		wchar_t* inUMap,
+		float* inWidths,
+		unsigned char inFI,
+		unsigned char inFL);
 	
 	PDFFontObject* GetFont(
 		const char* inKey);
@@ -347,6 +752,26 @@ protected:
 	PDFFontObject* GetFont(
 		long inIndex);
 		
+	// shared by the platform parsers' font extraction: folds what a font's
+	// ToUnicode map can say in the output encoding into its byte map
+	static char* FoldMaps(
+		wchar_t* unicode,
+		char* ansi,
+		TextEncoding encoding = kTextEncodingMacRoman);
+	
+	static bool UnicodeMapIsValid(
+		wchar_t* map);
+		
+	// a FontDescriptor's /CharSet, the glyph names in code order
+	static char* CharSetToMap(
+		const unsigned char* c,
+		size_t l);
+		
+	// the font a Tf on the current page names; platform parsers that
+	// extract fonts as pages use them (mLazyFonts) find it here
+	virtual PDFFontObject* ResolveFont(
+		const char* inKey);
+		
 	long GetFontCount() {
 		return mFontTable.size();
 	}
@@ -397,9 +822,141 @@ protected:
 	long GetPageHeight() {
 		return mPageHeight;
 	}
+	
+	// replaying
+	void ShowRun(
+		const PDFRun* inRun);
+	
+	// lay out the page without sorting, as if it had run over budget
+	void SetRawPage(bool inSet) {
+		mRawPage = inSet;
+	}
 		
 private:
+	struct PDFRenderState;
+	struct PDFPipeline;
+
+	// converting
+	
+	// pages first through last in sequence; pages is the count EmitPage()
+	// is given, so a break follows every page before it
+	struct PDFPageSpan {
+		size_t first;
+		size_t last;
+		size_t pages;
+	};
+	
+	bool GetPageSpans(
+		std::vector<PDFPageSpan>& outSpans,
+		bool& outHeader,
+		bool& outTrailer,
+		size_t& outSavePages);
+		
+	bool IsWholeDocument(
+		const std::vector<PDFPageSpan>& inSpans,
+		bool inHeader,
+		bool inTrailer);
+		
+	OSErr EmitHeader(
+		COutputSink* inSink,
+		const char* inTitle);
+		
+	OSErr EmitTitle(
+		COutputSink* inSink,
+		const char* inTitle);
+		
+	OSErr EmitTrailer(
+		COutputSink* inSink);
+		
+	OSErr ConvertPages(
+		COutputSink* inSink,
+		size_t inFirst,
+		size_t inLast,
+		size_t inPages,
+		size_t inSavePages,
+		long& ioDataBytes);
+		
+	bool EndsPreview(
+		long inPages,
+		long inDataBytes,
+		long inBytes,
+		long inPageBytes);
+		
+	OSErr EmitPage(
+		COutputSink* inSink,
+		PDFPageOutput& inPage,
+		size_t inPageIndex,
+		size_t inPages,
+		size_t inSavePages,
+		long& ioDataBytes);
+		
+	void TakePageOutput(
+		PDFPageOutput& outPage);
+		
+	// one parse, many outputs
+	void JoinOutput(
+		CPDFParser* inOwner,
+		long inType);
+		
+	void ReplayPage(
+		CPDFParser* inOwner,
+		OSErr inError,
+		float width,
+		float height);
+		
+	void RecordRun();
+	
+	void PackPage(
+		OSErr inError,
+		float width,
+		float height);
+	
+	void FinishPageCache(
+		bool inComplete);
+	
+	void FreeRuns();
+		
+	// threaded rendering
+	PDFRenderState* StartWorkers(
+		size_t inFirst,
+		size_t inLast);
+		
+	void StopWorkers(
+		PDFRenderState* inState);
+		
+	static void* RenderThread(
+		void* inInfo);
+		
+	PDFPipeline* StartPipeline(
+		size_t inFirst,
+		size_t inLast);
+		
+	void StopPipeline(
+		PDFPipeline* inPipeline);
+		
+	static void* PipelineThread(
+		void* inInfo);
+	
 	// rendering
+	OSErr ParsePage(
+		size_t inPage,
+		float& outWidth,
+		float& outHeight);
+		
+	void ResetPage();
+	
+	void StartPage(
+		float& ioWidth,
+		float& ioHeight);
+		
+	void SetupGrid(
+		float width,
+		float height);
+		
+	OSErr LayoutPage(
+		float width,
+		float height);
+		
 	void Normalize(
 		float width,
 		float height);
@@ -412,6 +969,32 @@ private:
 	
 	void CalcExtraTabs();
 	
+	// budgets
+	void StartBudget();
+	
+	void OverBudget(
+		long inLimit);
+	
+	void CheckPageBudget();
+	
+	bool CheckTime();
+	
+	void DegradePage();
+	
+	// raw text
+	void AppendRawText(
+		const unsigned char* inText,
+		long inSize,
+		float inX,
+		float inY,
+		float inWidth);
+		
+	bool AppendRaw(
+		const void* inData,
+		long inSize);
+		
+	OSErr FinishRawText();
+	
 	// parsing
 	void InitMetrics();
 
@@ -422,6 +1005,9 @@ private:
 
 	void CloseChunker();
 
+	bool ReserveChunk(
+		long inMore);
+
 	void ProcessChunk();
 		
 	void PadChunk(
@@ -455,9 +1041,21 @@ protected:
 	long mType;
 	size_t mPageCount;
 	
-	bool mAbort;
+	volatile long mAbort;
 	bool mRestrict;
 	
+	CPDFCancelToken* mCancel;
+	
+	// set on page workers, which follow their owner's abort
+	CPDFParser* mOwner;
+	
+	volatile long mProgress;
+	volatile long mMaxProgress;
+	volatile long mPhase;
+	volatile long mBytesParsed;
+	PDFProgressProc mProgressProc;
+	void* mProgressRefCon;
+	
 	// rendering
 	bool mCrop;
 	float mCropWidth;
@@ -474,7 +1072,23 @@ protected:
 	bool mRelaxSpacing;
 	bool mTightSpacing; // 1.4
 	bool mSort;
+	bool mShowBreaks;
 	char mNewlineCode;
+	long mRenderThreads;
+	bool mStreaming;
+	
+	size_t mFirstPage;
+	size_t mLastPage;
+	std::vector<PDFPageRange> mPageRanges;
+	
+	PDFBudget mBudget;
+	PDFBudgetStats mBudgetStats;
+	
+	// what this parser has written of the current conversion
+	PDFPreview mPreview;
+	long mBytesEmitted;
+	long mPagesEmitted;
+	bool mPreviewDone;
 	
 	bool mFontChanges;
 	bool mSizeChanges;
@@ -489,6 +1103,16 @@ protected:
 	
 	bool mParseIntoStore;
 	std::vector<StoreObject*> mStore;
+	
+	// pages are kept as runs for a page cache or ConvertOutputs(), which
+	// defers laying them out to its outputs
+	bool mRecordRuns;
+	bool mDeferLayout;
+	std::vector<PDFRun*> mPageRuns;
+	
+	CPDFPageCache* mPageCache;
+	unsigned char* mPageModel;
+	long mPageModelSize;
 
 		// persist over page
 	std::vector<PDFTextObject*> mPageObjects;
@@ -496,6 +1120,14 @@ protected:
 	
 		// persist over document
 	std::vector<PDFFontObject*> mFontTable;
+	CPDFFontCache* mFontCache;
+	
+	// fonts are added as pages name them rather than all up front, which
+	// only outputs without a document font table allow; the first
+	// mJoinedFonts belong to the owner
+	bool mLazyFonts;
+	size_t mJoinedFonts;
+	
 	std::vector<PDFXObject*> mObjectTable;
 	std::vector<PDFEncoder*> mEncoders;
 
@@ -528,6 +1160,7 @@ private:
 
 	unsigned char* c;
 	long cd;
+	long cSize; // room in c
 
 	long mHexStart;
 	long mQDepth;
@@ -568,6 +1201,18 @@ private:
 	
 	unsigned long mParseBytes;
 	
+	// page budget, the limit that ran out first or 0 while within it
+	long mOverBudget;
+	long mOperations;
+	double mPageStart;
+	bool mRawPage;
+	
+	// kWriteRawText, where the last run ended and how much mData holds
+	float mRawX;
+	float mRawY;
+	long mRawRuns;
+	long mRawCapacity;
+	
 	// page info
 	long mTopMargin;
 	long mLeftMargin;
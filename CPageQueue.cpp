@@ -0,0 +1,98 @@
+// Trapeze
+//
+// Copyright (c) 2004 Mesa Dynamics, LLC.  All rights reserved.
+
+#include "CPageQueue.h"
+
+#include <sched.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+CPageQueue::CPageQueue(
+	long inCapacity) :
+		mSlots(NULL),
+		mCapacity(2),
+		mHead(0),
+		mTail(0),
+		mClosed(0)
+{
+	while(mCapacity < inCapacity)
+		mCapacity <<= 1;
+		
+	mSlots = (CPDFParser::PDFPageOutput*) calloc(mCapacity, sizeof(CPDFParser::PDFPageOutput));
+	if(mSlots == NULL)
+		mCapacity = 0;
+}
+
+CPageQueue::~CPageQueue()
+{
+	if(mSlots) {
+		// pages nobody took
+		for(long i = mHead; i != mTail; i++) {
+			CPDFParser::PDFPageOutput& page = mSlots[i & (mCapacity - 1)];
+			
+			if(page.data)
+				free(page.data);
+				
+			if(page.tabs)
+				free(page.tabs);
+				
+			if(page.model)
+				free(page.model);
+		}
+		
+		free(mSlots);
+	}
+}
+
+bool
+CPageQueue::Push(
+	const CPDFParser::PDFPageOutput& inPage)
+{
+	long tail = mTail;
+	
+	if(tail - UPDFAtomic::Load(&mHead) >= mCapacity)
+		return false;
+		
+	mSlots[tail & (mCapacity - 1)] = inPage;
+	
+	// the page has to be in place before the consumer can see it
+	UPDFAtomic::Store(&mTail, tail + 1);
+	
+	return true;
+}
+
+void
+CPageQueue::Close()
+{
+	UPDFAtomic::Store(&mClosed, 1);
+}
+
+bool
+CPageQueue::Pop(
+	CPDFParser::PDFPageOutput& outPage)
+{
+	long head = mHead;
+	
+	if(head == UPDFAtomic::Load(&mTail))
+		return false;
+		
+	outPage = mSlots[head & (mCapacity - 1)];
+	
+	// and copied out before the producer may reuse the slot
+	UPDFAtomic::Store(&mHead, head + 1);
+	
+	return true;
+}
+
+void
+CPageQueue::Wait(
+	long& ioSpins)
+{
+	// the other side is usually only a moment away; when it isn't (a
+	// heavy page, a slow volume) stop burning the core
+	if(ioSpins++ < kPageQueueSpins)
+		sched_yield();
+	else
+		usleep(kPageQueueSleep);
+}
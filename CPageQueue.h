@@ -0,0 +1,64 @@
+// Trapeze
+//
+// Copyright (c) 2004 Mesa Dynamics, LLC.  All rights reserved.
+
+#ifndef _H_CPageQueue
+#define _H_CPageQueue
+#pragma once
+
+#include "CPDFParser.h"
+
+const long		kPageQueueDepth		= 4;
+const long		kPageQueueSpins		= 64;
+const long		kPageQueueSleep		= 500; // microseconds
+
+// Hands rendered pages from exactly one producer thread to exactly one
+// consumer thread, in order, without locks.  Push() and Pop() never block;
+// a side that finds the ring full or empty backs off with Wait() and
+// tries again, which is what keeps a fast renderer from running away
+// from a slow writer.
+class CPageQueue {
+public:
+	CPageQueue(
+		long inCapacity = kPageQueueDepth);
+
+	~CPageQueue();
+
+	bool IsValid() {
+		return (mSlots != NULL);
+	}
+
+	// producer side
+	bool Push(
+		const CPDFParser::PDFPageOutput& inPage);
+
+	// no more pages will be pushed
+	void Close();
+
+	// consumer side
+	bool Pop(
+		CPDFParser::PDFPageOutput& outPage);
+
+	bool IsClosed() {
+		return (UPDFAtomic::Load(&mClosed) != 0);
+	}
+
+	// yields at first, then sleeps, ioSpins starts at 0 for each wait
+	static void Wait(
+		long& ioSpins);
+
+private:
+	CPDFParser::PDFPageOutput* mSlots;
+	long mCapacity; // power of two
+	
+	// the two ends live on separate cache lines, each written by one side
+	volatile long mHead;
+	char mHeadPad[64 - sizeof(long)];
+	
+	volatile long mTail;
+	char mTailPad[64 - sizeof(long)];
+	
+	volatile long mClosed;
+};
+
+#endif
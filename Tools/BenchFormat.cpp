@@ -0,0 +1,306 @@
+// Trapeze
+//
+// Copyright (c) 2004 Mesa Dynamics, LLC.  All rights reserved.
+//
+// Times RTF emission: the control words ObjectsToRTF, PageToRTF and
+// GetTabString write, formatted with sprintf and strlen as they used to be
+// and with UPDFFormat as they are now, and then whole RTF conversions of a
+// generated document (or of the PDFs named on the command line).
+//
+//     trapeze_bench_format [file.pdf ...]
+
+#include "CNativePDFParser.h"
+#include "COutputSink.h"
+#include "UPDFFormat.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+
+#include <string>
+
+const long		kFormatRounds		= 2000000;
+const long		kDocumentPages		= 200;
+const long		kDocumentLines		= 60;
+const long		kConvertRounds		= 5;
+
+// keeps the formatted text from being optimized away
+static volatile unsigned long sCheck;
+
+static double
+Now()
+{
+	struct timeval tv;
+	gettimeofday(&tv, NULL);
+
+	return (tv.tv_sec + tv.tv_usec / 1000000.0);
+}
+
+#pragma mark -
+
+// one round writes what a line of a formatted page typically costs: size
+// and spacing, a margin, two tab stops and, now and then, a page anchor
+static long
+FormatWithPrintf(
+	unsigned char* outText,
+	long inRound)
+{
+	char* p = (char*) outText;
+
+	sprintf(p, "\\fs%ld\\sl%ld", 16 + (inRound & 15), -240 - (inRound & 127));
+	p += strlen(p);
+
+	sprintf(p, "\\li%ld", (inRound * 37) % 9000);
+	p += strlen(p);
+
+	sprintf(p, "\\tx%ld", 720 + (inRound & 1023));
+	p += strlen(p);
+
+	sprintf(p, "\\tx%ld", 4320 + (inRound & 2047));
+	p += strlen(p);
+
+	if((inRound & 63) == 0) {
+		sprintf(p, "<a name=\"page_%ld\"></a>", inRound >> 6);
+		p += strlen(p);
+	}
+
+	return (p - (char*) outText);
+}
+
+static long
+FormatWithUPDFFormat(
+	unsigned char* outText,
+	long inRound)
+{
+	unsigned char* p = outText;
+
+	p += UPDFFormat::AppendLiteral(p, "\\fs", 3);
+	p += UPDFFormat::AppendDecimal(p, 16 + (inRound & 15));
+	p += UPDFFormat::AppendLiteral(p, "\\sl", 3);
+	p += UPDFFormat::AppendDecimal(p, -240 - (inRound & 127));
+
+	p += UPDFFormat::AppendLiteral(p, "\\li", 3);
+	p += UPDFFormat::AppendDecimal(p, (inRound * 37) % 9000);
+
+	p += UPDFFormat::AppendLiteral(p, "\\tx", 3);
+	p += UPDFFormat::AppendDecimal(p, 720 + (inRound & 1023));
+
+	p += UPDFFormat::AppendLiteral(p, "\\tx", 3);
+	p += UPDFFormat::AppendDecimal(p, 4320 + (inRound & 2047));
+
+	if((inRound & 63) == 0) {
+		p += UPDFFormat::AppendLiteral(p, "<a name=\"page_", 14);
+		p += UPDFFormat::AppendDecimal(p, inRound >> 6);
+		p += UPDFFormat::AppendLiteral(p, "\"></a>", 6);
+	}
+
+	return (p - outText);
+}
+
+static double
+TimeFormat(
+	long (*inProc)(unsigned char*, long),
+	unsigned long& outBytes)
+{
+	unsigned char text[256];
+	unsigned long bytes = 0;
+	unsigned long check = 0;
+
+	double start = Now();
+
+	for(long i = 0; i < kFormatRounds; i++) {
+		bytes += inProc(text, i);
+		check += text[i & 7];
+	}
+
+	sCheck = check;
+	outBytes = bytes;
+
+	return (Now() - start);
+}
+
+static bool
+CheckFormat()
+{
+	unsigned char a[256];
+	unsigned char b[256];
+
+	for(long i = 0; i < 100000; i++) {
+		long aSize = FormatWithPrintf(a, i);
+		long bSize = FormatWithUPDFFormat(b, i);
+
+		if(aSize != bSize || memcmp(a, b, aSize) != 0)
+			return false;
+	}
+
+	return true;
+}
+
+#pragma mark -
+
+// a PDF of kDocumentPages pages of Helvetica in a few sizes and indents,
+// enough to exercise the RTF font, size, margin and tab output
+static std::string
+MakeDocument()
+{
+	std::string pdf = "%PDF-1.4\n";
+	char s[256];
+
+	long objects = 3 + kDocumentPages * 2;
+	long* offsets = (long*) calloc(objects + 1, sizeof(long));
+
+	offsets[1] = pdf.size();
+	pdf += "1 0 obj\n<< /Type /Catalog /Pages 2 0 R >>\nendobj\n";
+
+	offsets[2] = pdf.size();
+	pdf += "2 0 obj\n<< /Type /Pages /Kids [";
+	for(long i = 0; i < kDocumentPages; i++) {
+		sprintf(s, " %ld 0 R", 4 + i * 2);
+		pdf += s;
+	}
+	sprintf(s, " ] /Count %ld >>\nendobj\n", kDocumentPages);
+	pdf += s;
+
+	offsets[3] = pdf.size();
+	pdf += "3 0 obj\n<< /Type /Font /Subtype /Type1 /BaseFont /Helvetica /Encoding /WinAnsiEncoding >>\nendobj\n";
+
+	for(long i = 0; i < kDocumentPages; i++) {
+		std::string contents = "BT\n";
+
+		for(long j = 0; j < kDocumentLines; j++) {
+			long size = 9 + (j % 4) * 2;
+			long left = 72 + (j % 3) * 36;
+
+			sprintf(s, "/F1 %ld Tf 1 0 0 1 %ld %ld Tm (Line %ld of page %ld, set in %ld point) Tj\n",
+				size, left, 740 - j * 11, j + 1, i + 1, size);
+			contents += s;
+
+			// a second column on some lines makes tab stops
+			if(j % 5 == 0) {
+				sprintf(s, "1 0 0 1 %ld %ld Tm (%ld.%02ld) Tj\n", 420 + (j % 2) * 48, 740 - j * 11, i * 7 + j, j * 3 % 100);
+				contents += s;
+			}
+		}
+
+		contents += "ET\n";
+
+		offsets[4 + i * 2] = pdf.size();
+		sprintf(s, "%ld 0 obj\n<< /Type /Page /Parent 2 0 R /MediaBox [0 0 612 792] /Resources << /Font << /F1 3 0 R >> >> /Contents %ld 0 R >>\nendobj\n",
+			4 + i * 2, 5 + i * 2);
+		pdf += s;
+
+		offsets[5 + i * 2] = pdf.size();
+		sprintf(s, "%ld 0 obj\n<< /Length %ld >>\nstream\n", 5 + i * 2, (long) contents.size());
+		pdf += s;
+		pdf += contents;
+		pdf += "\nendstream\nendobj\n";
+	}
+
+	long start = pdf.size();
+	sprintf(s, "xref\n0 %ld\n0000000000 65535 f \n", objects);
+	pdf += s;
+
+	for(long i = 1; i < objects; i++) {
+		sprintf(s, "%010ld 00000 n \n", offsets[i]);
+		pdf += s;
+	}
+
+	sprintf(s, "trailer\n<< /Size %ld /Root 1 0 R >>\nstartxref\n%ld\n%%%%EOF\n", objects, start);
+	pdf += s;
+
+	free(offsets);
+
+	return pdf;
+}
+
+static void
+TimeConversion(
+	const char* inName,
+	const void* inData,
+	size_t inSize,
+	size_t inPages)
+{
+	double best = 0.0;
+	long size = 0;
+
+	for(long i = 0; i < kConvertRounds; i++) {
+		CNativePDFParser parser;
+		parser.SetRenderThreads(0);
+
+		CMemorySink sink(1024 * 1024);
+
+		double start = Now();
+		OSErr err = parser.ConvertBuffer(inData, inSize, CPDFParser::kWriteRTF, &sink);
+		double elapsed = Now() - start;
+
+		if(err != CPDFParser::kNoError) {
+			printf("%s: conversion failed (%d)\n", inName, (int) err);
+			return;
+		}
+
+		if(i == 0 || elapsed < best)
+			best = elapsed;
+
+		size = sink.GetSize();
+	}
+
+	printf("%s: %lu pages, %ld bytes of RTF in %.1f ms, %.0f pages/s, %.1f MB/s\n",
+		inName, (unsigned long) inPages, size, best * 1000.0, inPages / best, size / best / 1000000.0);
+}
+
+#pragma mark -
+
+int
+main(
+	int argc,
+	char** argv)
+{
+	if(CheckFormat() == false) {
+		printf("UPDFFormat and sprintf disagree\n");
+		return 1;
+	}
+
+	unsigned long printfBytes;
+	unsigned long formatBytes;
+	double printfTime = TimeFormat(FormatWithPrintf, printfBytes);
+	double formatTime = TimeFormat(FormatWithUPDFFormat, formatBytes);
+
+	printf("control words, %ld rounds\n", kFormatRounds);
+	printf("  sprintf:    %7.1f ms, %6.1f ns/round, %6.1f MB/s\n",
+		printfTime * 1000.0, printfTime * 1e9 / kFormatRounds, printfBytes / printfTime / 1000000.0);
+	printf("  UPDFFormat: %7.1f ms, %6.1f ns/round, %6.1f MB/s\n",
+		formatTime * 1000.0, formatTime * 1e9 / kFormatRounds, formatBytes / formatTime / 1000000.0);
+	printf("  speedup:    %.2fx\n", printfTime / formatTime);
+
+	printf("RTF conversion, best of %ld\n", kConvertRounds);
+
+	if(argc < 2) {
+		std::string pdf = MakeDocument();
+		TimeConversion("generated", pdf.data(), pdf.size(), kDocumentPages);
+	}
+
+	for(int i = 1; i < argc; i++) {
+		FILE* f = fopen(argv[i], "rb");
+		if(f == NULL) {
+			printf("%s: cannot open\n", argv[i]);
+			continue;
+		}
+
+		std::string pdf;
+		char buffer[65536];
+		size_t n;
+		while((n = fread(buffer, 1, sizeof(buffer), f)) > 0)
+			pdf.append(buffer, n);
+
+		fclose(f);
+
+		size_t pages = 0;
+		CNativePDFParser counter;
+		counter.CountPages(argv[i], pages);
+
+		TimeConversion(argv[i], pdf.data(), pdf.size(), pages);
+	}
+
+	return 0;
+}
@@ -0,0 +1,133 @@
+// Trapeze
+//
+// Copyright (c) 2004 Mesa Dynamics, LLC.  All rights reserved.
+//
+// Times glyph name lookup: UPDFMaps::GlyphToCode, which probes kNameHash,
+// against the strcmp walk over a map it replaced, on the names a font's
+// Differences array holds: mostly names the map knows, some Adobe aNNN
+// names and a few it has never heard of.
+//
+//     trapeze_bench_maphash
+
+#include "UPDFMaps.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <sys/time.h>
+
+#include <string>
+#include <vector>
+
+const long		kLookupRounds		= 200;
+
+// keeps the lookups from being optimized away
+static volatile long sCheck;
+
+static double
+Now()
+{
+	struct timeval tv;
+	gettimeofday(&tv, NULL);
+
+	return (tv.tv_sec + tv.tv_usec / 1000000.0);
+}
+
+// NameToCode as it was, then the aNNN fallback
+static char
+LinearGlyphToCode(
+	UPDFMaps::ConstMapParam inMap,
+	const char* inName)
+{
+	for(long j = 0; j < 256; j++) {
+		if(strcmp(inName, inMap[j].name) == 0)
+			return inMap[j].code;
+	}
+
+	return UPDFMaps::AdobeNameToCode(inName);
+}
+
+static void
+MakeNames(
+	UPDFMaps::ConstMapParam inMap,
+	std::vector<std::string>& outNames)
+{
+	char s[32];
+
+	for(long j = 0; j < 256; j++) {
+		if(inMap[j].name[0] == 0)
+			continue;
+
+		outNames.push_back(inMap[j].name);
+
+		// one Adobe name and one unknown name for every eight known ones
+		if(j % 8 == 0) {
+			sprintf(s, "a%ld", 30 + j % 190);
+			outNames.push_back(s);
+
+			sprintf(s, "uni%04lX", 0x0400 + j);
+			outNames.push_back(s);
+		}
+	}
+}
+
+static double
+TimeLookup(
+	UPDFMaps::ConstMapParam inMap,
+	const std::vector<std::string>& inNames,
+	bool inHashed)
+{
+	long check = 0;
+
+	double start = Now();
+
+	for(long i = 0; i < kLookupRounds; i++) {
+		for(size_t j = 0; j < inNames.size(); j++) {
+			const char* name = inNames[j].c_str();
+			check += (inHashed ? UPDFMaps::GlyphToCode(inMap, name) : LinearGlyphToCode(inMap, name));
+		}
+	}
+
+	sCheck = check;
+
+	return (Now() - start);
+}
+
+int
+main()
+{
+	struct {
+		const char* name;
+		UPDFMaps::ConstMapParam map;
+	} maps[] = {
+		{ "kMacLatinMap", UPDFMaps::kMacLatinMap },
+		{ "kWinLatinMap", UPDFMaps::kWinLatinMap },
+		{ "kSymbolMap", UPDFMaps::kSymbolMap }
+	};
+
+	int result = 0;
+
+	for(long m = 0; m < 3; m++) {
+		std::vector<std::string> names;
+		MakeNames(maps[m].map, names);
+
+		for(size_t j = 0; j < names.size(); j++) {
+			const char* name = names[j].c_str();
+
+			if(UPDFMaps::GlyphToCode(maps[m].map, name) != LinearGlyphToCode(maps[m].map, name)) {
+				printf("%s: lookups disagree on %s\n", maps[m].name, name);
+				result = 1;
+			}
+		}
+
+		double linear = TimeLookup(maps[m].map, names, false);
+		double hashed = TimeLookup(maps[m].map, names, true);
+		double lookups = (double) kLookupRounds * names.size();
+
+		printf("%s, %lu names x %ld\n", maps[m].name, (unsigned long) names.size(), kLookupRounds);
+		printf("  linear: %7.2f ms, %6.1f ns/name\n", linear * 1000.0, linear * 1e9 / lookups);
+		printf("  hashed: %7.2f ms, %6.1f ns/name\n", hashed * 1000.0, hashed * 1e9 / lookups);
+		printf("  speedup: %.1fx\n", linear / hashed);
+	}
+
+	return result;
+}
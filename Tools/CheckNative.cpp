@@ -0,0 +1,254 @@
+// Trapeze
+//
+// Copyright (c) 2004 Mesa Dynamics, LLC.  All rights reserved.
+//
+// Feeds CNativePDFParser the hostile files fuzzing turned up, through
+// every text output type, in sequence and on page workers.  A case passes
+// if it converts or fails with an error code; build with
+// -fsanitize=address for the overruns to show.
+//
+//     trapeze_check_native
+
+#include "CNativePDFParser.h"
+#include "COutputSink.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <string>
+#include <vector>
+
+#include <zlib.h>
+
+// the text outputs, plain text first
+const long kTypes[] = {
+	CPDFParser::kWritePlainText,
+	CPDFParser::kWriteASCII,
+	CPDFParser::kWriteRawText,
+	CPDFParser::kWriteHTML,
+	CPDFParser::kWriteRTF,
+	CPDFParser::kWriteRTFWord
+};
+
+const char* const kHelvetica = "<< /Type /Font /Subtype /Type1 /BaseFont /Helvetica >>";
+
+// a document of one font and one page per content stream, xref and all;
+// inCount stands in for the page tree's /Count when it is not 0
+static std::string
+MakeDocument(
+	const std::vector<std::string>& inContents,
+	long inCount = 0,
+	const char* inFilter = NULL)
+{
+	std::vector<std::string> objects;
+	char s[256];
+
+	long pages = inContents.size();
+
+	objects.push_back("<< /Type /Catalog /Pages 2 0 R >>");
+
+	std::string tree = "<< /Type /Pages /Kids [";
+	for(long i = 0; i < pages; i++) {
+		sprintf(s, " %ld 0 R", 4 + i * 2);
+		tree += s;
+	}
+	sprintf(s, " ] /Count %ld >>", (inCount ? inCount : pages));
+	tree += s;
+
+	objects.push_back(tree);
+	objects.push_back(kHelvetica);
+
+	for(long i = 0; i < pages; i++) {
+		sprintf(s, "<< /Type /Page /Parent 2 0 R /MediaBox [0 0 612 792] /Resources << /Font << /F1 3 0 R >> >> /Contents %ld 0 R >>",
+			5 + i * 2);
+		objects.push_back(s);
+
+		if(inFilter)
+			sprintf(s, "<< /Length %ld /Filter /%s >>\nstream\n", (long) inContents[i].size(), inFilter);
+		else
+			sprintf(s, "<< /Length %ld >>\nstream\n", (long) inContents[i].size());
+
+		objects.push_back(s + inContents[i] + "\nendstream");
+	}
+
+	std::string pdf = "%PDF-1.4\n";
+	std::vector<long> offsets;
+
+	for(size_t i = 0; i < objects.size(); i++) {
+		offsets.push_back(pdf.size());
+
+		sprintf(s, "%ld 0 obj\n", (long) i + 1);
+		pdf += s;
+		pdf += objects[i];
+		pdf += "\nendobj\n";
+	}
+
+	long start = pdf.size();
+	sprintf(s, "xref\n0 %ld\n0000000000 65535 f \n", (long) objects.size() + 1);
+	pdf += s;
+
+	for(size_t i = 0; i < offsets.size(); i++) {
+		sprintf(s, "%010ld 00000 n \n", offsets[i]);
+		pdf += s;
+	}
+
+	sprintf(s, "trailer\n<< /Size %ld /Root 1 0 R >>\nstartxref\n%ld\n%%%%EOF\n", (long) objects.size() + 1, start);
+	pdf += s;
+
+	return pdf;
+}
+
+static std::string
+MakeDocument(
+	const std::string& inContents,
+	long inCount = 0,
+	const char* inFilter = NULL)
+{
+	return MakeDocument(std::vector<std::string>(1, inContents), inCount, inFilter);
+}
+
+// inSize bytes of spaces between two strings, deflated to a few hundred K
+static std::string
+MakeDeflateBomb(
+	size_t inSize)
+{
+	std::string contents = "BT /F1 12 Tf 72 700 Td (before) Tj ";
+	contents.append(inSize, ' ');
+	contents += "(after) Tj ET";
+
+	uLongf size = compressBound(contents.size());
+	std::string deflated(size, 0);
+
+	if(compress2((Bytef*) &(deflated[0]), &size, (const Bytef*) contents.data(), contents.size(), 9) != Z_OK)
+		return std::string();
+
+	deflated.resize(size);
+
+	return deflated;
+}
+
+#pragma mark -
+
+struct Case {
+	const char* name;
+	std::string pdf;
+	size_t pages;		// what CountPages() should give
+	bool allTypes;		// or plain text on the calling thread only
+};
+
+static bool
+Check(
+	const Case& inCase)
+{
+	bool passed = true;
+
+	char path[] = "/tmp/trapeze_check_XXXXXX";
+	int fd = mkstemp(path);
+	if(fd < 0 || write(fd, inCase.pdf.data(), inCase.pdf.size()) != (ssize_t) inCase.pdf.size()) {
+		printf("%s: cannot write %s\n", inCase.name, path);
+		return false;
+	}
+
+	close(fd);
+
+	CNativePDFParser counter;
+	size_t pages = 0;
+	OSErr err = counter.CountPages(path, pages);
+
+	if(err != CPDFParser::kNoError || pages != inCase.pages) {
+		printf("%s: %lu pages (%d), expected %lu\n", inCase.name, (unsigned long) pages, (int) err, (unsigned long) inCase.pages);
+		passed = false;
+	}
+
+	size_t typeCount = (inCase.allTypes ? sizeof(kTypes) / sizeof(kTypes[0]) : 1);
+	long maxThreads = (inCase.allTypes ? 4 : 0);
+
+	for(size_t t = 0; t < typeCount; t++) {
+		for(long threads = 0; threads <= maxThreads; threads += 4) {
+			CNativePDFParser parser;
+			parser.SetRenderThreads(threads);
+
+			CMemorySink sink;
+			err = parser.ConvertPath(path, kTypes[t], &sink);
+
+			if(err != CPDFParser::kNoError && err != CPDFParser::kNoTextError) {
+				printf("%s: type %ld on %ld threads failed (%d)\n", inCase.name, kTypes[t], threads, (int) err);
+				passed = false;
+			}
+		}
+	}
+
+	unlink(path);
+
+	printf("%s: %s\n", inCase.name, (passed ? "ok" : "FAILED"));
+
+	return passed;
+}
+
+int
+main()
+{
+	std::vector<Case> cases;
+	Case c;
+
+	// TJ kerns wide enough to write more blanks than the stream is long
+	c.name = "kern";
+	c.pdf = MakeDocument("BT /F1 12 Tf 72 700 Td [(A) -99999999 (B) -2000000 (C)] TJ ET");
+	c.pages = 1;
+	c.allTypes = true;
+	cases.push_back(c);
+
+	// every character escaped for RTF, twice the stream's length
+	c.name = "escapes";
+	c.pdf = MakeDocument("BT /F1 12 Tf 72 700 Td (" + std::string(6000, '{') + ") Tj ET");
+	c.pages = 1;
+	c.allTypes = true;
+	cases.push_back(c);
+
+	// a run of digits longer than any operand
+	c.name = "digits";
+	c.pdf = MakeDocument("BT /F1 " + std::string(1000, '9') + " Tf 72 700 Td (A) Tj ET");
+	c.pages = 1;
+	c.allTypes = true;
+	cases.push_back(c);
+
+	// font and xobject names with nothing between them and the operator
+	c.name = "names";
+	c.pdf = MakeDocument("BT /F1Tf 72 700 Td (A) Tj ET /XDo");
+	c.pages = 1;
+	c.allTypes = true;
+	cases.push_back(c);
+
+	// contents that stop in the middle of a TJ array
+	c.name = "truncated";
+	c.pdf = MakeDocument("BT /F1 12 Tf [(A) 5");
+	c.pages = 1;
+	c.allTypes = true;
+	cases.push_back(c);
+
+	// a page tree that claims two billion pages and has two
+	std::vector<std::string> two(2, "BT /F1 12 Tf 72 700 Td (A) Tj ET");
+	c.name = "count";
+	c.pdf = MakeDocument(two, 2000000000);
+	c.pages = 2;
+	c.allTypes = true;
+	cases.push_back(c);
+
+	// a few hundred K that inflate to more than the filters will hold
+	c.name = "bomb";
+	c.pdf = MakeDocument(MakeDeflateBomb(80 * 1024 * 1024), 0, "FlateDecode");
+	c.pages = 1;
+	c.allTypes = false;
+	cases.push_back(c);
+
+	int result = 0;
+
+	for(size_t i = 0; i < cases.size(); i++) {
+		if(Check(cases[i]) == false)
+			result = 1;
+	}
+
+	return result;
+}
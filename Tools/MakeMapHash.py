@@ -0,0 +1,171 @@
+#!/usr/bin/env python3
+#
+# Trapeze
+#
+# Copyright (c) 2004 Mesa Dynamics, LLC.  All rights reserved.
+#
+# Generates UPDFMapHash.h, a perfect hash over the glyph names of the maps
+# in UPDFMaps.h, so a name is found with one probe whichever map it is
+# looked up in.  Run it from the source directory whenever a map changes:
+#
+#     python3 Tools/MakeMapHash.py
+
+import re
+import sys
+
+SOURCE = 'UPDFMaps.h'
+TARGET = 'UPDFMapHash.h'
+
+# columns of the table, in order
+MAPS = ['kMacLatinMap', 'kWinLatinMap', 'kSymbolMap']
+
+SLOTS = 512
+BUCKETS = 128
+MAX_SEED = 0xFFFF
+
+ENTRY = re.compile(r'^\s*\{\s*"([^"]*)",\s*\'\\([0-7]{3})\',\s*\},')
+
+
+def read_maps(path):
+    maps = {}
+    current = None
+
+    for line in open(path, encoding='latin-1'):
+        m = re.match(r'^const Map (\w+)\s*=', line)
+        if m:
+            current = m.group(1)
+            maps[current] = []
+            continue
+
+        if current and line.startswith('};'):
+            current = None
+            continue
+
+        m = ENTRY.match(line)
+        if current and m:
+            maps[current].append((m.group(1), int(m.group(2), 8)))
+
+    return maps
+
+
+# must match UPDFMaps::HashName()
+def hash_name(name, seed):
+    h = (2166136261 ^ seed) & 0xFFFFFFFF
+
+    for c in name.encode('latin-1'):
+        h = ((h ^ c) * 16777619) & 0xFFFFFFFF
+
+    return h
+
+
+# tabs from a column to another, at least one, four columns a tab
+def tab_count(column, target):
+    count = 0
+
+    while column < target or count == 0:
+        column = (column // 4 + 1) * 4
+        count += 1
+
+    return count
+
+
+def build(names):
+    buckets = [[] for i in range(BUCKETS)]
+    for name in names:
+        buckets[hash_name(name, 0) % BUCKETS].append(name)
+
+    slots = [None] * SLOTS
+    seeds = [0] * BUCKETS
+
+    # biggest buckets first, while the table is emptiest
+    order = sorted(range(BUCKETS), key=lambda b: -len(buckets[b]))
+
+    for b in order:
+        if not buckets[b]:
+            continue
+
+        for seed in range(1, MAX_SEED + 1):
+            taken = [hash_name(name, seed) % SLOTS for name in buckets[b]]
+
+            if len(set(taken)) == len(taken) and all(slots[t] is None for t in taken):
+                for name, t in zip(buckets[b], taken):
+                    slots[t] = name
+
+                seeds[b] = seed
+                break
+        else:
+            sys.exit('no seed for bucket %d, raise SLOTS or BUCKETS' % b)
+
+    return slots, seeds
+
+
+def main():
+    maps = read_maps(SOURCE)
+
+    # the first entry wins, as it did for the linear search
+    codes = {}
+    for column, map in enumerate(MAPS):
+        seen = set()
+
+        for name, code in maps[map]:
+            if name in seen:
+                continue
+
+            seen.add(name)
+            codes.setdefault(name, [0] * len(MAPS))[column] = code
+
+    names = sorted(codes)
+    slots, seeds = build(names)
+
+    out = []
+    out.append('// Trapeze')
+    out.append('//')
+    out.append('// Copyright (c) 2004 Mesa Dynamics, LLC.  All rights reserved.')
+    out.append('')
+    out.append('// generated by Tools/MakeMapHash.py from UPDFMaps.h, do not edit')
+    out.append('')
+    out.append('#ifndef _H_UPDFMapHash')
+    out.append('#define _H_UPDFMapHash')
+    out.append('#pragma once')
+    out.append('')
+    out.append('#include <stddef.h>')
+    out.append('')
+    out.append('namespace UPDFMaps {')
+    out.append('')
+    out.append('const unsigned long\tkNameHashSlots\t\t= %d;' % SLOTS)
+    out.append('const unsigned long\tkNameHashBuckets\t= %d;' % BUCKETS)
+    out.append('')
+    out.append('// %s' % ', '.join(MAPS))
+    out.append('const long\t\t\tkNameHashColumns\t= %d;' % len(MAPS))
+    out.append('')
+    out.append('struct NameHashEntry {')
+    out.append('\tconst char* name;')
+    out.append('\tchar codes[kNameHashColumns];')
+    out.append('};')
+    out.append('')
+    out.append('const unsigned short kNameHashSeeds[kNameHashBuckets] =')
+    out.append('{')
+    for i in range(0, BUCKETS, 8):
+        out.append('\t' + ' '.join('%5d,' % s for s in seeds[i:i + 8]))
+    out.append('};')
+    out.append('')
+    out.append('const NameHashEntry kNameHash[kNameHashSlots] =')
+    out.append('{')
+    for name in slots:
+        if name is None:
+            out.append('\t{ NULL, },')
+        else:
+            field = '"%s",' % name
+            tabs = '\t' * tab_count(6 + len(field), 28)
+            out.append('\t{ %s%s{ %s }, },' % (field, tabs, ', '.join("'\\%03o'" % c for c in codes[name])))
+    out.append('};')
+    out.append('')
+    out.append('}')
+    out.append('')
+    out.append('#endif')
+
+    open(TARGET, 'w', encoding='latin-1').write('\n'.join(out) + '\n')
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,171 @@
+#!/usr/bin/env python3
+#
+# Trapeze
+#
+# Copyright (c) 2004 Mesa Dynamics, LLC.  All rights reserved.
+#
+# Generates UPDFUnicodeFolds.h, tables from Unicode back to MacRoman,
+# WinAnsi and Symbol, for UPDFUnicode.h.  MacRoman and WinAnsi come from
+# Python's codecs, Symbol from kSymbolMap's glyph names in UPDFMaps.h.  Run
+# it from the source directory:
+#
+#     python3 Tools/MakeUnicodeFolds.py
+
+import sys
+
+from MakeMapHash import read_maps, tab_count
+
+SOURCE = 'UPDFMaps.h'
+TARGET = 'UPDFUnicodeFolds.h'
+
+# the Adobe Glyph List entries for the Symbol font; some glyphs are also
+# reached from a second character
+SYMBOL = {
+    'Alpha': [0x0391], 'Beta': [0x0392], 'Chi': [0x03A7],
+    'Delta': [0x0394, 0x2206], 'Epsilon': [0x0395], 'Eta': [0x0397],
+    'Euro': [0x20AC], 'Gamma': [0x0393], 'Ifraktur': [0x2111],
+    'Iota': [0x0399], 'Kappa': [0x039A], 'Lambda': [0x039B],
+    'Mu': [0x039C], 'Nu': [0x039D], 'Omega': [0x03A9, 0x2126],
+    'Omicron': [0x039F], 'Phi': [0x03A6], 'Pi': [0x03A0], 'Psi': [0x03A8],
+    'Rfraktur': [0x211C], 'Rho': [0x03A1], 'Sigma': [0x03A3],
+    'Tau': [0x03A4], 'Theta': [0x0398], 'Upsilon': [0x03A5],
+    'Upsilon1': [0x03D2], 'Xi': [0x039E], 'Zeta': [0x0396],
+    'aleph': [0x2135], 'alpha': [0x03B1], 'ampersand': [0x0026],
+    'angle': [0x2220], 'angleleft': [0x2329, 0x3008],
+    'angleright': [0x232A, 0x3009], 'approxequal': [0x2248],
+    'arrowboth': [0x2194], 'arrowdblboth': [0x21D4],
+    'arrowdbldown': [0x21D3], 'arrowdblleft': [0x21D0],
+    'arrowdblright': [0x21D2], 'arrowdblup': [0x21D1],
+    'arrowdown': [0x2193], 'arrowhorizex': [0x23AF, 0xF8E7],
+    'arrowleft': [0x2190], 'arrowright': [0x2192], 'arrowup': [0x2191],
+    'arrowvertex': [0x23D0, 0xF8E6], 'asteriskmath': [0x2217],
+    'bar': [0x007C], 'beta': [0x03B2], 'braceleft': [0x007B],
+    'braceright': [0x007D], 'bracelefttp': [0x23A7],
+    'braceleftmid': [0x23A8], 'braceleftbt': [0x23A9],
+    'bracerighttp': [0x23AB], 'bracerightmid': [0x23AC],
+    'bracerightbt': [0x23AD], 'braceex': [0x23AA],
+    'bracketleft': [0x005B], 'bracketright': [0x005D],
+    'bracketlefttp': [0x23A1], 'bracketleftex': [0x23A2],
+    'bracketleftbt': [0x23A3], 'bracketrighttp': [0x23A4],
+    'bracketrightex': [0x23A5], 'bracketrightbt': [0x23A6],
+    'bullet': [0x2022], 'carriagereturn': [0x21B5], 'chi': [0x03C7],
+    'circlemultiply': [0x2297], 'circleplus': [0x2295], 'club': [0x2663],
+    'colon': [0x003A], 'comma': [0x002C], 'congruent': [0x2245],
+    'copyrightsans': [0xF8E9], 'copyrightserif': [0x00A9, 0xF6D9],
+    'degree': [0x00B0], 'delta': [0x03B4], 'diamond': [0x2666],
+    'divide': [0x00F7], 'dotmath': [0x22C5], 'eight': [0x0038],
+    'element': [0x2208], 'ellipsis': [0x2026], 'emptyset': [0x2205],
+    'epsilon': [0x03B5], 'equal': [0x003D], 'equivalence': [0x2261],
+    'eta': [0x03B7], 'exclam': [0x0021], 'existential': [0x2203],
+    'five': [0x0035], 'florin': [0x0192], 'four': [0x0034],
+    'fraction': [0x2044], 'gamma': [0x03B3], 'gradient': [0x2207],
+    'greater': [0x003E], 'greaterequal': [0x2265], 'heart': [0x2665],
+    'infinity': [0x221E], 'integral': [0x222B], 'integraltp': [0x2320],
+    'integralex': [0x23AE], 'integralbt': [0x2321],
+    'intersection': [0x2229], 'iota': [0x03B9], 'kappa': [0x03BA],
+    'lambda': [0x03BB], 'less': [0x003C], 'lessequal': [0x2264],
+    'logicaland': [0x2227], 'logicalnot': [0x00AC], 'logicalor': [0x2228],
+    'lozenge': [0x25CA], 'minus': [0x2212], 'minute': [0x2032],
+    'mu': [0x03BC, 0x00B5], 'multiply': [0x00D7], 'nine': [0x0039],
+    'notelement': [0x2209], 'notequal': [0x2260], 'notsubset': [0x2284],
+    'nu': [0x03BD], 'numbersign': [0x0023], 'omega': [0x03C9],
+    'omega1': [0x03D6], 'omicron': [0x03BF], 'one': [0x0031],
+    'parenleft': [0x0028], 'parenright': [0x0029],
+    'parenlefttp': [0x239B], 'parenleftex': [0x239C],
+    'parenleftbt': [0x239D], 'parenrighttp': [0x239E],
+    'parenrightex': [0x239F], 'parenrightbt': [0x23A0],
+    'partialdiff': [0x2202], 'percent': [0x0025], 'period': [0x002E],
+    'perpendicular': [0x22A5], 'phi': [0x03C6], 'phi1': [0x03D5],
+    'pi': [0x03C0], 'plus': [0x002B], 'plusminus': [0x00B1],
+    'product': [0x220F], 'propersubset': [0x2282],
+    'propersuperset': [0x2283], 'proportional': [0x221D], 'psi': [0x03C8],
+    'question': [0x003F], 'radical': [0x221A], 'radicalex': [0xF8E5],
+    'reflexsubset': [0x2286], 'reflexsuperset': [0x2287],
+    'registersans': [0xF8E8], 'registerserif': [0x00AE, 0xF6DA],
+    'rho': [0x03C1], 'second': [0x2033], 'semicolon': [0x003B],
+    'seven': [0x0037], 'sigma': [0x03C3], 'sigma1': [0x03C2],
+    'similar': [0x223C], 'six': [0x0036], 'slash': [0x002F],
+    'space': [0x0020, 0x00A0], 'spade': [0x2660], 'suchthat': [0x220B],
+    'summation': [0x2211], 'tau': [0x03C4], 'therefore': [0x2234],
+    'theta': [0x03B8], 'theta1': [0x03D1], 'three': [0x0033],
+    'trademarksans': [0xF8EA], 'trademarkserif': [0x2122, 0xF6DB],
+    'two': [0x0032], 'underscore': [0x005F], 'union': [0x222A],
+    'universal': [0x2200], 'upsilon': [0x03C5], 'weierstrass': [0x2118],
+    'xi': [0x03BE], 'zero': [0x0030], 'zeta': [0x03B6],
+}
+
+
+# the upper half of a one-byte codec; ASCII folds to itself
+def codec_folds(codec):
+    folds = {}
+
+    for code in range(0x80, 0x100):
+        try:
+            u = ord(bytes([code]).decode(codec))
+        except UnicodeDecodeError:
+            continue
+
+        folds.setdefault(u, code)
+
+    return folds
+
+
+def symbol_folds(maps):
+    folds = {}
+
+    for name, code in maps['kSymbolMap']:
+        if name not in SYMBOL:
+            sys.exit('no Unicode for the Symbol glyph %s' % name)
+
+        for u in SYMBOL[name]:
+            folds.setdefault(u, code)
+
+    return folds
+
+
+def table(out, name, comment, folds):
+    out.append('// %s' % comment)
+    out.append('const Fold %s[] =' % name)
+    out.append('{')
+    for u in sorted(folds):
+        out.append('\t{ 0x%04X, 0x%02X, },' % (u, folds[u]))
+    out.append('};')
+    out.append('')
+    field = '%sCount' % name
+    out.append('const long\t%s%s= sizeof(%s) / sizeof(Fold);' % (field, '\t' * tab_count(15 + len(field), 32), name))
+    out.append('')
+
+
+def main():
+    maps = read_maps(SOURCE)
+
+    out = []
+    out.append('// Trapeze')
+    out.append('//')
+    out.append('// Copyright (c) 2004 Mesa Dynamics, LLC.  All rights reserved.')
+    out.append('')
+    out.append('// generated by Tools/MakeUnicodeFolds.py, do not edit')
+    out.append('')
+    out.append('#ifndef _H_UPDFUnicodeFolds')
+    out.append('#define _H_UPDFUnicodeFolds')
+    out.append('#pragma once')
+    out.append('')
+    out.append('namespace UPDFUnicode {')
+    out.append('')
+    out.append('struct Fold {')
+    out.append('\tunsigned short unicode;')
+    out.append('\tunsigned char code;')
+    out.append('};')
+    out.append('')
+    table(out, 'kMacRomanFolds', 'MacRoman 0x80-0xFF, by Unicode', codec_folds('mac_roman'))
+    table(out, 'kWinAnsiFolds', 'WinAnsi 0x80-0xFF, by Unicode', codec_folds('cp1252'))
+    table(out, 'kSymbolFolds', 'Symbol, by Unicode', symbol_folds(maps))
+    out.append('}')
+    out.append('')
+    out.append('#endif')
+
+    open(TARGET, 'w', encoding='latin-1').write('\n'.join(out) + '\n')
+
+
+if __name__ == '__main__':
+    main()
@@ -11,14 +11,41 @@
 #include <Carbon/Carbon.h>
 #include <CoreServices/CoreServices.h>
 #include "CMacPDFParser.h"
+#include "COutputSink.h"
+#include "CPDFPageCache.h"
 
 long gSaveIndex = -1;
 long gSaveProgress = -1;
 long gSaveMaxProgress = 0;
 
 long gIndex = -1;
-extern long gProgress;
-extern long gMaxProgress;
+long gProgress = -1;
+long gMaxProgress = 0;
+
+// set by the stop button, seen by the conversion thread mid-page
+CPDFCancelToken gCancel;
+
+// called on the conversion thread; the timer picks the values up on the main thread
+static void
+ConversionProgress(
+	long inProgress,
+	long inMaxProgress,
+	void* inRefCon)
+{
+	gMaxProgress = inMaxProgress;
+	gProgress = inProgress;
+}
+
+// where the parsed pages of a document are kept between conversions; the
+// cache itself checks that it still matches the document
+static NSString*
+PageCachePath(
+	NSString* inFileName)
+{
+	NSString* name = [NSString stringWithFormat:@"Trapeze-%lx.pagecache", (unsigned long) [inFileName hash]];
+	
+	return [NSTemporaryDirectory() stringByAppendingPathComponent:name];
+}
 
 @implementation TrapezeController
 
@@ -127,6 +154,7 @@ extern long gMaxProgress;
 
 - (void)handleStop:(id)sender
 {
+	gCancel.Cancel();
 }
 
 - (void)convert:(id)sender
@@ -144,19 +172,15 @@ extern long gMaxProgress;
 	gIndex = -1;
 	
 	while(fileName = [enumerator nextObject]) {
+		if(gCancel.IsCancelled())
+			break;
+			
 		gIndex++;
 		gSaveProgress = -1;
 		gSaveMaxProgress = 0;
 		gProgress = -1;
 		gMaxProgress = 0;	
 		
-		char* inData = NULL;
-		unsigned long inSize = 0;
-		
-		NSData* data = [NSData dataWithContentsOfFile:fileName];
-		if(data == nil)
-			continue;
-
 		long formatType = -1;
 		switch([format indexOfSelectedItem]) {
 			case 0:
@@ -183,100 +207,76 @@ extern long gMaxProgress;
 				continue;
 		}
 			
-		inData = (char*)[data bytes];
-		inSize = (unsigned long)[data length];
-
 		char* tmpData = NULL;
 		unsigned long tmpDataSize = 0;
 
-        HFSUniStr255 pdfName;
-        NSString* pdfString = [NSString stringWithFormat:@"trapeze_%d.pdf", (int)[fileName hash]];
-		::FSGetHFSUniStrFromString((CFStringRef)pdfString, &pdfName);
-        
-        HFSUniStr255 txtName;
-        NSString* txtString = [NSString stringWithFormat:@"trapeze_%d.dat", (int)[fileName hash]];
-		::FSGetHFSUniStrFromString((CFStringRef)txtString, &txtName);
-						
-		FSRef tempFolder;
-		FSRef pdfSpec;
-		FSRef txtSpec;
-		
-        ::FSFindFolder(kUserDomain, kTemporaryFolderType, true, &tempFolder);
-        
-        ::FSMakeFSRefUnicode(&tempFolder, pdfName.length, pdfName.unicode, kTextEncodingUnknown, &pdfSpec);
-        ::FSMakeFSRefUnicode(&tempFolder, txtName.length, txtName.unicode, kTextEncodingUnknown, &txtSpec);
-       
-		::FSDeleteObject(&pdfSpec);
-		::FSDeleteObject(&txtSpec);
-		                
-        ::FSCreateFileUnicode(&tempFolder, pdfName.length, pdfName.unicode, kFSCatInfoNone, NULL, &pdfSpec, NULL);
-		
-        FSIORefNum refNum;
-        
-        HFSUniStr255 dataForkName;
-        ::FSGetDataForkName(&dataForkName);
-        
-		if(::FSOpenFork(&pdfSpec, dataForkName.length, dataForkName.unicode, fsRdWrPerm, &refNum) == noErr) {
-            ::FSWriteFork(refNum, fsAtMark, 0, inSize, inData, NULL);
-			::FSCloseFork(refNum);
-
-			{
-				CMacPDFParser parser;
-				parser.SetPromptForPassword(false);
+		{
+			CMacPDFParser parser;
+			parser.SetPromptForPassword(false);
+			parser.SetProgressProc(ConversionProgress);
+			parser.SetCancelToken(&gCancel);
+			parser.SetRenderThreads([[NSProcessInfo processInfo] activeProcessorCount]);
+			
+			if([optionStrip state] == NSOnState)
+				parser.SetPadStripping(true);
 				
-				if([optionStrip state] == NSOnState)
-					parser.SetPadStripping(true);
-					
-				if([optionCollapse state] == NSOnState)
-					parser.SetSorting(false);
-					
-				if([optionRewrap state] == NSOnState)
-					parser.SetRewrapping(true);
-					
-				if([optionMark state] == NSOnState)
-					parser.SetShowBreaks(true);
-					
-				if([optionRelax state] == NSOnState)
-					parser.SetRelaxSpacing(true);
+			if([optionCollapse state] == NSOnState)
+				parser.SetSorting(false);
+				
+			if([optionRewrap state] == NSOnState)
+				parser.SetRewrapping(true);
+				
+			if([optionMark state] == NSOnState)
+				parser.SetShowBreaks(true);
+				
+			if([optionRelax state] == NSOnState)
+				parser.SetRelaxSpacing(true);
+				
+			if([optionTight state] == NSOnState)
+				parser.SetTightSpacing(true);
+			
+			// the pdf is mapped rather than read, and the text is collected in memory
+			CMemorySink sink;
+			NSString* title = [[NSFileManager defaultManager] displayNameAtPath:fileName];
+			
+			// the header takes the title as bytes, in the output's own encoding
+			NSStringEncoding titleEncoding = (formatType == CPDFParser::kWriteHTML ? NSISOLatin1StringEncoding : NSMacOSRomanStringEncoding);
+			NSMutableData* titleData = [NSMutableData dataWithData:[title dataUsingEncoding:titleEncoding allowLossyConversion:YES]];
+			[titleData increaseLengthBy:1];
+			
+			const char* titleText = (const char*) [titleData bytes];
+			
+			const char* path = [fileName fileSystemRepresentation];
+			const char* cachePath = [PageCachePath(fileName) fileSystemRepresentation];
+			
+			CPDFPageCache cache;
+			OSErr error;
+			
+			if(cache.Open(cachePath, path) == CPDFParser::kNoError) {
+				// converted before, only layout is left to do
+				CCachedPDFParser cachedParser(&cache);
+				
+				CPDFParser::PDFOptions options;
+				parser.GetOptions(options);
+				
+				cachedParser.SetOptions(options);
+				cachedParser.SetProgressProc(ConversionProgress);
+				cachedParser.SetCancelToken(&gCancel);
+				
+				error = cachedParser.Convert(formatType, &sink, titleText);
+			}
+			else {
+				if(cache.Create(cachePath, path) == CPDFParser::kNoError)
+					parser.SetPageCache(&cache);
 					
-				if([optionTight state] == NSOnState)
-					parser.SetTightSpacing(true);
-                					
-				if(parser.ConvertToFile(&pdfSpec, NULL, formatType, 0, NULL, &tempFolder, &txtName) == CPDFParser::kNoError) {
-                    ::FSMakeFSRefUnicode(&tempFolder, txtName.length, txtName.unicode, kTextEncodingUnknown, &txtSpec);
-                    if(::FSOpenFork(&txtSpec, dataForkName.length, dataForkName.unicode, fsRdPerm, &refNum) == noErr) {
-						SInt64 eof;
-						::FSGetForkSize(refNum, &eof);
-						eof += (4096 - (eof % 4096));
-						
-						tmpData = (char*) malloc(eof);
-						if(tmpData) {
-							::FSReadFork(refNum, fsAtMark, 0, eof, tmpData, &tmpDataSize);
-						}
-						
-                        ::FSCloseFork(refNum);
-					}
-                    else {
-                        // error
-                        ::FSDeleteObject(&pdfSpec);
-                        ::FSDeleteObject(&txtSpec);
-                    }
-				}
-				else {
-					// error
-                    ::FSDeleteObject(&pdfSpec);
-                    ::FSDeleteObject(&txtSpec);
-				}
+				error = parser.ConvertPath(path, formatType, &sink, titleText);
+			}
+			
+			if(error == CPDFParser::kNoError) {
+				tmpDataSize = sink.GetSize();
+				tmpData = (char*) sink.Detach();
 			}
 		}
-        else {
-            // error
-            ::FSDeleteObject(&pdfSpec);
-            ::FSDeleteObject(&txtSpec);
-        }
-						
-		::FSDeleteObject(&pdfSpec);
-		::FSDeleteObject(&txtSpec);
 		
 		if(tmpData) {
 			NSData* outData = [NSData dataWithBytesNoCopy:tmpData length:tmpDataSize freeWhenDone:YES];
@@ -522,6 +522,8 @@ extern long gMaxProgress;
 
 - (void)setupConversion
 {
+	gCancel.Reset();
+	
 	[progressBar setIndeterminate:YES];
 	[progressBar setMaxValue:0.0];
 	[progressBar setDoubleValue:0.0];
@@ -0,0 +1,68 @@
+// Trapeze
+//
+// Copyright (c) 2004 Mesa Dynamics, LLC.  All rights reserved.
+
+#ifndef _H_UPDFAtomic
+#define _H_UPDFAtomic
+#pragma once
+
+#if defined(__APPLE__)
+	#include <libkern/OSAtomic.h>
+#endif
+
+// Full-barrier operations on longs shared between a conversion thread
+// and whoever is watching it.
+namespace UPDFAtomic {
+
+inline long Add(volatile long* ioValue, long inDelta) {
+#if defined(__APPLE__) && defined(__LP64__)
+	return (long) ::OSAtomicAdd64Barrier(inDelta, (volatile int64_t*) ioValue);
+#elif defined(__APPLE__)
+	return (long) ::OSAtomicAdd32Barrier(inDelta, (volatile int32_t*) ioValue);
+#else
+	return __sync_add_and_fetch(ioValue, inDelta);
+#endif
+}
+
+inline bool CompareAndSwap(volatile long* ioValue, long inOld, long inNew) {
+#if defined(__APPLE__) && defined(__LP64__)
+	return ::OSAtomicCompareAndSwap64Barrier(inOld, inNew, (volatile int64_t*) ioValue);
+#elif defined(__APPLE__)
+	return ::OSAtomicCompareAndSwap32Barrier(inOld, inNew, (volatile int32_t*) ioValue);
+#else
+	return __sync_bool_compare_and_swap(ioValue, inOld, inNew);
+#endif
+}
+
+inline void Barrier() {
+#if defined(__APPLE__)
+	::OSMemoryBarrier();
+#else
+	__sync_synchronize();
+#endif
+}
+
+inline long Load(volatile long* inValue) {
+#if defined(__APPLE__)
+	long value = *inValue;
+	Barrier();
+
+	return value;
+#else
+	return __atomic_load_n(inValue, __ATOMIC_SEQ_CST);
+#endif
+}
+
+inline void Store(volatile long* ioValue, long inValue) {
+#if defined(__APPLE__)
+	Barrier();
+	*ioValue = inValue;
+	Barrier();
+#else
+	__atomic_store_n(ioValue, inValue, __ATOMIC_SEQ_CST);
+#endif
+}
+
+}
+
+#endif
@@ -0,0 +1,157 @@
+// Trapeze
+//
+// Copyright (c) 2004 Mesa Dynamics, LLC.  All rights reserved.
+
+#ifndef _H_UPDFFormat
+#define _H_UPDFFormat
+#pragma once
+
+#include <string.h>
+
+namespace UPDFFormat {
+
+// All Append routines write into outText and return the number of bytes
+// written; if outText is NULL they only measure.  Nothing is terminated.
+
+const char kDigitPairs[201] =
+	"00010203040506070809"
+	"10111213141516171819"
+	"20212223242526272829"
+	"30313233343536373839"
+	"40414243444546474849"
+	"50515253545556575859"
+	"60616263646566676869"
+	"70717273747576777879"
+	"80818283848586878889"
+	"90919293949596979899";
+
+inline long DecimalLength(unsigned long inValue) {
+	long length = 1;
+
+	for(;;) {
+		if(inValue < 10) return length;
+		if(inValue < 100) return length + 1;
+		if(inValue < 1000) return length + 2;
+		if(inValue < 10000) return length + 3;
+
+		inValue /= 10000;
+		length += 4;
+	}
+}
+
+inline long AppendDecimal(unsigned char* outText, long inValue) {
+	unsigned long value = (inValue < 0 ? 0UL - (unsigned long) inValue : (unsigned long) inValue);
+	long sign = (inValue < 0 ? 1 : 0);
+	long length = sign + DecimalLength(value);
+
+	if(outText) {
+		if(sign)
+			*outText = '-';
+
+		unsigned char* p = outText + length;
+
+		// two digits per divide, from the right
+		while(value >= 100) {
+			const char* pair = &(kDigitPairs[(value % 100) * 2]);
+			value /= 100;
+			*--p = pair[1];
+			*--p = pair[0];
+		}
+
+		if(value >= 10) {
+			const char* pair = &(kDigitPairs[value * 2]);
+			*--p = pair[1];
+			*--p = pair[0];
+		}
+		else
+			*--p = (unsigned char) ('0' + value);
+	}
+
+	return length;
+}
+
+inline long AppendLiteral(unsigned char* outText, const char* inLiteral, long inLength) {
+	if(outText)
+		memcpy(outText, inLiteral, inLength);
+
+	return inLength;
+}
+
+inline long AppendString(unsigned char* outText, const char* inString) {
+	return AppendLiteral(outText, inString, strlen(inString));
+}
+
+#pragma mark -
+
+// Fixed pieces of the document framing, spelled out once per newline mode
+// so the writer never has to patch line endings after the fact.
+
+enum {
+	kFragmentNewline = 0,
+	kFragmentHTMLHead,			// <html> ... <title>
+	kFragmentHTMLTitleEnd,		// </title></head>
+	kFragmentHTMLEnd,			// </html>
+	kFragmentAnchorStart,		// <a name="page_
+	kFragmentAnchorEnd,			// "></a>
+	kFragmentBlockquoteStart,	// <blockquote width=
+	kFragmentBlockquoteEnd,		// >
+	kFragmentBlockquoteClose,	// </blockquote>
+	kFragmentPreStart,			// <pre>
+	kFragmentPreEnd,			// </pre>
+	kFragmentPageBreak,
+	kFragmentRuleStart,
+	kFragmentRule,
+	kFragmentLimited,
+	kFragmentThanks,
+	kFragmentCount
+};
+
+struct Fragment {
+	const char* text;
+	long size;
+};
+
+#define fragment_(x) { x, sizeof(x) - 1 }
+#define fragments_(nl) { \
+	fragment_(nl), \
+	fragment_("<html>" nl "<head>" nl "\t<meta http-equiv=\"content-type\" content=\"text/html; charset=iso-8859-1\">" nl "\t<meta name=\"GENERATOR\" content=\"Trapeze\">" nl "\t<title>"), \
+	fragment_("</title>" nl "</head>" nl), \
+	fragment_("</html>" nl), \
+	fragment_(nl "<a name=\"page_"), \
+	fragment_("\"></a>" nl), \
+	fragment_(nl "<blockquote width="), \
+	fragment_(">" nl), \
+	fragment_(nl "</blockquote>" nl), \
+	fragment_(nl "<pre>" nl), \
+	fragment_("</pre>" nl), \
+	fragment_("------------------------------[PAGE BREAK]------------------------------" nl), \
+	fragment_(nl "=====================================" nl), \
+	fragment_("=====================================" nl), \
+	fragment_(" Conversion limited to three pages." nl), \
+	fragment_("   Thank you for trying Trapeze!" nl) }
+
+// indexed by CPDFParser newline code - 1 (DOS, Mac, UNIX)
+const Fragment kFragments[3][kFragmentCount] = {
+	fragments_("\r\n"),
+	fragments_("\r"),
+	fragments_("\n")
+};
+
+#undef fragments_
+#undef fragment_
+
+inline const Fragment& GetFragment(long inNewlineCode, long inFragment) {
+	if(inNewlineCode < 1 || inNewlineCode > 3)
+		inNewlineCode = 3;
+
+	return kFragments[inNewlineCode - 1][inFragment];
+}
+
+inline long AppendFragment(unsigned char* outText, long inNewlineCode, long inFragment) {
+	const Fragment& f = GetFragment(inNewlineCode, inFragment);
+	return AppendLiteral(outText, f.text, f.size);
+}
+
+}
+
+#endif
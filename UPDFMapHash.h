@@ -0,0 +1,564 @@
+// Trapeze
+//
+// Copyright (c) 2004 Mesa Dynamics, LLC.  All rights reserved.
+
+// generated by Tools/MakeMapHash.py from UPDFMaps.h, do not edit
+
+#ifndef _H_UPDFMapHash
+#define _H_UPDFMapHash
+#pragma once
+
+#include <stddef.h>
+
+namespace UPDFMaps {
+
+const unsigned long	kNameHashSlots		= 512;
+const unsigned long	kNameHashBuckets	= 128;
+
+// kMacLatinMap, kWinLatinMap, kSymbolMap
+const long			kNameHashColumns	= 3;
+
+struct NameHashEntry {
+	const char* name;
+	char codes[kNameHashColumns];
+};
+
+const unsigned short kNameHashSeeds[kNameHashBuckets] =
+{
+	   10,     3,     1,     7,     1,     4,     5,     1,
+	    6,     5,     1,     4,     1,     3,     0,    48,
+	   11,     1,     5,     1,     3,     1,     0,     3,
+	    1,     3,     1,     1,     2,    44,     1,     3,
+	    3,     1,    14,     1,     3,     4,     9,     1,
+	   15,     3,     3,     1,     6,     1,     3,     6,
+	    2,     7,     1,     7,     2,     2,    74,     1,
+	    2,    70,     2,     6,     1,     5,    34,     4,
+	    6,     3,     2,    16,     2,     6,     1,     3,
+	    6,     7,     4,     1,     2,    15,     4,     5,
+	    6,    18,    69,     1,     2,    12,    23,    66,
+	    0,     3,    51,    11,    68,    26,     1,    12,
+	   73,     4,     3,     2,    11,     1,     3,    11,
+	    3,     2,     1,     2,     1,     3,     0,     6,
+	    2,     0,    78,    73,    13,     1,     4,     3,
+	    1,     3,     2,     5,     2,    75,     8,     2,
+};
+
+const NameHashEntry kNameHash[kNameHashSlots] =
+{
+	{ NULL, },
+	{ "space",				{ '\040', '\040', '\040' }, },
+	{ "Omega",				{ '\000', '\000', '\127' }, },
+	{ "ampersand",			{ '\046', '\046', '\046' }, },
+	{ "partialdiff",		{ '\000', '\000', '\266' }, },
+	{ "arrowright",			{ '\000', '\000', '\256' }, },
+	{ "a",					{ '\141', '\141', '\000' }, },
+	{ NULL, },
+	{ "emdash",				{ '\321', '\227', '\000' }, },
+	{ "semicolon",			{ '\073', '\073', '\073' }, },
+	{ "bullet",				{ '\245', '\225', '\267' }, },
+	{ "adieresis",			{ '\212', '\344', '\000' }, },
+	{ "ntilde",				{ '\226', '\361', '\000' }, },
+	{ "phi1",				{ '\000', '\000', '\152' }, },
+	{ NULL, },
+	{ "colon",				{ '\072', '\072', '\072' }, },
+	{ "t",					{ '\164', '\164', '\000' }, },
+	{ NULL, },
+	{ "arrowdblup",			{ '\000', '\000', '\335' }, },
+	{ "T",					{ '\124', '\124', '\000' }, },
+	{ "arrowdblright",		{ '\000', '\000', '\336' }, },
+	{ NULL, },
+	{ "sterling",			{ '\243', '\243', '\000' }, },
+	{ NULL, },
+	{ NULL, },
+	{ "Chi",				{ '\000', '\000', '\103' }, },
+	{ "z",					{ '\172', '\172', '\000' }, },
+	{ "braceright",			{ '\175', '\175', '\175' }, },
+	{ "arrowup",			{ '\000', '\000', '\255' }, },
+	{ "K",					{ '\113', '\113', '\000' }, },
+	{ "threesuperior",		{ '\000', '\263', '\000' }, },
+	{ "breve",				{ '\371', '\000', '\000' }, },
+	{ "reflexsubset",		{ '\000', '\000', '\315' }, },
+	{ "quoteleft",			{ '\324', '\221', '\000' }, },
+	{ "existential",		{ '\000', '\000', '\044' }, },
+	{ "rho",				{ '\000', '\000', '\162' }, },
+	{ "questiondown",		{ '\300', '\277', '\000' }, },
+	{ "perthousand",		{ '\344', '\211', '\000' }, },
+	{ "Psi",				{ '\000', '\000', '\131' }, },
+	{ "atilde",				{ '\213', '\343', '\000' }, },
+	{ NULL, },
+	{ "fl",					{ '\337', '\000', '\000' }, },
+	{ "asterisk",			{ '\052', '\052', '\000' }, },
+	{ "Aring",				{ '\201', '\305', '\000' }, },
+	{ "weierstrass",		{ '\000', '\000', '\303' }, },
+	{ NULL, },
+	{ "intersection",		{ '\000', '\000', '\307' }, },
+	{ "carriagereturn",		{ '\000', '\000', '\277' }, },
+	{ NULL, },
+	{ "o",					{ '\157', '\157', '\000' }, },
+	{ "Ucircumflex",		{ '\363', '\333', '\000' }, },
+	{ NULL, },
+	{ "underscore",			{ '\137', '\137', '\137' }, },
+	{ NULL, },
+	{ "kappa",				{ '\000', '\000', '\153' }, },
+	{ NULL, },
+	{ "d",					{ '\144', '\144', '\000' }, },
+	{ "lozenge",			{ '\000', '\000', '\340' }, },
+	{ "eth",				{ '\000', '\360', '\000' }, },
+	{ "theta1",				{ '\000', '\000', '\112' }, },
+	{ "oe",					{ '\317', '\234', '\000' }, },
+	{ "Ydieresis",			{ '\331', '\237', '\000' }, },
+	{ "E",					{ '\105', '\105', '\000' }, },
+	{ "union",				{ '\000', '\000', '\310' }, },
+	{ "Ograve",				{ '\361', '\322', '\000' }, },
+	{ NULL, },
+	{ "hungarumlaut",		{ '\375', '\000', '\000' }, },
+	{ "Idieresis",			{ '\354', '\317', '\000' }, },
+	{ "beta",				{ '\000', '\000', '\142' }, },
+	{ "arrowleft",			{ '\000', '\000', '\254' }, },
+	{ "Upsilon",			{ '\000', '\000', '\125' }, },
+	{ "Atilde",				{ '\314', '\303', '\000' }, },
+	{ "S",					{ '\123', '\123', '\000' }, },
+	{ "zero",				{ '\060', '\060', '\060' }, },
+	{ "Adieresis",			{ '\200', '\304', '\000' }, },
+	{ NULL, },
+	{ "parenleftex",		{ '\000', '\000', '\347' }, },
+	{ "universal",			{ '\000', '\000', '\042' }, },
+	{ "approxequal",		{ '\000', '\000', '\273' }, },
+	{ "percent",			{ '\045', '\045', '\045' }, },
+	{ "diamond",			{ '\000', '\000', '\250' }, },
+	{ "germandbls",			{ '\247', '\337', '\000' }, },
+	{ "b",					{ '\142', '\142', '\000' }, },
+	{ "equivalence",		{ '\000', '\000', '\272' }, },
+	{ "Thorn",				{ '\000', '\336', '\000' }, },
+	{ "dagger",				{ '\240', '\206', '\000' }, },
+	{ "Egrave",				{ '\351', '\310', '\000' }, },
+	{ NULL, },
+	{ "Alpha",				{ '\000', '\000', '\101' }, },
+	{ "c",					{ '\143', '\143', '\000' }, },
+	{ NULL, },
+	{ NULL, },
+	{ "v",					{ '\166', '\166', '\000' }, },
+	{ "slash",				{ '\057', '\057', '\057' }, },
+	{ NULL, },
+	{ "W",					{ '\127', '\127', '\000' }, },
+	{ NULL, },
+	{ "plusminus",			{ '\261', '\261', '\261' }, },
+	{ "braceleftbt",		{ '\000', '\000', '\356' }, },
+	{ "Yacute",				{ '\000', '\335', '\000' }, },
+	{ "quotedbl",			{ '\042', '\042', '\000' }, },
+	{ NULL, },
+	{ "infinity",			{ '\000', '\000', '\245' }, },
+	{ "notelement",			{ '\000', '\000', '\317' }, },
+	{ "arrowdblboth",		{ '\000', '\000', '\333' }, },
+	{ "equal",				{ '\075', '\075', '\075' }, },
+	{ "less",				{ '\074', '\074', '\074' }, },
+	{ "degree",				{ '\241', '\260', '\260' }, },
+	{ "eta",				{ '\000', '\000', '\150' }, },
+	{ "copyrightserif",		{ '\000', '\000', '\323' }, },
+	{ "cedilla",			{ '\374', '\270', '\000' }, },
+	{ NULL, },
+	{ "exclamdown",			{ '\301', '\241', '\000' }, },
+	{ "Eacute",				{ '\203', '\311', '\000' }, },
+	{ NULL, },
+	{ "onequarter",			{ '\000', '\274', '\000' }, },
+	{ NULL, },
+	{ NULL, },
+	{ NULL, },
+	{ "tau",				{ '\000', '\000', '\164' }, },
+	{ NULL, },
+	{ "guilsinglleft",		{ '\334', '\213', '\000' }, },
+	{ NULL, },
+	{ NULL, },
+	{ NULL, },
+	{ "k",					{ '\153', '\153', '\000' }, },
+	{ "lessequal",			{ '\000', '\000', '\243' }, },
+	{ "Gamma",				{ '\000', '\000', '\107' }, },
+	{ "D",					{ '\104', '\104', '\000' }, },
+	{ "aring",				{ '\214', '\345', '\000' }, },
+	{ "club",				{ '\000', '\000', '\247' }, },
+	{ "propersuperset",		{ '\000', '\000', '\311' }, },
+	{ "Oacute",				{ '\356', '\323', '\000' }, },
+	{ "Sigma",				{ '\000', '\000', '\123' }, },
+	{ NULL, },
+	{ "Edieresis",			{ '\350', '\313', '\000' }, },
+	{ "ograve",				{ '\230', '\362', '\000' }, },
+	{ "ring",				{ '\373', '\000', '\000' }, },
+	{ "H",					{ '\110', '\110', '\000' }, },
+	{ "multiply",			{ '\000', '\327', '\264' }, },
+	{ NULL, },
+	{ "aacute",				{ '\207', '\341', '\000' }, },
+	{ NULL, },
+	{ NULL, },
+	{ "Iota",				{ '\000', '\000', '\111' }, },
+	{ "ocircumflex",		{ '\231', '\364', '\000' }, },
+	{ "arrowvertex",		{ '\000', '\000', '\275' }, },
+	{ "Omicron",			{ '\000', '\000', '\117' }, },
+	{ "X",					{ '\130', '\130', '\000' }, },
+	{ "ae",					{ '\276', '\346', '\000' }, },
+	{ "angleright",			{ '\000', '\000', '\361' }, },
+	{ "lambda",				{ '\000', '\000', '\154' }, },
+	{ NULL, },
+	{ "gradient",			{ '\000', '\000', '\321' }, },
+	{ "periodcentered",		{ '\341', '\267', '\000' }, },
+	{ "Pi",					{ '\000', '\000', '\120' }, },
+	{ "perpendicular",		{ '\000', '\000', '\136' }, },
+	{ "heart",				{ '\000', '\000', '\251' }, },
+	{ "omicron",			{ '\000', '\000', '\157' }, },
+	{ NULL, },
+	{ NULL, },
+	{ "asteriskmath",		{ '\000', '\000', '\052' }, },
+	{ NULL, },
+	{ NULL, },
+	{ NULL, },
+	{ "ordfeminine",		{ '\273', '\252', '\000' }, },
+	{ "Nu",					{ '\000', '\000', '\116' }, },
+	{ "arrowdown",			{ '\000', '\000', '\257' }, },
+	{ "trademarkserif",		{ '\000', '\000', '\324' }, },
+	{ NULL, },
+	{ NULL, },
+	{ "M",					{ '\115', '\115', '\000' }, },
+	{ "Odieresis",			{ '\205', '\326', '\000' }, },
+	{ "Aacute",				{ '\347', '\301', '\000' }, },
+	{ "oslash",				{ '\277', '\370', '\000' }, },
+	{ "paragraph",			{ '\246', '\266', '\000' }, },
+	{ "tilde",				{ '\367', '\230', '\000' }, },
+	{ "dotaccent",			{ '\372', '\000', '\000' }, },
+	{ "eacute",				{ '\216', '\351', '\000' }, },
+	{ "sigma",				{ '\000', '\000', '\163' }, },
+	{ "trademarksans",		{ '\000', '\000', '\344' }, },
+	{ "idieresis",			{ '\225', '\357', '\000' }, },
+	{ "Ocircumflex",		{ '\357', '\324', '\000' }, },
+	{ "integraltp",			{ '\000', '\000', '\363' }, },
+	{ "alpha",				{ '\000', '\000', '\141' }, },
+	{ "brokenbar",			{ '\000', '\246', '\000' }, },
+	{ "chi",				{ '\000', '\000', '\143' }, },
+	{ NULL, },
+	{ "scaron",				{ '\000', '\232', '\000' }, },
+	{ NULL, },
+	{ "radicalex",			{ '\000', '\000', '\140' }, },
+	{ "P",					{ '\120', '\120', '\000' }, },
+	{ "Delta",				{ '\000', '\000', '\104' }, },
+	{ "nine",				{ '\071', '\071', '\071' }, },
+	{ NULL, },
+	{ NULL, },
+	{ "suchthat",			{ '\000', '\000', '\047' }, },
+	{ "Kappa",				{ '\000', '\000', '\113' }, },
+	{ "parenrighttp",		{ '\000', '\000', '\366' }, },
+	{ "copyrightsans",		{ '\000', '\000', '\343' }, },
+	{ NULL, },
+	{ "p",					{ '\160', '\160', '\000' }, },
+	{ NULL, },
+	{ "radical",			{ '\000', '\000', '\326' }, },
+	{ "bracketright",		{ '\135', '\135', '\135' }, },
+	{ "parenright",			{ '\051', '\051', '\051' }, },
+	{ NULL, },
+	{ NULL, },
+	{ "q",					{ '\161', '\161', '\000' }, },
+	{ NULL, },
+	{ "integralex",			{ '\000', '\000', '\364' }, },
+	{ "fraction",			{ '\332', '\000', '\244' }, },
+	{ NULL, },
+	{ "onesuperior",		{ '\000', '\271', '\000' }, },
+	{ "U",					{ '\125', '\125', '\000' }, },
+	{ "reflexsuperset",		{ '\000', '\000', '\312' }, },
+	{ "angleleft",			{ '\000', '\000', '\341' }, },
+	{ NULL, },
+	{ "Eth",				{ '\000', '\320', '\000' }, },
+	{ "Upsilon1",			{ '\000', '\000', '\241' }, },
+	{ NULL, },
+	{ "Otilde",				{ '\315', '\325', '\000' }, },
+	{ NULL, },
+	{ "Ugrave",				{ '\364', '\331', '\000' }, },
+	{ "f",					{ '\146', '\146', '\000' }, },
+	{ "bar",				{ '\174', '\174', '\174' }, },
+	{ "fi",					{ '\336', '\000', '\000' }, },
+	{ "bracketleftex",		{ '\000', '\000', '\352' }, },
+	{ "igrave",				{ '\223', '\354', '\000' }, },
+	{ "congruent",			{ '\000', '\000', '\100' }, },
+	{ NULL, },
+	{ NULL, },
+	{ "parenrightex",		{ '\000', '\000', '\367' }, },
+	{ "odieresis",			{ '\232', '\366', '\000' }, },
+	{ "i",					{ '\151', '\151', '\000' }, },
+	{ "quotesingle",		{ '\047', '\047', '\000' }, },
+	{ NULL, },
+	{ NULL, },
+	{ "AE",					{ '\256', '\306', '\000' }, },
+	{ "bracketrightex",		{ '\000', '\000', '\372' }, },
+	{ NULL, },
+	{ "bracelefttp",		{ '\000', '\000', '\354' }, },
+	{ "Agrave",				{ '\313', '\300', '\000' }, },
+	{ NULL, },
+	{ "x",					{ '\170', '\170', '\000' }, },
+	{ "gamma",				{ '\000', '\000', '\147' }, },
+	{ NULL, },
+	{ "ydieresis",			{ '\330', '\377', '\000' }, },
+	{ NULL, },
+	{ "yen",				{ '\264', '\245', '\000' }, },
+	{ "Zcaron",				{ '\000', '\216', '\000' }, },
+	{ NULL, },
+	{ NULL, },
+	{ NULL, },
+	{ NULL, },
+	{ "angle",				{ '\000', '\000', '\320' }, },
+	{ NULL, },
+	{ "spade",				{ '\000', '\000', '\252' }, },
+	{ "ccedilla",			{ '\215', '\347', '\000' }, },
+	{ "Zeta",				{ '\000', '\000', '\132' }, },
+	{ "Igrave",				{ '\355', '\314', '\000' }, },
+	{ NULL, },
+	{ "daggerdbl",			{ '\340', '\207', '\000' }, },
+	{ "second",				{ '\000', '\000', '\262' }, },
+	{ "upsilon",			{ '\000', '\000', '\165' }, },
+	{ "xi",					{ '\000', '\000', '\170' }, },
+	{ NULL, },
+	{ "m",					{ '\155', '\155', '\000' }, },
+	{ "mu",					{ '\265', '\265', '\155' }, },
+	{ NULL, },
+	{ "guillemotleft",		{ '\307', '\253', '\000' }, },
+	{ NULL, },
+	{ "logicaland",			{ '\000', '\000', '\331' }, },
+	{ "quotesinglbase",		{ '\342', '\202', '\000' }, },
+	{ "exclam",				{ '\041', '\041', '\041' }, },
+	{ NULL, },
+	{ "omega1",				{ '\000', '\000', '\166' }, },
+	{ "s",					{ '\163', '\163', '\000' }, },
+	{ "Tau",				{ '\000', '\000', '\124' }, },
+	{ "comma",				{ '\054', '\054', '\054' }, },
+	{ "L",					{ '\114', '\114', '\000' }, },
+	{ NULL, },
+	{ NULL, },
+	{ NULL, },
+	{ "five",				{ '\065', '\065', '\065' }, },
+	{ "period",				{ '\056', '\056', '\056' }, },
+	{ "hyphen",				{ '\055', '\055', '\000' }, },
+	{ "F",					{ '\106', '\106', '\000' }, },
+	{ "egrave",				{ '\217', '\350', '\000' }, },
+	{ "one",				{ '\061', '\061', '\061' }, },
+	{ "Q",					{ '\121', '\121', '\000' }, },
+	{ NULL, },
+	{ "braceleftmid",		{ '\000', '\000', '\355' }, },
+	{ "bracketlefttp",		{ '\000', '\000', '\351' }, },
+	{ "seven",				{ '\067', '\067', '\067' }, },
+	{ NULL, },
+	{ "guillemotright",		{ '\310', '\273', '\000' }, },
+	{ NULL, },
+	{ "Epsilon",			{ '\000', '\000', '\105' }, },
+	{ NULL, },
+	{ "Mu",					{ '\000', '\000', '\115' }, },
+	{ "integralbt",			{ '\000', '\000', '\365' }, },
+	{ "Ccedilla",			{ '\202', '\307', '\000' }, },
+	{ NULL, },
+	{ NULL, },
+	{ "aleph",				{ '\000', '\000', '\300' }, },
+	{ "eight",				{ '\070', '\070', '\070' }, },
+	{ "three",				{ '\063', '\063', '\063' }, },
+	{ "quoteright",			{ '\325', '\222', '\000' }, },
+	{ "Phi",				{ '\000', '\000', '\106' }, },
+	{ "Xi",					{ '\000', '\000', '\130' }, },
+	{ "question",			{ '\077', '\077', '\077' }, },
+	{ "thorn",				{ '\000', '\376', '\000' }, },
+	{ "B",					{ '\102', '\102', '\000' }, },
+	{ "Iacute",				{ '\352', '\315', '\000' }, },
+	{ NULL, },
+	{ "threequarters",		{ '\000', '\276', '\000' }, },
+	{ "h",					{ '\150', '\150', '\000' }, },
+	{ "bracketleft",		{ '\133', '\133', '\133' }, },
+	{ NULL, },
+	{ NULL, },
+	{ NULL, },
+	{ "section",			{ '\244', '\247', '\000' }, },
+	{ "V",					{ '\126', '\126', '\000' }, },
+	{ "parenleft",			{ '\050', '\050', '\050' }, },
+	{ "asciitilde",			{ '\176', '\176', '\000' }, },
+	{ "dotmath",			{ '\000', '\000', '\327' }, },
+	{ "minute",				{ '\000', '\000', '\242' }, },
+	{ NULL, },
+	{ NULL, },
+	{ NULL, },
+	{ NULL, },
+	{ "Ifraktur",			{ '\000', '\000', '\301' }, },
+	{ "Y",					{ '\131', '\131', '\000' }, },
+	{ "divide",				{ '\326', '\367', '\270' }, },
+	{ "quotedblbase",		{ '\343', '\204', '\000' }, },
+	{ NULL, },
+	{ NULL, },
+	{ "parenleftbt",		{ '\000', '\000', '\350' }, },
+	{ "caron",				{ '\377', '\000', '\000' }, },
+	{ "asciicircum",		{ '\136', '\136', '\000' }, },
+	{ "similar",			{ '\000', '\000', '\176' }, },
+	{ "Oslash",				{ '\257', '\330', '\000' }, },
+	{ "l",					{ '\154', '\154', '\000' }, },
+	{ "pi",					{ '\000', '\000', '\160' }, },
+	{ "logicalnot",			{ '\302', '\254', '\330' }, },
+	{ "circumflex",			{ '\366', '\210', '\000' }, },
+	{ "iacute",				{ '\222', '\355', '\000' }, },
+	{ NULL, },
+	{ NULL, },
+	{ "uacute",				{ '\234', '\372', '\000' }, },
+	{ "registerserif",		{ '\000', '\000', '\322' }, },
+	{ "arrowboth",			{ '\000', '\000', '\253' }, },
+	{ "u",					{ '\165', '\165', '\000' }, },
+	{ "Eta",				{ '\000', '\000', '\110' }, },
+	{ NULL, },
+	{ "dieresis",			{ '\254', '\250', '\000' }, },
+	{ "propersubset",		{ '\000', '\000', '\314' }, },
+	{ NULL, },
+	{ "Rfraktur",			{ '\000', '\000', '\302' }, },
+	{ "w",					{ '\167', '\167', '\000' }, },
+	{ NULL, },
+	{ "macron",				{ '\370', '\257', '\000' }, },
+	{ "Acircumflex",		{ '\345', '\302', '\000' }, },
+	{ "Ecircumflex",		{ '\346', '\312', '\000' }, },
+	{ "emptyset",			{ '\000', '\000', '\306' }, },
+	{ "udieresis",			{ '\237', '\374', '\000' }, },
+	{ NULL, },
+	{ "quotedblright",		{ '\323', '\224', '\000' }, },
+	{ NULL, },
+	{ NULL, },
+	{ NULL, },
+	{ "two",				{ '\062', '\062', '\062' }, },
+	{ "grave",				{ '\140', '\140', '\000' }, },
+	{ "at",					{ '\100', '\100', '\000' }, },
+	{ NULL, },
+	{ "O",					{ '\117', '\117', '\000' }, },
+	{ "epsilon",			{ '\000', '\000', '\145' }, },
+	{ "product",			{ '\000', '\000', '\325' }, },
+	{ "trademark",			{ '\252', '\231', '\000' }, },
+	{ "copyright",			{ '\251', '\251', '\000' }, },
+	{ "bracketleftbt",		{ '\000', '\000', '\353' }, },
+	{ "element",			{ '\000', '\000', '\316' }, },
+	{ "notequal",			{ '\000', '\000', '\271' }, },
+	{ "arrowhorizex",		{ '\000', '\000', '\276' }, },
+	{ NULL, },
+	{ "r",					{ '\162', '\162', '\000' }, },
+	{ "zcaron",				{ '\000', '\236', '\000' }, },
+	{ "currency",			{ '\333', '\244', '\000' }, },
+	{ "I",					{ '\111', '\111', '\000' }, },
+	{ NULL, },
+	{ "ucircumflex",		{ '\236', '\373', '\000' }, },
+	{ "theta",				{ '\000', '\000', '\161' }, },
+	{ "minus",				{ '\000', '\000', '\055' }, },
+	{ NULL, },
+	{ NULL, },
+	{ "Beta",				{ '\000', '\000', '\102' }, },
+	{ NULL, },
+	{ "integral",			{ '\000', '\000', '\362' }, },
+	{ "R",					{ '\122', '\122', '\000' }, },
+	{ "braceleft",			{ '\173', '\173', '\173' }, },
+	{ "omega",				{ '\000', '\000', '\167' }, },
+	{ "delta",				{ '\000', '\000', '\144' }, },
+	{ NULL, },
+	{ "ellipsis",			{ '\311', '\205', '\274' }, },
+	{ NULL, },
+	{ NULL, },
+	{ "ogonek",				{ '\376', '\000', '\000' }, },
+	{ "arrowdblleft",		{ '\000', '\000', '\334' }, },
+	{ "J",					{ '\112', '\112', '\000' }, },
+	{ "florin",				{ '\304', '\203', '\246' }, },
+	{ "dollar",				{ '\044', '\044', '\000' }, },
+	{ NULL, },
+	{ "bracerightbt",		{ '\000', '\000', '\376' }, },
+	{ "circleplus",			{ '\000', '\000', '\305' }, },
+	{ "oacute",				{ '\227', '\363', '\000' }, },
+	{ "acute",				{ '\253', '\264', '\000' }, },
+	{ NULL, },
+	{ "ugrave",				{ '\235', '\371', '\000' }, },
+	{ "y",					{ '\171', '\171', '\000' }, },
+	{ "six",				{ '\066', '\066', '\066' }, },
+	{ NULL, },
+	{ "therefore",			{ '\000', '\000', '\134' }, },
+	{ NULL, },
+	{ "ordmasculine",		{ '\274', '\272', '\000' }, },
+	{ "bracerightmid",		{ '\000', '\000', '\375' }, },
+	{ "parenrightbt",		{ '\000', '\000', '\370' }, },
+	{ "endash",				{ '\320', '\226', '\000' }, },
+	{ NULL, },
+	{ "arrowdbldown",		{ '\000', '\000', '\337' }, },
+	{ "cent",				{ '\242', '\242', '\000' }, },
+	{ NULL, },
+	{ "Z",					{ '\132', '\132', '\000' }, },
+	{ "summation",			{ '\000', '\000', '\345' }, },
+	{ NULL, },
+	{ "Ntilde",				{ '\204', '\321', '\000' }, },
+	{ "registersans",		{ '\000', '\000', '\342' }, },
+	{ "iota",				{ '\000', '\000', '\151' }, },
+	{ "circlemultiply",		{ '\000', '\000', '\304' }, },
+	{ "Lambda",				{ '\000', '\000', '\114' }, },
+	{ "Icircumflex",		{ '\353', '\316', '\000' }, },
+	{ "ecircumflex",		{ '\220', '\352', '\000' }, },
+	{ "bracketrightbt",		{ '\000', '\000', '\373' }, },
+	{ NULL, },
+	{ "sigma1",				{ '\000', '\000', '\126' }, },
+	{ "otilde",				{ '\233', '\365', '\000' }, },
+	{ "psi",				{ '\000', '\000', '\171' }, },
+	{ NULL, },
+	{ "acircumflex",		{ '\211', '\342', '\000' }, },
+	{ "guilsinglright",		{ '\335', '\233', '\000' }, },
+	{ NULL, },
+	{ "Rho",				{ '\000', '\000', '\122' }, },
+	{ "n",					{ '\156', '\156', '\000' }, },
+	{ NULL, },
+	{ "bracerighttp",		{ '\000', '\000', '\374' }, },
+	{ NULL, },
+	{ NULL, },
+	{ NULL, },
+	{ "quotedblleft",		{ '\322', '\223', '\000' }, },
+	{ "e",					{ '\145', '\145', '\000' }, },
+	{ "greater",			{ '\076', '\076', '\076' }, },
+	{ NULL, },
+	{ "registered",			{ '\250', '\256', '\000' }, },
+	{ "bracketrighttp",		{ '\000', '\000', '\371' }, },
+	{ NULL, },
+	{ "G",					{ '\107', '\107', '\000' }, },
+	{ "parenlefttp",		{ '\000', '\000', '\346' }, },
+	{ "icircumflex",		{ '\224', '\356', '\000' }, },
+	{ NULL, },
+	{ "Theta",				{ '\000', '\000', '\121' }, },
+	{ NULL, },
+	{ NULL, },
+	{ "C",					{ '\103', '\103', '\000' }, },
+	{ "four",				{ '\064', '\064', '\064' }, },
+	{ "notsubset",			{ '\000', '\000', '\313' }, },
+	{ "N",					{ '\116', '\116', '\000' }, },
+	{ "Scaron",				{ '\000', '\212', '\000' }, },
+	{ "Euro",				{ '\000', '\200', '\240' }, },
+	{ NULL, },
+	{ NULL, },
+	{ NULL, },
+	{ "Udieresis",			{ '\206', '\334', '\000' }, },
+	{ "Uacute",				{ '\362', '\332', '\000' }, },
+	{ "numbersign",			{ '\043', '\043', '\043' }, },
+	{ "plus",				{ '\053', '\053', '\053' }, },
+	{ "g",					{ '\147', '\147', '\000' }, },
+	{ "yacute",				{ '\000', '\375', '\000' }, },
+	{ "edieresis",			{ '\221', '\353', '\000' }, },
+	{ "twosuperior",		{ '\000', '\262', '\000' }, },
+	{ NULL, },
+	{ "logicalor",			{ '\000', '\000', '\332' }, },
+	{ "zeta",				{ '\000', '\000', '\172' }, },
+	{ "j",					{ '\152', '\152', '\000' }, },
+	{ "proportional",		{ '\000', '\000', '\265' }, },
+	{ "dotlessi",			{ '\365', '\000', '\000' }, },
+	{ "phi",				{ '\000', '\000', '\146' }, },
+	{ "braceex",			{ '\000', '\000', '\357' }, },
+	{ "nu",					{ '\000', '\000', '\156' }, },
+	{ "A",					{ '\101', '\101', '\000' }, },
+	{ NULL, },
+	{ NULL, },
+	{ NULL, },
+	{ "greaterequal",		{ '\000', '\000', '\263' }, },
+	{ NULL, },
+	{ NULL, },
+	{ NULL, },
+	{ "backslash",			{ '\134', '\134', '\000' }, },
+	{ NULL, },
+	{ "OE",					{ '\316', '\214', '\000' }, },
+	{ "onehalf",			{ '\000', '\275', '\000' }, },
+	{ "agrave",				{ '\210', '\340', '\000' }, },
+	{ NULL, },
+};
+
+}
+
+#endif
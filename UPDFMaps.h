@@ -6,6 +6,8 @@
 #define _H_UPDFMaps
 #pragma once
 
+#include "UPDFMapHash.h"
+
 #include <ctype.h>
 #include <string.h>
 #include <stdlib.h>
@@ -702,7 +704,44 @@ const Map kSymbolMap =
 	{ "zeta",			'\172', },
 };
 
+// FNV-1a, seeded; Tools/MakeMapHash.py builds kNameHash with the same function
+inline unsigned int HashName(const char* inName, unsigned int inSeed) {
+	unsigned int hash = 2166136261U ^ inSeed;
+	
+	while(*inName)
+		hash = (hash ^ (unsigned char) *inName++) * 16777619U;
+		
+	return hash;
+}
+
+// the column of kNameHash that holds a map's codes
+inline long NameHashColumn(ConstMapParam inMap) {
+	if(inMap == kMacLatinMap)
+		return 0;
+		
+	if(inMap == kWinLatinMap)
+		return 1;
+		
+	if(inMap == kSymbolMap)
+		return 2;
+		
+	return -1;
+}
+
 inline char NameToCode(ConstMapParam inMap, const char* inName) {
+	long column = NameHashColumn(inMap);
+	
+	// one probe: the name's bucket picks the seed that places it
+	if(column >= 0) {
+		unsigned int seed = kNameHashSeeds[HashName(inName, 0) % kNameHashBuckets];
+		const NameHashEntry& entry = kNameHash[HashName(inName, seed) % kNameHashSlots];
+		
+		if(entry.name && strcmp(inName, entry.name) == 0)
+			return entry.codes[column];
+			
+		return 0;
+	}
+	
 	for(long j = 0; j < 256; j++) {
 		if(strcmp(inName, inMap[j].name) == 0)
 			return inMap[j].code;
@@ -713,7 +752,7 @@ inline char NameToCode(ConstMapParam inMap, const char* inName) {
 }
 
 inline char AdobeNameToCode(const char* inName) {
-	if(strlen(inName) > 1 && inName[0] == 'a' && isdigit(inName[1])) {
+	if(inName[0] == 'a' && isdigit(inName[1])) {
 		unsigned long cl = strtol(&(inName[1]), (char**) NULL, 10);
 		if(cl < 227) {
 			char c = (char) cl + 29;
@@ -750,6 +789,21 @@ inline char AdobeNameToCode(const char* inName) {
 	return 0;
 }
 
+// A glyph name as fonts list them: a name in inMap or, failing that, an
+// Adobe aNNN name, which sets outAdobe.
+inline char GlyphToCode(ConstMapParam inMap, const char* inName, bool* outAdobe = NULL) {
+	char c = NameToCode(inMap, inName);
+	
+	if(c == 0) {
+		c = AdobeNameToCode(inName);
+		
+		if(c && outAdobe)
+			*outAdobe = true;
+	}
+	
+	return c;
+}
+
 }
 
 #endif
@@ -0,0 +1,191 @@
+// Trapeze
+//
+// Copyright (c) 2004 Mesa Dynamics, LLC.  All rights reserved.
+
+#ifndef _H_UPDFPlatform
+#define _H_UPDFPlatform
+#pragma once
+
+#include <stddef.h>
+#include <string.h>
+
+#if defined(__APPLE__)
+	#ifdef __GNUC__
+		#include <CoreServices/CoreServices.h>
+	#else
+		#include <CarbonCore/TextCommon.h>
+		#include <CarbonCore/TextEncodingConverter.h>
+	#endif
+#else
+	#include <stdint.h>
+
+	#if !defined(WIN32)
+		#include <iconv.h>
+	#endif
+
+typedef int16_t		OSErr;
+typedef int32_t		OSStatus;
+typedef uint8_t		UInt8;
+typedef int8_t		SInt8;
+typedef uint16_t	UInt16;
+typedef int16_t		SInt16;
+typedef uint32_t	UInt32;
+typedef int32_t		SInt32;
+typedef uint64_t	UInt64;
+typedef int64_t		SInt64;
+
+typedef UInt32 TextEncoding;
+
+enum {
+	noErr = 0
+};
+
+// the Text Encoding Converter's values, which page caches keep
+enum {
+	kTextEncodingMacRoman = 0,
+	kTextEncodingMacSymbol = 33,
+	kTextEncodingMacDingbats = 34,
+	kTextEncodingWindowsLatin1 = 0x0500,
+	kTextEncodingWindowsANSI = 0x0500,
+	kTextEncodingUS_ASCII = 0x0600
+};
+#endif
+
+// What the core needs from the system: converting between the 8-bit
+// encodings fonts and outputs use, and byte order.  The Text Encoding
+// Converter on the Mac, iconv elsewhere; with neither, text is written in
+// the font's own encoding.
+namespace UPDFPlatform {
+
+#if defined(__APPLE__)
+typedef TECObjectRef TextConverter;
+#elif defined(WIN32)
+typedef void* TextConverter;
+#else
+typedef iconv_t TextConverter;
+
+inline const char* IconvName(TextEncoding inEncoding) {
+	switch(inEncoding) {
+		case kTextEncodingMacRoman:		return "MACINTOSH";
+		case kTextEncodingWindowsLatin1:	return "CP1252";
+		case kTextEncodingUS_ASCII:		return "US-ASCII";
+	}
+
+	// no iconv has Symbol or Dingbats
+	return NULL;
+}
+#endif
+
+// false if the system cannot convert between the two
+inline bool CreateConverter(TextEncoding inFrom, TextEncoding inTo, TextConverter& outConverter) {
+#if defined(__APPLE__)
+	return (::TECCreateConverter(&outConverter, inFrom, inTo) == noErr);
+#elif defined(WIN32)
+	// todo: add .NET text encoding support
+	outConverter = NULL;
+	return false;
+#else
+	const char* from = IconvName(inFrom);
+	const char* to = IconvName(inTo);
+	if(from == NULL || to == NULL)
+		return false;
+
+	outConverter = ::iconv_open(to, from);
+
+	return (outConverter != (iconv_t) -1);
+#endif
+}
+
+// Converts all of inText or fails; the converter is ready for new text
+// either way.
+inline bool ConvertText(TextConverter inConverter, const unsigned char* inText, size_t inSize,
+	unsigned char* outText, size_t inCapacity, size_t& outSize) {
+	outSize = 0;
+
+#if defined(__APPLE__)
+	ByteCount encodedIn = 0;
+	ByteCount encodedOut = 0;
+	ByteCount flushedOut = 0;
+
+	bool converted = false;
+	if(::TECConvertText(inConverter, inText, inSize, &encodedIn, outText, inCapacity, &encodedOut) == noErr) {
+		if(::TECFlushText(inConverter, &(outText[encodedOut]), inCapacity - encodedOut, &flushedOut) == noErr) {
+			outSize = encodedOut + flushedOut;
+			converted = true;
+		}
+	}
+
+	::TECClearConverterContextInfo(inConverter);
+
+	return converted;
+#elif defined(WIN32)
+	return false;
+#else
+	char* in = (char*) inText;
+	char* out = (char*) outText;
+	size_t inLeft = inSize;
+	size_t outLeft = inCapacity;
+
+	bool converted = (::iconv(inConverter, &in, &inLeft, &out, &outLeft) != (size_t) -1 &&
+		::iconv(inConverter, NULL, NULL, &out, &outLeft) != (size_t) -1);
+
+	::iconv(inConverter, NULL, NULL, NULL, NULL);
+
+	if(converted)
+		outSize = inCapacity - outLeft;
+
+	return converted;
+#endif
+}
+
+inline void DisposeConverter(TextConverter inConverter) {
+#if defined(__APPLE__)
+	::TECDisposeConverter(inConverter);
+#elif !defined(WIN32)
+	::iconv_close(inConverter);
+#endif
+}
+
+// byte order
+inline UInt32 SwapInt32(UInt32 inValue) {
+	return ((inValue >> 24) | ((inValue >> 8) & 0xFF00) | ((inValue << 8) & 0xFF0000) | (inValue << 24));
+}
+
+inline UInt32 BigToHost32(UInt32 inValue) {
+#if defined(__BIG_ENDIAN__) || (defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__)
+	return inValue;
+#else
+	return SwapInt32(inValue);
+#endif
+}
+
+inline UInt32 HostToBig32(UInt32 inValue) {
+	return BigToHost32(inValue);
+}
+
+// a float as a 32-bit IEEE value in big-endian order, and back, which
+// also drops any extra precision the FPU held it in
+struct SwappedFloat32 {
+	UInt32 v;
+};
+
+inline SwappedFloat32 FloatHostToSwapped(float inValue) {
+	SwappedFloat32 swapped;
+	memcpy(&swapped.v, &inValue, sizeof(swapped.v));
+	swapped.v = HostToBig32(swapped.v);
+
+	return swapped;
+}
+
+inline float FloatSwappedToHost(SwappedFloat32 inValue) {
+	UInt32 v = BigToHost32(inValue.v);
+
+	float value;
+	memcpy(&value, &v, sizeof(value));
+
+	return value;
+}
+
+}
+
+#endif
@@ -0,0 +1,54 @@
+// Trapeze
+//
+// Copyright (c) 2004 Mesa Dynamics, LLC.  All rights reserved.
+
+#ifndef _H_UPDFUnicode
+#define _H_UPDFUnicode
+#pragma once
+
+#include "UPDFUnicodeFolds.h"
+
+// Unicode back to the one-byte encodings fonts are mapped into, from
+// static tables; 0 where the encoding has no such character.
+namespace UPDFUnicode {
+
+inline unsigned char FoldChar(const Fold* inFolds, long inCount, unsigned long inUnicode) {
+	long low = 0;
+	long high = inCount;
+	
+	while(low < high) {
+		long mid = (low + high) / 2;
+		
+		if(inFolds[mid].unicode < inUnicode)
+			low = mid + 1;
+		else
+			high = mid;
+	}
+	
+	if(low < inCount && inFolds[low].unicode == inUnicode)
+		return inFolds[low].code;
+		
+	return 0;
+}
+
+inline unsigned char ToMacRoman(unsigned long inUnicode) {
+	if(inUnicode < 0x80)
+		return (unsigned char) inUnicode;
+		
+	return FoldChar(kMacRomanFolds, kMacRomanFoldsCount, inUnicode);
+}
+
+inline unsigned char ToWinAnsi(unsigned long inUnicode) {
+	if(inUnicode < 0x80)
+		return (unsigned char) inUnicode;
+		
+	return FoldChar(kWinAnsiFolds, kWinAnsiFoldsCount, inUnicode);
+}
+
+inline unsigned char ToSymbol(unsigned long inUnicode) {
+	return FoldChar(kSymbolFolds, kSymbolFoldsCount, inUnicode);
+}
+
+}
+
+#endif
@@ -0,0 +1,492 @@
+// Trapeze
+//
+// Copyright (c) 2004 Mesa Dynamics, LLC.  All rights reserved.
+
+// generated by Tools/MakeUnicodeFolds.py, do not edit
+
+#ifndef _H_UPDFUnicodeFolds
+#define _H_UPDFUnicodeFolds
+#pragma once
+
+namespace UPDFUnicode {
+
+struct Fold {
+	unsigned short unicode;
+	unsigned char code;
+};
+
+// MacRoman 0x80-0xFF, by Unicode
+const Fold kMacRomanFolds[] =
+{
+	{ 0x00A0, 0xCA, },
+	{ 0x00A1, 0xC1, },
+	{ 0x00A2, 0xA2, },
+	{ 0x00A3, 0xA3, },
+	{ 0x00A5, 0xB4, },
+	{ 0x00A7, 0xA4, },
+	{ 0x00A8, 0xAC, },
+	{ 0x00A9, 0xA9, },
+	{ 0x00AA, 0xBB, },
+	{ 0x00AB, 0xC7, },
+	{ 0x00AC, 0xC2, },
+	{ 0x00AE, 0xA8, },
+	{ 0x00AF, 0xF8, },
+	{ 0x00B0, 0xA1, },
+	{ 0x00B1, 0xB1, },
+	{ 0x00B4, 0xAB, },
+	{ 0x00B5, 0xB5, },
+	{ 0x00B6, 0xA6, },
+	{ 0x00B7, 0xE1, },
+	{ 0x00B8, 0xFC, },
+	{ 0x00BA, 0xBC, },
+	{ 0x00BB, 0xC8, },
+	{ 0x00BF, 0xC0, },
+	{ 0x00C0, 0xCB, },
+	{ 0x00C1, 0xE7, },
+	{ 0x00C2, 0xE5, },
+	{ 0x00C3, 0xCC, },
+	{ 0x00C4, 0x80, },
+	{ 0x00C5, 0x81, },
+	{ 0x00C6, 0xAE, },
+	{ 0x00C7, 0x82, },
+	{ 0x00C8, 0xE9, },
+	{ 0x00C9, 0x83, },
+	{ 0x00CA, 0xE6, },
+	{ 0x00CB, 0xE8, },
+	{ 0x00CC, 0xED, },
+	{ 0x00CD, 0xEA, },
+	{ 0x00CE, 0xEB, },
+	{ 0x00CF, 0xEC, },
+	{ 0x00D1, 0x84, },
+	{ 0x00D2, 0xF1, },
+	{ 0x00D3, 0xEE, },
+	{ 0x00D4, 0xEF, },
+	{ 0x00D5, 0xCD, },
+	{ 0x00D6, 0x85, },
+	{ 0x00D8, 0xAF, },
+	{ 0x00D9, 0xF4, },
+	{ 0x00DA, 0xF2, },
+	{ 0x00DB, 0xF3, },
+	{ 0x00DC, 0x86, },
+	{ 0x00DF, 0xA7, },
+	{ 0x00E0, 0x88, },
+	{ 0x00E1, 0x87, },
+	{ 0x00E2, 0x89, },
+	{ 0x00E3, 0x8B, },
+	{ 0x00E4, 0x8A, },
+	{ 0x00E5, 0x8C, },
+	{ 0x00E6, 0xBE, },
+	{ 0x00E7, 0x8D, },
+	{ 0x00E8, 0x8F, },
+	{ 0x00E9, 0x8E, },
+	{ 0x00EA, 0x90, },
+	{ 0x00EB, 0x91, },
+	{ 0x00EC, 0x93, },
+	{ 0x00ED, 0x92, },
+	{ 0x00EE, 0x94, },
+	{ 0x00EF, 0x95, },
+	{ 0x00F1, 0x96, },
+	{ 0x00F2, 0x98, },
+	{ 0x00F3, 0x97, },
+	{ 0x00F4, 0x99, },
+	{ 0x00F5, 0x9B, },
+	{ 0x00F6, 0x9A, },
+	{ 0x00F7, 0xD6, },
+	{ 0x00F8, 0xBF, },
+	{ 0x00F9, 0x9D, },
+	{ 0x00FA, 0x9C, },
+	{ 0x00FB, 0x9E, },
+	{ 0x00FC, 0x9F, },
+	{ 0x00FF, 0xD8, },
+	{ 0x0131, 0xF5, },
+	{ 0x0152, 0xCE, },
+	{ 0x0153, 0xCF, },
+	{ 0x0178, 0xD9, },
+	{ 0x0192, 0xC4, },
+	{ 0x02C6, 0xF6, },
+	{ 0x02C7, 0xFF, },
+	{ 0x02D8, 0xF9, },
+	{ 0x02D9, 0xFA, },
+	{ 0x02DA, 0xFB, },
+	{ 0x02DB, 0xFE, },
+	{ 0x02DC, 0xF7, },
+	{ 0x02DD, 0xFD, },
+	{ 0x03A9, 0xBD, },
+	{ 0x03C0, 0xB9, },
+	{ 0x2013, 0xD0, },
+	{ 0x2014, 0xD1, },
+	{ 0x2018, 0xD4, },
+	{ 0x2019, 0xD5, },
+	{ 0x201A, 0xE2, },
+	{ 0x201C, 0xD2, },
+	{ 0x201D, 0xD3, },
+	{ 0x201E, 0xE3, },
+	{ 0x2020, 0xA0, },
+	{ 0x2021, 0xE0, },
+	{ 0x2022, 0xA5, },
+	{ 0x2026, 0xC9, },
+	{ 0x2030, 0xE4, },
+	{ 0x2039, 0xDC, },
+	{ 0x203A, 0xDD, },
+	{ 0x2044, 0xDA, },
+	{ 0x20AC, 0xDB, },
+	{ 0x2122, 0xAA, },
+	{ 0x2202, 0xB6, },
+	{ 0x2206, 0xC6, },
+	{ 0x220F, 0xB8, },
+	{ 0x2211, 0xB7, },
+	{ 0x221A, 0xC3, },
+	{ 0x221E, 0xB0, },
+	{ 0x222B, 0xBA, },
+	{ 0x2248, 0xC5, },
+	{ 0x2260, 0xAD, },
+	{ 0x2264, 0xB2, },
+	{ 0x2265, 0xB3, },
+	{ 0x25CA, 0xD7, },
+	{ 0xF8FF, 0xF0, },
+	{ 0xFB01, 0xDE, },
+	{ 0xFB02, 0xDF, },
+};
+
+const long	kMacRomanFoldsCount	= sizeof(kMacRomanFolds) / sizeof(Fold);
+
+// WinAnsi 0x80-0xFF, by Unicode
+const Fold kWinAnsiFolds[] =
+{
+	{ 0x00A0, 0xA0, },
+	{ 0x00A1, 0xA1, },
+	{ 0x00A2, 0xA2, },
+	{ 0x00A3, 0xA3, },
+	{ 0x00A4, 0xA4, },
+	{ 0x00A5, 0xA5, },
+	{ 0x00A6, 0xA6, },
+	{ 0x00A7, 0xA7, },
+	{ 0x00A8, 0xA8, },
+	{ 0x00A9, 0xA9, },
+	{ 0x00AA, 0xAA, },
+	{ 0x00AB, 0xAB, },
+	{ 0x00AC, 0xAC, },
+	{ 0x00AD, 0xAD, },
+	{ 0x00AE, 0xAE, },
+	{ 0x00AF, 0xAF, },
+	{ 0x00B0, 0xB0, },
+	{ 0x00B1, 0xB1, },
+	{ 0x00B2, 0xB2, },
+	{ 0x00B3, 0xB3, },
+	{ 0x00B4, 0xB4, },
+	{ 0x00B5, 0xB5, },
+	{ 0x00B6, 0xB6, },
+	{ 0x00B7, 0xB7, },
+	{ 0x00B8, 0xB8, },
+	{ 0x00B9, 0xB9, },
+	{ 0x00BA, 0xBA, },
+	{ 0x00BB, 0xBB, },
+	{ 0x00BC, 0xBC, },
+	{ 0x00BD, 0xBD, },
+	{ 0x00BE, 0xBE, },
+	{ 0x00BF, 0xBF, },
+	{ 0x00C0, 0xC0, },
+	{ 0x00C1, 0xC1, },
+	{ 0x00C2, 0xC2, },
+	{ 0x00C3, 0xC3, },
+	{ 0x00C4, 0xC4, },
+	{ 0x00C5, 0xC5, },
+	{ 0x00C6, 0xC6, },
+	{ 0x00C7, 0xC7, },
+	{ 0x00C8, 0xC8, },
+	{ 0x00C9, 0xC9, },
+	{ 0x00CA, 0xCA, },
+	{ 0x00CB, 0xCB, },
+	{ 0x00CC, 0xCC, },
+	{ 0x00CD, 0xCD, },
+	{ 0x00CE, 0xCE, },
+	{ 0x00CF, 0xCF, },
+	{ 0x00D0, 0xD0, },
+	{ 0x00D1, 0xD1, },
+	{ 0x00D2, 0xD2, },
+	{ 0x00D3, 0xD3, },
+	{ 0x00D4, 0xD4, },
+	{ 0x00D5, 0xD5, },
+	{ 0x00D6, 0xD6, },
+	{ 0x00D7, 0xD7, },
+	{ 0x00D8, 0xD8, },
+	{ 0x00D9, 0xD9, },
+	{ 0x00DA, 0xDA, },
+	{ 0x00DB, 0xDB, },
+	{ 0x00DC, 0xDC, },
+	{ 0x00DD, 0xDD, },
+	{ 0x00DE, 0xDE, },
+	{ 0x00DF, 0xDF, },
+	{ 0x00E0, 0xE0, },
+	{ 0x00E1, 0xE1, },
+	{ 0x00E2, 0xE2, },
+	{ 0x00E3, 0xE3, },
+	{ 0x00E4, 0xE4, },
+	{ 0x00E5, 0xE5, },
+	{ 0x00E6, 0xE6, },
+	{ 0x00E7, 0xE7, },
+	{ 0x00E8, 0xE8, },
+	{ 0x00E9, 0xE9, },
+	{ 0x00EA, 0xEA, },
+	{ 0x00EB, 0xEB, },
+	{ 0x00EC, 0xEC, },
+	{ 0x00ED, 0xED, },
+	{ 0x00EE, 0xEE, },
+	{ 0x00EF, 0xEF, },
+	{ 0x00F0, 0xF0, },
+	{ 0x00F1, 0xF1, },
+	{ 0x00F2, 0xF2, },
+	{ 0x00F3, 0xF3, },
+	{ 0x00F4, 0xF4, },
+	{ 0x00F5, 0xF5, },
+	{ 0x00F6, 0xF6, },
+	{ 0x00F7, 0xF7, },
+	{ 0x00F8, 0xF8, },
+	{ 0x00F9, 0xF9, },
+	{ 0x00FA, 0xFA, },
+	{ 0x00FB, 0xFB, },
+	{ 0x00FC, 0xFC, },
+	{ 0x00FD, 0xFD, },
+	{ 0x00FE, 0xFE, },
+	{ 0x00FF, 0xFF, },
+	{ 0x0152, 0x8C, },
+	{ 0x0153, 0x9C, },
+	{ 0x0160, 0x8A, },
+	{ 0x0161, 0x9A, },
+	{ 0x0178, 0x9F, },
+	{ 0x017D, 0x8E, },
+	{ 0x017E, 0x9E, },
+	{ 0x0192, 0x83, },
+	{ 0x02C6, 0x88, },
+	{ 0x02DC, 0x98, },
+	{ 0x2013, 0x96, },
+	{ 0x2014, 0x97, },
+	{ 0x2018, 0x91, },
+	{ 0x2019, 0x92, },
+	{ 0x201A, 0x82, },
+	{ 0x201C, 0x93, },
+	{ 0x201D, 0x94, },
+	{ 0x201E, 0x84, },
+	{ 0x2020, 0x86, },
+	{ 0x2021, 0x87, },
+	{ 0x2022, 0x95, },
+	{ 0x2026, 0x85, },
+	{ 0x2030, 0x89, },
+	{ 0x2039, 0x8B, },
+	{ 0x203A, 0x9B, },
+	{ 0x20AC, 0x80, },
+	{ 0x2122, 0x99, },
+};
+
+const long	kWinAnsiFoldsCount	= sizeof(kWinAnsiFolds) / sizeof(Fold);
+
+// Symbol, by Unicode
+const Fold kSymbolFolds[] =
+{
+	{ 0x0020, 0x20, },
+	{ 0x0021, 0x21, },
+	{ 0x0023, 0x23, },
+	{ 0x0025, 0x25, },
+	{ 0x0026, 0x26, },
+	{ 0x0028, 0x28, },
+	{ 0x0029, 0x29, },
+	{ 0x002B, 0x2B, },
+	{ 0x002C, 0x2C, },
+	{ 0x002E, 0x2E, },
+	{ 0x002F, 0x2F, },
+	{ 0x0030, 0x30, },
+	{ 0x0031, 0x31, },
+	{ 0x0032, 0x32, },
+	{ 0x0033, 0x33, },
+	{ 0x0034, 0x34, },
+	{ 0x0035, 0x35, },
+	{ 0x0036, 0x36, },
+	{ 0x0037, 0x37, },
+	{ 0x0038, 0x38, },
+	{ 0x0039, 0x39, },
+	{ 0x003A, 0x3A, },
+	{ 0x003B, 0x3B, },
+	{ 0x003C, 0x3C, },
+	{ 0x003D, 0x3D, },
+	{ 0x003E, 0x3E, },
+	{ 0x003F, 0x3F, },
+	{ 0x005B, 0x5B, },
+	{ 0x005D, 0x5D, },
+	{ 0x005F, 0x5F, },
+	{ 0x007B, 0x7B, },
+	{ 0x007C, 0x7C, },
+	{ 0x007D, 0x7D, },
+	{ 0x00A0, 0x20, },
+	{ 0x00A9, 0xD3, },
+	{ 0x00AC, 0xD8, },
+	{ 0x00AE, 0xD2, },
+	{ 0x00B0, 0xB0, },
+	{ 0x00B1, 0xB1, },
+	{ 0x00B5, 0x6D, },
+	{ 0x00D7, 0xB4, },
+	{ 0x00F7, 0xB8, },
+	{ 0x0192, 0xA6, },
+	{ 0x0391, 0x41, },
+	{ 0x0392, 0x42, },
+	{ 0x0393, 0x47, },
+	{ 0x0394, 0x44, },
+	{ 0x0395, 0x45, },
+	{ 0x0396, 0x5A, },
+	{ 0x0397, 0x48, },
+	{ 0x0398, 0x51, },
+	{ 0x0399, 0x49, },
+	{ 0x039A, 0x4B, },
+	{ 0x039B, 0x4C, },
+	{ 0x039C, 0x4D, },
+	{ 0x039D, 0x4E, },
+	{ 0x039E, 0x58, },
+	{ 0x039F, 0x4F, },
+	{ 0x03A0, 0x50, },
+	{ 0x03A1, 0x52, },
+	{ 0x03A3, 0x53, },
+	{ 0x03A4, 0x54, },
+	{ 0x03A5, 0x55, },
+	{ 0x03A6, 0x46, },
+	{ 0x03A7, 0x43, },
+	{ 0x03A8, 0x59, },
+	{ 0x03A9, 0x57, },
+	{ 0x03B1, 0x61, },
+	{ 0x03B2, 0x62, },
+	{ 0x03B3, 0x67, },
+	{ 0x03B4, 0x64, },
+	{ 0x03B5, 0x65, },
+	{ 0x03B6, 0x7A, },
+	{ 0x03B7, 0x68, },
+	{ 0x03B8, 0x71, },
+	{ 0x03B9, 0x69, },
+	{ 0x03BA, 0x6B, },
+	{ 0x03BB, 0x6C, },
+	{ 0x03BC, 0x6D, },
+	{ 0x03BD, 0x6E, },
+	{ 0x03BE, 0x78, },
+	{ 0x03BF, 0x6F, },
+	{ 0x03C0, 0x70, },
+	{ 0x03C1, 0x72, },
+	{ 0x03C2, 0x56, },
+	{ 0x03C3, 0x73, },
+	{ 0x03C4, 0x74, },
+	{ 0x03C5, 0x75, },
+	{ 0x03C6, 0x66, },
+	{ 0x03C7, 0x63, },
+	{ 0x03C8, 0x79, },
+	{ 0x03C9, 0x77, },
+	{ 0x03D1, 0x4A, },
+	{ 0x03D2, 0xA1, },
+	{ 0x03D5, 0x6A, },
+	{ 0x03D6, 0x76, },
+	{ 0x2022, 0xB7, },
+	{ 0x2026, 0xBC, },
+	{ 0x2032, 0xA2, },
+	{ 0x2033, 0xB2, },
+	{ 0x2044, 0xA4, },
+	{ 0x20AC, 0xA0, },
+	{ 0x2111, 0xC1, },
+	{ 0x2118, 0xC3, },
+	{ 0x211C, 0xC2, },
+	{ 0x2122, 0xD4, },
+	{ 0x2126, 0x57, },
+	{ 0x2135, 0xC0, },
+	{ 0x2190, 0xAC, },
+	{ 0x2191, 0xAD, },
+	{ 0x2192, 0xAE, },
+	{ 0x2193, 0xAF, },
+	{ 0x2194, 0xAB, },
+	{ 0x21B5, 0xBF, },
+	{ 0x21D0, 0xDC, },
+	{ 0x21D1, 0xDD, },
+	{ 0x21D2, 0xDE, },
+	{ 0x21D3, 0xDF, },
+	{ 0x21D4, 0xDB, },
+	{ 0x2200, 0x22, },
+	{ 0x2202, 0xB6, },
+	{ 0x2203, 0x24, },
+	{ 0x2205, 0xC6, },
+	{ 0x2206, 0x44, },
+	{ 0x2207, 0xD1, },
+	{ 0x2208, 0xCE, },
+	{ 0x2209, 0xCF, },
+	{ 0x220B, 0x27, },
+	{ 0x220F, 0xD5, },
+	{ 0x2211, 0xE5, },
+	{ 0x2212, 0x2D, },
+	{ 0x2217, 0x2A, },
+	{ 0x221A, 0xD6, },
+	{ 0x221D, 0xB5, },
+	{ 0x221E, 0xA5, },
+	{ 0x2220, 0xD0, },
+	{ 0x2227, 0xD9, },
+	{ 0x2228, 0xDA, },
+	{ 0x2229, 0xC7, },
+	{ 0x222A, 0xC8, },
+	{ 0x222B, 0xF2, },
+	{ 0x2234, 0x5C, },
+	{ 0x223C, 0x7E, },
+	{ 0x2245, 0x40, },
+	{ 0x2248, 0xBB, },
+	{ 0x2260, 0xB9, },
+	{ 0x2261, 0xBA, },
+	{ 0x2264, 0xA3, },
+	{ 0x2265, 0xB3, },
+	{ 0x2282, 0xCC, },
+	{ 0x2283, 0xC9, },
+	{ 0x2284, 0xCB, },
+	{ 0x2286, 0xCD, },
+	{ 0x2287, 0xCA, },
+	{ 0x2295, 0xC5, },
+	{ 0x2297, 0xC4, },
+	{ 0x22A5, 0x5E, },
+	{ 0x22C5, 0xD7, },
+	{ 0x2320, 0xF3, },
+	{ 0x2321, 0xF5, },
+	{ 0x2329, 0xE1, },
+	{ 0x232A, 0xF1, },
+	{ 0x239B, 0xE6, },
+	{ 0x239C, 0xE7, },
+	{ 0x239D, 0xE8, },
+	{ 0x239E, 0xF6, },
+	{ 0x239F, 0xF7, },
+	{ 0x23A0, 0xF8, },
+	{ 0x23A1, 0xE9, },
+	{ 0x23A2, 0xEA, },
+	{ 0x23A3, 0xEB, },
+	{ 0x23A4, 0xF9, },
+	{ 0x23A5, 0xFA, },
+	{ 0x23A6, 0xFB, },
+	{ 0x23A7, 0xEC, },
+	{ 0x23A8, 0xED, },
+	{ 0x23A9, 0xEE, },
+	{ 0x23AA, 0xEF, },
+	{ 0x23AB, 0xFC, },
+	{ 0x23AC, 0xFD, },
+	{ 0x23AD, 0xFE, },
+	{ 0x23AE, 0xF4, },
+	{ 0x23AF, 0xBE, },
+	{ 0x23D0, 0xBD, },
+	{ 0x25CA, 0xE0, },
+	{ 0x2660, 0xAA, },
+	{ 0x2663, 0xA7, },
+	{ 0x2665, 0xA9, },
+	{ 0x2666, 0xA8, },
+	{ 0x3008, 0xE1, },
+	{ 0x3009, 0xF1, },
+	{ 0xF6D9, 0xD3, },
+	{ 0xF6DA, 0xD2, },
+	{ 0xF6DB, 0xD4, },
+	{ 0xF8E5, 0x60, },
+	{ 0xF8E6, 0xBD, },
+	{ 0xF8E7, 0xBE, },
+	{ 0xF8E8, 0xE2, },
+	{ 0xF8E9, 0xE3, },
+	{ 0xF8EA, 0xE4, },
+};
+
+const long	kSymbolFoldsCount	= sizeof(kSymbolFolds) / sizeof(Fold);
+
+}
+
+#endif